@@ -0,0 +1,79 @@
+#ifndef Backplanes_h
+#define Backplanes_h
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <csm.h>
+
+#include "ImageWindow.h"
+
+class GDALDataset;
+class MdisNacSensorModel;
+
+/**
+ * Computes the geometric backplanes of a frame in one pass: every pixel is intersected with
+ * the body once (imageToGround) and all of its backplanes are derived from that ground
+ * point, the sensor position and the sun position.
+ *
+ * The body is a sphere (as in MdisNacSensorModel::intersect), so the surface normal is the
+ * direction of the ground point and latitudes are planetocentric.  Pixels that miss the
+ * body are NaN in every backplane.
+ */
+class Backplanes {
+
+  public:
+    /** The backplanes, in band order. */
+    enum Backplane {
+      LATITUDE,       //!< Planetocentric latitude (degrees).
+      LONGITUDE,      //!< Positive east longitude, 0 to 360 (degrees).
+      RADIUS,         //!< Distance of the ground point from the body center (km).
+      INCIDENCE,      //!< Angle between the surface normal and the sun (degrees).
+      EMISSION,       //!< Angle between the surface normal and the sensor (degrees).
+      PHASE,          //!< Angle between the sun and the sensor seen from the ground (degrees).
+      RESOLUTION,     //!< Pixel resolution (meters per pixel).
+      NUM_BACKPLANES
+    };
+
+    static const char *name(Backplane backplane);
+
+    Backplanes(const MdisNacSensorModel &model);
+
+    void computePixel(const csm::ImageCoord &imagePoint, float *values,
+                      size_t bandStride) const;
+    void computeRow(const ImageWindow &window, int row, float *values,
+                    size_t bandStride) const;
+
+  private:
+    const MdisNacSensorModel &m_model;  //!< The model of the frame.
+    csm::EcefCoord m_sensorPosition;    //!< Position of the sensor (body-fixed meters).
+};
+
+
+/**
+ * Writes the backplanes of a window as a float32 GeoTIFF, one band per backplane, through
+ * GDAL.  NaN marks the pixels that miss the body.
+ */
+class BackplaneWriter {
+
+  public:
+    BackplaneWriter();
+    ~BackplaneWriter();
+
+    bool open(const std::string &filename, const ImageWindow &window);
+    bool write(int startRow, int rows, const float *values);
+    bool close();
+
+  private:
+    // Not copyable; the writer owns the dataset.
+    BackplaneWriter(const BackplaneWriter &other);
+    BackplaneWriter &operator=(const BackplaneWriter &other);
+
+    GDALDataset *m_dataset;   //!< The output file.
+    std::string m_filename;   //!< Name of the output file, for error messages.
+    int m_samples;            //!< Width of the output grid.
+    bool m_failed;            //!< True if a write failed.
+};
+
+#endif
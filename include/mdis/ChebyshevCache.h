@@ -0,0 +1,92 @@
+#ifndef ChebyshevCache_h
+#define ChebyshevCache_h
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * Chebyshev polynomials fitted to a vector-valued function of time (e.g. a spacecraft's
+ * position and a camera-to-body-fixed rotation from SPICE), so that times inside the fitted
+ * windows are answered without sampling the function again.
+ *
+ * A window is split into segments, each fitted with a polynomial of the same degree per
+ * component through the Chebyshev nodes.  Every segment is checked against the function at
+ * the points between its nodes and at its ends, and bisected until each component is within
+ * its tolerance there; the largest errors found are kept as the cache's error bound.  A
+ * segment shorter than the minimum span that still misses a tolerance fails the fit.
+ *
+ * The segments can be saved to a file and loaded again by later jobs.
+ */
+class ChebyshevCache {
+
+  public:
+    /** Samples the function at a time; returns false if it cannot. */
+    typedef std::function<bool(double time, double *values)> Sampler;
+
+    ChebyshevCache();
+    ChebyshevCache(const std::vector<double> &tolerances, int degree, double minimumSpan);
+
+    bool fit(const Sampler &sample, double start, double end);
+    bool evaluate(double time, double *values, double *rates = NULL) const;
+    bool covers(double start, double end) const;
+    void clear();
+
+    bool save(const std::string &filename) const;
+    bool load(const std::string &filename);
+
+    /** Returns true if a time is inside a fitted window. */
+    bool covers(double time) const {
+      return covers(time, time);
+    }
+
+    /** Returns the number of values of the function. */
+    int components() const {
+      return m_tolerances.size();
+    }
+
+    /** Returns the number of fitted segments. */
+    size_t segments() const {
+      return m_segments.size();
+    }
+
+    /** Returns the largest error of each component found by the checks of the fits. */
+    const std::vector<double> &errors() const {
+      return m_errors;
+    }
+
+    /** Returns what the cache was fitted to, as set by setLabel(). */
+    const std::string &label() const {
+      return m_label;
+    }
+
+    /** Sets what the cache is fitted to (e.g. the target), which is saved with it. */
+    void setLabel(const std::string &label) {
+      m_label = label;
+    }
+
+  private:
+    /** A fitted interval: its Chebyshev coefficients, component by component. */
+    struct Segment {
+      double start;
+      double end;
+      std::vector<double> coefficients;
+
+      bool operator<(const Segment &other) const {
+        return start < other.start;
+      }
+    };
+
+    bool fitSegment(const Sampler &sample, double start, double end, int depth);
+    const Segment *find(double time) const;
+
+    std::vector<double> m_tolerances;   //!< The largest error allowed for each component.
+    std::vector<double> m_errors;       //!< The largest error found for each component.
+    int m_degree;                       //!< The degree of the polynomials.
+    double m_minimumSpan;               //!< The shortest segment to bisect.
+    std::string m_label;                //!< What the cache is fitted to.
+    std::vector<Segment> m_segments;    //!< The segments, sorted by time.
+};
+
+#endif
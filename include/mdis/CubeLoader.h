@@ -0,0 +1,43 @@
+#ifndef CubeLoader_h
+#define CubeLoader_h
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * Loads many files (e.g. the cubes of a batch job) into memory with many reads in flight, so
+ * a fast disk array is kept busy while the files that are already loaded are processed.
+ *
+ * Each file is read whole, in chunks of chunkSize bytes, and at most maxFiles files are held
+ * in memory at once.  A loader thread keeps up to queueDepth chunk reads of the next files in
+ * flight, through Linux io_uring when the library is built with USE_LIBURING and otherwise
+ * with pread on a pool of threads.  The files are handed to the consumer in the order they
+ * were given, on the thread that called load(), while the following files are being read.
+ */
+class CubeLoader {
+
+  public:
+    /**
+     * Processes a loaded file.
+     * @param index The index of the file in the list given to load().
+     * @param data The contents of the file, or NULL if it could not be read.
+     * @param size The size of the file.
+     * @return false to stop loading.
+     */
+    typedef std::function<bool(int index, const unsigned char *data, size_t size)> Consumer;
+
+    CubeLoader(int queueDepth = 64, int maxFiles = 4, size_t chunkSize = 1 << 20);
+
+    bool load(const std::vector<std::string> &filenames, const Consumer &consumer);
+
+    static bool usesIoUring();
+
+  private:
+    int m_queueDepth;     //!< Most chunk reads in flight at once.
+    int m_maxFiles;       //!< Most files in memory at once.
+    size_t m_chunkSize;   //!< Size of one read.
+};
+
+#endif
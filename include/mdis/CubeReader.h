@@ -0,0 +1,129 @@
+#ifndef CubeReader_h
+#define CubeReader_h
+
+#include <cstddef>
+#include <map>
+#include <string>
+
+/**
+ * Reads the pixels of an ISIS cube with an attached label straight from a memory map of the
+ * file (or from a copy of the file already in memory), without GDAL.
+ *
+ * The label is parsed for the layout of the core (BandSequential or Tile), the pixel type,
+ * byte order, base and multiplier.  The core is divided into blocks: a whole band for a
+ * BandSequential cube, one tile for a Tile cube.  Each block is stored line-major, so when
+ * the pixels are native floats that need no scaling (see isDirect()) a block can be used in
+ * place through block() without copying anything.  read() converts any other cube to float
+ * (applying the base and multiplier, and mapping special pixels to their ISIS float values).
+ */
+class CubeReader {
+
+  public:
+    /** The layouts of the core. */
+    enum Format {
+      BAND_SEQUENTIAL_FORMAT,
+      TILE_FORMAT
+    };
+
+    /** The pixel types of the core. */
+    enum PixelType {
+      UNSIGNED_BYTE,
+      SIGNED_WORD,
+      UNSIGNED_WORD,
+      SIGNED_INTEGER,
+      REAL
+    };
+
+    static bool isCube(const std::string &filename);
+
+    CubeReader();
+    ~CubeReader();
+
+    bool open(const std::string &filename);
+    bool open(const std::string &filename, const unsigned char *data, size_t size);
+    void close();
+
+    const float *block(int band, int blockRow, int blockColumn) const;
+    bool read(float *destination, size_t lineSpace, int band, int startSample, int startLine,
+              int samples, int lines) const;
+    std::string instrumentValue(const std::string &keyword) const;
+
+    /** Returns true if a cube is open. */
+    bool isOpen() const {
+      return m_map != NULL;
+    }
+
+    /**
+     * Returns true if the pixels are floats in the host's byte order with no scaling, so
+     * block() can return them in place.
+     */
+    bool isDirect() const {
+      return m_pixelType == REAL && !m_swap && m_base == 0.0 && m_multiplier == 1.0;
+    }
+
+    int samples() const {
+      return m_samples;
+    }
+
+    int lines() const {
+      return m_lines;
+    }
+
+    int bands() const {
+      return m_bands;
+    }
+
+    Format format() const {
+      return m_format;
+    }
+
+    PixelType pixelType() const {
+      return m_pixelType;
+    }
+
+    double base() const {
+      return m_base;
+    }
+
+    double multiplier() const {
+      return m_multiplier;
+    }
+
+    int blockSamples() const {
+      return m_blockSamples;
+    }
+
+    int blockLines() const {
+      return m_blockLines;
+    }
+
+  private:
+    // Not copyable; the reader owns the map.
+    CubeReader(const CubeReader &other);
+    CubeReader &operator=(const CubeReader &other);
+
+    bool parseCube();
+    bool parseLabel(const char *label, size_t size);
+    const unsigned char *pixel(int band, int line, int sample) const;
+    void convert(const unsigned char *source, int count, float *destination) const;
+
+    const unsigned char *m_map;   //!< The whole file, mapped read-only or in memory.
+    size_t m_mapSize;         //!< Size of the file.
+    bool m_mapped;            //!< True if the reader mapped the file (and unmaps it).
+    std::string m_filename;   //!< Name of the open cube, for error messages.
+    size_t m_coreStart;       //!< Offset of the core in the file.
+    Format m_format;          //!< Layout of the core.
+    PixelType m_pixelType;    //!< Type of the stored pixels.
+    int m_pixelSize;          //!< Size of a stored pixel in bytes.
+    bool m_swap;              //!< True if the core's byte order is not the host's.
+    double m_base;            //!< Added to every stored (non-special) pixel.
+    double m_multiplier;      //!< Stored (non-special) pixels are multiplied by this.
+    int m_samples;            //!< Width of the cube.
+    int m_lines;              //!< Height of the cube.
+    int m_bands;              //!< Number of bands.
+    int m_blockSamples;       //!< Width of a block (a tile, or the whole band).
+    int m_blockLines;         //!< Height of a block (a tile, or the whole band).
+    std::map<std::string, std::string> m_instrument;  //!< The IsisCube/Instrument keywords.
+};
+
+#endif
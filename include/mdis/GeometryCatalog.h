@@ -0,0 +1,126 @@
+#ifndef GeometryCatalog_h
+#define GeometryCatalog_h
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class MdisNacSensorModel;
+
+/**
+ * Observation geometry of one image, from its model sampled on a sparse grid of pixels.
+ * Angles and coordinates are in degrees (planetocentric latitude, positive east longitude
+ * from 0 to 360) and the body is a sphere, as in Backplanes.  Values that cannot be
+ * computed (e.g. the center pixel misses the body) are NaN.
+ */
+struct ImageSummary {
+  double centerLatitude;        //!< Latitude of the center pixel.
+  double centerLongitude;       //!< Longitude of the center pixel.
+  double minLatitude;           //!< Southernmost latitude of the footprint.
+  double maxLatitude;           //!< Northernmost latitude of the footprint.
+  double westLongitude;         //!< Westernmost longitude of the footprint.
+  double eastLongitude;         //!< Easternmost longitude; below westLongitude if the
+                                //!< footprint crosses longitude 0.
+  double groundSampleDistance;  //!< Pixel resolution at the center (meters per pixel).
+  double emission;              //!< Emission angle at the center.
+  double incidence;             //!< Incidence angle at the center; NaN without a sun position.
+  double altitude;              //!< Height of the spacecraft above the surface (km).
+  double coverage;              //!< Fraction of the grid points that are on the body.
+};
+
+bool summarizeImage(const MdisNacSensorModel &model, int gridSize, ImageSummary &summary);
+
+
+/**
+ * The header of one column of a catalog file.
+ */
+struct CatalogColumnRecord {
+  char name[24];      //!< Column name, NUL padded.
+  uint64_t offset;    //!< Byte offset of the column's values from the start of the file.
+};
+
+/**
+ * Writes image summaries as a columnar catalog file, so a query over a whole mission reads
+ * only the columns it needs instead of every model.
+ *
+ * File layout (all integers and doubles are native byte order):
+ *
+ *   header   "MDISCATL" magic, uint32 version, uint32 column count, uint64 row count,
+ *            uint64 image identifier offset                                         (32 bytes)
+ *   columns  one CatalogColumnRecord per column
+ *   values   for each column, one double per row, in row order
+ *   ids      uint64 start of each row's image identifier in the strings, plus the end of
+ *            the last one (row count + 1 values), then the identifiers' text
+ *
+ * Rows are kept in memory and the file is written by close().
+ */
+class CatalogWriter {
+
+  public:
+    CatalogWriter();
+    ~CatalogWriter();
+
+    bool open(const std::string &filename);
+    void add(const std::string &imageId, const ImageSummary &summary);
+    bool close();
+
+    /** Returns the number of rows added so far. */
+    size_t size() const {
+      return m_ids.size();
+    }
+
+  private:
+    std::string m_filename;                 //!< The catalog being written.
+    bool m_open;                            //!< True between open() and close().
+    std::vector<std::string> m_ids;         //!< Image identifier of every row.
+    std::vector<ImageSummary> m_summaries;  //!< Summary of every row.
+};
+
+/**
+ * Read-only, memory-mapped view of a catalog file.  Columns are looked up by name and
+ * returned as pointers into the mapping; nothing is copied.
+ */
+class Catalog {
+
+  public:
+    Catalog();
+    ~Catalog();
+
+    bool open(const std::string &filename);
+    void close();
+
+    const double *column(const std::string &name) const;
+    std::string columnName(size_t index) const;
+    std::string imageId(size_t row) const;
+
+    /** Returns the number of rows (images) in the catalog. */
+    size_t size() const {
+      return m_rows;
+    }
+
+    /** Returns the number of columns in the catalog. */
+    size_t columns() const {
+      return m_columnCount;
+    }
+
+    /** Returns the values of the index-th column. */
+    const double *column(size_t index) const {
+      return reinterpret_cast<const double *>(m_map + m_columns[index].offset);
+    }
+
+  private:
+    // Not copyable; the catalog owns the mapping.
+    Catalog(const Catalog &other);
+    Catalog &operator=(const Catalog &other);
+
+    const char *m_map;                      //!< The mapped file.
+    size_t m_mapSize;                       //!< Size of the mapping.
+    const CatalogColumnRecord *m_columns;   //!< The column headers, in the mapping.
+    size_t m_columnCount;                   //!< Number of columns.
+    size_t m_rows;                          //!< Number of rows.
+    const uint64_t *m_idStarts;             //!< Start of each image identifier in m_idText.
+    const char *m_idText;                   //!< The image identifiers.
+};
+
+#endif
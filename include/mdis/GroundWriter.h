@@ -0,0 +1,85 @@
+#ifndef GroundWriter_h
+#define GroundWriter_h
+
+#include <string>
+
+#include "ImageWindow.h"
+
+namespace csm {
+  struct EcefCoord;
+}
+
+/**
+ * Writes the ground grid of an image: the DN and ground coordinates of every pixel, as
+ * body-fixed X, Y, Z (km), latitude and longitude (degrees) and height (km), or east, north,
+ * up (km) in a local frame.
+ *
+ * The grid is the output grid of an ImageWindow: a region of interest of the image, sampled
+ * with a stride.  Rows are written in order, a strip at a time, so a writer never holds more
+ * than the strip it is given.  The binary formats store four float64 bands (DN and the three
+ * coordinates) in band-sequential order:
+ *
+ *   CSV_FORMAT    "Line, Sample, DN, X (km), Y (km), Z (km)" text records, for debugging.
+ *   GTIFF_FORMAT  A four band float64 GeoTIFF, written through GDAL.
+ *   ENVI_FORMAT   A raw band-sequential file and an ENVI .hdr header next to it.
+ *   NPY_FORMAT    A NumPy .npy file holding a (4, lines, samples) array.
+ *
+ * The raw ENVI and NumPy files have no compression or padding, so readers can mmap them.
+ */
+class GroundWriter {
+
+  public:
+    /** The output formats. */
+    enum Format {
+      CSV_FORMAT,
+      GTIFF_FORMAT,
+      ENVI_FORMAT,
+      NPY_FORMAT
+    };
+
+    /** The coordinates of the ground points. */
+    enum Coordinates {
+      ECEF_COORDINATES,       //!< Body-fixed x, y, z.
+      GEODETIC_COORDINATES,   //!< Latitude, longitude (radians) and height.
+      ENU_COORDINATES         //!< East, north, up in a local frame.
+    };
+
+    static GroundWriter *create(Format format, Coordinates coordinates = ECEF_COORDINATES);
+    static bool findFormat(const std::string &name, Format &format);
+    static bool findCoordinates(const std::string &name, Coordinates &coordinates);
+    static const char *extension(Format format);
+
+    GroundWriter() : m_coordinates(ECEF_COORDINATES) {}
+
+    virtual ~GroundWriter() {}
+
+    /**
+     * Creates the output file for the output grid of a window
+     * (window.outputSamples() x window.outputLines() pixels).
+     * @return false if the file could not be created.
+     */
+    virtual bool open(const std::string &filename, const ImageWindow &window) = 0;
+
+    /**
+     * Writes a strip of whole rows of the grid.  Strips must be written in row order.
+     * @param startRow The 0-based first row of the strip.
+     * @param rows The number of rows in the strip.
+     * @param dn The DN of each pixel of the strip, row-major.
+     * @param ground The ground point of each pixel of the strip, row-major, in the writer's
+     *               coordinates (lengths in meters, angles in radians).
+     * @return false if the strip could not be written.
+     */
+    virtual bool write(int startRow, int rows, const float *dn,
+                       const csm::EcefCoord *ground) = 0;
+
+    /**
+     * Finishes and closes the output file.
+     * @return false if this or an earlier write failed.
+     */
+    virtual bool close() = 0;
+
+  protected:
+    Coordinates m_coordinates;   //!< The coordinates of the ground points.
+};
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef ImageId_h
+#define ImageId_h
+
+#include <string>
+
+/**
+ * Returns the image identifier for an ISD file: its file name without directory and
+ * extensions (e.g. data/EN1007907102M.json -> EN1007907102M).  Everything from the first
+ * dot of the name on is dropped, so EN1007907102M.isd.json has the same identifier.
+ *
+ * The catalog and isdarchive apps both key images this way, so an archive built from ISD
+ * files and a catalog built from the same files agree on the identifiers.
+ *
+ * @param path Path of the ISD file.
+ */
+inline std::string imageIdFromPath(const std::string &path) {
+  size_t slash = path.find_last_of('/');
+  std::string name = (slash == std::string::npos) ? path : path.substr(slash + 1);
+  return name.substr(0, name.find_first_of('.'));
+}
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef ImageWindow_h
+#define ImageWindow_h
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+/**
+ * A region of interest of an image and the stride it is sampled with.
+ *
+ * The window covers image samples [startSample, startSample + samples) and lines
+ * [startLine, startLine + lines), 0-based.  Every sampleStride-th sample of every
+ * lineStride-th line, starting with the first, is a pixel of the output grid, which is
+ * addressed by (row, column).
+ */
+struct ImageWindow {
+  int startSample;    //!< 0-based first image sample.
+  int startLine;      //!< 0-based first image line.
+  int samples;        //!< Width of the window in image samples.
+  int lines;          //!< Height of the window in image lines.
+  int sampleStride;   //!< Distance between the samples of the output grid.
+  int lineStride;     //!< Distance between the lines of the output grid.
+
+  ImageWindow() :
+      startSample(0), startLine(0), samples(0), lines(0), sampleStride(1), lineStride(1) {
+  }
+
+  ImageWindow(int startSample, int startLine, int samples, int lines, int sampleStride = 1,
+              int lineStride = 1) :
+      startSample(startSample), startLine(startLine), samples(samples), lines(lines),
+      sampleStride(sampleStride), lineStride(lineStride) {
+  }
+
+  /** Returns the number of columns of the output grid. */
+  int outputSamples() const {
+    return (samples + sampleStride - 1) / sampleStride;
+  }
+
+  /** Returns the number of rows of the output grid. */
+  int outputLines() const {
+    return (lines + lineStride - 1) / lineStride;
+  }
+
+  /** Returns the 0-based image sample of an output column. */
+  int imageSample(int column) const {
+    return startSample + column * sampleStride;
+  }
+
+  /** Returns the 0-based image line of an output row. */
+  int imageLine(int row) const {
+    return startLine + row * lineStride;
+  }
+
+  /**
+   * Sets up a window from the --roi and --stride options of the apps.
+   *
+   * @param roi "SAMPLE,LINE,SAMPLES,LINES" (1-based first pixel and size), or empty for the
+   *            whole image.
+   * @param stride "N" or "SAMPLES,LINES", or empty for every pixel.
+   * @param imageSamples The width of the image.
+   * @param imageLines The height of the image.
+   * @param window Receives the window.
+   *
+   * @return @b bool false (after printing why) if an option is malformed or the region of
+   *                 interest is not inside the image.
+   */
+  static bool parse(const std::string &roi, const std::string &stride, int imageSamples,
+                    int imageLines, ImageWindow &window) {
+    window = ImageWindow(0, 0, imageSamples, imageLines);
+
+    if (!roi.empty()) {
+      int sample, line, samples, lines;
+      if (sscanf(roi.c_str(), "%d,%d,%d,%d", &sample, &line, &samples, &lines) != 4 ||
+          sample < 1 || line < 1 || samples < 1 || lines < 1 ||
+          sample - 1 + samples > imageSamples || line - 1 + lines > imageLines) {
+        std::cout << "The region of interest " << roi << " is not inside the "
+                  << imageSamples << " x " << imageLines << " image." << std::endl;
+        return false;
+      }
+      window.startSample = sample - 1;
+      window.startLine = line - 1;
+      window.samples = samples;
+      window.lines = lines;
+    }
+
+    if (!stride.empty()) {
+      int count = sscanf(stride.c_str(), "%d,%d", &window.sampleStride, &window.lineStride);
+      if (count == 1) {
+        window.lineStride = window.sampleStride;
+      }
+      if (count < 1 || window.sampleStride < 1 || window.lineStride < 1) {
+        std::cout << "The stride " << stride << " is not valid." << std::endl;
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef IsdArchive_h
+#define IsdArchive_h
+
+#include <cstddef>
+#include <cstdio>
+#include <set>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace csm {
+  class Isd;
+}
+
+/**
+ * Single-file archive of ISDs with an index keyed by image identifier (e.g. a product ID).
+ *
+ * File layout (all integers are native byte order):
+ *
+ *   header   "MDISISDA" magic, uint32 version (2), uint32 reserved,
+ *            uint64 offset of the current trailer (0 before the first close)        (24 bytes)
+ *   payloads ISD text for each entry, each starting on an 8 byte boundary
+ *   index    one IsdArchiveRecord per entry, sorted by image identifier
+ *   strings  the image identifiers referenced by the index records
+ *   trailer  uint64 index offset, uint64 entry count, uint64 strings offset,
+ *            "MDISIDX1" magic                                                       (32 bytes)
+ *
+ * Appending writes the new payloads, a new index of every entry and a new trailer after
+ * the current trailer, and only then points the header at the new trailer.  The payloads
+ * already stored are never touched, and an append that fails part way leaves the archive
+ * as it was.
+ */
+struct IsdArchiveRecord {
+  uint64_t offset;    //!< Byte offset of the ISD payload from the start of the file.
+  uint64_t size;      //!< Size of the ISD payload in bytes.
+  uint64_t idOffset;  //!< Byte offset of the image identifier from the start of the file.
+  uint32_t idLength;  //!< Length of the image identifier in bytes.
+  uint32_t reserved;
+};
+
+
+/**
+ * Builds an IsdArchive.  Entries are appended; the sorted index is written by close().
+ */
+class IsdArchiveWriter {
+
+  public:
+    IsdArchiveWriter();
+    ~IsdArchiveWriter();
+
+    bool open(const std::string &filename);
+    bool add(const std::string &imageId, const char *data, size_t size);
+    bool addFile(const std::string &imageId, const std::string &isdFile);
+    bool close();
+
+    /** Returns true if an archive is open for writing. */
+    bool isOpen() const {
+      return m_file != NULL;
+    }
+
+    /** Returns the number of entries in the archive, including previously stored ones. */
+    size_t size() const {
+      return m_entries.size();
+    }
+
+  private:
+    struct PendingEntry {
+      std::string imageId;
+      uint64_t offset;
+      uint64_t size;
+    };
+
+    std::FILE *m_file;                    //!< The archive being written.
+    std::string m_filename;               //!< Name of the archive being written.
+    uint64_t m_end;                       //!< Offset one past the last payload byte.
+    std::vector<PendingEntry> m_entries;  //!< Every entry of the archive.
+    std::set<std::string> m_ids;          //!< Identifiers already in the archive.
+};
+
+
+/**
+ * Read-only, memory-mapped view of an IsdArchive.  Lookups binary search the index in the
+ * mapped file and return pointers into the mapping; nothing is copied.
+ */
+class IsdArchive {
+
+  public:
+    IsdArchive();
+    ~IsdArchive();
+
+    bool open(const std::string &filename);
+    void close();
+
+    bool find(const std::string &imageId, const char **data, size_t *size) const;
+    csm::Isd *readISD(const std::string &imageId) const;
+    std::string imageId(size_t index) const;
+
+    /** Returns the number of ISDs in the archive. */
+    size_t size() const {
+      return m_count;
+    }
+
+    /** Returns the index record of the index-th entry (sorted by image identifier). */
+    const IsdArchiveRecord &record(size_t index) const {
+      return m_records[index];
+    }
+
+    /** Returns a pointer to the payload of the index-th entry. */
+    const char *data(size_t index) const {
+      return m_map + m_records[index].offset;
+    }
+
+  private:
+    // Archives are not copyable; they own their mapping.
+    IsdArchive(const IsdArchive &);
+    IsdArchive &operator=(const IsdArchive &);
+
+    std::string m_filename;              //!< Name of the mapped archive.
+    const char *m_map;                   //!< Start of the mapped file.
+    size_t m_mapSize;                    //!< Size of the mapped file.
+    const IsdArchiveRecord *m_records;   //!< Index records inside the mapping.
+    size_t m_count;                      //!< Number of index records.
+};
+
+#endif
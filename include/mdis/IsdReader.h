@@ -19,9 +19,22 @@ enum DataType {
   UNKNOWN
 };
 
-void addParam(csm::Isd &isd, json::iterator, DataType dt, int prec=12);
+//The JSON parsers an ISD can be read with.  readISD uses simdjson when the library is built
+//with USE_SIMDJSON and nlohmann::json otherwise.
+enum IsdParser {
+  NLOHMANN_PARSER,
+  SIMDJSON_PARSER
+};
+
+//prec is the number of significant digits floats are written to the ISD with; 0 writes the
+//shortest text that reads back to the same double.
+void addParam(csm::Isd &isd, json::iterator, DataType dt, int prec=0);
+void addParams(csm::Isd &isd, json &jsonFile, int prec=0);
 DataType checkType(json::value_type obj);
 csm::Isd *readISD(string filename);
+csm::Isd *readISD(const char *data, size_t size, string filename);
+csm::Isd *readISD(const char *data, size_t size, string filename, IsdParser parser);
+bool isdParserAvailable(IsdParser parser);
 void printISD(const csm::Isd &isd);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,99 @@
+#ifndef IsdWriter_h
+#define IsdWriter_h
+
+#include <cstddef>
+#include <string>
+
+#include "TextBuffer.h"
+
+/**
+ * The values of an MDIS NAC ISD (see MdisIsdView for the keywords they are written as).
+ * Positions are body-fixed meters, the body axes kilometers and the angles radians.
+ */
+struct MdisIsd {
+  std::string instrumentId;
+  std::string spacecraftName;
+  std::string targetName;
+  double ephemerisTime;
+  double focalLength;
+  double focalLengthEpsilon;
+  double pixelPitch;
+  double ccdCenter;
+  double ifov;
+  int nLines;
+  int nSamples;
+  double originalHalfLines;
+  double originalHalfSamples;
+  double startingDetectorSample;
+  double startingDetectorLine;
+  double boresight[3];
+  double transX[3];
+  double transY[3];
+  double iTransS[3];
+  double iTransL[3];
+  double odtX[9];
+  double odtY[9];
+  double semiMajorAxis;
+  double semiMinorAxis;
+  double sensorPosition[3];
+  double omega;
+  double phi;
+  double kappa;
+  double sunPosition[3];
+  double sensorCoefficients[15];   //!< Sensor position polynomial around ephemerisTime.
+  double sunCoefficients[15];      //!< Sun position polynomial around ephemerisTime.
+};
+
+
+/**
+ * Serializes ISDs into one reused buffer, as JSON or in the binary ISD format, so writing a
+ * batch of ISDs allocates nothing once the buffer has grown to the size of one.
+ *
+ * JSON is written field by field (numbers as the shortest text that reads back to the same
+ * double, text escaped), either from an MdisIsd with the keywords MdisIsdView reads or from
+ * arbitrary typed fields.  The binary format is the ISD's strings, each as a uint32 length
+ * and the text, then its numbers as native doubles in a fixed order; readBinary() reads it
+ * back exactly.
+ */
+class IsdWriter {
+
+  public:
+    IsdWriter();
+
+    void beginJSON();
+    void field(const char *key, double value);
+    void field(const char *key, const std::string &text);
+    void field(const char *key, const double *values, int count);
+    void endJSON();
+
+    void appendJSON(const MdisIsd &isd);
+    void appendBinary(const MdisIsd &isd);
+    static bool readBinary(const char *bytes, size_t size, MdisIsd &isd);
+
+    bool write(const std::string &filePath) const;
+    bool writeJSON(const MdisIsd &isd, const std::string &filePath);
+
+    /** Empties the buffer, keeping its memory. */
+    void clear() {
+      m_buffer.clear();
+    }
+
+    /** Returns the serialized ISDs. */
+    const char *data() const {
+      return m_buffer.data();
+    }
+
+    /** Returns the number of bytes of the serialized ISDs. */
+    size_t size() const {
+      return m_buffer.size();
+    }
+
+  private:
+    void key(const char *key);
+    void appendText(const std::string &text);
+
+    TextBuffer m_buffer;   //!< The serialized ISDs.
+    bool m_firstField;     //!< Whether the next JSON field is the first of its object.
+};
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef MdisIsdView_h
+#define MdisIsdView_h
+
+#include <string>
+#include <vector>
+
+namespace csm {
+  class Isd;
+}
+
+/**
+ * Pre-indexed view of the MDIS keywords of an ISD.
+ *
+ * csm::Isd::param() performs a string-keyed multimap search per call, and array keywords
+ * need one call per element.  This view walks the ISD's parameters once, merging the
+ * (sorted) multimap against a sorted table of MDIS keywords, converts every value to a
+ * double and stores it in a flat array indexed by keyword.  Required keywords that are
+ * missing are collected during the same pass.
+ */
+class MdisIsdView {
+
+  public:
+    /** The MDIS keywords, in the (sorted) order of their names. */
+    enum Keyword {
+      BORESIGHT,
+      CCD_CENTER,
+      EPHEMERIS_TIME,
+      FOCAL_LENGTH,
+      FOCAL_LENGTH_EPSILON,
+      IFOV,
+      INSTRUMENT_ID,
+      ITRANS_LINE,
+      ITRANS_SAMPLE,
+      KAPPA,
+      NLINES,
+      NSAMPLES,
+      ODT_X,
+      ODT_Y,
+      OMEGA,
+      ORIGINAL_HALF_LINES,
+      ORIGINAL_HALF_SAMPLES,
+      PHI,
+      PIXEL_PITCH,
+      SEMI_MAJOR_AXIS,
+      SEMI_MINOR_AXIS,
+      SENSOR_POSITION_COEFFICIENTS,
+      SPACECRAFT_NAME,
+      STARTING_DETECTOR_LINE,
+      STARTING_DETECTOR_SAMPLE,
+      SUN_POSITION,
+      SUN_POSITION_COEFFICIENTS,
+      TARGET_NAME,
+      TRANSX,
+      TRANSY,
+      X_SENSOR_ORIGIN,
+      Y_SENSOR_ORIGIN,
+      Z_SENSOR_ORIGIN,
+      NUM_KEYWORDS
+    };
+
+    MdisIsdView(const csm::Isd &isd);
+
+    /**
+     * Returns the index-th value of a keyword converted to a double, or 0.0 if the ISD
+     * does not have it.
+     */
+    double value(Keyword keyword, int index = 0) const {
+      return m_values[s_keywords[keyword].slot + index];
+    }
+
+    /** Returns the first value of a text keyword (instrument_id, spacecraft_name, target_name). */
+    const std::string &text(Keyword keyword) const {
+      return m_text[keyword];
+    }
+
+    /** Returns true if every element of a keyword is present and non-empty. */
+    bool has(Keyword keyword) const {
+      return m_counts[keyword] == s_keywords[keyword].size;
+    }
+
+    /** Returns the required keywords that are missing, in the order they are reported. */
+    const std::vector<std::string> &missingKeywords() const {
+      return m_missingKeywords;
+    }
+
+    static const char *keywordName(Keyword keyword);
+    static int keywordSize(Keyword keyword);
+    static Keyword findKeyword(const std::string &name);
+
+  private:
+    /** Static description of one keyword. */
+    struct KeywordInfo {
+      const char *name;   //!< ISD keyword name.
+      int slot;           //!< Position of the first element in m_values.
+      int size;           //!< Number of elements.
+      bool isText;        //!< Whether the first value is kept as text.
+    };
+
+    static const int NUM_SLOTS = 96;
+
+    /** A required keyword and the message reported when it is missing. */
+    struct RequiredKeyword {
+      Keyword keyword;
+      const char *message;
+    };
+
+    static const KeywordInfo s_keywords[NUM_KEYWORDS];
+    static const RequiredKeyword s_requiredKeywords[];
+
+    double m_values[NUM_SLOTS];         //!< Keyword values, flattened.
+    int m_counts[NUM_KEYWORDS];         //!< Number of non-empty elements found per keyword.
+    std::string m_text[NUM_KEYWORDS];   //!< First value of each text keyword.
+    std::vector<std::string> m_missingKeywords;
+};
+
+#endif
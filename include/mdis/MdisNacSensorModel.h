@@ -76,6 +76,12 @@ class MdisNacSensorModel : public csm::RasterGM {
     virtual csm::EcefVector getSensorVelocity(const csm::ImageCoord &imagePt) const;
  
     virtual csm::EcefVector getSensorVelocity(double time) const;
+
+    csm::EcefCoord getSunPosition(double time) const;
+
+    double getSemiMajorAxis() const;
+
+    double getSemiMinorAxis() const;
  
     virtual csm::RasterGM::SensorPartials computeSensorPartials(int index, 
                                                                 const csm::EcefCoord &groundPt, 
@@ -251,6 +257,16 @@ class MdisNacSensorModel : public csm::RasterGM {
         
     static const std::string _SENSOR_MODEL_NAME;
 
+    /**
+     * Returns the size (meters) of a detector pixel projected to a ground point at its
+     * distance from the sensor: the range times the pixel pitch over the focal length.
+     *
+     * @param groundPt Ground point in body-fixed meters.
+     *
+     * @return @b double Returns the pixel resolution in meters per pixel.
+     */
+    double getPixelResolution(const csm::EcefCoord &groundPt) const;
+
 
                                                             
 
@@ -350,6 +366,21 @@ class MdisNacSensorModel : public csm::RasterGM {
                                bool invert = false) const;
     
   private:
+
+    /** Number of terms of the sensor and sun position polynomials, per axis. */
+    static const int STATE_TERMS = 5;
+
+    /**
+     * Evaluates a position polynomial (STATE_TERMS coefficients for x, then y, then z) and,
+     * if rates is not NULL, its derivative.
+     *
+     * @param coefficients The polynomial coefficients.
+     * @param time Seconds relative to the ephemeris time.
+     * @param values The 3 positions.
+     * @param rates The 3 velocities, or NULL.
+     */
+    void evaluateState(const double *coefficients, double time,
+                       double *values, double *rates) const;
     
     double m_transX[3];
     double m_transY[3];
@@ -360,6 +391,12 @@ class MdisNacSensorModel : public csm::RasterGM {
     double m_kappa;
     double m_focalLength;
     double m_spacecraftPosition[3];
+    double m_sunPosition[3];
+    bool m_hasSunPosition;
+    double m_sensorCoefficients[3 * STATE_TERMS];
+    bool m_hasSensorCoefficients;
+    double m_sunCoefficients[3 * STATE_TERMS];
+    bool m_hasSunCoefficients;
     double m_ccdCenter;
     double m_startingDetectorSample;
     double m_startingDetectorLine;
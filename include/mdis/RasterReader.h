@@ -0,0 +1,135 @@
+#ifndef RasterReader_h
+#define RasterReader_h
+
+#include <cstddef>
+#include <string>
+
+#include "CubeReader.h"
+#include "ImageWindow.h"
+
+class GDALDataset;
+class GDALRasterBand;
+
+/**
+ * A contiguous, 64-byte aligned buffer of float pixels in line-major order.
+ *
+ * The memory is kept between resize() calls that do not grow the buffer, so one buffer can
+ * be reused for every tile of an image.
+ */
+class RasterBuffer {
+
+  public:
+    RasterBuffer();
+    RasterBuffer(int samples, int lines);
+    ~RasterBuffer();
+
+    bool resize(int samples, int lines);
+
+    /** Returns the pixel at a (0-based) line and sample. */
+    float at(int line, int sample) const {
+      return m_data[(size_t)line * m_samples + sample];
+    }
+
+    /** Returns the first pixel of a (0-based) line. */
+    float *line(int line) {
+      return m_data + (size_t)line * m_samples;
+    }
+
+    const float *line(int line) const {
+      return m_data + (size_t)line * m_samples;
+    }
+
+    float *data() {
+      return m_data;
+    }
+
+    const float *data() const {
+      return m_data;
+    }
+
+    int samples() const {
+      return m_samples;
+    }
+
+    int lines() const {
+      return m_lines;
+    }
+
+  private:
+    // Not copyable; the buffer owns its memory.
+    RasterBuffer(const RasterBuffer &other);
+    RasterBuffer &operator=(const RasterBuffer &other);
+
+    float *m_data;        //!< The pixels.
+    size_t m_capacity;    //!< Number of pixels m_data has room for.
+    int m_samples;        //!< Width of the buffer.
+    int m_lines;          //!< Height of the buffer.
+};
+
+
+/**
+ * Reads a band of a GDAL raster (e.g. an ISIS cube) as float pixels.
+ *
+ * ISIS cubes with an attached label are read straight from a memory map of the file with a
+ * CubeReader, bypassing GDAL; block() then gives the cube's blocks in place when they hold
+ * native floats.  Everything else goes through GDAL, with reads split along the band's
+ * natural block grid (the size GDALRasterBand::GetBlockSize reports), so every RasterIO call
+ * covers whole blocks and GDAL never has to read a block more than once.
+ */
+class RasterReader {
+
+  public:
+    RasterReader();
+    ~RasterReader();
+
+    bool open(const std::string &filename, int band = 1);
+    bool open(const std::string &filename, const unsigned char *data, size_t size,
+              int band = 1);
+    void close();
+
+    bool read(RasterBuffer &buffer, int startSample, int startLine, int samples, int lines);
+    bool read(RasterBuffer &buffer, const ImageWindow &window, int startRow, int rows);
+    bool readAll(RasterBuffer &buffer);
+    const float *block(int blockRow, int blockColumn) const;
+
+    /** Returns true if a raster is open. */
+    bool isOpen() const {
+      return m_band != NULL || m_cube.isOpen();
+    }
+
+    int samples() const {
+      return m_samples;
+    }
+
+    int lines() const {
+      return m_lines;
+    }
+
+    int blockSamples() const {
+      return m_blockSamples;
+    }
+
+    int blockLines() const {
+      return m_blockLines;
+    }
+
+  private:
+    // Not copyable; the reader owns the dataset.
+    RasterReader(const RasterReader &other);
+    RasterReader &operator=(const RasterReader &other);
+
+    bool openCube(const std::string &filename, int band);
+
+    GDALDataset *m_dataset;   //!< The open raster.
+    GDALRasterBand *m_band;   //!< The band being read.
+    CubeReader m_cube;        //!< The open cube, when it is read without GDAL.
+    int m_bandNumber;         //!< The (1-based) band being read.
+    std::string m_filename;   //!< Name of the open raster, for error messages.
+    int m_samples;            //!< Width of the band.
+    int m_lines;              //!< Height of the band.
+    int m_blockSamples;       //!< Width of the band's blocks.
+    int m_blockLines;         //!< Height of the band's blocks.
+    RasterBuffer m_lineBuffer;  //!< One line of a strided window, before decimation.
+};
+
+#endif
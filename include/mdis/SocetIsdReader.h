@@ -0,0 +1,30 @@
+#ifndef SocetIsdReader_h
+#define SocetIsdReader_h
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace csm {
+  class Isd;
+}
+
+// Readers for the legacy tab-separated SOCET SET style keyword ISD, e.g.
+//
+//   ISD_SENSOR_MODEL_NAME	MDIS_SENSOR_MODEL
+//   ISD_FOCAL_LENGTH_PIXELS		549.2139159521081
+//
+// The known ISD_* keywords are mapped onto the MDIS keywords MdisPlugin reads (with unit
+// conversions); those without an MDIS equivalent (the ISD_*_ORIG_* values, the covariances,
+// ISD_SENSOR_MODEL_NAME, ...) are dropped.  Only unknown keywords are kept, under their
+// original name.
+// The format carries no instrument constants (transx, odt_x, ...), so an optional ISD of
+// instrument constants (e.g. tests/data/hardcoded.isd) fills in whatever the file lacks.
+
+csm::Isd *readSocetISD(const std::string &filename, const csm::Isd *instrument = NULL);
+csm::Isd *readSocetISD(const char *data, size_t size, const std::string &filename,
+                       const csm::Isd *instrument = NULL);
+int readSocetISDDirectory(const std::string &directory, std::vector<csm::Isd *> &isds,
+                          const csm::Isd *instrument = NULL);
+
+#endif
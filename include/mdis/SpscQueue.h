@@ -0,0 +1,123 @@
+#ifndef SpscQueue_h
+#define SpscQueue_h
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A bounded, lock-free queue between exactly one producer thread and one consumer thread.
+ *
+ * The queue is a ring buffer with one slot left empty to tell full from empty.  The producer
+ * only writes m_tail and the consumer only writes m_head, each with release ordering, so a
+ * value is fully written before the other side can see it.  The two indices are kept on
+ * separate cache lines so the threads do not contend for one line.
+ *
+ * push() and pop() wait while the queue is full or empty, which is what gives a pipeline of
+ * these queues its backpressure.  A waiting thread retries a few times, then sleeps on a
+ * condition variable until the other side pops or pushes, so a stage that waits for long
+ * (e.g. a writer waiting on a compute pool that has every core) does not take a core too.
+ * The other side only takes the mutex to wake it when a thread is asleep.
+ */
+template <typename T>
+class SpscQueue {
+
+  public:
+    /** Creates a queue that holds up to capacity values. */
+    explicit SpscQueue(size_t capacity) :
+        m_slots(capacity + 1), m_head(0), m_tail(0), m_sleepers(0) {
+    }
+
+    /** Adds a value; returns false (and does nothing) if the queue is full. */
+    bool tryPush(const T &value) {
+      size_t tail = m_tail.load(std::memory_order_relaxed);
+      size_t next = tail + 1 == m_slots.size() ? 0 : tail + 1;
+      if (next == m_head.load(std::memory_order_acquire)) {
+        return false;
+      }
+      m_slots[tail] = value;
+      m_tail.store(next, std::memory_order_release);
+      return true;
+    }
+
+    /** Removes the oldest value; returns false if the queue is empty. */
+    bool tryPop(T &value) {
+      size_t head = m_head.load(std::memory_order_relaxed);
+      if (head == m_tail.load(std::memory_order_acquire)) {
+        return false;
+      }
+      value = m_slots[head];
+      m_head.store(head + 1 == m_slots.size() ? 0 : head + 1, std::memory_order_release);
+      return true;
+    }
+
+    /** Adds a value, waiting while the queue is full. */
+    void push(const T &value) {
+      wait([&] { return tryPush(value); });
+      wake();
+    }
+
+    /** Removes the oldest value, waiting while the queue is empty. */
+    T pop() {
+      T value;
+      wait([&] { return tryPop(value); });
+      wake();
+      return value;
+    }
+
+    /** Returns the number of values the queue holds when full. */
+    size_t capacity() const {
+      return m_slots.size() - 1;
+    }
+
+  private:
+    // Not copyable; the threads share the queue.
+    SpscQueue(const SpscQueue &other);
+    SpscQueue &operator=(const SpscQueue &other);
+
+    /** Number of times a waiting thread retries before it goes to sleep. */
+    static const int SPINS = 64;
+
+    /** Calls done() until it succeeds: first spinning, then asleep between wake() calls. */
+    template <typename Done>
+    void wait(Done done) {
+      for (int i = 0; i < SPINS; i++) {
+        if (done()) {
+          return;
+        }
+        std::this_thread::yield();
+      }
+
+      // Announce the sleeper before the last check.  With the fence in wake(), either this
+      // check sees the other side's push or pop, or that side sees the sleeper and wakes it;
+      // it cannot notify in between, as this thread holds the mutex until it waits.
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_sleepers.fetch_add(1);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      while (!done()) {
+        m_changed.wait(lock);
+      }
+      m_sleepers.fetch_sub(1);
+    }
+
+    /** Wakes the other side if it is asleep in wait(). */
+    void wake() {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (m_sleepers.load(std::memory_order_relaxed) > 0) {
+        { std::lock_guard<std::mutex> lock(m_mutex); }
+        m_changed.notify_all();
+      }
+    }
+
+    std::vector<T> m_slots;                       //!< The ring buffer.
+    alignas(64) std::atomic<size_t> m_head;       //!< Next slot to pop (consumer side).
+    alignas(64) std::atomic<size_t> m_tail;       //!< Next slot to push (producer side).
+    alignas(64) std::atomic<int> m_sleepers;      //!< Threads asleep in wait().
+    std::mutex m_mutex;                           //!< Guards going to sleep.
+    std::condition_variable m_changed;            //!< Signals a push or pop to a sleeper.
+};
+
+#endif
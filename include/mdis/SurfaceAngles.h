@@ -0,0 +1,32 @@
+#ifndef SurfaceAngles_h
+#define SurfaceAngles_h
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * Angle helpers shared by the per-pixel backplanes and the per-image geometry catalog, so
+ * both report identical incidence, emission, phase and longitude values.
+ */
+
+static const double DEGREES_PER_RADIAN = 180.0 / M_PI;
+
+/**
+ * @brief Returns the angle (degrees) between two unit vectors.
+ *
+ * The cosine is clamped to [-1, 1] so rounding cannot push acos out of its domain.
+ */
+inline double angleBetween(const double a[3], const double b[3]) {
+  double cosine = a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+  return std::acos(std::max(-1.0, std::min(1.0, cosine))) * DEGREES_PER_RADIAN;
+}
+
+/**
+ * @brief Returns the positive east longitude (0 to 360 degrees) of a body-fixed point.
+ */
+inline double positiveEastLongitude(double x, double y) {
+  double longitude = std::atan2(y, x) * DEGREES_PER_RADIAN;
+  return longitude < 0.0 ? longitude + 360.0 : longitude;
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef TextBuffer_h
+#define TextBuffer_h
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Buffer size formatDouble and formatFloat need, including the terminating null.
+static const int MAX_NUMBER_LENGTH = 32;
+
+int formatDouble(double value, char *buffer);
+int formatDouble(double value, int precision, char *buffer);
+int formatFloat(float value, char *buffer);
+int formatInteger(long long value, char *buffer);
+
+/**
+ * Reusable output buffer for text files.
+ *
+ * Numbers are formatted straight into the buffer (shortest text that reads back to the same
+ * value, see formatDouble), so writing a record does not allocate.  When the buffer is
+ * attached to a file it is written out whenever it fills up; otherwise it grows and the
+ * text can be taken with str().
+ */
+class TextBuffer {
+
+  public:
+    TextBuffer(FILE *file = NULL, size_t capacity = 1 << 16);
+    ~TextBuffer();
+
+    void append(const char *text, size_t length);
+    void append(const char *text);
+    void append(const std::string &text);
+    void append(char c);
+    void appendDouble(double value);
+    void appendDouble(double value, int precision);
+    void appendFloat(float value);
+    void appendInteger(long long value);
+
+    bool flush();
+    void clear();
+
+    /** Returns the text that has not been written to the file yet. */
+    const char *data() const {
+      return m_buffer.empty() ? "" : &m_buffer[0];
+    }
+
+    /** Returns the number of bytes that have not been written to the file yet. */
+    size_t size() const {
+      return m_size;
+    }
+
+    std::string str() const;
+
+  private:
+    char *reserve(size_t length);
+
+    FILE *m_file;                 //!< File the text is written to, or NULL to keep it.
+    std::vector<char> m_buffer;   //!< Pending text.
+    size_t m_size;                //!< Number of bytes of m_buffer in use.
+    bool m_failed;                //!< Whether a write to the file has failed.
+};
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef TextKernel_h
+#define TextKernel_h
+
+#include <cstddef>
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * The variables of a NAIF text kernel (IK, FK, PCK, ...) read without CSPICE.
+ *
+ * Only the \begindata sections are parsed.  A variable is assigned with NAME = value or
+ * NAME = ( value, value, ... ), and extended with +=; a later = replaces earlier values, as
+ * in the kernel pool.  Values are numbers (with E or D exponents) or quoted strings ('' is
+ * a quote).  @ dates are numbers, UTC seconds past J2000 counting 86400 seconds a day, as in
+ * the kernel pool.
+ *
+ * loadCached() keeps a binary copy of the parsed variables in a cache directory, named by a
+ * hash of the kernel's text, so a kernel that has not changed is read back without parsing
+ * it again.
+ */
+class TextKernel {
+
+  public:
+    /** The values of one variable; either numbers or strings. */
+    struct Variable {
+      bool isString;                      //!< True if the values are strings.
+      std::vector<double> numbers;        //!< The values of a numeric variable.
+      std::vector<std::string> strings;   //!< The values of a string variable.
+    };
+
+    static uint64_t hash(const char *data, size_t size);
+    static bool parseCalendar(const std::string &text, long &day, double &seconds);
+
+    TextKernel();
+
+    bool load(const std::string &filename);
+    bool loadCached(const std::string &filename, const std::string &cacheDirectory);
+    bool parse(const char *text, size_t size, const std::string &filename);
+    void clear();
+
+    bool readCache(const std::string &cacheFile, uint64_t kernelHash);
+    bool writeCache(const std::string &cacheFile, uint64_t kernelHash) const;
+
+    const std::vector<double> *numbers(const std::string &name) const;
+    const std::vector<std::string> *strings(const std::string &name) const;
+    bool getDoubles(const std::string &name, int count, double *values) const;
+
+    /** Returns true if the kernel assigns the variable. */
+    bool has(const std::string &name) const {
+      return m_variables.find(name) != m_variables.end();
+    }
+
+    /** Returns the number of variables. */
+    size_t size() const {
+      return m_variables.size();
+    }
+
+    /** Returns true if the kernel was read from its cache by the last loadCached(). */
+    bool fromCache() const {
+      return m_fromCache;
+    }
+
+  private:
+    std::map<std::string, Variable> m_variables;  //!< The variables, by name.
+    bool m_fromCache;                             //!< True if read from the cache.
+};
+
+#endif
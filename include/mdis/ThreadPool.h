@@ -0,0 +1,56 @@
+#ifndef ThreadPool_h
+#define ThreadPool_h
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of worker threads that run parallel loops.
+ *
+ * parallelFor(count, task) calls task(i) for every i in [0, count) and returns when all of
+ * them are done.  Indices are handed out one at a time from a shared counter, so uneven
+ * tasks balance themselves, and the calling thread works on the loop too.  Tasks that write
+ * only to their own index's output produce the same result for any number of threads.
+ */
+class ThreadPool {
+
+  public:
+    ThreadPool(int threads = defaultThreads());
+    ~ThreadPool();
+
+    void parallelFor(int count, const std::function<void(int)> &task);
+
+    /** Returns the number of threads loops run on, including the calling thread. */
+    int threads() const {
+      return m_workers.size() + 1;
+    }
+
+    static int defaultThreads();
+
+  private:
+    // Not copyable; the pool owns its threads.
+    ThreadPool(const ThreadPool &other);
+    ThreadPool &operator=(const ThreadPool &other);
+
+    void work();
+    void runTasks();
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_start;        //!< Signals the workers that a loop started.
+    std::condition_variable m_done;         //!< Signals the caller that a worker finished.
+    const std::function<void(int)> *m_task; //!< The body of the current loop.
+    int m_count;                            //!< Number of indices of the current loop.
+    std::atomic<int> m_next;                //!< Next index to hand out.
+    int m_busy;                             //!< Number of workers still in the current loop.
+    unsigned long m_generation;             //!< Incremented for every loop.
+    bool m_stop;                            //!< Tells the workers to exit.
+    std::exception_ptr m_error;             //!< First exception thrown by a task.
+};
+
+#endif
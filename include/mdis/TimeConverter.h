@@ -0,0 +1,73 @@
+#ifndef TimeConverter_h
+#define TimeConverter_h
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class TextKernel;
+
+/**
+ * Converts UTC and spacecraft clock times to ephemeris time (TDB seconds past J2000) from a
+ * leapseconds kernel (LSK) and a type 1 spacecraft clock kernel (SCLK) read with
+ * TextKernel, without CSPICE or its kernel pool.
+ *
+ * The kernels are turned into lookup tables when they are loaded: TAI-UTC by day, and the
+ * clock's partitions and (encoded ticks, ephemeris time, rate) records.  The batch
+ * conversions look up each time from the interval of the previous one, so sorted times cost
+ * a comparison or two each.  ET is TDT + K sin(E), as with the DELTET model of CSPICE.
+ */
+class TimeConverter {
+
+  public:
+    TimeConverter();
+
+    bool loadLeapseconds(const TextKernel &kernel);
+    bool loadClock(const TextKernel &kernel, int spacecraftCode);
+
+    bool utcToEt(const std::string &utc, double &et) const;
+    size_t utcToEt(const std::string *utc, size_t count, double *et) const;
+    void utcSecondsToEt(const double *utc, size_t count, double *et) const;
+    void tdtToEt(const double *tdt, size_t count, double *et) const;
+
+    bool sclkToTicks(const std::string &sclk, double &ticks) const;
+    bool sclkToEt(const std::string &sclk, double &et) const;
+    size_t sclkToEt(const std::string *sclk, size_t count, double *et) const;
+    void ticksToEt(const double *ticks, size_t count, double *et) const;
+
+    /** Returns true if a leapseconds kernel has been loaded. */
+    bool hasLeapseconds() const {
+      return !m_leapDays.empty();
+    }
+
+    /** Returns true if a spacecraft clock kernel has been loaded. */
+    bool hasClock() const {
+      return !m_clockTicks.empty();
+    }
+
+  private:
+    double tdtToEt(double tdt) const;
+    double etOfUtc(double day, double seconds, size_t &leap) const;
+    double etOfTicks(double ticks, size_t &record) const;
+
+    double m_deltaTA;                   //!< TDT - TAI in seconds.
+    double m_k;                         //!< Amplitude of TDB - TDT in seconds.
+    double m_eb;                        //!< Eccentricity of the heliocentric orbit.
+    double m_m[2];                      //!< Mean anomaly at J2000 and its rate.
+    std::vector<double> m_leapDays;     //!< Days past 2000-01-01 each TAI-UTC starts on.
+    std::vector<double> m_deltaAt;      //!< TAI-UTC from each of m_leapDays.
+    std::vector<double> m_leapSeconds;  //!< UTC seconds past J2000 of each of m_leapDays.
+
+    std::vector<double> m_moduli;          //!< Modulus of each clock field.
+    std::vector<double> m_offsets;         //!< Offset of each clock field.
+    std::vector<double> m_weights;         //!< Ticks per count of each clock field.
+    std::vector<double> m_partitionStart;  //!< First clock reading of each partition.
+    std::vector<double> m_partitionEnd;    //!< Last clock reading of each partition.
+    std::vector<double> m_partitionBase;   //!< Encoded ticks at the start of each partition.
+    std::vector<double> m_clockTicks;      //!< Encoded ticks of each clock record.
+    std::vector<double> m_clockTimes;      //!< Parallel time of each clock record.
+    std::vector<double> m_clockRates;      //!< Parallel seconds per tick of each record.
+    bool m_clockTdt;                       //!< True if the parallel time is TDT, not TDB.
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef UnitQuaternion_h
+#define UnitQuaternion_h
+
+#include <cstddef>
+
+/**
+ * A unit quaternion attitude: w + xi + yj + zk.
+ *
+ * Its rotation matrix takes vectors the way the matrices of opkToRotation() do, and the
+ * product a * b has the matrix of a times the matrix of b, so attitudes compose with 16
+ * multiplications instead of a 27-multiplication matrix product.  Between two epochs an
+ * attitude is interpolated with slerp() (constant angular rate) or the cheaper nlerp()
+ * (same path, slightly uneven rate) without going through Euler angles.
+ */
+class UnitQuaternion {
+
+  public:
+    /** Creates the identity rotation. */
+    UnitQuaternion() : w(1.0), x(0.0), y(0.0), z(0.0) {
+    }
+
+    UnitQuaternion(double w, double x, double y, double z) : w(w), x(x), y(y), z(z) {
+    }
+
+    static UnitQuaternion fromRotation(const double *rotation);
+    static UnitQuaternion fromOpk(double omega, double phi, double kappa);
+
+    /** Returns the composition of two rotations: this one applied after q. */
+    UnitQuaternion operator*(const UnitQuaternion &q) const {
+      return UnitQuaternion(w * q.w - x * q.x - y * q.y - z * q.z,
+                            w * q.x + x * q.w + y * q.z - z * q.y,
+                            w * q.y - x * q.z + y * q.w + z * q.x,
+                            w * q.z + x * q.y - y * q.x + z * q.w);
+    }
+
+    /** Returns the inverse of a unit quaternion. */
+    UnitQuaternion conjugate() const {
+      return UnitQuaternion(w, -x, -y, -z);
+    }
+
+    /** Returns the dot product of two quaternions (the cosine of half the angle between). */
+    double dot(const UnitQuaternion &q) const {
+      return w * q.w + x * q.x + y * q.y + z * q.z;
+    }
+
+    UnitQuaternion normalized() const;
+    void toRotation(double *rotation) const;
+    void rotate(const double *v, double *rotated) const;
+
+    static UnitQuaternion nlerp(const UnitQuaternion &a, const UnitQuaternion &b, double t);
+    static UnitQuaternion slerp(const UnitQuaternion &a, const UnitQuaternion &b, double t);
+
+    double w;   //!< The scalar part.
+    double x;   //!< The i part.
+    double y;   //!< The j part.
+    double z;   //!< The k part.
+};
+
+void quaternionsToRotations(const UnitQuaternion *quaternions, size_t count, double *rotations);
+
+#endif
@@ -1,10 +1,25 @@
 #ifndef TRANSFORMATION_H
 #define TRANSFORMATION_H
 
+#include <cstddef>
+
 #include <Eigen/Dense>
 
 using namespace Eigen;
 
-Matrix3d opkToRotation(float omega, float phi, float kappa);
+Matrix3d opkToRotation(double omega, double phi, double kappa);
+
+void opkToRotation(const double *opk, size_t count, double *rotations,
+                   double *derivatives = NULL);
+void rotationToOpk(const double *rotations, size_t count, double *opk);
+
+void ecefToGeodetic(const double *ecef, size_t count, double semiMajor, double semiMinor,
+                    double *geodetic);
+void geodeticToEcef(const double *geodetic, size_t count, double semiMajor, double semiMinor,
+                    double *ecef);
+void ecefToEnu(const double *ecef, size_t count, const double *origin, double semiMajor,
+               double semiMinor, double *enu);
+void enuToEcef(const double *enu, size_t count, const double *origin, double semiMajor,
+               double semiMinor, double *ecef);
 
 #endif
@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <csm.h>
+#include <Error.h>
+#include <Isd.h>
+
+#include <Backplanes.h>
+#include <ImageWindow.h>
+#include <IsdReader.h>
+#include <MdisNacSensorModel.h>
+#include <MdisPlugin.h>
+#include <ThreadPool.h>
+
+using namespace std;
+
+// Upper bound on the number of pixels in one strip of the output grid, so the memory used
+// does not grow with the size of the image.
+static const int MAX_STRIP_PIXELS = 1 << 16;
+
+int main(int argc, char *argv[]) {
+  int threads = ThreadPool::defaultThreads();
+  string outputFile("backplanes.tif");
+  string roi;
+  string stride;
+  bool validArgs = true;
+
+  vector<string> files;
+  for (int i = 1; i < argc; i++) {
+    string arg(argv[i]);
+    if (arg == "--threads" && i + 1 < argc) {
+      threads = atoi(argv[++i]);
+      validArgs = validArgs && threads > 0;
+    }
+    else if ((arg == "--output" || arg == "-o") && i + 1 < argc) {
+      outputFile = argv[++i];
+    }
+    else if (arg == "--roi" && i + 1 < argc) {
+      roi = argv[++i];
+    }
+    else if (arg == "--stride" && i + 1 < argc) {
+      stride = argv[++i];
+    }
+    else {
+      files.push_back(arg);
+    }
+  }
+
+  if (files.size() != 1 || !validArgs) {
+    cout << "Usage: backplanes [--threads N] [--output FILE]\n"
+            "                  [--roi SAMPLE,LINE,SAMPLES,LINES] [--stride N|SAMPLES,LINES]\n"
+            "                  <ISD.json>\n";
+    cout << "Computes the latitude, longitude, radius, incidence, emission, phase and\n";
+    cout << "resolution of every pixel of a frame in one pass and writes them as the bands\n";
+    cout << "of a float32 GeoTIFF (default: backplanes.tif).  The ISD needs a sun_position.\n";
+    cout << "Pixels are computed on N threads (default: one per core).  --roi and --stride\n";
+    cout << "select the pixels as in set.\n";
+    return 1;
+  }
+
+  csm::Isd *isd = readISD(files[0]);
+  if (isd == nullptr) {
+    return 1;
+  }
+
+  MdisPlugin plugin;
+  MdisNacSensorModel *model = nullptr;
+  try {
+    model = dynamic_cast<MdisNacSensorModel *>(
+        plugin.constructModelFromISD(*isd, MdisNacSensorModel::_SENSOR_MODEL_NAME));
+  }
+  catch (csm::Error &e) {
+    cout << e.what() << endl;
+    delete isd;
+    return 1;
+  }
+  delete isd;
+  if (model == nullptr) {
+    cout << "Could not construct the sensor model from the plugin." << endl;
+    return 1;
+  }
+
+  csm::ImageVector size = model->getImageSize();
+  ImageWindow window;
+  if (!ImageWindow::parse(roi, stride, (int)size.samp, (int)size.line, window)) {
+    delete model;
+    return 1;
+  }
+
+  BackplaneWriter writer;
+  if (!writer.open(outputFile, window)) {
+    delete model;
+    return 1;
+  }
+
+  // Compute and write one strip of rows at a time; the rows of a strip are spread over the
+  // threads, each writing its own part of the strip.
+  Backplanes backplanes(*model);
+  ThreadPool pool(threads);
+  int samples = window.outputSamples();
+  int rowsPerStrip = max(1, min(MAX_STRIP_PIXELS / max(samples, 1), window.outputLines()));
+  vector<float> strip((size_t)Backplanes::NUM_BACKPLANES * rowsPerStrip * samples);
+  bool status = true;
+
+  for (int startRow = 0; startRow < window.outputLines() && status; startRow += rowsPerStrip) {
+    int rows = min(rowsPerStrip, window.outputLines() - startRow);
+    size_t bandStride = (size_t)rows * samples;
+    try {
+      pool.parallelFor(rows, [&](int row) {
+        backplanes.computeRow(window, startRow + row, &strip[(size_t)row * samples],
+                              bandStride);
+      });
+    }
+    catch (csm::Error &e) {
+      cout << e.what() << endl;
+      status = false;
+      break;
+    }
+    status = writer.write(startRow, rows, strip.data());
+  }
+
+  if (!writer.close()) {
+    cout << "Error while writing file \"" << outputFile << "\"." << endl;
+    status = false;
+  }
+  delete model;
+  return status ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,176 @@
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <csm.h>
+#include <Error.h>
+#include <Isd.h>
+
+#include <GeometryCatalog.h>
+#include <ImageId.h>
+#include <IsdArchive.h>
+#include <IsdReader.h>
+#include <MdisNacSensorModel.h>
+#include <MdisPlugin.h>
+#include <ThreadPool.h>
+
+using namespace std;
+
+int printCatalog(const string &catalogFile);
+
+int main(int argc, char *argv[]) {
+  if (argc == 3 && string(argv[1]) == "-p") {
+    return printCatalog(argv[2]);
+  }
+
+  int threads = ThreadPool::defaultThreads();
+  int gridSize = 9;
+  string outputFile("geometry.cat");
+  string archiveFile;
+  bool validArgs = true;
+
+  vector<string> files;
+  for (int i = 1; i < argc; i++) {
+    string arg(argv[i]);
+    if (arg == "--threads" && i + 1 < argc) {
+      threads = atoi(argv[++i]);
+      validArgs = validArgs && threads > 0;
+    }
+    else if (arg == "--grid" && i + 1 < argc) {
+      gridSize = atoi(argv[++i]);
+      validArgs = validArgs && gridSize >= 2;
+    }
+    else if ((arg == "--output" || arg == "-o") && i + 1 < argc) {
+      outputFile = argv[++i];
+    }
+    else if (arg == "--archive" && i + 1 < argc) {
+      archiveFile = argv[++i];
+    }
+    else if (arg == "--list" && i + 1 < argc) {
+      ifstream list(argv[++i]);
+      if (!list.is_open()) {
+        cout << "Could not open the list " << argv[i] << endl;
+        return 1;
+      }
+      string file;
+      while (list >> file) {
+        files.push_back(file);
+      }
+    }
+    else {
+      files.push_back(arg);
+    }
+  }
+
+  if ((files.empty() && archiveFile.empty()) || !validArgs) {
+    cout << "Usage: catalog [--threads N] [--grid N] [--output FILE] [--archive ARCHIVE]\n"
+            "               [--list FILE] [ISD.json ...]\n";
+    cout << "       catalog -p <catalog>\n";
+    cout << "Summarizes the observation geometry of every image (center latitude and\n";
+    cout << "longitude, footprint extent, ground sample distance, emission and incidence at\n";
+    cout << "the center, spacecraft altitude) from an N x N grid of its pixels (default 9),\n";
+    cout << "on N threads (default: one per core), and writes the summaries as a columnar\n";
+    cout << "catalog (default: geometry.cat).  The ISDs are the files given, the files listed\n";
+    cout << "one per line in --list, and every ISD of an ISD archive.  -p prints a catalog.\n";
+    return 1;
+  }
+
+  // Images are identified by their ISD file name, or their identifier in the archive.
+  IsdArchive archive;
+  if (!archiveFile.empty() && !archive.open(archiveFile)) {
+    return 1;
+  }
+  vector<string> imageIds;
+  for (size_t i = 0; i < files.size(); i++) {
+    imageIds.push_back(imageIdFromPath(files[i]));
+  }
+  for (size_t i = 0; i < archive.size(); i++) {
+    imageIds.push_back(archive.imageId(i));
+  }
+
+  // Summarize the images in parallel; every image writes only its own entries.
+  MdisPlugin plugin;
+  vector<ImageSummary> summaries(imageIds.size());
+  vector<string> errors(imageIds.size());
+  ThreadPool pool(threads);
+  pool.parallelFor(imageIds.size(), [&](int i) {
+    csm::Isd *isd = (size_t)i < files.size() ? readISD(files[i])
+                                              : archive.readISD(imageIds[i]);
+    if (isd == nullptr) {
+      errors[i] = "Could not read the ISD of " + imageIds[i];
+      return;
+    }
+    MdisNacSensorModel *model = nullptr;
+    try {
+      model = dynamic_cast<MdisNacSensorModel *>(
+          plugin.constructModelFromISD(*isd, MdisNacSensorModel::_SENSOR_MODEL_NAME));
+      if (model == nullptr) {
+        errors[i] = "Could not construct the sensor model of " + imageIds[i];
+      }
+      else if (!summarizeImage(*model, gridSize, summaries[i])) {
+        errors[i] = imageIds[i] + " does not see the body";
+      }
+    }
+    catch (csm::Error &e) {
+      errors[i] = imageIds[i] + ": " + e.what();
+    }
+    delete model;
+    delete isd;
+  });
+
+  CatalogWriter writer;
+  if (!writer.open(outputFile)) {
+    return 1;
+  }
+  int failures = 0;
+  for (size_t i = 0; i < imageIds.size(); i++) {
+    if (!errors[i].empty()) {
+      cout << errors[i] << endl;
+      failures++;
+      continue;
+    }
+    writer.add(imageIds[i], summaries[i]);
+  }
+  size_t rows = writer.size();
+  if (!writer.close()) {
+    cout << "Error while writing file \"" << outputFile << "\"." << endl;
+    return 1;
+  }
+
+  cout << rows << " images in " << outputFile;
+  if (failures > 0) {
+    cout << " (" << failures << " could not be summarized)";
+  }
+  cout << endl;
+  return failures == 0 ? 0 : 1;
+}
+
+
+/**
+ * Prints a catalog as tab-separated text: a header of column names, then one line per
+ * image.
+ *
+ * @param catalogFile The catalog to print.
+ */
+int printCatalog(const string &catalogFile) {
+  Catalog catalog;
+  if (!catalog.open(catalogFile)) {
+    return 1;
+  }
+  cout << "image_id";
+  for (size_t column = 0; column < catalog.columns(); column++) {
+    cout << "\t" << catalog.columnName(column);
+  }
+  cout << endl;
+  for (size_t row = 0; row < catalog.size(); row++) {
+    cout << catalog.imageId(row);
+    for (size_t column = 0; column < catalog.columns(); column++) {
+      cout << "\t" << catalog.column(column)[row];
+    }
+    cout << endl;
+  }
+  return 0;
+}
@@ -0,0 +1,79 @@
+#include <iostream>
+#include <string>
+
+#include <ImageId.h>
+#include <IsdArchive.h>
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+
+  if (argc < 3) {
+    cout << "Usage: isdarchive <archive> <ISD.json> [ISD.json ...]\n";
+    cout << "       isdarchive -l <archive>\n";
+    cout << "       isdarchive -x <archive> <image id>\n";
+    cout << "Appends ISD files to an archive (keyed by file name without extension), lists\n";
+    cout << "the image ids in an archive, or prints the ISD stored for an image id.\n";
+    return 1;
+  }
+
+  string option(argv[1]);
+
+  // List the archive contents
+  if (option == "-l") {
+    IsdArchive archive;
+    if (!archive.open(argv[2])) {
+      return 1;
+    }
+    for (size_t i = 0; i < archive.size(); i++) {
+      cout << archive.imageId(i) << "\t" << archive.record(i).size << endl;
+    }
+    return 0;
+  }
+
+  // Extract one ISD
+  if (option == "-x") {
+    if (argc != 4) {
+      cout << "Usage: isdarchive -x <archive> <image id>\n";
+      return 1;
+    }
+    IsdArchive archive;
+    if (!archive.open(argv[2])) {
+      return 1;
+    }
+    const char *data = NULL;
+    size_t size = 0;
+    if (!archive.find(argv[3], &data, &size)) {
+      cout << "Image id " << argv[3] << " is not in " << argv[2] << endl;
+      return 1;
+    }
+    cout.write(data, size);
+    cout << endl;
+    return 0;
+  }
+
+  // Append ISDs
+  IsdArchiveWriter writer;
+  if (!writer.open(argv[1])) {
+    return 1;
+  }
+
+  int failures = 0;
+  for (int i = 2; i < argc; i++) {
+    string isdFile(argv[i]);
+    if (!writer.addFile(imageIdFromPath(isdFile), isdFile)) {
+      failures++;
+    }
+  }
+
+  if (!writer.close()) {
+    return 1;
+  }
+
+  cout << writer.size() << " ISDs in " << argv[1];
+  if (failures > 0) {
+    cout << " (" << failures << " could not be added)";
+  }
+  cout << endl;
+  return failures == 0 ? 0 : 1;
+}
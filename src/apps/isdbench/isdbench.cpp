@@ -0,0 +1,143 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <csm/Isd.h>
+#include <json/json.hpp>
+
+#include <IsdReader.h>
+
+using namespace std;
+using json = nlohmann::json;
+
+vector<string> syntheticCorpus(const string &isdText, int corpusSize);
+void benchmark(const string &name, const vector<string> &corpus, int iterations);
+
+int main(int argc, char *argv[]) {
+
+  string isdFile("../../../tests/data/EN1007907102M.json");
+  int iterations = 10000;
+  int corpusSize = 10000;
+
+  if (argc > 1) {
+    isdFile = argv[1];
+  }
+  if (argc > 2) {
+    iterations = atoi(argv[2]);
+  }
+  if (argc > 3) {
+    corpusSize = atoi(argv[3]);
+  }
+  if (argc > 4 || iterations <= 0 || corpusSize <= 0) {
+    cout << "Usage: isdbench [ISD.json] [iterations] [corpus size]\n";
+    cout << "Times ISD parsing with each available JSON parser on the given ISD and on a\n";
+    cout << "synthetic corpus generated from it.\n";
+    return 1;
+  }
+
+  ifstream file(isdFile.c_str(), ios::in | ios::binary);
+  if (!file.is_open()) {
+    cout << "Could not open " << isdFile << endl;
+    return 1;
+  }
+  stringstream contents;
+  contents << file.rdbuf();
+  string isdText = contents.str();
+
+  vector<string> single(1, isdText);
+  vector<string> corpus = syntheticCorpus(isdText, corpusSize);
+
+  benchmark(isdFile, single, iterations);
+  benchmark("synthetic corpus (" + to_string(corpusSize) + " ISDs)", corpus, 1);
+
+  return 0;
+}
+
+
+/**
+ * Generates a corpus of distinct ISDs by perturbing every floating point value of an ISD.
+ *
+ * @param isdText JSON text of the ISD to start from.
+ * @param corpusSize Number of ISDs to generate.
+ *
+ * @return @b vector<string> The JSON text of each ISD.
+ */
+vector<string> syntheticCorpus(const string &isdText, int corpusSize) {
+  json base = json::parse(isdText);
+  mt19937 generator(42);
+  uniform_real_distribution<double> perturbation(0.999, 1.001);
+
+  vector<string> corpus;
+  corpus.reserve(corpusSize);
+  for (int i = 0; i < corpusSize; i++) {
+    json isd = base;
+    for (json::iterator it = isd.begin(); it != isd.end(); it++) {
+      if (it.value().is_number_float()) {
+        it.value() = it.value().get<double>() * perturbation(generator);
+      }
+      else if (it.value().is_array()) {
+        for (json::iterator element = it.value().begin(); element != it.value().end(); element++) {
+          if (element.value().is_number_float()) {
+            element.value() = element.value().get<double>() * perturbation(generator);
+          }
+        }
+      }
+    }
+    corpus.push_back(isd.dump());
+  }
+  return corpus;
+}
+
+
+/**
+ * Parses every ISD of a corpus with each available parser and reports the throughput.
+ *
+ * @param name Name of the corpus.
+ * @param corpus JSON text of each ISD.
+ * @param iterations Number of passes over the corpus.
+ */
+void benchmark(const string &name, const vector<string> &corpus, int iterations) {
+  const IsdParser parsers[] = { NLOHMANN_PARSER, SIMDJSON_PARSER };
+  const char *parserNames[] = { "nlohmann::json", "simdjson" };
+
+  size_t bytes = 0;
+  for (size_t i = 0; i < corpus.size(); i++) {
+    bytes += corpus[i].size();
+  }
+
+  cout << name << endl;
+  for (int p = 0; p < 2; p++) {
+    if (!isdParserAvailable(parsers[p])) {
+      cout << "  " << setw(16) << left << parserNames[p] << "not built (configure with "
+           << "-DUSE_SIMDJSON=ON)" << endl;
+      continue;
+    }
+
+    size_t parsed = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int it = 0; it < iterations; it++) {
+      for (size_t i = 0; i < corpus.size(); i++) {
+        csm::Isd *isd = readISD(corpus[i].data(), corpus[i].size(), "bench", parsers[p]);
+        if (isd == NULL) {
+          continue;
+        }
+        parsed += isd->parameters().size();
+        delete isd;
+      }
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    double count = double(iterations) * corpus.size();
+    cout << "  " << setw(16) << left << parserNames[p]
+         << fixed << setprecision(2)
+         << elapsed.count() / count * 1e6 << " us/ISD, "
+         << double(bytes) * iterations / elapsed.count() / 1e6 << " MB/s"
+         << " (" << parsed << " parameters)" << endl;
+  }
+}
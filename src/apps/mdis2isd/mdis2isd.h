@@ -15,8 +15,6 @@ class mdis2isd
 
     mdis2isd(QString cubeFile);
     ~mdis2isd();
-    void isdJSON(std::vector<std::pair<std::string,double> > * isdData,std::string sensorModel,
-                           std::string filePath);
     void writeISD();
 
 
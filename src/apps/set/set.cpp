@@ -1,30 +1,83 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <dlfcn.h>
+#include <exception>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <csm.h>
 #include <Isd.h>
 #include <Plugin.h>
 
-#include <gdal/gdal.h>
-#include <gdal/gdal_priv.h>
-#include <gdal/cpl_conv.h>
-#include <gdal/cpl_string.h>
-
 #include <IsdReader.h>
 #include <MdisPlugin.h>
 #include <MdisNacSensorModel.h>
+#include <CubeLoader.h>
+#include <GroundWriter.h>
+#include <ImageWindow.h>
+#include <RasterReader.h>
+#include <SpscQueue.h>
+#include <ThreadPool.h>
+#include <transformations.h>
 
 
 using namespace std;
 
-void cubeArray(vector<vector<float> > *cube, GDALRasterBand *poBand);
-void writeCSV(const string &csvFile,
-              const vector<string> &csvHeaders,
-              const vector< vector<float> > &cubeData,
-              const vector< vector<csm::EcefCoord> > &groundPoints);
+// Upper bound on the number of pixels in one tile.  Tiles are whole rows of the output grid,
+// so records are written in line order, but never more than this many pixels, so the memory
+// used does not grow with the size of the image.
+static const int MAX_TILE_PIXELS = 1 << 18;
+
+// Number of tiles in the pipeline: one each being read, computed and written, and a spare
+// so the reader can run a tile ahead.  The pipeline never allocates more, so a slow output
+// device stalls the reader instead of letting memory grow.
+static const int PIPELINE_TILES = 4;
+
+/**
+ * A strip of whole rows of the output grid, their DNs and their ground points.  A fixed set
+ * of tiles is reused for every strip of the grid, so their buffers are only allocated once.
+ */
+struct Tile {
+  int startRow;                       //!< 0-based first output row of the tile.
+  RasterBuffer dn;                    //!< The DNs, row-major.
+  vector<csm::EcefCoord> ground;      //!< The ground point of each pixel, row-major.
+};
+
+/** The options that apply to every image. */
+struct SetOptions {
+  GroundWriter::Format format;        //!< The output format.
+  GroundWriter::Coordinates coordinates;   //!< The coordinates ground points are written in.
+  string roi;                         //!< The --roi option, or empty for the whole image.
+  string stride;                      //!< The --stride option, or empty for every pixel.
+};
+
+/** How the body-fixed ground points of an image are converted before they are written. */
+struct GroundFrame {
+  GroundWriter::Coordinates coordinates;   //!< The coordinates to convert to.
+  double semiMajor;                   //!< The target's equatorial radius, in meters.
+  double semiMinor;                   //!< The target's polar radius, in meters.
+  double origin[3];                   //!< The latitude, longitude and height of the ENU origin.
+};
+
+bool processImage(const csm::Plugin &plugin, const string &isdFile, RasterReader &reader,
+                  const SetOptions &options, const string &outputFile, ThreadPool &pool);
+bool processBatch(const csm::Plugin &plugin, const string &batchFile,
+                  const SetOptions &options, ThreadPool &pool);
+int tileRows(const RasterReader &reader, const ImageWindow &window);
+bool groundFrame(const MdisNacSensorModel &model, const ImageWindow &window,
+                 GroundWriter::Coordinates coordinates, GroundFrame &frame);
+void computeGround(const MdisNacSensorModel &model, const ImageWindow &window,
+                   const GroundFrame &frame, Tile &tile, ThreadPool &pool);
+bool streamTiles(RasterReader &reader, const ImageWindow &window,
+                 const MdisNacSensorModel &model, const GroundFrame &frame, ThreadPool &pool,
+                 GroundWriter &writer);
 
 int main(int argc, char *argv[]) {
   
@@ -32,19 +85,78 @@ int main(int argc, char *argv[]) {
   string isdFile("../../../tests/data/EN1007907102M.json");
   string cubeFile("../../../tests/data/EN1007907102M.cub");
   
+  int threads = ThreadPool::defaultThreads();
+  SetOptions options;
+  options.format = GroundWriter::CSV_FORMAT;
+  options.coordinates = GroundWriter::ECEF_COORDINATES;
+  string outputFile;
+  string batchFile;
+  bool validArgs = true;
+
   // User can provide ISD and cube if desired.
-  if (argc == 3) {
-    isdFile = argv[1];
-    cubeFile = argv[2];
+  vector<string> files;
+  for (int i = 1; i < argc; i++) {
+    string arg(argv[i]);
+    if (arg == "--threads" && i + 1 < argc) {
+      threads = atoi(argv[++i]);
+      validArgs = validArgs && threads > 0;
+    }
+    else if (arg == "--format" && i + 1 < argc) {
+      validArgs = GroundWriter::findFormat(argv[++i], options.format) && validArgs;
+    }
+    else if (arg == "--coordinates" && i + 1 < argc) {
+      validArgs = GroundWriter::findCoordinates(argv[++i], options.coordinates) && validArgs;
+    }
+    else if ((arg == "--output" || arg == "-o") && i + 1 < argc) {
+      outputFile = argv[++i];
+    }
+    else if (arg == "--roi" && i + 1 < argc) {
+      options.roi = argv[++i];
+    }
+    else if (arg == "--stride" && i + 1 < argc) {
+      options.stride = argv[++i];
+    }
+    else if (arg == "--batch" && i + 1 < argc) {
+      batchFile = argv[++i];
+    }
+    else {
+      files.push_back(arg);
+    }
   }
-  else {
-    cout << "Usage: set <ISD.json> <cube.cub>\n";
+
+  if (files.size() == 2 && validArgs && batchFile.empty()) {
+    isdFile = files[0];
+    cubeFile = files[1];
+  }
+  else if (!(files.empty() && validArgs && !batchFile.empty())) {
+    cout << "Usage: set [--threads N] [--format csv|gtiff|envi|npy] [--output FILE]\n"
+            "           [--coordinates ecef|geodetic|enu]\n"
+            "           [--roi SAMPLE,LINE,SAMPLES,LINES] [--stride N|SAMPLES,LINES]\n"
+            "           <ISD.json> <cube.cub>\n";
+    cout << "       set [options] --batch LIST\n";
     cout << "Provide an ISD .json file and its associated cube .cub file.\n";  
+    cout << "Ground points are computed on N threads (default: one per core).\n";
+    cout << "The DN and ground X, Y, Z (km) of every pixel are written to FILE (default:\n";
+    cout << "ground.csv, ground.tif, ground.bsq + ground.hdr or ground.npy).  csv is slow\n";
+    cout << "and large and meant for debugging; the other formats hold four float64 bands.\n";
+    cout << "With --coordinates geodetic, latitude and longitude (degrees) and height (km)\n";
+    cout << "on the target's ellipsoid are written instead of X, Y, Z; with enu, east,\n";
+    cout << "north and up (km) from the ground point of the center pixel, which must be on\n";
+    cout << "the body.  Pixels off the body are NaN in both.\n";
+    cout << "Only the pixels of the region of interest (1-based first sample and line, and\n";
+    cout << "size; default: the whole image) are processed, and of those only every Nth\n";
+    cout << "sample of every Nth line (default: 1).\n";
+    cout << "With --batch, every line of LIST names an ISD, its cube and optionally the\n";
+    cout << "output file (default: the cube's name with the format's extension, in the\n";
+    cout << "current directory).  The cubes are loaded with many reads in flight while\n";
+    cout << "earlier ones are processed.\n";
+    if (!validArgs || !batchFile.empty()) {
+      return 1;
+    }
   }
 
-  csm::Isd *isd = readISD(isdFile);
-  if (isd == nullptr) {
-    return 1;
+  if (outputFile.empty()) {
+    outputFile = string("ground") + GroundWriter::extension(options.format);
   }
 
   // Find plugins TODO: probably need a dedicated area for plugins to load
@@ -62,157 +174,359 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
-  MdisNacSensorModel *model;
+  ThreadPool pool(threads);
+  bool status;
+  if (!batchFile.empty()) {
+    status = processBatch(*plugin, batchFile, options, pool);
+  }
+  else {
+    // ISIS cubes are mapped and read directly; anything else is read through GDAL.
+    RasterReader reader;
+    status = reader.open(cubeFile) &&
+             processImage(*plugin, isdFile, reader, options, outputFile, pool);
+  }
+
+  dlclose(pluginFile);
+  return status ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/**
+ * Computes and writes the ground grid of one image.
+ *
+ * @param plugin The plugin sensor models are constructed with.
+ * @param isdFile The ISD of the image.
+ * @param reader The open image.
+ * @param options The output format and the window of the image to process.
+ * @param outputFile The file the ground grid is written to.
+ * @param pool The threads ground points are computed on.
+ *
+ * @return @b bool false if the model could not be constructed, or the ground grid could not
+ *                 be computed or written.
+ */
+bool processImage(const csm::Plugin &plugin, const string &isdFile, RasterReader &reader,
+                  const SetOptions &options, const string &outputFile, ThreadPool &pool) {
+  csm::Isd *isd = readISD(isdFile);
+  if (isd == nullptr) {
+    return false;
+  }
+
+  MdisNacSensorModel *model = nullptr;
   
   // Initialize the MdisNacSensorModel from the ISD using the plugin
   try {
     model = dynamic_cast<MdisNacSensorModel*>
-            (plugin->constructModelFromISD(*isd, "ISIS_MDISNAC_USGSAstro_1_Linux64_csm30.so"));
+            (plugin.constructModelFromISD(*isd, "ISIS_MDISNAC_USGSAstro_1_Linux64_csm30.so"));
   }
   catch (csm::Error &e) {
     cout << e.what() << endl;
     delete isd;
-    if (model != nullptr) {
-      delete model;
-    }
-    exit (EXIT_FAILURE);
+    return false;
   }
+  delete isd;
 
   if (model == nullptr) {
      cout << "Could not construct the sensor model from the plugin." << endl;
-     delete isd;
-     return 0;
+     return false;
   }
-  
-  // Test the model's accuracy by visually comparing the results of the function calls
-//   csm::EcefCoord groundPoint;
-//   csm::ImageCoord imagePoint;
-// 
-//   for (int i = 0; i < 10; i++) {
-//     groundPoint = model->imageToGround(imagePoint, 0);
-// 
-//     cout << "Image Point (s, l) : (" << imagePoint.samp << ", " << imagePoint.line << "); "
-//               << "Ground Point (x, y, z) : (" << groundPoint.x << ", " << groundPoint.y << ", " 
-//                                               << groundPoint.z << ")" << endl;
-// 
-//     //imagePoint = model->groundToImage(groundPoint);
-//   }
-
-  //Read from a cube using the GDAL API, and outputs the DN values to a 2D vector matrix
-  //string cubePath("../../../tests/data/CN0108840044M_IF_5_NAC_spiced.cub");
-  string cubePath(cubeFile);
-  GDALDataset *poDataset;
-  GDALRasterBand *poBand;
-  int nBlockXSize, nBlockYSize;
-
-  cout << endl;
-  cout << "Testing GDAL"  << endl;
-  cout << endl;
-  GDALAllRegister();
-
-  poDataset = (GDALDataset *)GDALOpen(cubePath.c_str(),GA_ReadOnly);
-
-  if (poDataset == NULL) {
-    cout << "Could not open the:  " + cubePath  << endl;
-    delete isd;
+
+  ImageWindow window;
+  if (!ImageWindow::parse(options.roi, options.stride, reader.samples(), reader.lines(),
+                          window)) {
     delete model;
-    return 1;
+    return false;
   }
 
-  else {
-    poBand = poDataset->GetRasterBand(1);
-    poBand->GetBlockSize(&nBlockXSize, &nBlockYSize);
-    
-    cout << "Num samples = " << nBlockXSize << endl;
-    cout << "Num lines = " <<   nBlockYSize << endl;
-    
-    //Read a band of data
-    vector< vector<float> > cubeMatrix;
-    cubeArray(&cubeMatrix,poBand);
-    
-    // Get ground X,Y,Z for each pixel in image
-    vector< vector<csm::EcefCoord> > groundPoints;
-    for (int line = 0; line < cubeMatrix.size(); line++) {
-      vector<csm::EcefCoord> groundLine;
-      for (int sample = 0; sample < cubeMatrix[line].size(); sample++) {
-        csm::ImageCoord imagePoint(line + 1, sample + 1);
-        groundLine.push_back(model->imageToGround(imagePoint, 0.0));
-      }
-      groundPoints.push_back(groundLine);
-    }
-        
-    // Write to csv file
-    string csvFilename("ground.csv");
-    vector<string> csvHeaders { "Line", "Sample", "DN", "X (km)", "Y (km)", "Z (km)" };
-    writeCSV(csvFilename, csvHeaders, cubeMatrix, groundPoints);
+  GroundFrame frame;
+  bool status;
+  try {
+    status = groundFrame(*model, window, options.coordinates, frame);
+  }
+  catch (csm::Error &e) {
+    cout << e.what() << endl;
+    status = false;
+  }
+  if (!status) {
+    delete model;
+    return false;
+  }
 
-  }  //end else
- 
-  delete isd;
-  delete model;
-  dlclose(pluginFile);
-  exit (EXIT_SUCCESS);
-}
+  GroundWriter *writer = GroundWriter::create(options.format, options.coordinates);
+  if (!writer->open(outputFile, window)) {
+    cout << "\nUnable to open file \"" << outputFile << " for writing." << endl;
+    delete writer;
+    delete model;
+    return false;
+  }
 
+  // Stream the image through the tile pipeline: read DNs, get the ground X,Y,Z of each
+  // pixel and write them, one strip of lines at a time.
+  try {
+    status = streamTiles(reader, window, *model, frame, pool, *writer);
+  }
+  catch (csm::Error &e) {
+    cout << e.what() << endl;
+    status = false;
+  }
 
-void cubeArray(vector <vector<float> > *cube,GDALRasterBand *poBand) {
+  if (!writer->close()) {
+    cout << "\nError while writing file \"" << outputFile << "\"." << endl;
+    status = false;
+  }
+  delete writer;
+  delete model;
+  return status;
+}
 
-  vector<float> tempVector;
-  float *pafScanline;
-  int nsamps = poBand->GetXSize();
-  int nlines = poBand->GetYSize();
-  for (int j = 0;j<nlines;j++) {
 
-    pafScanline = (float *)CPLMalloc(sizeof(float)*nsamps);
-    poBand->RasterIO(GF_Read,0,j,nsamps,1,pafScanline,nsamps,1,GDT_Float32,0,0);
+/**
+ * Computes and writes the ground grids of a list of images.
+ *
+ * The cubes are loaded by a CubeLoader, which keeps many reads of the next cubes in flight
+ * while each loaded cube is processed from memory.
+ *
+ * @param plugin The plugin sensor models are constructed with.
+ * @param batchFile The list of images: "ISD CUBE [OUTPUT]" on each line.
+ * @param options The output format and the window of each image to process.
+ * @param pool The threads ground points are computed on.
+ *
+ * @return @b bool false if the list could not be read or any image failed.
+ */
+bool processBatch(const csm::Plugin &plugin, const string &batchFile,
+                  const SetOptions &options, ThreadPool &pool) {
+  ifstream list(batchFile.c_str());
+  if (!list) {
+    cout << "Could not open the batch list " << batchFile << endl;
+    return false;
+  }
 
-    for (int i = 0;i < nsamps;i++) {
-      tempVector.push_back(pafScanline[i]);
+  vector<string> isdFiles, cubeFiles, outputFiles;
+  string line;
+  while (getline(list, line)) {
+    istringstream fields(line);
+    string isdFile, cubeFile, outputFile;
+    if (!(fields >> isdFile >> cubeFile)) {
+      continue;
     }
-    cube->push_back(tempVector);
-    tempVector.clear();
-    CPLFree(pafScanline);
+    if (!(fields >> outputFile)) {
+      size_t start = cubeFile.find_last_of('/');
+      outputFile = cubeFile.substr(start == string::npos ? 0 : start + 1);
+      outputFile = outputFile.substr(0, outputFile.find_last_of('.')) +
+                   GroundWriter::extension(options.format);
+    }
+    isdFiles.push_back(isdFile);
+    cubeFiles.push_back(cubeFile);
+    outputFiles.push_back(outputFile);
   }
+
+  int failures = 0;
+  CubeLoader loader;
+  loader.load(cubeFiles, [&](int index, const unsigned char *data, size_t size) {
+    RasterReader reader;
+    if (data == NULL || !reader.open(cubeFiles[index], data, size) ||
+        !processImage(plugin, isdFiles[index], reader, options, outputFiles[index], pool)) {
+      cout << "Could not process " << cubeFiles[index] << endl;
+      failures++;
+    }
+    return true;
+  });
+
+  cout << cubeFiles.size() - failures << " of " << cubeFiles.size() << " images processed."
+       << endl;
+  return failures == 0;
 }
 
 
 /**
- * Writes a CSV file to the given destination.
- * 
- * This CSV will contain a DN, X, Y, and Z for each Line,Sample of the input cube data.
- * 
- * @param csvFilename Name of the output CSV file to write to.
- * @param csvHeaders Vector containing the header elements to write to the CSV file.
- * @param cubeData Matrix of cube DNs.
- * @param groundPoints Matrix of ground points for the image pixels.
+ * Streams an image through a three stage pipeline and writes the ground grid of every pixel.
+ *
+ * A reader thread fills tiles with DNs, this thread computes their ground points (on the
+ * pool) and a writer thread writes them to the output file, so reading the next tile and
+ * writing the previous one overlap with computing the current one.  The stages hand tiles
+ * to each other in line order through bounded single-producer/single-consumer queues, and
+ * the writer thread returns written tiles to the reader, so only PIPELINE_TILES tiles ever
+ * exist.  A NULL tile marks the end of the image.
+ *
+ * @param reader The open image.
+ * @param window The pixels of the image to process.
+ * @param model The sensor model of the image.
+ * @param frame The coordinates the ground points are converted to.
+ * @param pool The threads ground points are computed on.
+ * @param writer The open output file.
+ *
+ * @return @b bool false if a read, a ground point computation or a write failed.
  */
-void writeCSV(const string &csvFilename,
-              const vector<string> &csvHeaders,
-              const vector< vector<float> > &cubeData,
-              const vector< vector<csm::EcefCoord> > &groundPoints) {
-  ofstream csvFile(csvFilename);
-  if (csvFile.is_open()) {
-    
-    // Write the csv header
-    for (int str = 0; str < csvHeaders.size() - 1; str++) {
-      csvFile << csvHeaders[str] << ", ";
-    }
-    
-    // Write the last header element
-    csvFile << csvHeaders[csvHeaders.size() - 1] << "\n";
-    
-    // Write the csv records
-    for (int line = 0; line < cubeData.size(); line++) {
-      for (int sample = 0; sample < cubeData[line].size(); sample++) {
-        csm::EcefCoord ground = groundPoints[line][sample];
-        csvFile << line + 1 << ", " << sample + 1 << ", " << cubeData[line][sample] << ", "
-                << ground.x/1000 << ", " << ground.y/1000 << ", " << ground.z/1000 << "\n";
+bool streamTiles(RasterReader &reader, const ImageWindow &window,
+                 const MdisNacSensorModel &model, const GroundFrame &frame, ThreadPool &pool,
+                 GroundWriter &writer) {
+  vector<Tile> tiles(PIPELINE_TILES);
+  SpscQueue<Tile *> freeTiles(PIPELINE_TILES);
+  SpscQueue<Tile *> readTiles(PIPELINE_TILES + 1);
+  SpscQueue<Tile *> computedTiles(PIPELINE_TILES + 1);
+  for (int i = 0; i < PIPELINE_TILES; i++) {
+    freeTiles.push(&tiles[i]);
+  }
+
+  atomic<bool> failed(false);
+  int rowsPerTile = tileRows(reader, window);
+  int rows = window.outputLines();
+
+  // Every stage catches what its work throws (csm::Error, bad_alloc, ...), so the end marker
+  // always reaches the next stage and both threads can be joined.
+  thread readThread([&] {
+    for (int row = 0; row < rows && !failed; row += rowsPerTile) {
+      Tile *tile = freeTiles.pop();
+      tile->startRow = row;
+      try {
+        if (!reader.read(tile->dn, window, row, min(rowsPerTile, rows - row))) {
+          failed = true;
+        }
+      }
+      catch (std::exception &e) {
+        cout << e.what() << endl;
+        failed = true;
+      }
+      if (failed) {
+        break;
+      }
+      readTiles.push(tile);
+    }
+    readTiles.push(NULL);
+  });
+
+  thread writeThread([&] {
+    Tile *tile;
+    while ((tile = computedTiles.pop()) != NULL) {
+      try {
+        if (!failed && !writer.write(tile->startRow, tile->dn.lines(), tile->dn.data(),
+                                     tile->ground.data())) {
+          failed = true;
+        }
+      }
+      catch (std::exception &e) {
+        cout << e.what() << endl;
+        failed = true;
+      }
+      freeTiles.push(tile);
+    }
+  });
+
+  Tile *tile;
+  while ((tile = readTiles.pop()) != NULL) {
+    if (!failed) {
+      try {
+        computeGround(model, window, frame, *tile, pool);
+      }
+      catch (std::exception &e) {
+        cout << e.what() << endl;
+        failed = true;
       }
     }
+    computedTiles.push(tile);
   }
-  
-  else {
-    cout << "\nUnable to open file \"" << csvFilename << " for writing." << endl;
-    return;
+  computedTiles.push(NULL);
+
+  readThread.join();
+  writeThread.join();
+  return !failed;
+}
+
+
+/**
+ * Returns the number of output rows of the tiles a window is streamed through: as many
+ * rows as fit in MAX_TILE_PIXELS and, when every line is read, whole blocks of lines.
+ *
+ * @param reader The open image.
+ * @param window The pixels of the image to process.
+ *
+ * @return @b int The number of rows per tile.
+ */
+int tileRows(const RasterReader &reader, const ImageWindow &window) {
+  int rows = MAX_TILE_PIXELS / max(window.outputSamples(), 1);
+  if (window.lineStride == 1 && rows >= reader.blockLines()) {
+    rows -= rows % reader.blockLines();
+  }
+  return max(1, min(rows, window.outputLines()));
+}
+
+
+/**
+ * Sets up the conversion of an image's ground points to the coordinates they are written
+ * in.  The ENU origin is the ground point of the center pixel of the window.
+ *
+ * @param model The sensor model of the image.
+ * @param window The pixels of the image being processed.
+ * @param coordinates The coordinates to convert to.
+ * @param frame Receives the conversion.
+ *
+ * @return @b bool false if ENU coordinates are asked for and the center pixel of the window
+ *                 is off the body, so there is no origin to put the frame at.
+ */
+bool groundFrame(const MdisNacSensorModel &model, const ImageWindow &window,
+                 GroundWriter::Coordinates coordinates, GroundFrame &frame) {
+  frame.coordinates = coordinates;
+  frame.semiMajor = model.getSemiMajorAxis();
+  frame.semiMinor = model.getSemiMinorAxis();
+  frame.origin[0] = frame.origin[1] = frame.origin[2] = 0.0;
+  if (coordinates == GroundWriter::ENU_COORDINATES) {
+    int line = window.imageLine(window.outputLines() / 2) + 1;
+    int sample = window.imageSample(window.outputSamples() / 2) + 1;
+    csm::EcefCoord origin = model.imageToGround(csm::ImageCoord(line, sample), 0.0);
+    // The model returns the body's center for a pixel that misses the body.
+    if (origin.x == 0.0 && origin.y == 0.0 && origin.z == 0.0) {
+      cout << "The center pixel (line " << line << ", sample " << sample << ") of the "
+           << "window is off the body, so it cannot be the ENU origin; choose a --roi "
+           << "centered on the body." << endl;
+      return false;
+    }
+    const double point[3] = { origin.x, origin.y, origin.z };
+    ecefToGeodetic(point, 1, frame.semiMajor, frame.semiMinor, frame.origin);
   }
+  return true;
+}
+
+
+/**
+ * Computes the ground point of every pixel of a tile.
+ *
+ * The rows of the tile are spread over the pool's threads.  The model is only read, and
+ * each row writes its own part of the ground points, so the result does not depend on the
+ * number of threads.  Each row is converted to the frame's coordinates in place, in one
+ * batch; pixels off the body are NaN in geodetic and ENU coordinates.
+ *
+ * @param model The sensor model of the image.
+ * @param window The pixels of the image being processed.
+ * @param frame The coordinates the ground points are converted to.
+ * @param tile The tile; its ground points are resized to match its DNs.
+ * @param pool The threads to compute on.
+ */
+void computeGround(const MdisNacSensorModel &model, const ImageWindow &window,
+                   const GroundFrame &frame, Tile &tile, ThreadPool &pool) {
+  static_assert(sizeof(csm::EcefCoord) == 3 * sizeof(double),
+                "csm::EcefCoord is not an (x, y, z) triple");
+  int samples = tile.dn.samples();
+  tile.ground.resize((size_t)samples * tile.dn.lines());
+  pool.parallelFor(tile.dn.lines(), [&](int row) {
+    csm::EcefCoord *groundRow = &tile.ground[(size_t)row * samples];
+    double line = window.imageLine(tile.startRow + row) + 1;
+    for (int column = 0; column < samples; column++) {
+      csm::ImageCoord imagePoint(line, window.imageSample(column) + 1);
+      groundRow[column] = model.imageToGround(imagePoint, 0.0);
+      // A pixel that misses the body comes back as the body's center, which has no latitude,
+      // longitude or local position.  Converted, it is NaN, which the conversions keep.
+      if (frame.coordinates != GroundWriter::ECEF_COORDINATES &&
+          groundRow[column].x == 0.0 && groundRow[column].y == 0.0 &&
+          groundRow[column].z == 0.0) {
+        groundRow[column] = csm::EcefCoord(NAN, NAN, NAN);
+      }
+    }
+
+    double *points = &groundRow[0].x;
+    if (frame.coordinates == GroundWriter::GEODETIC_COORDINATES) {
+      ecefToGeodetic(points, samples, frame.semiMajor, frame.semiMinor, points);
+    }
+    else if (frame.coordinates == GroundWriter::ENU_COORDINATES) {
+      ecefToEnu(points, samples, frame.origin, frame.semiMajor, frame.semiMinor, points);
+    }
+  });
 }
@@ -1,44 +1,550 @@
 #include "CSpiceIsd.h"
 #include "SpiceController.h"
 
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <string>
 
+#include <SpiceUsr.h>
+
+#include <CubeReader.h>
+#include <TextKernel.h>
+#include <UnitQuaternion.h>
+#include <transformations.h>
+
 using namespace std;
 
+// The geometry fit: largest errors of the spacecraft and sun positions (meters) and of the
+// rotation matrix elements, the degree of its polynomials and its shortest segment.
+static const double FIT_TOLERANCES[CSpiceIsd::GEOMETRY_COMPONENTS] = {
+  0.01, 0.01, 0.01, 1.0, 1.0, 1.0,
+  1e-9, 1e-9, 1e-9, 1e-9, 1e-9, 1e-9, 1e-9, 1e-9, 1e-9
+};
+static const int FIT_DEGREE = 12;
+static const double FIT_MINIMUM_SPAN = 0.5;
+
+// Exposures more than FIT_GAP seconds apart are fitted in separate windows, and windows of
+// fewer than FIT_EXPOSURES exposures are not fitted.
+static const double FIT_GAP = 600.0;
+static const size_t FIT_EXPOSURES = 16;
+
+// The sensor and sun position polynomials of an ISD are quartics in the seconds from its
+// ephemeris time, through the positions STATE_STEP seconds apart over +/-2 steps.
+static const int STATE_TERMS = 5;
+static const double STATE_STEP = 30.0;
+
+
+  /**
+   * @brief Reads the first count values of a kernel pool variable.
+   * @return false if the pool does not have count values for it.
+   */
+  static bool poolDoubles(const string &name, int count, double *values) {
+    SpiceInt n = 0;
+    SpiceBoolean found = SPICEFALSE;
+    gdpool_c(name.c_str(), 0, count, &n, values, &found);
+    return found && n == count;
+  }
+
+
+  /**
+   * @brief Computes the coefficients of the quartic, per axis, through the positions at
+   * -2, -1, 0, 1 and 2 STATE_STEPs from the ephemeris time (the central differences of
+   * the samples).
+   *
+   * @param samples  The geometry at the 5 times.
+   * @param first  The first component of the position in the geometry.
+   * @param coefficients  Receives STATE_TERMS coefficients for x, then y, then z.
+   */
+  static void stateCoefficients(const double samples[][CSpiceIsd::GEOMETRY_COMPONENTS],
+                                int first, double *coefficients) {
+    const double h = STATE_STEP;
+    for (int axis = 0; axis < 3; axis++) {
+      int k = first + axis;
+      double p0 = samples[2][k];
+      double odd1 = samples[3][k] - samples[1][k];
+      double odd2 = samples[4][k] - samples[0][k];
+      double even1 = samples[3][k] + samples[1][k];
+      double even2 = samples[4][k] + samples[0][k];
+      double *c = coefficients + axis * STATE_TERMS;
+      c[0] = p0;
+      c[1] = (8 * odd1 - odd2) / (12 * h);
+      c[2] = (16 * even1 - even2 - 30 * p0) / (24 * h * h);
+      c[3] = (odd2 - 2 * odd1) / (12 * h * h * h);
+      c[4] = (even2 - 4 * even1 + 6 * p0) / (24 * h * h * h * h);
+    }
+  }
+
+
   CSpiceIsd::CSpiceIsd(string cubeFileName) {
     m_cubeFileString = cubeFileName;
     m_validCube = true;  
+    m_instrumentCode = MDIS_NAC_CODE;
     }
 
+
+  /**
+   * @brief CSpiceIsd::CSpiceIsd  Sets up ISD generation for an instrument whose kernels are
+   * loaded (see SpiceController).  Call loadInstrument() before computeIsd().
+   * @param instrumentCode  The NAIF code of the instrument.
+   */
+  CSpiceIsd::CSpiceIsd(int instrumentCode)
+      : m_fit(vector<double>(FIT_TOLERANCES, FIT_TOLERANCES + GEOMETRY_COMPONENTS),
+              FIT_DEGREE, FIT_MINIMUM_SPAN) {
+    m_validCube = false;
+    m_instrumentCode = instrumentCode;
+  }
+
   CSpiceIsd::~CSpiceIsd(){
 
   }
 
 
   /**
-   * @brief CSpiceIsd::isdJSON  Outputs an ISD (Image Support Data) file in JSON format.
-   * @param isdList A list of key-value pairs from the ISD
-   * @param sensorModel  The name of the sensor model
-   * @param filePath  The path name of the output file.
+   * @brief CSpiceIsd::loadInstrument  Reads the instrument's constants from the kernel pool,
+   * once for all the ISDs computed afterwards.
+   * @param error  Set to the reason if the constants could not be read.
+   * @return false if the instrument kernel is not loaded or incomplete.
+   */
+  bool CSpiceIsd::loadInstrument(string &error) {
+    string prefix = "INS" + to_string(m_instrumentCode) + "_";
+    SpiceChar frame[1][33];
+    SpiceInt n = 0;
+    SpiceBoolean found = SPICEFALSE;
+    gcpool_c((prefix + "FOV_FRAME").c_str(), 0, 1, sizeof(frame[0]), &n, frame, &found);
+
+    bool ok = readInstrument([](const string &name, int count, double *values) {
+      return poolDoubles(name, count, values);
+    }, found ? frame[0] : "", error);
+
+    string message;
+    if (SpiceController::checkError(message)) {
+      error = message;
+      return false;
+    }
+    return ok;
+  }
+
+
+  /**
+   * @brief CSpiceIsd::loadInstrument  Reads the instrument's constants from a parsed
+   * instrument kernel instead of the kernel pool, so the kernel need not be loaded.
+   * @param kernel  The instrument kernel.
+   * @param error  Set to the reason if the constants could not be read.
+   * @return false if the kernel does not have every constant.
+   */
+  bool CSpiceIsd::loadInstrument(const TextKernel &kernel, string &error) {
+    string prefix = "INS" + to_string(m_instrumentCode) + "_";
+    const vector<string> *frame = kernel.strings(prefix + "FOV_FRAME");
+    return readInstrument([&kernel](const string &name, int count, double *values) {
+      return kernel.getDoubles(name, count, values);
+    }, frame != NULL && !frame->empty() ? frame->front() : "", error);
+  }
+
+
+  /**
+   * @brief CSpiceIsd::loadLeapseconds  Converts UTC times with a parsed leapseconds kernel
+   * instead of str2et_c, so the conversions do not go through the kernel pool.
+   * @param kernel  The leapseconds kernel.
+   * @param error  Set to the reason if the kernel could not be used.
+   * @return false if the kernel is not a valid leapseconds kernel.
+   */
+  bool CSpiceIsd::loadLeapseconds(const TextKernel &kernel, string &error) {
+    if (!m_time.loadLeapseconds(kernel)) {
+      error = "not a valid leapseconds kernel";
+      return false;
+    }
+    return true;
+  }
+
+
+  /**
+   * @brief CSpiceIsd::utcToEt  Converts a UTC time to ephemeris time, with the leapseconds
+   * kernel given to loadLeapseconds() or else with str2et_c.
+   * @param utc  The UTC time.
+   * @param et  Receives the ephemeris time.
+   * @param error  Set to the reason if the time could not be converted.
+   * @return false if the time could not be converted.
+   */
+  bool CSpiceIsd::utcToEt(const string &utc, double &et, string &error) const {
+    if (m_time.hasLeapseconds()) {
+      if (!m_time.utcToEt(utc, et)) {
+        error = "invalid UTC time " + utc;
+        return false;
+      }
+      return true;
+    }
+    string message;
+    str2et_c(utc.c_str(), &et);
+    if (SpiceController::checkError(message)) {
+      error = message;
+      return false;
+    }
+    return true;
+  }
+
+
+  /**
+   * @brief CSpiceIsd::readInstrument  Reads the instrument's constants.
+   * @param lookup  Copies the first count values of a numeric variable; returns false if
+   *                there are fewer.
+   * @param frame  The instrument's frame (its FOV_FRAME), or empty if it is not known.
+   * @param error  Set to the reason if the constants could not be read.
+   * @return false if a constant is missing.
+   */
+  bool CSpiceIsd::readInstrument(const function<bool(const string &, int, double *)> &lookup,
+                                 const string &frame, string &error) {
+    string prefix = "INS" + to_string(m_instrumentCode) + "_";
+    MdisIsd &isd = m_instrument;
+    isd.instrumentId = "MDIS-NAC";
+    isd.spacecraftName = "Messenger";
+    isd.targetName = "Mercury";
+
+    double pixelLines = 0.0;
+    double pixelSamples = 0.0;
+    const struct {
+      const char *name;
+      int count;
+      double *values;
+    } constants[] = {
+      { "FOCAL_LENGTH", 1, &isd.focalLength },
+      { "FL_UNCERTAINTY", 1, &isd.focalLengthEpsilon },
+      { "PIXEL_PITCH", 1, &isd.pixelPitch },
+      { "CCD_CENTER", 1, &isd.ccdCenter },
+      { "IFOV", 1, &isd.ifov },
+      { "PIXEL_LINES", 1, &pixelLines },
+      { "PIXEL_SAMPLES", 1, &pixelSamples },
+      { "BORESIGHT", 3, isd.boresight },
+      { "TRANSX", 3, isd.transX },
+      { "TRANSY", 3, isd.transY },
+      { "ITRANSS", 3, isd.iTransS },
+      { "ITRANSL", 3, isd.iTransL },
+      { "OD_T_X", 9, isd.odtX },
+      { "OD_T_Y", 9, isd.odtY },
+      { "FPUBIN_START_SAMPLE", 1, &isd.startingDetectorSample },
+      { "FPUBIN_START_LINE", 1, &isd.startingDetectorLine }
+    };
+    for (size_t i = 0; i < sizeof(constants) / sizeof(constants[0]); i++) {
+      if (!lookup(prefix + constants[i].name, constants[i].count, constants[i].values)) {
+        error = prefix + constants[i].name + " is missing or too short";
+        return false;
+      }
+    }
+    isd.nLines = (int)pixelLines;
+    isd.nSamples = (int)pixelSamples;
+    isd.originalHalfLines = pixelLines / 2;
+    isd.originalHalfSamples = pixelSamples / 2;
+
+    m_frame = frame;
+    if (m_frame.empty()) {
+      error = prefix + "FOV_FRAME is missing";
+      return false;
+    }
+    return true;
+  }
+
+
+  /**
+   * @brief CSpiceIsd::computeIsd  Computes the ISD of an image given as a cube, or of an
+   * exposure at an epoch (see readExposure()).
+   *
+   * @param cubeOrEpoch  The cube file or epoch.
+   * @param isd  Receives the ISD.
+   * @param error  Set to the reason if the ISD could not be computed.
+   * @return false if the ISD could not be computed.
+   */
+  bool CSpiceIsd::computeIsd(const string &cubeOrEpoch, MdisIsd &isd, string &error) const {
+    Exposure exposure;
+    return readExposure(cubeOrEpoch, exposure, error) && computeIsd(exposure, isd, error);
+  }
+
+
+  /**
+   * @brief CSpiceIsd::computeIsd  Computes the ISD of an exposure read by readExposure().
+   * @param exposure  The exposure.
+   * @param isd  Receives the ISD.
+   * @param error  Set to the reason if the ISD could not be computed.
+   * @return false if the ISD could not be computed.
+   */
+  bool CSpiceIsd::computeIsd(const Exposure &exposure, MdisIsd &isd, string &error) const {
+    if (!computeIsd(exposure.ephemerisTime, exposure.target, exposure.summing, isd, error)) {
+      return false;
+    }
+    if (exposure.lines > 0) {
+      isd.nLines = exposure.lines;
+      isd.nSamples = exposure.samples;
+    }
+    return true;
+  }
+
+
+  /**
+   * @brief CSpiceIsd::readExposure  Reads the exposure of an image given as a cube, or of an
+   * epoch.
+   *
+   * The exposure of a cube is centered half its ExposureDuration (milliseconds) after its
+   * StartTime, and its size, target and FPU binning come from its Instrument group.  An
+   * epoch is either a number of ephemeris seconds past J2000 or a UTC string; it is an
+   * unbinned frame of Mercury.
+   *
+   * @param cubeOrEpoch  The cube file or epoch.
+   * @param exposure  Receives the exposure.
+   * @param error  Set to the reason if the exposure could not be read.
+   * @return false if the exposure could not be read.
+   */
+  bool CSpiceIsd::readExposure(const string &cubeOrEpoch, Exposure &exposure,
+                               string &error) const {
+    exposure.target = m_instrument.targetName;
+    exposure.summing = 1;
+    exposure.lines = 0;
+    exposure.samples = 0;
+    exposure.ephemerisTime = 0.0;
+    double &et = exposure.ephemerisTime;
+
+    if (CubeReader::isCube(cubeOrEpoch)) {
+      CubeReader cube;
+      if (!cube.open(cubeOrEpoch)) {
+        error = "could not open the cube";
+        return false;
+      }
+      string startTime = cube.instrumentValue("StartTime");
+      if (startTime.empty()) {
+        error = "the cube has no Instrument StartTime";
+        return false;
+      }
+      if (!utcToEt(startTime, et, error)) {
+        return false;
+      }
+      et += atof(cube.instrumentValue("ExposureDuration").c_str()) / 1000 / 2;
+      if (!cube.instrumentValue("TargetName").empty()) {
+        exposure.target = cube.instrumentValue("TargetName");
+      }
+      exposure.summing = cube.instrumentValue("FpuBinningMode") == "1" ? 2 : 1;
+      exposure.lines = cube.lines();
+      exposure.samples = cube.samples();
+    }
+    else {
+      const char *text = cubeOrEpoch.c_str();
+      char *end = NULL;
+      et = strtod(text, &end);
+      if ((end == text || *end != '\0') && !utcToEt(cubeOrEpoch, et, error)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+
+  /**
+   * @brief CSpiceIsd::fitGeometry  Fits the geometry of a target (see sampleGeometry())
+   * around a set of exposures, so that computeIsd() answers them without querying the
+   * kernels.
+   *
+   * The epochs are split into windows wherever two are more than FIT_GAP seconds apart, and
+   * each window of at least FIT_EXPOSURES epochs is fitted unless the fit already covers
+   * it.  A window that cannot be fitted within the tolerances is left to the kernels.  A fit
+   * of another target is dropped.
+   *
+   * @param epochs  The ephemeris times of the exposures.
+   * @param target  The target of the exposures.
+   * @return The number of windows that could not be fitted.
+   */
+  int CSpiceIsd::fitGeometry(vector<double> epochs, const string &target) {
+    if (m_fit.label() != target) {
+      m_fit.clear();
+      m_fit.setLabel(target);
+    }
+    ChebyshevCache::Sampler sample = [this, &target](double et, double *values) {
+      string error;
+      return sampleGeometry(et, target, values, error);
+    };
+
+    int failures = 0;
+    sort(epochs.begin(), epochs.end());
+    size_t first = 0;
+    for (size_t i = 1; i <= epochs.size(); i++) {
+      if (i < epochs.size() && epochs[i] - epochs[i - 1] <= FIT_GAP) {
+        continue;
+      }
+      // The windows include the span of the ISDs' position polynomials.
+      if (i - first >= FIT_EXPOSURES &&
+          !m_fit.fit(sample, epochs[first] - 2 * STATE_STEP, epochs[i - 1] + 2 * STATE_STEP)) {
+        failures++;
+      }
+      first = i;
+    }
+    return failures;
+  }
+
+
+  /**
+   * @brief CSpiceIsd::loadFit  Reads a geometry fit saved by saveFit().
+   * @param filePath  The fit file.
+   * @return false if the file is not a valid fit of the geometry.
+   */
+  bool CSpiceIsd::loadFit(const string &filePath) {
+    ChebyshevCache fit;
+    if (!fit.load(filePath)) {
+      return false;
+    }
+    if (fit.components() != GEOMETRY_COMPONENTS) {
+      cerr << filePath << " is not a fit of the ISD geometry" << endl;
+      return false;
+    }
+    m_fit = fit;
+    return true;
+  }
+
+
+  /**
+   * @brief CSpiceIsd::saveFit  Writes the geometry fit, for later jobs to read with loadFit().
+   * @param filePath  The fit file.
+   * @return false if the file could not be written.
+   */
+  bool CSpiceIsd::saveFit(const string &filePath) const {
+    return m_fit.save(filePath);
+  }
+
+
+  /**
+   * @brief CSpiceIsd::sampleGeometry  Queries the kernels for the geometry of an exposure:
+   * the light-time corrected position of the spacecraft and of the sun in the target's IAU
+   * body-fixed frame (meters), and the camera-to-body-fixed rotation (row by row).
+   *
+   * @param ephemerisTime  The center of the exposure (ephemeris seconds past J2000).
+   * @param target  The target body (e.g. Mercury).
+   * @param values  Receives the GEOMETRY_COMPONENTS values.
+   * @param error  Set to the reason if the kernels could not be queried.
+   * @return false if the kernels could not be queried.
    */
-  void CSpiceIsd::isdJSON(vector<pair<string,double> > * isdList,string sensorModel,
-                         string filePath){
-    ofstream os;
-    os.open(filePath.c_str(), ofstream::out);
-    os << "{" << endl;
-    os << "\"" <<"ISD_SENSOR_MODEL_NAME"<<"\":" << sensorModel << ",";
-    os << setprecision(prec);
-    unsigned int nparams = isdList->size();
-    for (unsigned int i =0;i < nparams-1;i++) {
-      pair<string,double> isdNode=isdList->at(i);
-      os << "\"" << isdNode.first << "\":" << isdNode.second << ",";
+  bool CSpiceIsd::sampleGeometry(double ephemerisTime, const string &target, double *values,
+                                 string &error) const {
+    string bodyFrame = "IAU_" + target;
+    for (size_t i = 0; i < bodyFrame.size(); i++) {
+      bodyFrame[i] = toupper(bodyFrame[i]);
+    }
+    string spacecraft = to_string(m_instrumentCode / 1000);
+
+    // The target as seen from the spacecraft, in the body-fixed frame at the time the light
+    // left the target.
+    SpiceDouble targetPosition[3];
+    SpiceDouble lightTime = 0.0;
+    spkpos_c(target.c_str(), ephemerisTime, bodyFrame.c_str(), "LT+S", spacecraft.c_str(),
+             targetPosition, &lightTime);
+
+    SpiceDouble sunPosition[3];
+    SpiceDouble sunLightTime = 0.0;
+    spkpos_c("SUN", ephemerisTime - lightTime, bodyFrame.c_str(), "LT+S", target.c_str(),
+             sunPosition, &sunLightTime);
+
+    SpiceDouble cameraToJ2000[3][3];
+    SpiceDouble j2000ToBody[3][3];
+    SpiceDouble cameraToBody[3][3];
+    pxform_c(m_frame.c_str(), "J2000", ephemerisTime, cameraToJ2000);
+    pxform_c("J2000", bodyFrame.c_str(), ephemerisTime - lightTime, j2000ToBody);
+    mxm_c(j2000ToBody, cameraToJ2000, cameraToBody);
+
+    string message;
+    if (SpiceController::checkError(message)) {
+      error = message;
+      return false;
     }
-     pair<string,double> lastNode=isdList->at(nparams-1);
-     os << "\"" << lastNode.first << "\":" << lastNode.second << "}";
-     os.close();
+    for (int i = 0; i < 3; i++) {
+      values[i] = -1000 * targetPosition[i];
+      values[3 + i] = 1000 * sunPosition[i];
+      for (int j = 0; j < 3; j++) {
+        values[6 + 3 * i + j] = cameraToBody[i][j];
+      }
+    }
+    return true;
+  }
+
+
+  /**
+   * @brief CSpiceIsd::geometryAt  Returns the geometry (see sampleGeometry()) at a time from
+   * the geometry fit if it covers the time, or else from the loaded kernels.
+   */
+  bool CSpiceIsd::geometryAt(double ephemerisTime, const string &target, double *values,
+                             string &error) const {
+    return (m_fit.label() == target && m_fit.evaluate(ephemerisTime, values)) ||
+           sampleGeometry(ephemerisTime, target, values, error);
+  }
+
+
+  /**
+   * @brief CSpiceIsd::computeIsd  Computes the ISD of an exposure from its geometry (see
+   * geometryAt()), with the camera-to-body-fixed rotation as the omega, phi and kappa of
+   * MdisNacSensorModel, and the polynomials of the sensor and sun positions over the
+   * +/-2 * STATE_STEP seconds around it.
+   *
+   * @param ephemerisTime  The center of the exposure (ephemeris seconds past J2000).
+   * @param target  The target body (e.g. Mercury).
+   * @param summing  The binning of the frame (2 for FPU binned frames).
+   * @param isd  Receives the ISD.
+   * @param error  Set to the reason if the ISD could not be computed.
+   * @return false if the ISD could not be computed.
+   */
+  bool CSpiceIsd::computeIsd(double ephemerisTime, const string &target, int summing,
+                             MdisIsd &isd, string &error) const {
+    isd = m_instrument;
+    isd.targetName = target;
+    isd.ephemerisTime = ephemerisTime;
+
+    // The geometry at the exposure and around it, for the position polynomials.
+    double samples[STATE_TERMS][GEOMETRY_COMPONENTS];
+    for (int j = 0; j < STATE_TERMS; j++) {
+      if (!geometryAt(ephemerisTime + (j - 2) * STATE_STEP, target, samples[j], error)) {
+        return false;
+      }
+    }
+    const double *geometry = samples[2];
+    stateCoefficients(samples, 0, isd.sensorCoefficients);
+    stateCoefficients(samples, 3, isd.sunCoefficients);
+
+    SpiceDouble radii[3];
+    SpiceInt n = 0;
+    bodvrd_c(target.c_str(), "RADII", 3, &n, radii);
+    string message;
+    if (SpiceController::checkError(message)) {
+      error = message;
+      return false;
+    }
+
+    for (int i = 0; i < 3; i++) {
+      isd.sensorPosition[i] = geometry[i];
+      isd.sunPosition[i] = geometry[3 + i];
+    }
+    isd.semiMajorAxis = radii[0];
+    isd.semiMinorAxis = radii[2];
+
+    // MdisNacSensorModel builds its camera-to-body-fixed rotation with opkToRotation().  A
+    // fitted rotation is orthonormal only to within the fit's tolerance, so the angles are
+    // taken from the rotation of its quaternion.
+    double cameraToBody[9];
+    UnitQuaternion::fromRotation(geometry + 6).toRotation(cameraToBody);
+    double opk[3];
+    rotationToOpk(cameraToBody, 1, opk);
+    isd.omega = opk[0];
+    isd.phi = opk[1];
+    isd.kappa = opk[2];
+
+    // Binned frames have larger pixels.
+    isd.pixelPitch *= summing;
+    for (int i = 0; i < 3; i++) {
+      isd.transX[i] *= summing;
+      isd.transY[i] *= summing;
+      isd.iTransS[i] /= summing;
+      isd.iTransL[i] /= summing;
+    }
+    isd.ccdCenter = (isd.ccdCenter - 0.5) / summing + 0.5;
+    isd.nLines /= summing;
+    isd.nSamples /= summing;
+    return true;
   }
 
 
@@ -251,7 +757,15 @@ using namespace std;
     }
 
     os.close();
-    isdJSON(&isdList,modelName.toStdString(),"json.isd");
+
+    IsdWriter writer;
+    writer.beginJSON();
+    writer.field("ISD_SENSOR_MODEL_NAME", modelName.toStdString());
+    for (unsigned int i = 0; i < isdList.size(); i++) {
+      writer.field(isdList[i].first.c_str(), isdList[i].second);
+    }
+    writer.endJSON();
+    writer.write("json.isd");
 
 #endif
   }
@@ -1,29 +1,81 @@
 #ifndef CSPICEISD_H
 #define CSPICEISD_H
 
+#include <functional>
 #include <utility>
 #include <vector>
 #include <string>
 
+#include <ChebyshevCache.h>
+#include <IsdWriter.h>
+#include <TimeConverter.h>
+
+class TextKernel;
+
 using namespace std;
 
 
+/**
+ * When and what an image was taken of.
+ */
+struct Exposure {
+  double ephemerisTime;   //!< The center of the exposure (ephemeris seconds past J2000).
+  string target;          //!< The target body.
+  int summing;            //!< The binning of the frame (2 for FPU binned frames).
+  int lines;              //!< The lines of the image, or 0 to use the instrument's.
+  int samples;            //!< The samples of the image, or 0 to use the instrument's.
+};
+
 
 class CSpiceIsd
 {
   public:
     CSpiceIsd(string cubeFile);
+    CSpiceIsd(int instrumentCode = MDIS_NAC_CODE);
    ~CSpiceIsd();
-    void isdJSON(vector<pair<string,double> > * isdData,string sensorModel,
-                           string filePath);
     void writeISD();
 
+    bool loadInstrument(string &error);
+    bool loadInstrument(const TextKernel &kernel, string &error);
+    bool loadLeapseconds(const TextKernel &kernel, string &error);
+    bool readExposure(const string &cubeOrEpoch, Exposure &exposure, string &error) const;
+    bool computeIsd(const string &cubeOrEpoch, MdisIsd &isd, string &error) const;
+    bool computeIsd(const Exposure &exposure, MdisIsd &isd, string &error) const;
+    bool computeIsd(double ephemerisTime, const string &target, int summing, MdisIsd &isd,
+                    string &error) const;
+
+    int fitGeometry(vector<double> epochs, const string &target);
+    bool loadFit(const string &filePath);
+    bool saveFit(const string &filePath) const;
+
+    /** Returns the geometry fit. */
+    const ChebyshevCache &geometryFit() const {
+      return m_fit;
+    }
+
+    static const int MDIS_NAC_CODE = -236820;   //!< NAIF code of the MDIS NAC.
+    static const int GEOMETRY_COMPONENTS = 15;  //!< Values sampleGeometry() returns.
+
   private:
 
     string m_cubeFileString;
     bool m_validCube;
     static const int prec =16;
 
+    bool readInstrument(const function<bool(const string &, int, double *)> &lookup,
+                        const string &frame, string &error);
+    bool utcToEt(const string &utc, double &et, string &error) const;
+    bool sampleGeometry(double ephemerisTime, const string &target, double *values,
+                        string &error) const;
+    bool geometryAt(double ephemerisTime, const string &target, double *values,
+                    string &error) const;
+
+    int m_instrumentCode;   //!< NAIF code of the instrument.
+    string m_frame;         //!< The instrument's frame.
+    MdisIsd m_instrument;   //!< The values that come from the instrument kernel.
+    TimeConverter m_time;   //!< Converts UTC without CSPICE, once it has a leapseconds kernel.
+    ChebyshevCache m_fit;   //!< The geometry fitted by fitGeometry().
+
 };
 
 
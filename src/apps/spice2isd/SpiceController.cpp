@@ -17,6 +17,18 @@
 using namespace std;
 
 
+/**
+ * @brief SpiceController::SpiceController  Sets CSPICE to return from failed calls (instead
+ * of aborting) without printing, so errors can be reported per image by checkError().
+ */
+SpiceController::SpiceController() : m_kernlist(), m_furnish(true) {
+  char action[] = "RETURN";
+  char report[] = "NONE";
+  erract_c("SET", 0, action);
+  errprt_c("SET", 0, report);
+}
+
+
 void SpiceController::unload() {
 
   for (unsigned int i = 0; i < m_kernlist.size();i++) {
@@ -37,7 +49,13 @@ void SpiceController::load() {
 
 }
 
-void SpiceController::loadKernel(string &kernelFile) {
+
+/**
+ * @brief SpiceController::loadKernel  Loads one kernel into the kernel pool.
+ * @param kernelFile  The kernel file.
+ * @return false if the file does not exist or CSPICE could not load it.
+ */
+bool SpiceController::loadKernel(const string &kernelFile) {
 
 
 
@@ -45,21 +63,49 @@ void SpiceController::loadKernel(string &kernelFile) {
 
   if(!inFile.good() ) {
      cout << "Could not load: " << kernelFile << endl;
-     return;
+     return false;
   }
 
   if(m_furnish) {
     furnsh_c(kernelFile.c_str() );
+    string message;
+    if (checkError(message)) {
+      cout << "Could not load " << kernelFile << ": " << message << endl;
+      return false;
+    }
     m_kernlist.push_back(kernelFile);
     cout << kernelFile << " loaded."  <<endl;
   }
 
+  return true;
+}
 
 
-
-
-
+/**
+ * @brief SpiceController::loadMetaKernel  Loads every kernel listed in a meta-kernel (its
+ * KERNELS_TO_LOAD, relative to its PATH_VALUES), once for all the images of a run.
+ * Unloading the meta-kernel unloads all of them.
+ * @param metaKernel  The meta-kernel file.
+ * @return false if the meta-kernel or one of its kernels could not be loaded.
+ */
+bool SpiceController::loadMetaKernel(const string &metaKernel) {
+  return loadKernel(metaKernel);
 }
 
 
-
+/**
+ * @brief SpiceController::checkError  Checks whether a CSPICE call failed since the last
+ * check, and clears the error so later calls run normally.
+ * @param message  Set to the long error message if a call failed.
+ * @return true if a call failed.
+ */
+bool SpiceController::checkError(string &message) {
+  if (!failed_c()) {
+    return false;
+  }
+  SpiceChar text[1841];
+  getmsg_c("LONG", sizeof(text), text);
+  message = text;
+  reset_c();
+  return true;
+}
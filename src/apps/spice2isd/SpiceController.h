@@ -12,13 +12,19 @@
 
 using namespace std;
 
+/**
+ * Loads kernels into the CSPICE kernel pool and unloads them when destroyed.
+ *
+ * CSPICE is set to return from failed calls instead of aborting the process, so one bad
+ * image does not end a batch: after a sequence of CSPICE calls, checkError() reports and
+ * clears any error they raised.
+ */
 class SpiceController {
 
 
 public:
 
-  //Default constructor
-  SpiceController():m_kernlist(),m_furnish(true){ }
+  SpiceController();
 
   /** Returns the number of kernels found and/or loaded */
   int size() const {
@@ -31,7 +37,10 @@ public:
     unload();
   }
 
-  void loadKernel(string &kernelFile);
+  bool loadKernel(const string &kernelFile);
+  bool loadMetaKernel(const string &metaKernel);
+
+  static bool checkError(string &message);
 
 private:
   vector<string> m_kernlist;  //!< The list of kernels
@@ -41,4 +50,3 @@ private:
 };
 
 #endif
-
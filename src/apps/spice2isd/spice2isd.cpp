@@ -1,183 +1,552 @@
-
-
 #include "SpiceController.h"
 #include "CSpiceIsd.h"
-#include <gdal/gdal.h>
-#include <SpiceUsr.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
-#include <iomanip>
+#include <map>
+#include <sstream>
+#include <stdint.h>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include <TextKernel.h>
 
-
-#include <gdal/gdal.h>
-#include <gdal/gdal_priv.h>
-#include <gdal/cpl_conv.h>
-#include <gdal/cpl_string.h>
-
-
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 
 using namespace std;
 
+typedef vector<pair<string, string> > JobList;   // (cube or epoch, output file) pairs
+
+/** Where the kernels come from. */
+struct KernelOptions {
+  string metaKernel;          //!< The meta-kernel listing the kernels.
+  string instrumentKernel;    //!< The IK to read natively instead of from the pool, if any.
+  string leapseconds;         //!< The LSK to convert UTC with natively, if any.
+  string cacheDirectory;      //!< Where parsed text kernels are cached, if anywhere.
+};
+
+/** Whether and where the geometry of a batch is fitted. */
+struct FitOptions {
+  bool enabled;               //!< True to fit the geometry around the batch's exposures.
+  string file;                //!< The fit to start from and save to, if any.
+};
+
+bool readTextKernel(const KernelOptions &kernels, const string &filename, TextKernel &kernel);
+bool setUp(const KernelOptions &kernels, SpiceController &sc, CSpiceIsd &cspice, string &error);
+int runJobs(const KernelOptions &kernels, const FitOptions &fit, const JobList &jobs);
+void fitExposures(const FitOptions &fit, CSpiceIsd &cspice, const vector<Exposure> &exposures,
+                  const vector<bool> &valid);
+int runSharded(const KernelOptions &kernels, const JobList &jobs, int processes);
+void runWorker(const KernelOptions &kernels, const JobList &jobs, size_t first, size_t last,
+               int fd);
+string defaultIsdFile(const string &cubeOrEpoch);
 
 
-
-void cubeArray(vector<vector<float> > *cube, GDALRasterBand *poBand);
-
 int main(int argc,char *argv[]) {
 
-    int ikid = 236820;
-
-    vector<pair<string,SpiceDouble> >  isdList;
-
-
-    CSpiceIsd cspice("blah.cub");
-    SpiceController sc;
-
-    string kernel1("data/msgr_v231.tf");
-    string kernel2("data/msgr_v231.tf");
-    string kernel3("data/pck00010_msgr_v23.tpc");
-    string kernel4("data/msgr_dyn_v600.tf");
-    string kernel5("data/msgr_v231.tf");
-    string kernel6("data/msgr_de405_de423s.bsp");
-    string kernel7("data/msgr_mdis_sc050727_100302_sub_v1.bc");
-    string kernel8("data/msgr_mdis_gm040819_150430v1.bc");
-    string kernel9("data/naif0011.tls");
-    string kernel10("data/messenger_2548.tsc");
-
-
-    furnsh_c("data/msgr_mdis_v160.ti");
-    furnsh_c("data/msgr_v231.tf");
-    furnsh_c("data/pck00010_msgr_v23.tpc");
-    furnsh_c("data/msgr_dyn_v600.tf");
-    furnsh_c("data/msgr_v231.tf");
-    furnsh_c("data/msgr_de405_de423s.bsp");
-    furnsh_c("data/msgr_mdis_sc050727_100302_sub_v1.bc");
-    furnsh_c("data/msgr_mdis_gm040819_150430v1.bc");
-    furnsh_c("data/naif0011.tls");
-    furnsh_c("data/messenger_2548.tsc");
-
-
-    SpiceInt code;
-    SpiceInt found;
-    bodn2c_c("MESSENGER",&code,&found);
-
-
-    SpiceDouble focalLength;
-    SpiceInt numLines;
-    SpiceInt numSamples;
-    SpiceInt n;
-    SpiceDouble odt_x[9];
-    SpiceDouble odt_y[9];
-    SpiceDouble flEpsilon;
-    SpiceDouble pixelPitch;
-    SpiceDouble ccdCenter;
-    SpiceDouble ifov;
-    SpiceDouble boresight[3];
-    SpiceDouble transX[3];
-    SpiceDouble transY[3];
-    SpiceDouble itranss[3];
-    SpiceDouble itransl[3];
-    SpiceDouble startSample;
-    SpiceDouble startLine;
-
-    int prec = 10;
-
-    gdpool_c ("INS-236820_FOCAL_LENGTH", 0,1, &n, &focalLength, &found );
-    gdpool_c ("INS-236820_FL_UNCERTAINTY", 0,1, &n, &flEpsilon, &found );
-    gipool_c ("INS-236820_PIXEL_LINES", 0,1, &n, &numLines, &found );
-    gipool_c ("INS-236820_PIXEL_SAMPLES", 0,1, &n, &numSamples, &found );
-    gdpool_c ("INS-236820_PIXEL_PITCH", 0,1, &n, &pixelPitch, &found );
-    gdpool_c ("INS-236820_CCD_CENTER", 0,1, &n, &ccdCenter, &found );
-    gdpool_c ("INS-236820_IFOV", 0,1, &n, &ifov, &found );
-    gdpool_c ("INS-236820_BORESIGHT", 0,3, &n, boresight, &found );
-    gdpool_c ("INS-236820_TRANSX", 0,3, &n, transX, &found );
-    gdpool_c ("INS-236820_TRANSY", 0,3, &n, transY, &found );
-    gdpool_c ("INS-236820_ITRANSS", 0,3, &n, itranss, &found );
-    gdpool_c ("INS-236820_ITRANSL", 0,3, &n, itransl, &found );
-
-    gdpool_c ("INS-236820_OD_T_X", 0,9, &n, odt_x, &found );
-    gdpool_c ("INS-236820_OD_T_Y", 0,9, &n, odt_y, &found );
-
-    gdpool_c ("INS-236820_FPUBIN_START_SAMPLE", 0,1, &n, &startSample, &found );
-    gdpool_c ("INS-236820_FPUBIN_START_LINE", 0,1, &n, &startLine, &found );
-
+  KernelOptions kernels;
+  FitOptions fit;
+  fit.enabled = false;
+  string batchFile;
+  string outputFile;
+  string outputDirectory;
+  int processes = 1;
+  bool validArgs = true;
+  vector<string> images;
+
+  for (int i = 1; i < argc; i++) {
+    string arg(argv[i]);
+    if (arg == "--kernels" && i + 1 < argc) {
+      kernels.metaKernel = argv[++i];
+    }
+    else if (arg == "--ik" && i + 1 < argc) {
+      kernels.instrumentKernel = argv[++i];
+    }
+    else if (arg == "--lsk" && i + 1 < argc) {
+      kernels.leapseconds = argv[++i];
+    }
+    else if (arg == "--cache" && i + 1 < argc) {
+      kernels.cacheDirectory = argv[++i];
+    }
+    else if (arg == "--batch" && i + 1 < argc) {
+      batchFile = argv[++i];
+    }
+    else if ((arg == "--output" || arg == "-o") && i + 1 < argc) {
+      outputFile = argv[++i];
+    }
+    else if (arg == "--output-dir" && i + 1 < argc) {
+      outputDirectory = argv[++i];
+    }
+    else if (arg == "--fit") {
+      fit.enabled = true;
+    }
+    else if (arg == "--fit-file" && i + 1 < argc) {
+      fit.enabled = true;
+      fit.file = argv[++i];
+    }
+    else if (arg == "--processes" && i + 1 < argc) {
+      processes = atoi(argv[++i]);
+      validArgs = validArgs && processes > 0;
+    }
+    else {
+      images.push_back(arg);
+    }
+  }
 
-    string cubePath("CN0108840044M_IF_5_NAC_spiced.cub");
-    GDALDataset *poDataset;
-    GDALRasterBand *poBand;
-    int nBlockXSize,nBlockYSize;
+  bool single = batchFile.empty() && images.size() == 1;
+  bool batch = !batchFile.empty() && images.empty() && outputFile.empty();
+  if (kernels.metaKernel.empty() || !validArgs || (!single && !batch)) {
+    cout << "Usage: spice2isd --kernels META [--ik IK] [--lsk LSK] [--cache DIR]\n";
+    cout << "                 [--output FILE] <CUBE|EPOCH>\n";
+    cout << "       spice2isd --kernels META [--ik IK] [--lsk LSK] [--cache DIR]\n";
+    cout << "                 --batch LIST [--output-dir DIR] [--processes N]\n";
+    cout << "                 [--fit | --fit-file FILE]\n";
+    cout << "Computes MDIS NAC ISDs from the kernels listed in a meta-kernel, which are\n";
+    cout << "loaded once for all images.  An image is an ISIS cube (its exposure comes from\n";
+    cout << "its Instrument group) or an epoch (ephemeris seconds past J2000, or UTC).  Each\n";
+    cout << "line of a batch LIST is CUBE|EPOCH [OUTPUT]; the default output is the cube or\n";
+    cout << "epoch name with a .json extension, in DIR if given.  Images that fail are\n";
+    cout << "reported and skipped.  CSPICE is not thread-safe, so --processes splits a batch\n";
+    cout << "over N worker processes, each loading the kernels once.  --ik reads the MDIS\n";
+    cout << "constants from an instrument kernel without CSPICE (the meta-kernel need not\n";
+    cout << "list it); --lsk converts UTC times with a leapseconds kernel read the same way.\n";
+    cout << "--cache keeps the kernels read this way, parsed, in DIR for the next run.\n";
+    cout << "--fit fits polynomials to the spacecraft and sun positions and the camera\n";
+    cout << "rotation around each run of 16 or more images less than 10 minutes apart, within\n";
+    cout << "1 cm, 1 m and 1e-9, and computes those images from the fit in one process.\n";
+    cout << "--fit-file also starts from the fit in FILE, if it exists, and saves it there.\n";
+    return 1;
+  }
 
+  // Pair every image with its output file.
+  JobList jobs;
+  if (single) {
+    jobs.push_back(make_pair(images[0],
+                             outputFile.empty() ? defaultIsdFile(images[0]) : outputFile));
+  }
+  else {
+    ifstream list(batchFile.c_str());
+    if (!list.is_open()) {
+      cout << "Could not open the batch list " << batchFile << endl;
+      return 1;
+    }
+    string line;
+    while (getline(list, line)) {
+      istringstream fields(line);
+      string image, output;
+      if (!(fields >> image) || image[0] == '#') {
+        continue;
+      }
+      if (!(fields >> output)) {
+        output = defaultIsdFile(image);
+      }
+      if (!outputDirectory.empty() && output[0] != '/') {
+        output = outputDirectory + "/" + output;
+      }
+      jobs.push_back(make_pair(image, output));
+    }
+  }
 
-    GDALAllRegister();
+  int failures = processes > 1 && jobs.size() > 1 && !fit.enabled
+                     ? runSharded(kernels, jobs, processes)
+                     : runJobs(kernels, fit, jobs);
+  if (failures < 0) {
+    return 1;
+  }
+  cout << jobs.size() - failures << " of " << jobs.size() << " ISDs written." << endl;
+  return failures == 0 ? 0 : 1;
+}
 
-    poDataset = (GDALDataset *)GDALOpen(cubePath.c_str(),GA_ReadOnly);
 
-    if(poDataset == NULL) {
+/**
+ * Reads a text kernel natively, through the cache of parsed text kernels if there is one.
+ *
+ * @param kernels Where the kernels come from.
+ * @param filename The text kernel.
+ * @param kernel Receives the kernel's variables.
+ *
+ * @return @b bool Returns false if the kernel could not be read.
+ */
+bool readTextKernel(const KernelOptions &kernels, const string &filename, TextKernel &kernel) {
+  return kernels.cacheDirectory.empty() ? kernel.load(filename)
+                                        : kernel.loadCached(filename, kernels.cacheDirectory);
+}
 
-      cout << "Could not open the:" + cubePath  << endl;
 
+/**
+ * Loads the kernel pool once for every image, and the instrument constants from it, or from
+ * the instrument kernel read natively.  UTC times are converted with the leapseconds kernel
+ * read natively, if one is given.
+ *
+ * @param kernels Where the kernels come from.
+ * @param sc Loads the kernels.
+ * @param cspice Reads the instrument constants.
+ * @param error Set to the reason if the kernels or constants could not be loaded.
+ *
+ * @return @b bool Returns false if the kernels or constants could not be loaded.
+ */
+bool setUp(const KernelOptions &kernels, SpiceController &sc, CSpiceIsd &cspice,
+           string &error) {
+  if (!sc.loadMetaKernel(kernels.metaKernel)) {
+    error = "could not load the kernels of " + kernels.metaKernel;
+    return false;
+  }
+  if (!kernels.leapseconds.empty()) {
+    TextKernel lsk;
+    if (!readTextKernel(kernels, kernels.leapseconds, lsk)) {
+      error = "could not read " + kernels.leapseconds;
+      return false;
     }
+    if (!cspice.loadLeapseconds(lsk, error)) {
+      error = kernels.leapseconds + ": " + error;
+      return false;
+    }
+  }
 
-    else {
-
-      poBand = poDataset->GetRasterBand(1);
-      poBand->GetBlockSize(&nBlockXSize,&nBlockYSize);
-
-    //Read a band of data
-
-      vector<vector<float> > cubeMatrix;
-      cubeArray(&cubeMatrix,poBand);
-      for (int i =0; i < cubeMatrix.size(); i++ ) {
-        vector<float> v = cubeMatrix[i];
+  if (kernels.instrumentKernel.empty()) {
+    if (!cspice.loadInstrument(error)) {
+      error = "could not read the MDIS NAC constants: " + error;
+      return false;
+    }
+    return true;
+  }
 
-        for (int j = 0; j < v.size(); j++) {
-            cout << v[j] << endl;
-        }//end inner-for
+  TextKernel ik;
+  if (!readTextKernel(kernels, kernels.instrumentKernel, ik)) {
+    error = "could not read " + kernels.instrumentKernel;
+    return false;
+  }
+  if (!cspice.loadInstrument(ik, error)) {
+    error = "could not read the MDIS NAC constants from " + kernels.instrumentKernel + ": " +
+            error;
+    return false;
+  }
+  return true;
+}
 
 
-      }//end outer-for
+/**
+ * Computes and writes the ISDs of a list of images in this process, from the geometry
+ * fitted around their exposures if asked to.
+ *
+ * @param kernels Where the kernels come from.
+ * @param fit Whether and where the geometry is fitted.
+ * @param jobs The images and their output files.
+ *
+ * @return @b int Returns the number of images that failed, or -1 if the kernels could not
+ *                be loaded.
+ */
+int runJobs(const KernelOptions &kernels, const FitOptions &fit, const JobList &jobs) {
+  SpiceController sc;
+  CSpiceIsd cspice;
+  string error;
+  if (!setUp(kernels, sc, cspice, error)) {
+    cout << error << endl;
+    return -1;
+  }
 
-    }  //end else
+  vector<Exposure> exposures(jobs.size());
+  vector<string> errors(jobs.size());
+  vector<bool> valid(jobs.size());
+  for (size_t i = 0; i < jobs.size(); i++) {
+    valid[i] = cspice.readExposure(jobs[i].first, exposures[i], errors[i]);
+  }
+  if (fit.enabled) {
+    fitExposures(fit, cspice, exposures, valid);
+  }
 
+  int failures = 0;
+  MdisIsd isd;
+  IsdWriter writer;
+  for (size_t i = 0; i < jobs.size(); i++) {
+    if (!valid[i] || !cspice.computeIsd(exposures[i], isd, errors[i])) {
+      cout << jobs[i].first << ": " << errors[i] << endl;
+      failures++;
+      continue;
+    }
+    if (!writer.writeJSON(isd, jobs[i].second)) {
+      failures++;
+    }
+  }
+  return failures;
 }
 
 
 /**
- * @brief cubeArray:  Translates a GDALRasterBand into a 2D vector matrix
- * @param cube:  The 2D vector matrix which is output by this function.
- * @param poBand:  The GDALRasterBand obtained from the ISIS3 cube.
+ * Fits the geometry around the exposures of a batch's most common target, starting from
+ * and saving to the fit file if there is one, and reports the fit's error bound.
+ *
+ * @param fit Whether and where the geometry is fitted.
+ * @param cspice Fits the geometry.
+ * @param exposures The exposures of the batch.
+ * @param valid Whether each exposure could be read.
  */
+void fitExposures(const FitOptions &fit, CSpiceIsd &cspice, const vector<Exposure> &exposures,
+                  const vector<bool> &valid) {
+  if (!fit.file.empty() && access(fit.file.c_str(), F_OK) == 0 && !cspice.loadFit(fit.file)) {
+    cout << "Could not read the fit " << fit.file << "; fitting again." << endl;
+  }
 
-void cubeArray(vector <vector<float> > *cube,GDALRasterBand *poBand) {
+  map<string, vector<double> > epochs;
+  string target;
+  for (size_t i = 0; i < exposures.size(); i++) {
+    if (valid[i]) {
+      vector<double> &targetEpochs = epochs[exposures[i].target];
+      targetEpochs.push_back(exposures[i].ephemerisTime);
+      if (target.empty() || targetEpochs.size() > epochs[target].size()) {
+        target = exposures[i].target;
+      }
+    }
+  }
+  if (target.empty()) {
+    return;
+  }
 
-  vector<float> tempVector;
+  const ChebyshevCache &geometry = cspice.geometryFit();
+  size_t segments = geometry.label() == target ? geometry.segments() : 0;
+  int failures = cspice.fitGeometry(epochs[target], target);
+  const vector<double> &errors = geometry.errors();
+  cout << "Geometry fit of " << target << ": " << geometry.segments() << " segments, "
+       << "largest errors " << max(errors[0], max(errors[1], errors[2])) << " m (spacecraft), "
+       << max(errors[3], max(errors[4], errors[5])) << " m (sun), "
+       << *max_element(errors.begin() + 6, errors.end()) << " (rotation)." << endl;
+  if (failures > 0) {
+    cout << failures << " windows could not be fitted; their images are queried directly."
+         << endl;
+  }
+  if (!fit.file.empty() && geometry.segments() != segments) {
+    cspice.saveFit(fit.file);
+  }
+}
 
-  float *pafScanline;
-  int nsamps = poBand->GetXSize();
-  int nlines = poBand->GetYSize();
 
-  for (int j = 0;j<nlines;j++) {
+/**
+ * Computes the ISDs of a list of images in worker processes and writes them in this one.
+ *
+ * The list is split into one contiguous shard per worker, so each worker's images tend to
+ * share ephemeris segments.  Each worker loads the kernels once and sends back one record
+ * per image through its own pipe: a uint32 job index, a uint32 payload size and the
+ * payload, which is 'I' and an MdisIsd in IsdWriter's binary format, or 'E' and an error
+ * message.
+ *
+ * @param kernels Where the kernels come from.
+ * @param jobs The images and their output files.
+ * @param processes The number of worker processes.
+ *
+ * @return @b int Returns the number of images that failed.
+ */
+int runSharded(const KernelOptions &kernels, const JobList &jobs, int processes) {
+  processes = min<size_t>(processes, jobs.size());
+  vector<pid_t> workers;
+  vector<int> fds;
+  vector<string> buffers;
+  vector<bool> done(jobs.size(), false);
+
+  // Don't let the workers inherit (and flush again) anything the parent has buffered.
+  cout.flush();
+  fflush(NULL);
+
+  for (int w = 0; w < processes; w++) {
+    size_t first = jobs.size() * w / processes;
+    size_t last = jobs.size() * (w + 1) / processes;
+    int pipeFds[2];
+    if (pipe(pipeFds) != 0) {
+      perror("error while creating a pipe");
+      break;
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+      perror("error while starting a worker");
+      close(pipeFds[0]);
+      close(pipeFds[1]);
+      break;
+    }
+    if (pid == 0) {
+      close(pipeFds[0]);
+      for (size_t i = 0; i < fds.size(); i++) {
+        close(fds[i]);
+      }
+      runWorker(kernels, jobs, first, last, pipeFds[1]);
+      close(pipeFds[1]);
+      cout.flush();
+      _exit(0);
+    }
+    close(pipeFds[1]);
+    workers.push_back(pid);
+    fds.push_back(pipeFds[0]);
+    buffers.push_back(string());
+  }
 
-    pafScanline = (float *)CPLMalloc(sizeof(float)*nsamps);
-    poBand->RasterIO(GF_Read,0,j,nsamps,1,pafScanline,nsamps,1,GDT_Float32,0,0);
+  // Write the records as they come in, from whichever worker has sent some.
+  int failures = 0;
+  size_t openPipes = fds.size();
+  vector<char> chunk(1 << 16);
+  MdisIsd isd;
+  IsdWriter writer;
+  while (openPipes > 0) {
+    vector<pollfd> polls;
+    vector<size_t> pollWorkers;
+    for (size_t w = 0; w < fds.size(); w++) {
+      if (fds[w] >= 0) {
+        pollfd entry = { fds[w], POLLIN, 0 };
+        polls.push_back(entry);
+        pollWorkers.push_back(w);
+      }
+    }
+    if (poll(&polls[0], polls.size(), -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("error while waiting for the workers");
+      break;
+    }
 
-    for (int i = 0;i < nsamps;i++) {
-        tempVector.push_back(pafScanline[i]);
+    for (size_t p = 0; p < polls.size(); p++) {
+      if (polls[p].revents == 0) {
+        continue;
+      }
+      size_t w = pollWorkers[p];
+      ssize_t count = read(fds[w], &chunk[0], chunk.size());
+      if (count < 0 && errno == EINTR) {
+        continue;
+      }
+      if (count <= 0) {
+        close(fds[w]);
+        fds[w] = -1;
+        openPipes--;
+        continue;
+      }
+
+      string &buffer = buffers[w];
+      buffer.append(&chunk[0], count);
+      size_t position = 0;
+      while (buffer.size() - position >= 8) {
+        uint32_t index, size;
+        memcpy(&index, buffer.data() + position, 4);
+        memcpy(&size, buffer.data() + position + 4, 4);
+        if (buffer.size() - position - 8 < size) {
+          break;
+        }
+        const char *payload = buffer.data() + position + 8;
+        position += 8 + size;
+        if (index >= jobs.size() || size == 0) {
+          continue;
+        }
+
+        done[index] = true;
+        if (payload[0] == 'I' && IsdWriter::readBinary(payload + 1, size - 1, isd)) {
+          if (!writer.writeJSON(isd, jobs[index].second)) {
+            failures++;
+          }
+        }
+        else {
+          cout << jobs[index].first << ": " << string(payload + 1, size - 1) << endl;
+          failures++;
+        }
+      }
+      buffer.erase(0, position);
     }
-    cube->push_back(tempVector);
-    tempVector.clear();
-    //free the memory allocated to store the current scanline
-    CPLFree(pafScanline);
   }
 
+  for (size_t w = 0; w < workers.size(); w++) {
+    if (fds[w] >= 0) {
+      close(fds[w]);
+    }
+    int status;
+    waitpid(workers[w], &status, 0);
+  }
 
+  // Images whose worker could not start or died before sending them.
+  for (size_t i = 0; i < jobs.size(); i++) {
+    if (!done[i]) {
+      cout << jobs[i].first << ": no result from its worker process" << endl;
+      failures++;
+    }
+  }
+  return failures;
+}
 
 
+/**
+ * Runs in a worker process: loads the kernels and sends the record of every image of a
+ * shard to the parent (see runSharded()).
+ *
+ * @param kernels Where the kernels come from.
+ * @param jobs The images and their output files.
+ * @param first The index of the first image of the shard.
+ * @param last The index one past the last image of the shard.
+ * @param fd The write end of the pipe to the parent.
+ */
+void runWorker(const KernelOptions &kernels, const JobList &jobs, size_t first, size_t last,
+               int fd) {
+  SpiceController sc;
+  CSpiceIsd cspice;
+  string error;
+  bool ready = setUp(kernels, sc, cspice, error);
+
+  MdisIsd isd;
+  IsdWriter writer;
+  string record;
+  for (size_t i = first; i < last; i++) {
+    record.assign(8, '\0');
+    if (ready && cspice.computeIsd(jobs[i].first, isd, error)) {
+      record += 'I';
+      writer.clear();
+      writer.appendBinary(isd);
+      record.append(writer.data(), writer.size());
+    }
+    else {
+      record += 'E';
+      record += error;
+    }
+    uint32_t index = i;
+    uint32_t size = record.size() - 8;
+    memcpy(&record[0], &index, 4);
+    memcpy(&record[4], &size, 4);
+
+    const char *data = record.data();
+    size_t remaining = record.size();
+    while (remaining > 0) {
+      ssize_t count = write(fd, data, remaining);
+      if (count < 0 && errno == EINTR) {
+        continue;
+      }
+      if (count <= 0) {
+        return;
+      }
+      data += count;
+      remaining -= count;
+    }
+  }
 }
 
 
-
+/**
+ * Returns the default ISD file of an image: the cube's file name without directory and
+ * extension, or the epoch with the characters that are awkward in file names replaced,
+ * followed by .json.
+ *
+ * @param cubeOrEpoch The cube or epoch.
+ */
+string defaultIsdFile(const string &cubeOrEpoch) {
+  size_t slash = cubeOrEpoch.find_last_of('/');
+  string name = (slash == string::npos) ? cubeOrEpoch : cubeOrEpoch.substr(slash + 1);
+  size_t dot = name.rfind(".cub");
+  if (dot != string::npos && dot > 0) {
+    name.erase(dot);
+  }
+  for (size_t i = 0; i < name.size(); i++) {
+    if (name[i] == ':' || name[i] == ' ') {
+      name[i] = '_';
+    }
+  }
+  return name + ".json";
+}
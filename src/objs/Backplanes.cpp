@@ -0,0 +1,196 @@
+#include "Backplanes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+#include <gdal/gdal.h>
+#include <gdal/gdal_priv.h>
+#include <gdal/cpl_error.h>
+#include <gdal/cpl_string.h>
+
+#include "MdisNacSensorModel.h"
+#include "SurfaceAngles.h"
+#include "TextBuffer.h"
+
+using namespace std;
+
+static const char *s_names[Backplanes::NUM_BACKPLANES] = {
+  "Latitude (deg)", "Longitude (deg)", "Radius (km)", "Incidence (deg)", "Emission (deg)",
+  "Phase (deg)", "Resolution (m/pixel)"
+};
+
+
+/**
+ * @brief Returns the description of a backplane (its name and units).
+ */
+const char *Backplanes::name(Backplane backplane) {
+  return s_names[backplane];
+}
+
+
+/**
+ * @brief Sets up the backplanes of a frame.  The model must outlive this object.
+ * @param model  The model of the frame; its ISD must have a sun_position.
+ */
+Backplanes::Backplanes(const MdisNacSensorModel &model) :
+    m_model(model), m_sensorPosition(model.getSensorPosition(0.0)) {
+}
+
+
+/**
+ * @brief Computes every backplane of one pixel.
+ * @param imagePoint  The pixel (CSM image coordinates).
+ * @param values  Receives the values: values[backplane * bandStride].
+ * @param bandStride  Distance between the values of consecutive backplanes.
+ * @throw csm::Error if the model has no sun position.
+ */
+void Backplanes::computePixel(const csm::ImageCoord &imagePoint, float *values,
+                              size_t bandStride) const {
+  csm::EcefCoord ground = m_model.imageToGround(imagePoint, 0.0);
+  double radius = sqrt(ground.x * ground.x + ground.y * ground.y + ground.z * ground.z);
+  if (radius == 0.0) {
+    for (int band = 0; band < NUM_BACKPLANES; band++) {
+      values[band * bandStride] = numeric_limits<float>::quiet_NaN();
+    }
+    return;
+  }
+
+  double normal[3] = { ground.x / radius, ground.y / radius, ground.z / radius };
+
+  double toSensor[3] = { m_sensorPosition.x - ground.x, m_sensorPosition.y - ground.y,
+                         m_sensorPosition.z - ground.z };
+  double range = sqrt(toSensor[0] * toSensor[0] + toSensor[1] * toSensor[1] +
+                      toSensor[2] * toSensor[2]);
+  for (int i = 0; i < 3; i++) {
+    toSensor[i] /= range;
+  }
+
+  csm::EcefVector illumination = m_model.getIlluminationDirection(ground);
+  double toSun[3] = { -illumination.x, -illumination.y, -illumination.z };
+
+  values[LATITUDE * bandStride] = asin(normal[2]) * DEGREES_PER_RADIAN;
+  values[LONGITUDE * bandStride] = positiveEastLongitude(ground.x, ground.y);
+  values[RADIUS * bandStride] = radius / 1000;
+  values[INCIDENCE * bandStride] = angleBetween(normal, toSun);
+  values[EMISSION * bandStride] = angleBetween(normal, toSensor);
+  values[PHASE * bandStride] = angleBetween(toSun, toSensor);
+  values[RESOLUTION * bandStride] = m_model.getPixelResolution(ground);
+}
+
+
+/**
+ * @brief Computes every backplane of one row of a window's output grid.
+ * @param window  The pixels of the image being processed.
+ * @param row  The (0-based) output row.
+ * @param values  Receives the row: values[backplane * bandStride + column].
+ * @param bandStride  Distance between the rows of consecutive backplanes.
+ */
+void Backplanes::computeRow(const ImageWindow &window, int row, float *values,
+                            size_t bandStride) const {
+  double line = window.imageLine(row) + 1;
+  for (int column = 0; column < window.outputSamples(); column++) {
+    csm::ImageCoord imagePoint(line, window.imageSample(column) + 1);
+    computePixel(imagePoint, values + column, bandStride);
+  }
+}
+
+
+BackplaneWriter::BackplaneWriter() : m_dataset(NULL), m_samples(0), m_failed(false) {
+}
+
+
+BackplaneWriter::~BackplaneWriter() {
+  close();
+}
+
+
+/**
+ * @brief Creates the GeoTIFF for the output grid of a window.
+ * @return false if the file could not be created.
+ */
+bool BackplaneWriter::open(const string &filename, const ImageWindow &window) {
+  close();
+  GDALAllRegister();
+  GDALDriver *driver = (GDALDriver *)GDALGetDriverByName("GTiff");
+  if (driver == NULL) {
+    cerr << "The GDAL GTiff driver is not available" << endl;
+    return false;
+  }
+
+  char **options = NULL;
+  options = CSLSetNameValue(options, "INTERLEAVE", "BAND");
+  options = CSLSetNameValue(options, "BIGTIFF", "IF_SAFER");
+  m_dataset = driver->Create(filename.c_str(), window.outputSamples(), window.outputLines(),
+                             Backplanes::NUM_BACKPLANES, GDT_Float32, options);
+  CSLDestroy(options);
+  if (m_dataset == NULL) {
+    cerr << "Could not create " << filename << endl;
+    return false;
+  }
+
+  for (int band = 0; band < Backplanes::NUM_BACKPLANES; band++) {
+    GDALRasterBand *rasterBand = m_dataset->GetRasterBand(band + 1);
+    rasterBand->SetDescription(Backplanes::name(static_cast<Backplanes::Backplane>(band)));
+    rasterBand->SetNoDataValue(numeric_limits<double>::quiet_NaN());
+  }
+  // Record where the grid's pixels are in the image (1-based).
+  char value[MAX_NUMBER_LENGTH];
+  const int windowValues[] = { window.startSample + 1, window.startLine + 1,
+                               window.sampleStride, window.lineStride };
+  const char *windowNames[] = { "START_SAMPLE", "START_LINE", "SAMPLE_STRIDE",
+                                "LINE_STRIDE" };
+  for (int i = 0; i < 4; i++) {
+    formatInteger(windowValues[i], value);
+    m_dataset->SetMetadataItem(windowNames[i], value);
+  }
+
+  m_filename = filename;
+  m_samples = window.outputSamples();
+  m_failed = false;
+  return true;
+}
+
+
+/**
+ * @brief Writes a strip of whole rows of every backplane.  Strips must be written in order.
+ * @param startRow  The 0-based first row of the strip.
+ * @param rows  The number of rows in the strip.
+ * @param values  The strip, band-sequential: values[(backplane * rows + row) * samples +
+ *                column].
+ * @return false if the strip could not be written.
+ */
+bool BackplaneWriter::write(int startRow, int rows, const float *values) {
+  size_t bandSize = (size_t)rows * m_samples;
+  for (int band = 0; band < Backplanes::NUM_BACKPLANES && !m_failed; band++) {
+    CPLErr status = m_dataset->GetRasterBand(band + 1)->RasterIO(
+        GF_Write, 0, startRow, m_samples, rows, const_cast<float *>(values + band * bandSize),
+        m_samples, rows, GDT_Float32, 0, 0);
+    if (status != CE_None) {
+      cerr << "Error while writing file " << m_filename << endl;
+      m_failed = true;
+    }
+  }
+  return !m_failed;
+}
+
+
+/**
+ * @brief Finishes and closes the file.
+ * @return false if this or an earlier write failed.
+ */
+bool BackplaneWriter::close() {
+  if (m_dataset != NULL) {
+    // Closing writes the last blocks and the TIFF directory; GDAL reports a failure to do
+    // so only through its error state.
+    CPLErrorReset();
+    GDALClose(m_dataset);
+    m_dataset = NULL;
+    if (CPLGetLastErrorType() >= CE_Failure) {
+      cerr << "Error while writing file " << m_filename << endl;
+      m_failed = true;
+    }
+  }
+  return !m_failed;
+}
@@ -0,0 +1,377 @@
+#include "ChebyshevCache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdint.h>
+#include <utility>
+
+#include <unistd.h>
+
+using namespace std;
+
+static const char CACHE_MAGIC[8] = { 'M', 'D', 'I', 'S', 'C', 'H', 'E', 'B' };
+static const uint32_t CACHE_VERSION = 1;
+static const size_t HEADER_SIZE = 40;
+static const int MAX_DEPTH = 48;
+
+
+/**
+ * @brief Returns the value of a Chebyshev series at x in [-1, 1], and its derivative with
+ * respect to x.
+ * @param coefficients  The coefficients, from degree 0.
+ * @param count  The number of coefficients.
+ * @param x  Where to evaluate the series.
+ * @param derivative  Receives the derivative, if not NULL.
+ */
+static double evaluateSeries(const double *coefficients, int count, double x,
+                             double *derivative) {
+  // T(j+1) = 2x T(j) - T(j-1), and T'(j+1) = 2 T(j) + 2x T'(j) - T'(j-1).
+  double previous = 1.0, current = x;
+  double previousSlope = 0.0, currentSlope = 1.0;
+  double value = coefficients[0];
+  double slope = 0.0;
+  for (int j = 1; j < count; j++) {
+    value += coefficients[j] * current;
+    slope += coefficients[j] * currentSlope;
+    double next = 2.0 * x * current - previous;
+    double nextSlope = 2.0 * current + 2.0 * x * currentSlope - previousSlope;
+    previous = current;
+    current = next;
+    previousSlope = currentSlope;
+    currentSlope = nextSlope;
+  }
+  if (derivative != NULL) {
+    *derivative = slope;
+  }
+  return value;
+}
+
+
+ChebyshevCache::ChebyshevCache() : m_degree(0), m_minimumSpan(0.0) {
+}
+
+
+/**
+ * @brief Creates an empty cache.
+ * @param tolerances  The largest error allowed for each component of the function.
+ * @param degree  The degree of the polynomials.
+ * @param minimumSpan  The shortest segment (in the units of time) a fit may bisect.
+ */
+ChebyshevCache::ChebyshevCache(const vector<double> &tolerances, int degree,
+                               double minimumSpan)
+    : m_tolerances(tolerances), m_errors(tolerances.size(), 0.0), m_degree(degree),
+      m_minimumSpan(minimumSpan) {
+}
+
+
+/**
+ * @brief Fits the function over a window, leaving the parts of it already fitted alone.
+ * @param sample  Samples the function.
+ * @param start  The start of the window.
+ * @param end  The end of the window.
+ * @return false if the function could not be sampled or fitted within the tolerances (the
+ *         cache is then left as it was).
+ */
+bool ChebyshevCache::fit(const Sampler &sample, double start, double end) {
+  if (m_tolerances.empty() || m_degree < 0 || end < start) {
+    return false;
+  }
+  if (covers(start, end)) {
+    return true;
+  }
+
+  // The parts of the window no segment covers.
+  vector<pair<double, double> > gaps;
+  double cursor = start;
+  for (size_t s = 0; s < m_segments.size() && m_segments[s].start < end; s++) {
+    if (m_segments[s].end <= cursor) {
+      continue;
+    }
+    if (m_segments[s].start > cursor) {
+      gaps.push_back(make_pair(cursor, m_segments[s].start));
+    }
+    cursor = m_segments[s].end;
+  }
+  if (cursor < end || gaps.empty()) {
+    gaps.push_back(make_pair(cursor, max(cursor, end)));
+  }
+
+  vector<Segment> fitted;
+  vector<double> errors(m_tolerances.size(), 0.0);
+  swap(fitted, m_segments);
+  swap(errors, m_errors);
+  bool ok = true;
+  for (size_t g = 0; g < gaps.size() && ok; g++) {
+    ok = fitSegment(sample, gaps[g].first, gaps[g].second, 0);
+  }
+  swap(fitted, m_segments);
+  swap(errors, m_errors);
+  if (!ok) {
+    return false;
+  }
+
+  m_segments.insert(m_segments.end(), fitted.begin(), fitted.end());
+  sort(m_segments.begin(), m_segments.end());
+  for (size_t i = 0; i < m_errors.size(); i++) {
+    m_errors[i] = max(m_errors[i], errors[i]);
+  }
+  return true;
+}
+
+
+/**
+ * @brief Fits one segment, or its halves if it misses a tolerance, appending them to the
+ * segments and their errors to the errors.
+ * @param sample  Samples the function.
+ * @param start  The start of the segment.
+ * @param end  The end of the segment.
+ * @param depth  How many times the window has been bisected.
+ * @return false if the function could not be sampled or the segment fitted.
+ */
+bool ChebyshevCache::fitSegment(const Sampler &sample, double start, double end, int depth) {
+  int count = m_degree + 1;
+  int components = m_tolerances.size();
+  double middle = 0.5 * (start + end);
+  double half = 0.5 * (end - start);
+
+  Segment segment;
+  segment.start = start;
+  segment.end = end;
+  segment.coefficients.assign(components * count, 0.0);
+  vector<double> values(components);
+  for (int k = 0; k < count; k++) {
+    double angle = M_PI * (k + 0.5) / count;
+    if (!sample(middle + half * cos(angle), &values[0])) {
+      return false;
+    }
+    for (int i = 0; i < components; i++) {
+      for (int j = 0; j < count; j++) {
+        segment.coefficients[i * count + j] += values[i] * cos(j * angle) * 2.0 / count;
+      }
+    }
+  }
+  for (int i = 0; i < components; i++) {
+    segment.coefficients[i * count] *= 0.5;
+  }
+
+  // Check the fit halfway between the nodes and at the ends, where it strays the most.
+  vector<double> errors(components, 0.0);
+  bool within = true;
+  for (int k = 0; k <= count && within; k++) {
+    double x = cos(M_PI * k / count);
+    if (!sample(middle + half * x, &values[0])) {
+      return false;
+    }
+    for (int i = 0; i < components; i++) {
+      double error = fabs(evaluateSeries(&segment.coefficients[i * count], count, x, NULL) -
+                          values[i]);
+      errors[i] = max(errors[i], error);
+      within = within && !(error > m_tolerances[i]);
+    }
+  }
+
+  if (within) {
+    m_segments.push_back(segment);
+    for (int i = 0; i < components; i++) {
+      m_errors[i] = max(m_errors[i], errors[i]);
+    }
+    return true;
+  }
+  if (half < m_minimumSpan || depth >= MAX_DEPTH) {
+    cerr << "error while fitting Chebyshev polynomials: no fit within the tolerances from "
+         << start << " to " << end << endl;
+    return false;
+  }
+  return fitSegment(sample, start, middle, depth + 1) &&
+         fitSegment(sample, middle, end, depth + 1);
+}
+
+
+/**
+ * @brief Evaluates the fitted function.
+ * @param time  The time.
+ * @param values  Receives the components of the function.
+ * @param rates  Receives their derivatives with respect to time, if not NULL.
+ * @return false if the time is not inside a fitted window.
+ */
+bool ChebyshevCache::evaluate(double time, double *values, double *rates) const {
+  const Segment *segment = find(time);
+  if (segment == NULL) {
+    return false;
+  }
+  int count = m_degree + 1;
+  double half = 0.5 * (segment->end - segment->start);
+  double x = half > 0.0 ? (time - segment->start) / half - 1.0 : 0.0;
+  for (int i = 0; i < components(); i++) {
+    double slope;
+    values[i] = evaluateSeries(&segment->coefficients[i * count], count, x, &slope);
+    if (rates != NULL) {
+      rates[i] = half > 0.0 ? slope / half : 0.0;
+    }
+  }
+  return true;
+}
+
+
+/**
+ * @brief Returns true if fitted segments cover a whole window, without gaps.
+ */
+bool ChebyshevCache::covers(double start, double end) const {
+  const Segment *segment = find(start);
+  if (segment == NULL) {
+    return false;
+  }
+  size_t s = segment - &m_segments[0];
+  while (m_segments[s].end < end) {
+    if (s + 1 == m_segments.size() || m_segments[s + 1].start > m_segments[s].end) {
+      return false;
+    }
+    s++;
+  }
+  return true;
+}
+
+
+/**
+ * @brief Removes every segment and resets the error bound.
+ */
+void ChebyshevCache::clear() {
+  m_segments.clear();
+  m_errors.assign(m_tolerances.size(), 0.0);
+}
+
+
+/**
+ * @brief Returns the segment holding a time, or NULL if none does.
+ */
+const ChebyshevCache::Segment *ChebyshevCache::find(double time) const {
+  Segment key;
+  key.start = time;
+  vector<Segment>::const_iterator next = upper_bound(m_segments.begin(), m_segments.end(),
+                                                     key);
+  if (next == m_segments.begin() || time > (next - 1)->end) {
+    return NULL;
+  }
+  return &*(next - 1);
+}
+
+
+/**
+ * @brief Writes the cache to a file.  The file is written under a temporary name and
+ * renamed, so concurrent jobs never read a partial file.
+ *
+ * Layout (native byte order): "MDISCHEB" magic, uint32 version, uint32 components, uint32
+ * degree, uint32 label length, uint64 segment count, double minimum span; the label; the
+ * tolerances and errors of the components; then for each segment its start, end and
+ * coefficients (degree + 1 per component, from degree 0).
+ *
+ * @param filename  The file.
+ * @return false if the file could not be written.
+ */
+bool ChebyshevCache::save(const string &filename) const {
+  string contents(HEADER_SIZE, '\0');
+  uint32_t header[4] = { CACHE_VERSION, (uint32_t)components(), (uint32_t)m_degree,
+                         (uint32_t)m_label.size() };
+  uint64_t count = m_segments.size();
+  memcpy(&contents[0], CACHE_MAGIC, 8);
+  memcpy(&contents[8], header, sizeof(header));
+  memcpy(&contents[24], &count, 8);
+  memcpy(&contents[32], &m_minimumSpan, 8);
+  contents.append(m_label);
+  contents.append(reinterpret_cast<const char *>(m_tolerances.data()),
+                  m_tolerances.size() * sizeof(double));
+  contents.append(reinterpret_cast<const char *>(m_errors.data()),
+                  m_errors.size() * sizeof(double));
+  for (size_t s = 0; s < m_segments.size(); s++) {
+    const Segment &segment = m_segments[s];
+    contents.append(reinterpret_cast<const char *>(&segment.start), sizeof(double));
+    contents.append(reinterpret_cast<const char *>(&segment.end), sizeof(double));
+    contents.append(reinterpret_cast<const char *>(segment.coefficients.data()),
+                    segment.coefficients.size() * sizeof(double));
+  }
+
+  char suffix[32];
+  snprintf(suffix, sizeof(suffix), ".%ld.tmp", (long)getpid());
+  string temporary = filename + suffix;
+  FILE *file = fopen(temporary.c_str(), "wb");
+  if (file == NULL) {
+    perror(("error while opening file " + temporary).c_str());
+    return false;
+  }
+  bool ok = fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+  ok = fclose(file) == 0 && ok;
+  ok = ok && rename(temporary.c_str(), filename.c_str()) == 0;
+  if (!ok) {
+    perror(("error while writing file " + filename).c_str());
+    remove(temporary.c_str());
+  }
+  return ok;
+}
+
+
+/**
+ * @brief Reads a cache written by save(), replacing this one.
+ * @param filename  The file.
+ * @return false if the file could not be read or is not a valid cache (this one is then
+ *         left empty).
+ */
+bool ChebyshevCache::load(const string &filename) {
+  clear();
+  FILE *file = fopen(filename.c_str(), "rb");
+  if (file == NULL) {
+    perror(("error while opening file " + filename).c_str());
+    return false;
+  }
+  string contents;
+  char buffer[1 << 16];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    contents.append(buffer, read);
+  }
+  fclose(file);
+
+  uint32_t header[4];
+  uint64_t count = 0;
+  bool ok = contents.size() >= HEADER_SIZE && memcmp(contents.data(), CACHE_MAGIC, 8) == 0;
+  if (ok) {
+    memcpy(header, contents.data() + 8, sizeof(header));
+    memcpy(&count, contents.data() + 24, 8);
+    memcpy(&m_minimumSpan, contents.data() + 32, 8);
+    ok = header[0] == CACHE_VERSION && header[1] > 0;
+  }
+  size_t components = ok ? header[1] : 0;
+  size_t coefficients = ok ? components * (header[2] + 1) : 0;
+  size_t size = ok ? HEADER_SIZE + header[3] + 2 * components * sizeof(double) : 0;
+  ok = ok && contents.size() >= size &&
+       contents.size() - size == count * (coefficients + 2) * sizeof(double);
+  if (!ok) {
+    cerr << "error while reading file " << filename << ": not a valid Chebyshev cache"
+         << endl;
+    return false;
+  }
+
+  const char *bytes = contents.data() + HEADER_SIZE;
+  m_degree = header[2];
+  m_label.assign(bytes, header[3]);
+  bytes += header[3];
+  m_tolerances.resize(components);
+  m_errors.resize(components);
+  memcpy(&m_tolerances[0], bytes, components * sizeof(double));
+  bytes += components * sizeof(double);
+  memcpy(&m_errors[0], bytes, components * sizeof(double));
+  bytes += components * sizeof(double);
+  m_segments.resize(count);
+  for (uint64_t s = 0; s < count; s++) {
+    Segment &segment = m_segments[s];
+    memcpy(&segment.start, bytes, sizeof(double));
+    memcpy(&segment.end, bytes + sizeof(double), sizeof(double));
+    bytes += 2 * sizeof(double);
+    segment.coefficients.resize(coefficients);
+    memcpy(&segment.coefficients[0], bytes, coefficients * sizeof(double));
+    bytes += coefficients * sizeof(double);
+  }
+  return true;
+}
@@ -0,0 +1,392 @@
+#include "CubeLoader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef USE_LIBURING
+#include <liburing.h>
+#endif
+
+#include "SpscQueue.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// Alignment of the file buffers, one page (which O_DIRECT reads would need).
+static const size_t FILE_ALIGNMENT = 4096;
+
+namespace {
+
+/** A file being loaded, or loaded and waiting for the consumer. */
+struct LoadedFile {
+  int index;              //!< Index of the file in the list being loaded.
+  unsigned char *data;    //!< The contents of the file.
+  size_t capacity;        //!< Size of data; kept between files.
+  size_t size;            //!< Size of the file.
+  size_t nextOffset;      //!< Offset of the first byte no read has been queued for.
+  int pending;            //!< Number of reads in flight.
+  int fd;                 //!< The open file, or -1.
+  bool failed;            //!< True if the file could not be read.
+};
+
+/** One read of part of a file. */
+struct ChunkRead {
+  LoadedFile *file;       //!< The file read from.
+  size_t offset;          //!< Offset of the read in the file (and in file->data).
+  size_t length;          //!< Number of bytes to read.
+  long result;            //!< Bytes read, or -errno.
+};
+
+
+/** A queue of asynchronous reads. */
+class ReadQueue {
+  public:
+    virtual ~ReadQueue() {}
+
+    /** Queues a read. */
+    virtual void submit(ChunkRead *chunk) = 0;
+
+    /**
+     * Waits for a queued read to finish and returns it, with its result set.  Returns NULL
+     * if the queue failed; it must then be deleted, which ends the reads still queued.
+     */
+    virtual ChunkRead *complete() = 0;
+};
+
+
+/**
+ * Reads with pread on a pool of threads.  Reads are run a round at a time: complete() reads
+ * everything queued since the last round in parallel, then hands the reads back one by one.
+ */
+class PreadQueue : public ReadQueue {
+  public:
+    explicit PreadQueue(int threads) : m_pool(threads) {
+    }
+
+    void submit(ChunkRead *chunk) {
+      m_submitted.push_back(chunk);
+    }
+
+    ChunkRead *complete() {
+      if (m_completed.empty()) {
+        m_pool.parallelFor(m_submitted.size(), [this](int i) {
+          ChunkRead *chunk = m_submitted[i];
+          ssize_t result = pread(chunk->file->fd, chunk->file->data + chunk->offset,
+                                 chunk->length, chunk->offset);
+          chunk->result = result < 0 ? -errno : result;
+        });
+        m_completed.swap(m_submitted);
+      }
+      ChunkRead *chunk = m_completed.back();
+      m_completed.pop_back();
+      return chunk;
+    }
+
+  private:
+    ThreadPool m_pool;                  //!< The threads reads run on.
+    vector<ChunkRead *> m_submitted;    //!< Reads waiting for the next round.
+    vector<ChunkRead *> m_completed;    //!< Reads of the last round not yet handed back.
+};
+
+
+#ifdef USE_LIBURING
+/**
+ * Reads through an io_uring: every read is submitted to the kernel, which runs them all at
+ * once, and complete() waits for whichever finishes first.
+ */
+class UringQueue : public ReadQueue {
+  public:
+    UringQueue() : m_open(false) {
+    }
+
+    ~UringQueue() {
+      if (m_open) {
+        io_uring_queue_exit(&m_ring);
+      }
+    }
+
+    /** Sets up a ring for depth reads; returns false if the kernel does not allow it. */
+    bool open(int depth) {
+      m_open = io_uring_queue_init(depth, &m_ring, 0) == 0;
+      return m_open;
+    }
+
+    void submit(ChunkRead *chunk) {
+      io_uring_sqe *sqe = io_uring_get_sqe(&m_ring);
+      if (sqe == NULL) {
+        io_uring_submit(&m_ring);
+        sqe = io_uring_get_sqe(&m_ring);
+      }
+      io_uring_prep_read(sqe, chunk->file->fd, chunk->file->data + chunk->offset,
+                         chunk->length, chunk->offset);
+      io_uring_sqe_set_data(sqe, chunk);
+    }
+
+    ChunkRead *complete() {
+      io_uring_submit(&m_ring);
+      io_uring_cqe *cqe = NULL;
+      int status;
+      do {
+        status = io_uring_wait_cqe(&m_ring, &cqe);
+      } while (status == -EINTR);
+      if (status < 0) {
+        cerr << "io_uring wait failed: " << strerror(-status) << endl;
+        return NULL;
+      }
+      ChunkRead *chunk = static_cast<ChunkRead *>(io_uring_cqe_get_data(cqe));
+      chunk->result = cqe->res;
+      io_uring_cqe_seen(&m_ring, cqe);
+      return chunk;
+    }
+
+  private:
+    io_uring m_ring;    //!< The submission and completion queues.
+    bool m_open;        //!< True if the ring was set up.
+};
+#endif
+
+
+/**
+ * @brief Returns an io_uring queue if the library was built with one and the kernel allows
+ * it, and a pread queue otherwise.  The pread queue still takes depth reads a round, but
+ * runs them on no more threads than the machine has, as more would only wait on each other.
+ */
+ReadQueue *createReadQueue(int depth) {
+#ifdef USE_LIBURING
+  UringQueue *queue = new UringQueue();
+  if (queue->open(depth)) {
+    return queue;
+  }
+  delete queue;
+#endif
+  return new PreadQueue(min(depth, ThreadPool::defaultThreads()));
+}
+
+
+/**
+ * @brief Opens a file and makes room for its contents.  Failures are recorded in the file.
+ */
+void startFile(LoadedFile &file, const string &filename, int index) {
+  file.index = index;
+  file.size = 0;
+  file.nextOffset = 0;
+  file.pending = 0;
+  file.failed = false;
+
+  file.fd = open(filename.c_str(), O_RDONLY);
+  struct stat status;
+  if (file.fd < 0 || fstat(file.fd, &status) != 0) {
+    perror(filename.c_str());
+    file.failed = true;
+    return;
+  }
+  file.size = status.st_size;
+  posix_fadvise(file.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  if (file.size > file.capacity) {
+    free(file.data);
+    file.data = NULL;
+    file.capacity = 0;
+    void *data = NULL;
+    if (posix_memalign(&data, FILE_ALIGNMENT, file.size) != 0) {
+      cerr << "Could not allocate " << file.size << " bytes for " << filename << endl;
+      file.failed = true;
+      return;
+    }
+    file.data = static_cast<unsigned char *>(data);
+    file.capacity = file.size;
+  }
+}
+
+
+/**
+ * @brief Returns true if no more reads will be queued or finish for a file.
+ */
+bool isDone(const LoadedFile &file) {
+  return file.pending == 0 && (file.failed || file.nextOffset >= file.size);
+}
+
+}
+
+
+/**
+ * @brief Sets up a loader.
+ * @param queueDepth  Most reads in flight at once.
+ * @param maxFiles  Most files held in memory at once, including the one being consumed.
+ * @param chunkSize  Size of one read in bytes.
+ */
+CubeLoader::CubeLoader(int queueDepth, int maxFiles, size_t chunkSize) :
+    m_queueDepth(queueDepth > 0 ? queueDepth : 1), m_maxFiles(maxFiles > 0 ? maxFiles : 1),
+    m_chunkSize(chunkSize > 0 ? chunkSize : 1 << 20) {
+}
+
+
+/**
+ * @brief Returns true if the loader was built to read through io_uring.  It still falls back
+ * to pread if the kernel does not allow io_uring.
+ */
+bool CubeLoader::usesIoUring() {
+#ifdef USE_LIBURING
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+/**
+ * @brief Loads files and hands each to a consumer, in order, while the next ones are read.
+ *
+ * A loader thread queues reads for the files in order, earliest file first, and passes
+ * each file to this thread once it is read.  Either thread sleeps in its queue while it
+ * waits for the other (the loader for memory to reuse, this thread for a loaded file).  The file's memory is reused for a later file
+ * once the consumer returns, so it must not be kept.  If the read queue fails, every file
+ * not yet read is handed over as one that could not be read.
+ *
+ * @param filenames  The files to load.
+ * @param consumer  Called on this thread for every file (with NULL data if the file could
+ *                  not be read), unless an earlier call returned false.
+ * @return false if a file could not be read or the consumer stopped the loading.
+ */
+bool CubeLoader::load(const vector<string> &filenames, const Consumer &consumer) {
+  vector<LoadedFile> files(m_maxFiles);
+  SpscQueue<LoadedFile *> freeFiles(m_maxFiles);
+  SpscQueue<LoadedFile *> loadedFiles(m_maxFiles + 1);
+  for (int i = 0; i < m_maxFiles; i++) {
+    files[i].data = NULL;
+    files[i].capacity = 0;
+    freeFiles.push(&files[i]);
+  }
+  atomic<bool> stopped(false);
+
+  thread loadThread([&] {
+    ReadQueue *queue = createReadQueue(m_queueDepth);
+    vector<ChunkRead> chunks(m_queueDepth);
+    vector<ChunkRead *> freeChunks;
+    for (int i = 0; i < m_queueDepth; i++) {
+      freeChunks.push_back(&chunks[i]);
+    }
+
+    deque<LoadedFile *> loading;    // In file order.
+    int inFlight = 0;
+    size_t next = 0;
+    while (true) {
+      // Start as many of the next files as there is memory for.
+      while (next < filenames.size() && !stopped) {
+        LoadedFile *file;
+        if (!freeFiles.tryPop(file)) {
+          if (!loading.empty()) {
+            break;
+          }
+          file = freeFiles.pop();
+        }
+        startFile(*file, filenames[next], next);
+        if (queue == NULL) {
+          file->failed = true;
+        }
+        next++;
+        loading.push_back(file);
+      }
+
+      // Hand the files that are done to the consumer, in order.
+      if (!loading.empty() && isDone(*loading.front())) {
+        LoadedFile *file = loading.front();
+        loading.pop_front();
+        if (file->fd >= 0) {
+          close(file->fd);
+          file->fd = -1;
+        }
+        loadedFiles.push(file);
+        continue;
+      }
+      if (loading.empty()) {
+        if (next >= filenames.size() || stopped) {
+          break;
+        }
+        continue;
+      }
+
+      // Keep the queue full, reading the earliest files first.
+      for (size_t i = 0; i < loading.size() && inFlight < m_queueDepth; i++) {
+        LoadedFile *file = loading[i];
+        while (!file->failed && file->nextOffset < file->size && inFlight < m_queueDepth) {
+          ChunkRead *chunk = freeChunks.back();
+          freeChunks.pop_back();
+          chunk->file = file;
+          chunk->offset = file->nextOffset;
+          chunk->length = min(m_chunkSize, file->size - file->nextOffset);
+          file->nextOffset += chunk->length;
+          file->pending++;
+          inFlight++;
+          queue->submit(chunk);
+        }
+      }
+
+      // Only reached with reads in flight, so never once the queue has failed: every file is
+      // failed then, and done as soon as its reads are abandoned.
+      ChunkRead *chunk = queue->complete();
+      if (chunk == NULL) {
+        delete queue;
+        queue = NULL;
+        for (size_t i = 0; i < loading.size(); i++) {
+          loading[i]->failed = true;
+          loading[i]->pending = 0;
+        }
+        inFlight = 0;
+        continue;
+      }
+      LoadedFile *file = chunk->file;
+      inFlight--;
+      file->pending--;
+      if (chunk->result > 0 && (size_t)chunk->result < chunk->length) {
+        // A short read; read the rest.
+        chunk->offset += chunk->result;
+        chunk->length -= chunk->result;
+        file->pending++;
+        inFlight++;
+        queue->submit(chunk);
+        continue;
+      }
+      if (chunk->result <= 0 && !file->failed) {
+        cerr << "Could not read " << filenames[file->index] << ": "
+             << (chunk->result < 0 ? strerror(-chunk->result) : "unexpected end of file")
+             << endl;
+        file->failed = true;
+      }
+      freeChunks.push_back(chunk);
+    }
+
+    loadedFiles.push(NULL);
+    delete queue;
+  });
+
+  bool status = true;
+  for (LoadedFile *file = loadedFiles.pop(); file != NULL; file = loadedFiles.pop()) {
+    if (!stopped) {
+      if (file->failed) {
+        status = false;
+      }
+      if (!consumer(file->index, file->failed ? NULL : file->data, file->size)) {
+        status = false;
+        stopped = true;
+      }
+    }
+    freeFiles.push(file);
+  }
+  loadThread.join();
+
+  for (int i = 0; i < m_maxFiles; i++) {
+    free(files[i].data);
+  }
+  return status;
+}
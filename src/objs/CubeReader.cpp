@@ -0,0 +1,486 @@
+#include "CubeReader.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+// The special pixel values of ISIS.  Real cubes store them as these bit patterns; they are
+// never scaled.
+static const uint32_t NULL4 = 0xFF7FFFFB;
+static const uint32_t LOW_REPR_SAT4 = 0xFF7FFFFC;
+static const uint32_t LOW_INSTR_SAT4 = 0xFF7FFFFD;
+static const uint32_t HIGH_INSTR_SAT4 = 0xFF7FFFFE;
+static const uint32_t HIGH_REPR_SAT4 = 0xFF7FFFFF;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+static const bool HOST_LSB = false;
+#else
+static const bool HOST_LSB = true;
+#endif
+
+
+/**
+ * @brief Returns the float with the given bits.
+ */
+static float floatBits(uint32_t bits) {
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+
+/**
+ * @brief Returns the ISIS float special pixel of one of the integer special values, or the
+ * scaled value of a valid pixel.
+ */
+static float scaled(int32_t raw, int32_t nullValue, int32_t lowReprSat, int32_t lowInstrSat,
+                    int32_t highInstrSat, int32_t highReprSat, double base, double multiplier) {
+  if (raw == nullValue) return floatBits(NULL4);
+  if (raw == lowReprSat) return floatBits(LOW_REPR_SAT4);
+  if (raw == lowInstrSat) return floatBits(LOW_INSTR_SAT4);
+  if (raw == highInstrSat) return floatBits(HIGH_INSTR_SAT4);
+  if (raw == highReprSat) return floatBits(HIGH_REPR_SAT4);
+  return (float)(base + multiplier * raw);
+}
+
+
+/**
+ * @brief Returns the value of a label line, without quotes and units.
+ */
+static string labelValue(const string &text) {
+  string value = text;
+  size_t units = value.find('<');
+  if (units != string::npos) {
+    value.erase(units);
+  }
+  size_t first = value.find_first_not_of(" \t\"");
+  size_t last = value.find_last_not_of(" \t\"\r");
+  if (first == string::npos) {
+    return "";
+  }
+  return value.substr(first, last - first + 1);
+}
+
+
+/**
+ * @brief Checks whether a file is an ISIS cube (its label starts with Object = IsisCube).
+ * @param filename  The file to check.
+ * @return false if the file could not be read or is not a cube.
+ */
+bool CubeReader::isCube(const string &filename) {
+  FILE *file = fopen(filename.c_str(), "rb");
+  if (file == NULL) {
+    return false;
+  }
+  char start[64];
+  size_t length = fread(start, 1, sizeof(start) - 1, file);
+  fclose(file);
+  start[length] = '\0';
+
+  const char *text = start + strspn(start, " \t\r\n");
+  if (strncmp(text, "Object", 6) != 0) {
+    return false;
+  }
+  text += 6 + strspn(text + 6, " \t=");
+  return strncmp(text, "IsisCube", 8) == 0;
+}
+
+
+CubeReader::CubeReader() :
+    m_map(NULL), m_mapSize(0), m_mapped(false), m_coreStart(0),
+    m_format(BAND_SEQUENTIAL_FORMAT), m_pixelType(REAL), m_pixelSize(4), m_swap(false),
+    m_base(0.0), m_multiplier(1.0),
+    m_samples(0), m_lines(0), m_bands(0), m_blockSamples(0), m_blockLines(0) {
+}
+
+
+CubeReader::~CubeReader() {
+  close();
+}
+
+
+/**
+ * @brief Maps a cube with an attached label and parses the label.
+ * @param filename  The cube.
+ * @return false if the file could not be mapped, is not a cube, or has a layout or pixel
+ *         type this reader does not handle (e.g. a detached label).
+ */
+bool CubeReader::open(const string &filename) {
+  close();
+
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    perror(filename.c_str());
+    return false;
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0 || status.st_size == 0) {
+    cerr << "Could not map " << filename << endl;
+    ::close(fd);
+    return false;
+  }
+  void *map = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    perror(filename.c_str());
+    return false;
+  }
+  m_map = static_cast<unsigned char *>(map);
+  m_mapSize = status.st_size;
+  m_mapped = true;
+  m_filename = filename;
+  return parseCube();
+}
+
+
+/**
+ * @brief Reads a cube that is already in memory, e.g. one loaded by a CubeLoader.  The
+ * memory is not copied; it must stay valid until the reader is closed.
+ * @param filename  Name of the cube, for error messages.
+ * @param data  The whole cube file.
+ * @param size  Size of the file.
+ * @return false if the data is not a cube this reader handles.
+ */
+bool CubeReader::open(const string &filename, const unsigned char *data, size_t size) {
+  close();
+
+  m_map = data;
+  m_mapSize = size;
+  m_filename = filename;
+  return parseCube();
+}
+
+
+/**
+ * @brief Parses the label of the open file and checks that the core fits in it.
+ * @return false (after closing the reader) if it does not.
+ */
+bool CubeReader::parseCube() {
+  if (!parseLabel(reinterpret_cast<const char *>(m_map), m_mapSize)) {
+    close();
+    return false;
+  }
+
+  size_t coreSize = (size_t)m_bands * m_pixelSize *
+                    ((m_samples + m_blockSamples - 1) / m_blockSamples) * m_blockSamples *
+                    ((m_lines + m_blockLines - 1) / m_blockLines) * m_blockLines;
+  if (m_coreStart + coreSize > m_mapSize) {
+    cerr << m_filename << " is too short for its " << m_samples << " x " << m_lines << " x "
+         << m_bands << " core" << endl;
+    close();
+    return false;
+  }
+  if (m_mapped) {
+    madvise(const_cast<unsigned char *>(m_map) + m_coreStart, coreSize, MADV_WILLNEED);
+  }
+  return true;
+}
+
+
+/**
+ * @brief Unmaps the cube.
+ */
+void CubeReader::close() {
+  if (m_mapped) {
+    munmap(const_cast<unsigned char *>(m_map), m_mapSize);
+  }
+  m_map = NULL;
+  m_mapSize = 0;
+  m_mapped = false;
+  m_filename.clear();
+  m_samples = 0;
+  m_lines = 0;
+  m_bands = 0;
+  m_blockSamples = 0;
+  m_blockLines = 0;
+  m_instrument.clear();
+}
+
+
+/**
+ * @brief Reads the layout of the core from the IsisCube/Core object of the label, and keeps
+ * the keywords of the IsisCube/Instrument group.
+ * @param label  The start of the file.
+ * @param size  The size of the file.
+ * @return false if the label has no usable core description.
+ */
+bool CubeReader::parseLabel(const char *label, size_t size) {
+  vector<string> path;
+  string startByte, format, tileSamples, tileLines, samples, lines, bands;
+  string type, byteOrder, base, multiplier;
+  bool inCore = false;
+
+  size_t position = 0;
+  while (position < size) {
+    const char *end = static_cast<const char *>(memchr(label + position, '\n',
+                                                       size - position));
+    size_t next = end == NULL ? size : end - label + 1;
+    string line(label + position, (end == NULL ? size : end - label) - position);
+    position = next;
+
+    size_t equals = line.find('=');
+    string keyword = labelValue(line.substr(0, equals));
+    string value = equals == string::npos ? "" : labelValue(line.substr(equals + 1));
+
+    if (keyword == "End") {
+      break;
+    }
+    else if (keyword == "Object" || keyword == "Group") {
+      path.push_back(value);
+      inCore = path.size() >= 2 && path[0] == "IsisCube" && path[1] == "Core";
+    }
+    else if (keyword == "End_Object" || keyword == "End_Group") {
+      if (!path.empty()) {
+        path.pop_back();
+      }
+      inCore = inCore && path.size() >= 2;
+      if (path.empty()) {
+        break;
+      }
+    }
+    else if (keyword == "^Core" && path.size() == 1 && path[0] == "IsisCube") {
+      cerr << m_filename << " has a detached core, which is not supported" << endl;
+      return false;
+    }
+    else if (inCore && path.size() == 2) {
+      if (keyword == "StartByte") startByte = value;
+      else if (keyword == "Format") format = value;
+      else if (keyword == "TileSamples") tileSamples = value;
+      else if (keyword == "TileLines") tileLines = value;
+    }
+    else if (inCore && path.size() == 3 && path[2] == "Dimensions") {
+      if (keyword == "Samples") samples = value;
+      else if (keyword == "Lines") lines = value;
+      else if (keyword == "Bands") bands = value;
+    }
+    else if (inCore && path.size() == 3 && path[2] == "Pixels") {
+      if (keyword == "Type") type = value;
+      else if (keyword == "ByteOrder") byteOrder = value;
+      else if (keyword == "Base") base = value;
+      else if (keyword == "Multiplier") multiplier = value;
+    }
+    else if (path.size() == 2 && path[0] == "IsisCube" && path[1] == "Instrument" &&
+             equals != string::npos) {
+      m_instrument[keyword] = value;
+    }
+  }
+
+  m_samples = atoi(samples.c_str());
+  m_lines = atoi(lines.c_str());
+  m_bands = atoi(bands.c_str());
+  long long start = atoll(startByte.c_str());
+  if (m_samples <= 0 || m_lines <= 0 || m_bands <= 0 || start < 1) {
+    cerr << m_filename << " does not have an attached IsisCube core" << endl;
+    return false;
+  }
+  m_coreStart = start - 1;
+
+  if (format == "BandSequential") {
+    m_format = BAND_SEQUENTIAL_FORMAT;
+    m_blockSamples = m_samples;
+    m_blockLines = m_lines;
+  }
+  else if (format == "Tile") {
+    m_format = TILE_FORMAT;
+    m_blockSamples = atoi(tileSamples.c_str());
+    m_blockLines = atoi(tileLines.c_str());
+    if (m_blockSamples <= 0 || m_blockLines <= 0) {
+      cerr << m_filename << " has an invalid tile size" << endl;
+      return false;
+    }
+  }
+  else {
+    cerr << m_filename << " has an unsupported core format: " << format << endl;
+    return false;
+  }
+
+  if (type == "UnsignedByte") {
+    m_pixelType = UNSIGNED_BYTE;
+    m_pixelSize = 1;
+  }
+  else if (type == "SignedWord") {
+    m_pixelType = SIGNED_WORD;
+    m_pixelSize = 2;
+  }
+  else if (type == "UnsignedWord") {
+    m_pixelType = UNSIGNED_WORD;
+    m_pixelSize = 2;
+  }
+  else if (type == "SignedInteger") {
+    m_pixelType = SIGNED_INTEGER;
+    m_pixelSize = 4;
+  }
+  else if (type == "Real") {
+    m_pixelType = REAL;
+    m_pixelSize = 4;
+  }
+  else {
+    cerr << m_filename << " has an unsupported pixel type: " << type << endl;
+    return false;
+  }
+
+  if (byteOrder != "Lsb" && byteOrder != "Msb") {
+    cerr << m_filename << " has an unsupported byte order: " << byteOrder << endl;
+    return false;
+  }
+  m_swap = (byteOrder == "Lsb") != HOST_LSB;
+  m_base = base.empty() ? 0.0 : atof(base.c_str());
+  m_multiplier = multiplier.empty() ? 1.0 : atof(multiplier.c_str());
+  return true;
+}
+
+
+/**
+ * @brief Returns the stored pixel at a (0-based) band, line and sample.
+ */
+const unsigned char *CubeReader::pixel(int band, int line, int sample) const {
+  size_t blocksAcross = (m_samples + m_blockSamples - 1) / m_blockSamples;
+  size_t blocksDown = (m_lines + m_blockLines - 1) / m_blockLines;
+  size_t blockIndex = ((size_t)band * blocksDown + line / m_blockLines) * blocksAcross +
+                      sample / m_blockSamples;
+  size_t pixelIndex = blockIndex * m_blockSamples * m_blockLines +
+                      (size_t)(line % m_blockLines) * m_blockSamples + sample % m_blockSamples;
+  return m_map + m_coreStart + pixelIndex * m_pixelSize;
+}
+
+
+/**
+ * @brief Returns the value of a keyword of the label's IsisCube/Instrument group (e.g.
+ * StartTime), without quotes and units.
+ * @return An empty string if the group has no such keyword.
+ */
+string CubeReader::instrumentValue(const string &keyword) const {
+  map<string, string>::const_iterator value = m_instrument.find(keyword);
+  return value == m_instrument.end() ? "" : value->second;
+}
+
+
+/**
+ * @brief Returns a block of the core in place: a whole band (line-major) of a BandSequential
+ * cube, or one tile of a Tile cube.  Tiles on the right and bottom edges are padded to the
+ * full tile size.
+ * @param band  The (1-based) band.
+ * @param blockRow  The (0-based) row of the block in the block grid.
+ * @param blockColumn  The (0-based) column of the block in the block grid.
+ * @return NULL if no cube is open, the pixels are not direct (see isDirect()), or the block
+ *         is outside of the cube.
+ */
+const float *CubeReader::block(int band, int blockRow, int blockColumn) const {
+  if (m_map == NULL || !isDirect() || band < 1 || band > m_bands || blockRow < 0 ||
+      blockColumn < 0 || blockRow * m_blockLines >= m_lines ||
+      blockColumn * m_blockSamples >= m_samples) {
+    return NULL;
+  }
+  return reinterpret_cast<const float *>(pixel(band - 1, blockRow * m_blockLines,
+                                               blockColumn * m_blockSamples));
+}
+
+
+/**
+ * @brief Converts stored pixels to float.
+ */
+void CubeReader::convert(const unsigned char *source, int count, float *destination) const {
+  if (isDirect()) {
+    memcpy(destination, source, count * sizeof(float));
+    return;
+  }
+
+  for (int i = 0; i < count; i++) {
+    switch (m_pixelType) {
+      case UNSIGNED_BYTE:
+        destination[i] = scaled(source[i], 0, -1, -1, -1, 255, m_base, m_multiplier);
+        break;
+
+      case SIGNED_WORD:
+      case UNSIGNED_WORD: {
+        uint16_t bits;
+        memcpy(&bits, source + 2 * i, 2);
+        if (m_swap) {
+          bits = __builtin_bswap16(bits);
+        }
+        if (m_pixelType == SIGNED_WORD) {
+          destination[i] = scaled((int16_t)bits, -32768, -32767, -32766, -32765, -32764,
+                                  m_base, m_multiplier);
+        }
+        else {
+          destination[i] = scaled(bits, 0, 1, 2, 65534, 65535, m_base, m_multiplier);
+        }
+        break;
+      }
+
+      case SIGNED_INTEGER:
+      case REAL: {
+        uint32_t bits;
+        memcpy(&bits, source + 4 * i, 4);
+        if (m_swap) {
+          bits = __builtin_bswap32(bits);
+        }
+        if (m_pixelType == SIGNED_INTEGER) {
+          destination[i] = scaled((int32_t)bits, INT32_MIN, INT32_MIN + 1, INT32_MIN + 2,
+                                  INT32_MIN + 3, INT32_MIN + 4, m_base, m_multiplier);
+        }
+        else if (bits >= NULL4) {
+          destination[i] = floatBits(bits);
+        }
+        else {
+          destination[i] = (float)(m_base + m_multiplier * floatBits(bits));
+        }
+        break;
+      }
+    }
+  }
+}
+
+
+/**
+ * @brief Reads a window of a band as floats.
+ *
+ * Each line of the window is copied (or converted) a block at a time straight from the
+ * mapped core.
+ *
+ * @param destination  The first pixel of the window in the caller's buffer.
+ * @param lineSpace  Distance in pixels between the lines of the window in the buffer.
+ * @param band  The (1-based) band.
+ * @param startSample  The (0-based) first sample of the window.
+ * @param startLine  The (0-based) first line of the window.
+ * @param samples  The width of the window.
+ * @param lines  The height of the window.
+ * @return false if no cube is open or the window is outside of the cube.
+ */
+bool CubeReader::read(float *destination, size_t lineSpace, int band, int startSample,
+                      int startLine, int samples, int lines) const {
+  if (m_map == NULL) {
+    cerr << "No cube is open" << endl;
+    return false;
+  }
+  if (band < 1 || band > m_bands || startSample < 0 || startLine < 0 || samples <= 0 ||
+      lines <= 0 || startSample + samples > m_samples || startLine + lines > m_lines) {
+    cerr << "Window " << startSample << ", " << startLine << ", " << samples << " x " << lines
+         << " of band " << band << " is outside of " << m_filename << endl;
+    return false;
+  }
+
+  int endSample = startSample + samples;
+  for (int line = 0; line < lines; line++) {
+    float *out = destination + line * lineSpace;
+    for (int sample = startSample; sample < endSample; ) {
+      int blockEndSample = min((sample / m_blockSamples + 1) * m_blockSamples, endSample);
+      convert(pixel(band - 1, startLine + line, sample), blockEndSample - sample,
+              out + (sample - startSample));
+      sample = blockEndSample;
+    }
+  }
+  return true;
+}
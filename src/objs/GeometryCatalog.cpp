@@ -0,0 +1,398 @@
+#include "GeometryCatalog.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <csm/Error.h>
+
+#include "MdisNacSensorModel.h"
+#include "SurfaceAngles.h"
+
+using namespace std;
+
+static const char CATALOG_MAGIC[8] = { 'M', 'D', 'I', 'S', 'C', 'A', 'T', 'L' };
+static const uint32_t CATALOG_VERSION = 1;
+static const size_t HEADER_SIZE = 32;
+
+/** The columns written for an ImageSummary, in file order. */
+static const struct {
+  const char *name;
+  size_t offset;
+} s_columns[] = {
+  { "center_latitude", offsetof(ImageSummary, centerLatitude) },
+  { "center_longitude", offsetof(ImageSummary, centerLongitude) },
+  { "min_latitude", offsetof(ImageSummary, minLatitude) },
+  { "max_latitude", offsetof(ImageSummary, maxLatitude) },
+  { "west_longitude", offsetof(ImageSummary, westLongitude) },
+  { "east_longitude", offsetof(ImageSummary, eastLongitude) },
+  { "ground_sample_distance", offsetof(ImageSummary, groundSampleDistance) },
+  { "emission", offsetof(ImageSummary, emission) },
+  { "incidence", offsetof(ImageSummary, incidence) },
+  { "altitude", offsetof(ImageSummary, altitude) },
+  { "coverage", offsetof(ImageSummary, coverage) }
+};
+static const size_t NUM_COLUMNS = sizeof(s_columns) / sizeof(s_columns[0]);
+
+
+/**
+ * @brief Rounds an offset up to the next multiple of 8 bytes.
+ */
+static uint64_t align8(uint64_t offset) {
+  return (offset + 7) & ~uint64_t(7);
+}
+
+
+/**
+ * @brief Summarizes the observation geometry of an image from a sparse grid of its pixels.
+ *
+ * The footprint is the extent of the gridSize x gridSize pixels spread evenly from corner to
+ * corner of the image that are on the body; its longitudes span the smallest arc that holds
+ * all of them, so footprints across longitude 0 stay narrow.  The center values come from
+ * the center pixel.
+ *
+ * @param model  The model of the image.
+ * @param gridSize  The number of pixels sampled along each side of the image (at least 2).
+ * @param summary  Receives the summary.
+ * @return false if none of the sampled pixels is on the body.
+ */
+bool summarizeImage(const MdisNacSensorModel &model, int gridSize, ImageSummary &summary) {
+  double nan = numeric_limits<double>::quiet_NaN();
+  summary.centerLatitude = summary.centerLongitude = nan;
+  summary.minLatitude = summary.maxLatitude = nan;
+  summary.westLongitude = summary.eastLongitude = nan;
+  summary.groundSampleDistance = summary.emission = summary.incidence = nan;
+  summary.altitude = nan;
+  summary.coverage = 0.0;
+
+  gridSize = max(gridSize, 2);
+  csm::ImageVector size = model.getImageSize();
+  csm::EcefCoord sensor = model.getSensorPosition(0.0);
+  double sensorDistance = sqrt(sensor.x * sensor.x + sensor.y * sensor.y +
+                               sensor.z * sensor.z);
+
+  vector<double> longitudes;
+  double minLatitude = 90.0;
+  double maxLatitude = -90.0;
+  double radiusSum = 0.0;
+  for (int i = 0; i < gridSize; i++) {
+    double line = 1.0 + (size.line - 1.0) * i / (gridSize - 1);
+    for (int j = 0; j < gridSize; j++) {
+      double sample = 1.0 + (size.samp - 1.0) * j / (gridSize - 1);
+      csm::EcefCoord ground = model.imageToGround(csm::ImageCoord(line, sample), 0.0);
+      double radius = sqrt(ground.x * ground.x + ground.y * ground.y + ground.z * ground.z);
+      if (radius == 0.0) {
+        continue;
+      }
+      double latitude = asin(ground.z / radius) * DEGREES_PER_RADIAN;
+      minLatitude = min(minLatitude, latitude);
+      maxLatitude = max(maxLatitude, latitude);
+      longitudes.push_back(positiveEastLongitude(ground.x, ground.y));
+      radiusSum += radius;
+    }
+  }
+
+  if (longitudes.empty()) {
+    return false;
+  }
+  summary.coverage = double(longitudes.size()) / (gridSize * gridSize);
+  summary.minLatitude = minLatitude;
+  summary.maxLatitude = maxLatitude;
+
+  // The footprint is everything outside the widest gap between the sampled longitudes.
+  sort(longitudes.begin(), longitudes.end());
+  size_t west = 0;
+  double widestGap = longitudes.front() + 360.0 - longitudes.back();
+  for (size_t i = 1; i < longitudes.size(); i++) {
+    if (longitudes[i] - longitudes[i - 1] > widestGap) {
+      widestGap = longitudes[i] - longitudes[i - 1];
+      west = i;
+    }
+  }
+  summary.westLongitude = longitudes[west];
+  summary.eastLongitude = longitudes[(west + longitudes.size() - 1) % longitudes.size()];
+
+  // Without a center on the body, the altitude is above the mean radius of the footprint.
+  double surfaceRadius = radiusSum / longitudes.size();
+
+  csm::ImageCoord centerPixel((size.line + 1.0) / 2, (size.samp + 1.0) / 2);
+  csm::EcefCoord center = model.imageToGround(centerPixel, 0.0);
+  double radius = sqrt(center.x * center.x + center.y * center.y + center.z * center.z);
+  if (radius != 0.0) {
+    double normal[3] = { center.x / radius, center.y / radius, center.z / radius };
+    double toSensor[3] = { sensor.x - center.x, sensor.y - center.y, sensor.z - center.z };
+    double range = sqrt(toSensor[0] * toSensor[0] + toSensor[1] * toSensor[1] +
+                        toSensor[2] * toSensor[2]);
+    for (int i = 0; i < 3; i++) {
+      toSensor[i] /= range;
+    }
+
+    summary.centerLatitude = asin(normal[2]) * DEGREES_PER_RADIAN;
+    summary.centerLongitude = positiveEastLongitude(center.x, center.y);
+    summary.groundSampleDistance = model.getPixelResolution(center);
+    summary.emission = angleBetween(normal, toSensor);
+    try {
+      csm::EcefVector illumination = model.getIlluminationDirection(center);
+      double toSun[3] = { -illumination.x, -illumination.y, -illumination.z };
+      summary.incidence = angleBetween(normal, toSun);
+    }
+    catch (csm::Error &) {
+      // No sun position in the ISD; the incidence stays NaN.
+    }
+    surfaceRadius = radius;
+  }
+  summary.altitude = (sensorDistance - surfaceRadius) / 1000;
+  return true;
+}
+
+
+CatalogWriter::CatalogWriter() : m_open(false) {
+}
+
+
+CatalogWriter::~CatalogWriter() {
+  close();
+}
+
+
+/**
+ * @brief Starts a new catalog.  The file is created when the catalog is closed.
+ * @param filename  The catalog file; an existing file is replaced.
+ * @return true if the catalog is ready for rows.
+ */
+bool CatalogWriter::open(const string &filename) {
+  close();
+  m_filename = filename;
+  m_ids.clear();
+  m_summaries.clear();
+  m_open = true;
+  return true;
+}
+
+
+/**
+ * @brief Appends the summary of an image.
+ * @param imageId  The image identifier (e.g. a product ID) of the row.
+ * @param summary  The summary of the image.
+ */
+void CatalogWriter::add(const string &imageId, const ImageSummary &summary) {
+  m_ids.push_back(imageId);
+  m_summaries.push_back(summary);
+}
+
+
+/**
+ * @brief Writes the catalog: every column of every row, then the image identifiers.
+ * @return true if the file was written.
+ */
+bool CatalogWriter::close() {
+  if (!m_open) {
+    return true;
+  }
+  m_open = false;
+
+  FILE *file = fopen(m_filename.c_str(), "wb");
+  if (file == NULL) {
+    perror(("error while opening file " + m_filename).c_str());
+    return false;
+  }
+
+  uint64_t rows = m_ids.size();
+  uint64_t valuesOffset = HEADER_SIZE + NUM_COLUMNS * sizeof(CatalogColumnRecord);
+  uint64_t idsOffset = valuesOffset + NUM_COLUMNS * rows * sizeof(double);
+  uint32_t columnCount = NUM_COLUMNS;
+
+  char header[HEADER_SIZE];
+  memcpy(header, CATALOG_MAGIC, 8);
+  memcpy(header + 8, &CATALOG_VERSION, 4);
+  memcpy(header + 12, &columnCount, 4);
+  memcpy(header + 16, &rows, 8);
+  memcpy(header + 24, &idsOffset, 8);
+
+  vector<CatalogColumnRecord> records(NUM_COLUMNS);
+  for (size_t column = 0; column < NUM_COLUMNS; column++) {
+    memset(records[column].name, 0, sizeof(records[column].name));
+    strncpy(records[column].name, s_columns[column].name, sizeof(records[column].name) - 1);
+    records[column].offset = valuesOffset + column * rows * sizeof(double);
+  }
+
+  bool ok = fwrite(header, 1, HEADER_SIZE, file) == HEADER_SIZE &&
+            fwrite(&records[0], sizeof(CatalogColumnRecord), NUM_COLUMNS, file) == NUM_COLUMNS;
+
+  // Gather each column from the rows.
+  vector<double> values(rows);
+  for (size_t column = 0; column < NUM_COLUMNS && ok; column++) {
+    for (size_t row = 0; row < rows; row++) {
+      const char *summary = reinterpret_cast<const char *>(&m_summaries[row]);
+      memcpy(&values[row], summary + s_columns[column].offset, sizeof(double));
+    }
+    ok = rows == 0 || fwrite(&values[0], sizeof(double), rows, file) == rows;
+  }
+
+  vector<uint64_t> starts(rows + 1);
+  string text;
+  for (size_t row = 0; row < rows; row++) {
+    starts[row] = text.size();
+    text += m_ids[row];
+  }
+  starts[rows] = text.size();
+  text.resize(align8(text.size()), '\0');
+
+  ok = ok && fwrite(&starts[0], sizeof(uint64_t), rows + 1, file) == rows + 1;
+  ok = ok && fwrite(text.data(), 1, text.size(), file) == text.size();
+  if (fclose(file) != 0) {
+    ok = false;
+  }
+  if (!ok) {
+    perror(("error while writing file " + m_filename).c_str());
+  }
+  return ok;
+}
+
+
+Catalog::Catalog() : m_map(NULL), m_mapSize(0), m_columns(NULL), m_columnCount(0), m_rows(0),
+    m_idStarts(NULL), m_idText(NULL) {
+}
+
+
+Catalog::~Catalog() {
+  close();
+}
+
+
+/**
+ * @brief Memory-maps a catalog written by CatalogWriter.
+ * @param filename  The catalog file.
+ * @return true if the catalog was mapped and its layout is valid.
+ */
+bool Catalog::open(const string &filename) {
+  close();
+
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    perror(("error while opening file " + filename).c_str());
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    perror(("error while reading file " + filename).c_str());
+    ::close(fd);
+    return false;
+  }
+
+  size_t fileSize = info.st_size;
+  if (fileSize < HEADER_SIZE) {
+    cerr << "error while opening catalog " << filename << ": not a valid catalog" << endl;
+    ::close(fd);
+    return false;
+  }
+
+  void *map = mmap(NULL, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    perror(("error while mapping file " + filename).c_str());
+    return false;
+  }
+  m_map = static_cast<const char *>(map);
+  m_mapSize = fileSize;
+
+  uint32_t version = 0;
+  uint32_t columnCount = 0;
+  uint64_t rows = 0;
+  uint64_t idsOffset = 0;
+  memcpy(&version, m_map + 8, 4);
+  memcpy(&columnCount, m_map + 12, 4);
+  memcpy(&rows, m_map + 16, 8);
+  memcpy(&idsOffset, m_map + 24, 8);
+
+  // Every size is bounded by fileSize before it is added to an offset, so a corrupt header
+  // cannot overflow these checks into passing.
+  bool valid = memcmp(m_map, CATALOG_MAGIC, 8) == 0 && version == CATALOG_VERSION &&
+               HEADER_SIZE + uint64_t(columnCount) * sizeof(CatalogColumnRecord) <= fileSize &&
+               rows < fileSize / sizeof(uint64_t) &&
+               idsOffset % 8 == 0 && idsOffset <= fileSize &&
+               (rows + 1) * sizeof(uint64_t) <= fileSize - idsOffset;
+  m_columns = reinterpret_cast<const CatalogColumnRecord *>(m_map + HEADER_SIZE);
+  for (uint32_t column = 0; valid && column < columnCount; column++) {
+    valid = m_columns[column].offset % 8 == 0 && m_columns[column].offset <= fileSize &&
+            rows * sizeof(double) <= fileSize - m_columns[column].offset;
+  }
+  if (valid) {
+    // imageId() reads [m_idStarts[row], m_idStarts[row + 1]) of the id text, so the starts must
+    // never decrease and the last one must lie within the file.
+    m_idStarts = reinterpret_cast<const uint64_t *>(m_map + idsOffset);
+    m_idText = m_map + idsOffset + (rows + 1) * sizeof(uint64_t);
+    for (uint64_t row = 0; valid && row < rows; row++) {
+      valid = m_idStarts[row] <= m_idStarts[row + 1];
+    }
+    valid = valid && m_idStarts[rows] <= uint64_t(m_map + fileSize - m_idText);
+  }
+
+  if (!valid) {
+    cerr << "error while opening catalog " << filename << ": not a valid catalog" << endl;
+    close();
+    return false;
+  }
+
+  m_columnCount = columnCount;
+  m_rows = rows;
+  return true;
+}
+
+
+/**
+ * @brief Unmaps the catalog.  Pointers returned by column() become invalid.
+ */
+void Catalog::close() {
+  if (m_map != NULL) {
+    munmap(const_cast<char *>(m_map), m_mapSize);
+  }
+  m_map = NULL;
+  m_mapSize = 0;
+  m_columns = NULL;
+  m_columnCount = 0;
+  m_rows = 0;
+  m_idStarts = NULL;
+  m_idText = NULL;
+}
+
+
+/**
+ * @brief Looks up a column by name (e.g. "center_latitude").
+ * @return The column's values, one per row, or NULL if the catalog has no such column.
+ */
+const double *Catalog::column(const string &name) const {
+  for (size_t index = 0; index < m_columnCount; index++) {
+    if (columnName(index) == name) {
+      return column(index);
+    }
+  }
+  return NULL;
+}
+
+
+/**
+ * @brief Returns the name of the index-th column.
+ */
+string Catalog::columnName(size_t index) const {
+  const char *name = m_columns[index].name;
+  return string(name, strnlen(name, sizeof(m_columns[index].name)));
+}
+
+
+/**
+ * @brief Returns the image identifier of a row.
+ */
+string Catalog::imageId(size_t row) const {
+  return string(m_idText + m_idStarts[row], m_idStarts[row + 1] - m_idStarts[row]);
+}
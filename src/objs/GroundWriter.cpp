@@ -0,0 +1,531 @@
+#include "GroundWriter.h"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <csm.h>
+
+#include <gdal/gdal.h>
+#include <gdal/gdal_priv.h>
+#include <gdal/cpl_error.h>
+#include <gdal/cpl_string.h>
+
+#include "TextBuffer.h"
+
+using namespace std;
+
+// Bands of the binary formats, in file order, for each kind of Coordinates.
+static const int NUM_BANDS = 4;
+static const char *s_bandNames[][NUM_BANDS] = {
+  { "DN", "X (km)", "Y (km)", "Z (km)" },
+  { "DN", "Latitude (deg)", "Longitude (deg)", "Height (km)" },
+  { "DN", "East (km)", "North (km)", "Up (km)" }
+};
+
+// What the coordinates of the ground points are divided by to write them in the units of
+// their bands.
+static const double s_divisors[][NUM_BANDS - 1] = {
+  { 1000.0, 1000.0, 1000.0 },
+  { M_PI / 180.0, M_PI / 180.0, 1000.0 },
+  { 1000.0, 1000.0, 1000.0 }
+};
+
+// Format names accepted by findFormat, in Format order.
+static const char *s_formatNames[] = { "csv", "gtiff", "envi", "npy" };
+static const char *s_extensions[] = { ".csv", ".tif", ".bsq", ".npy" };
+
+// Coordinates names accepted by findCoordinates, in Coordinates order.
+static const char *s_coordinatesNames[] = { "ecef", "geodetic", "enu" };
+
+
+/**
+ * @brief Returns true if doubles are stored little-endian on this machine.
+ */
+static bool isLittleEndian() {
+  const uint16_t one = 1;
+  return *reinterpret_cast<const uint8_t *>(&one) == 1;
+}
+
+
+/**
+ * @brief Converts one band of a strip to float64 (lengths in km, angles in degrees).
+ * @param band  The band: 0 = DN, 1 to 3 = the coordinates.
+ * @param coordinates  The coordinates of the ground points.
+ * @param count  Number of pixels of the strip.
+ * @param dn  The DNs of the strip.
+ * @param ground  The ground points of the strip, in meters and radians.
+ * @param values  Receives the count values.
+ */
+static void bandValues(int band, GroundWriter::Coordinates coordinates, size_t count,
+                       const float *dn, const csm::EcefCoord *ground, double *values) {
+  double divisor = band > 0 ? s_divisors[coordinates][band - 1] : 1.0;
+  switch (band) {
+    case 0:
+      for (size_t i = 0; i < count; i++) {
+        values[i] = dn[i];
+      }
+      break;
+    case 1:
+      for (size_t i = 0; i < count; i++) {
+        values[i] = ground[i].x / divisor;
+      }
+      break;
+    case 2:
+      for (size_t i = 0; i < count; i++) {
+        values[i] = ground[i].y / divisor;
+      }
+      break;
+    default:
+      for (size_t i = 0; i < count; i++) {
+        values[i] = ground[i].z / divisor;
+      }
+      break;
+  }
+}
+
+
+/**
+ * Writes "Line, Sample, DN, X (km), Y (km), Z (km)" text records (or the band names of the
+ * writer's coordinates).
+ */
+class CsvGroundWriter : public GroundWriter {
+
+  public:
+    CsvGroundWriter() : m_file(NULL), m_csv(NULL) {
+    }
+
+    ~CsvGroundWriter() {
+      close();
+    }
+
+    bool open(const string &filename, const ImageWindow &window) {
+      close();
+      m_file = fopen(filename.c_str(), "w");
+      if (m_file == NULL) {
+        perror(("error while opening file " + filename).c_str());
+        return false;
+      }
+      m_filename = filename;
+      m_window = window;
+
+      // Records are formatted into one reusable buffer; numbers are written with the
+      // shortest text that reads back to the same value.
+      m_csv = new TextBuffer(m_file);
+      m_csv->append("Line, Sample");
+      for (int band = 0; band < NUM_BANDS; band++) {
+        m_csv->append(", ");
+        m_csv->append(s_bandNames[m_coordinates][band]);
+      }
+      m_csv->append('\n');
+      return true;
+    }
+
+    bool write(int startRow, int rows, const float *dn, const csm::EcefCoord *ground) {
+      // Records are labeled with the (1-based) image line and sample of each grid pixel.
+      int samples = m_window.outputSamples();
+      const double *divisors = s_divisors[m_coordinates];
+      for (int row = 0; row < rows; row++) {
+        for (int column = 0; column < samples; column++) {
+          size_t i = (size_t)row * samples + column;
+          m_csv->appendInteger(m_window.imageLine(startRow + row) + 1);
+          m_csv->append(", ");
+          m_csv->appendInteger(m_window.imageSample(column) + 1);
+          m_csv->append(", ");
+          m_csv->appendFloat(dn[i]);
+          m_csv->append(", ");
+          m_csv->appendDouble(ground[i].x / divisors[0]);
+          m_csv->append(", ");
+          m_csv->appendDouble(ground[i].y / divisors[1]);
+          m_csv->append(", ");
+          m_csv->appendDouble(ground[i].z / divisors[2]);
+          m_csv->append('\n');
+        }
+      }
+      if (!m_csv->flush()) {
+        cerr << "Error while writing file " << m_filename << endl;
+        return false;
+      }
+      return true;
+    }
+
+    bool close() {
+      if (m_file == NULL) {
+        return true;
+      }
+      bool status = m_csv->flush();
+      delete m_csv;
+      m_csv = NULL;
+      status = fclose(m_file) == 0 && status;
+      m_file = NULL;
+      return status;
+    }
+
+  private:
+    FILE *m_file;
+    TextBuffer *m_csv;
+    string m_filename;
+    ImageWindow m_window;
+};
+
+
+/**
+ * Writes a raw band-sequential float64 file.  Each band's part of a strip is contiguous in
+ * the file, so a strip is written with one pwrite per band.  Subclasses add a header: in a
+ * separate file (ENVI) or in front of the data (NumPy).
+ */
+class RawGroundWriter : public GroundWriter {
+
+  public:
+    RawGroundWriter() : m_samples(0), m_lines(0), m_fd(-1), m_dataOffset(0), m_failed(false) {
+    }
+
+    ~RawGroundWriter() {
+      if (m_fd >= 0) {
+        ::close(m_fd);
+      }
+    }
+
+    bool open(const string &filename, const ImageWindow &window) {
+      close();
+      m_fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (m_fd < 0) {
+        perror(("error while opening file " + filename).c_str());
+        return false;
+      }
+      m_filename = filename;
+      m_window = window;
+      m_samples = window.outputSamples();
+      m_lines = window.outputLines();
+      m_failed = false;
+
+      string header = fileHeader();
+      m_dataOffset = header.size();
+      if (!writeAt(header.data(), header.size(), 0)) {
+        return false;
+      }
+
+      // Size the file up front; the bands are filled in strip by strip.
+      off_t size = m_dataOffset + (off_t)NUM_BANDS * m_lines * m_samples * sizeof(double);
+      if (ftruncate(m_fd, size) != 0) {
+        perror(("error while writing file " + filename).c_str());
+        m_failed = true;
+        return false;
+      }
+      return writeSidecar();
+    }
+
+    bool write(int startRow, int rows, const float *dn, const csm::EcefCoord *ground) {
+      size_t count = (size_t)rows * m_samples;
+      m_values.resize(count);
+      for (int band = 0; band < NUM_BANDS && !m_failed; band++) {
+        bandValues(band, m_coordinates, count, dn, ground, m_values.data());
+        off_t offset = m_dataOffset +
+                       ((off_t)band * m_lines + startRow) * m_samples * sizeof(double);
+        writeAt(m_values.data(), count * sizeof(double), offset);
+      }
+      return !m_failed;
+    }
+
+    bool close() {
+      if (m_fd < 0) {
+        return !m_failed;
+      }
+      if (::close(m_fd) != 0) {
+        perror(("error while closing file " + m_filename).c_str());
+        m_failed = true;
+      }
+      m_fd = -1;
+      return !m_failed;
+    }
+
+  protected:
+    /** Returns the bytes written in front of the data. */
+    virtual string fileHeader() const {
+      return string();
+    }
+
+    /** Writes any file that accompanies the data file. */
+    virtual bool writeSidecar() {
+      return true;
+    }
+
+    string m_filename;          //!< The data file.
+    ImageWindow m_window;       //!< The pixels being written.
+    int m_samples;              //!< Samples per line of each band, the window's output width.
+    int m_lines;                //!< Lines of each band, the window's output height.
+
+  private:
+    bool writeAt(const void *data, size_t size, off_t offset) {
+      const char *bytes = static_cast<const char *>(data);
+      while (size > 0) {
+        ssize_t written = pwrite(m_fd, bytes, size, offset);
+        if (written < 0 && errno == EINTR) {
+          continue;
+        }
+        if (written <= 0) {
+          perror(("error while writing file " + m_filename).c_str());
+          m_failed = true;
+          return false;
+        }
+        bytes += written;
+        size -= written;
+        offset += written;
+      }
+      return true;
+    }
+
+    int m_fd;                   //!< The open data file, or -1.
+    off_t m_dataOffset;         //!< Offset of the first band in the data file.
+    bool m_failed;              //!< Whether a write failed; close() then reports it.
+    vector<double> m_values;    //!< One band of the current strip, reused for every strip.
+};
+
+
+/**
+ * Writes a raw band-sequential file and an ENVI header.  The header is named after the data
+ * file with its extension replaced by .hdr (ground.bsq -> ground.hdr).
+ */
+class EnviGroundWriter : public RawGroundWriter {
+
+  protected:
+    bool writeSidecar() {
+      string headerName = m_filename;
+      size_t dot = headerName.find_last_of('.');
+      size_t slash = headerName.find_last_of('/');
+      if (dot != string::npos && (slash == string::npos || dot > slash)) {
+        headerName.erase(dot);
+      }
+      headerName += ".hdr";
+
+      FILE *file = fopen(headerName.c_str(), "w");
+      if (file == NULL) {
+        perror(("error while opening file " + headerName).c_str());
+        return false;
+      }
+      fprintf(file, "ENVI\n");
+      fprintf(file, "description = {set ground grid of image samples %d-%d every %d, "
+                    "lines %d-%d every %d}\n",
+              m_window.startSample + 1, m_window.startSample + m_window.samples,
+              m_window.sampleStride, m_window.startLine + 1,
+              m_window.startLine + m_window.lines, m_window.lineStride);
+      fprintf(file, "samples = %d\n", m_samples);
+      fprintf(file, "lines = %d\n", m_lines);
+      fprintf(file, "bands = %d\n", NUM_BANDS);
+      fprintf(file, "header offset = 0\n");
+      fprintf(file, "file type = ENVI Standard\n");
+      fprintf(file, "data type = 5\n");
+      fprintf(file, "interleave = bsq\n");
+      fprintf(file, "byte order = %d\n", isLittleEndian() ? 0 : 1);
+      const char **bandNames = s_bandNames[m_coordinates];
+      fprintf(file, "band names = {%s, %s, %s, %s}\n",
+              bandNames[0], bandNames[1], bandNames[2], bandNames[3]);
+      if (fclose(file) != 0) {
+        perror(("error while writing file " + headerName).c_str());
+        return false;
+      }
+      return true;
+    }
+};
+
+
+/**
+ * Writes a NumPy .npy (format version 1.0) file holding a (4, lines, samples) float64 array.
+ */
+class NpyGroundWriter : public RawGroundWriter {
+
+  protected:
+    string fileHeader() const {
+      char dict[128];
+      snprintf(dict, sizeof(dict),
+               "{'descr': '%s', 'fortran_order': False, 'shape': (%d, %d, %d), }",
+               isLittleEndian() ? "<f8" : ">f8", NUM_BANDS, m_lines, m_samples);
+
+      // Magic, version and header length take 10 bytes; the header is padded with spaces
+      // and a newline so the data starts on a 64 byte boundary.
+      string header(dict);
+      size_t total = 10 + header.size() + 1;
+      header.append((64 - total % 64) % 64, ' ');
+      header += '\n';
+
+      string prefix("\x93NUMPY\x01\x00", 8);
+      prefix += char(header.size() & 0xff);
+      prefix += char(header.size() >> 8);
+      return prefix + header;
+    }
+};
+
+
+/**
+ * Writes a four band float64 GeoTIFF through GDAL.  The DNs are handed to GDAL straight from
+ * the caller's buffer (GDAL converts them to float64); the ground bands are scaled to km in
+ * one reusable band buffer first.
+ */
+class GTiffGroundWriter : public GroundWriter {
+
+  public:
+    GTiffGroundWriter() : m_dataset(NULL), m_samples(0), m_failed(false) {
+    }
+
+    ~GTiffGroundWriter() {
+      close();
+    }
+
+    bool open(const string &filename, const ImageWindow &window) {
+      close();
+      GDALAllRegister();
+      GDALDriver *driver = (GDALDriver *)GDALGetDriverByName("GTiff");
+      if (driver == NULL) {
+        cerr << "The GDAL GTiff driver is not available" << endl;
+        return false;
+      }
+
+      char **options = NULL;
+      options = CSLSetNameValue(options, "INTERLEAVE", "BAND");
+      options = CSLSetNameValue(options, "BIGTIFF", "IF_SAFER");
+      m_dataset = driver->Create(filename.c_str(), window.outputSamples(),
+                                 window.outputLines(), NUM_BANDS, GDT_Float64, options);
+      CSLDestroy(options);
+      if (m_dataset == NULL) {
+        cerr << "Could not create " << filename << endl;
+        return false;
+      }
+
+      for (int band = 0; band < NUM_BANDS; band++) {
+        m_dataset->GetRasterBand(band + 1)->SetDescription(s_bandNames[m_coordinates][band]);
+      }
+      // Record where the grid's pixels are in the image (1-based).
+      char value[MAX_NUMBER_LENGTH];
+      const int windowValues[] = { window.startSample + 1, window.startLine + 1,
+                                   window.sampleStride, window.lineStride };
+      const char *windowNames[] = { "START_SAMPLE", "START_LINE", "SAMPLE_STRIDE",
+                                    "LINE_STRIDE" };
+      for (int i = 0; i < 4; i++) {
+        formatInteger(windowValues[i], value);
+        m_dataset->SetMetadataItem(windowNames[i], value);
+      }
+
+      m_filename = filename;
+      m_samples = window.outputSamples();
+      m_failed = false;
+      return true;
+    }
+
+    bool write(int startRow, int rows, const float *dn, const csm::EcefCoord *ground) {
+      size_t count = (size_t)rows * m_samples;
+      m_values.resize(count);
+      for (int band = 0; band < NUM_BANDS && !m_failed; band++) {
+        CPLErr status;
+        if (band == 0) {
+          status = m_dataset->GetRasterBand(1)->RasterIO(
+              GF_Write, 0, startRow, m_samples, rows, const_cast<float *>(dn),
+              m_samples, rows, GDT_Float32, 0, 0);
+        }
+        else {
+          bandValues(band, m_coordinates, count, dn, ground, m_values.data());
+          status = m_dataset->GetRasterBand(band + 1)->RasterIO(
+              GF_Write, 0, startRow, m_samples, rows, m_values.data(),
+              m_samples, rows, GDT_Float64, 0, 0);
+        }
+        if (status != CE_None) {
+          cerr << "Error while writing file " << m_filename << endl;
+          m_failed = true;
+        }
+      }
+      return !m_failed;
+    }
+
+    bool close() {
+      if (m_dataset != NULL) {
+        // Closing writes the last blocks and the TIFF directory; GDAL reports a failure to
+        // do so only through its error state.
+        CPLErrorReset();
+        GDALClose(m_dataset);
+        m_dataset = NULL;
+        if (CPLGetLastErrorType() >= CE_Failure) {
+          cerr << "Error while writing file " << m_filename << endl;
+          m_failed = true;
+        }
+      }
+      return !m_failed;
+    }
+
+  private:
+    GDALDataset *m_dataset;
+    string m_filename;
+    int m_samples;
+    bool m_failed;
+    vector<double> m_values;    //!< One ground band of the current strip.
+};
+
+
+/**
+ * @brief Creates a writer for a format and the coordinates of the ground points.
+ * @return A new writer; the caller owns it.
+ */
+GroundWriter *GroundWriter::create(Format format, Coordinates coordinates) {
+  GroundWriter *writer;
+  switch (format) {
+    case GTIFF_FORMAT:
+      writer = new GTiffGroundWriter();
+      break;
+    case ENVI_FORMAT:
+      writer = new EnviGroundWriter();
+      break;
+    case NPY_FORMAT:
+      writer = new NpyGroundWriter();
+      break;
+    default:
+      writer = new CsvGroundWriter();
+      break;
+  }
+  writer->m_coordinates = coordinates;
+  return writer;
+}
+
+
+/**
+ * @brief Looks up a format by its command line name (csv, gtiff, envi or npy).
+ * @return false if the name is not a format.
+ */
+bool GroundWriter::findFormat(const string &name, Format &format) {
+  for (int i = 0; i < int(sizeof(s_formatNames) / sizeof(s_formatNames[0])); i++) {
+    if (name == s_formatNames[i]) {
+      format = static_cast<Format>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+
+/**
+ * @brief Looks up coordinates by their command line name (ecef, geodetic or enu).
+ * @return false if the name is not a kind of coordinates.
+ */
+bool GroundWriter::findCoordinates(const string &name, Coordinates &coordinates) {
+  for (int i = 0; i < int(sizeof(s_coordinatesNames) / sizeof(s_coordinatesNames[0])); i++) {
+    if (name == s_coordinatesNames[i]) {
+      coordinates = static_cast<Coordinates>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+
+/**
+ * @brief Returns the usual file extension of a format, including the dot.
+ */
+const char *GroundWriter::extension(Format format) {
+  return s_extensions[format];
+}
@@ -0,0 +1,510 @@
+#include "IsdArchive.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <csm/Isd.h>
+
+#include "IsdReader.h"
+
+using namespace std;
+
+static const char ARCHIVE_MAGIC[8] = { 'M', 'D', 'I', 'S', 'I', 'S', 'D', 'A' };
+static const char INDEX_MAGIC[8] = { 'M', 'D', 'I', 'S', 'I', 'D', 'X', '1' };
+static const uint32_t ARCHIVE_VERSION = 2;
+static const size_t HEADER_SIZE = 24;
+static const size_t TRAILER_SIZE = 32;
+
+// Position in the header of the offset of the current trailer.
+static const off_t TRAILER_POINTER = 16;
+
+
+/**
+ * @brief Rounds an offset up to the next multiple of 8 bytes.
+ */
+static uint64_t align8(uint64_t offset) {
+  return (offset + 7) & ~uint64_t(7);
+}
+
+
+/**
+ * @brief Compares an image identifier stored in the archive against a key.
+ * @return <0, 0 or >0 in the manner of strcmp.
+ */
+static int compareId(const char *id, uint32_t idLength, const string &key) {
+  size_t n = min<size_t>(idLength, key.size());
+  int cmp = memcmp(id, key.data(), n);
+  if (cmp != 0) {
+    return cmp;
+  }
+  if (idLength < key.size()) {
+    return -1;
+  }
+  return idLength > key.size() ? 1 : 0;
+}
+
+
+/**
+ * @brief Checks the header of an archive and reads the offset of its current trailer.
+ * @param header  The HEADER_SIZE bytes of the header.
+ * @param trailerOffset  Set to the offset of the trailer, 0 if no index was ever written.
+ * @return false if the header is not that of an archive of this version.
+ */
+static bool readHeader(const char *header, uint64_t &trailerOffset) {
+  uint32_t version = 0;
+  memcpy(&version, header + 8, 4);
+  memcpy(&trailerOffset, header + TRAILER_POINTER, 8);
+  return memcmp(header, ARCHIVE_MAGIC, 8) == 0 && version == ARCHIVE_VERSION &&
+         trailerOffset % 8 == 0;
+}
+
+
+/**
+ * @brief Checks a trailer and reads where its index is.
+ * @param trailer  The TRAILER_SIZE bytes of the trailer.
+ * @param trailerOffset  The offset of the trailer in the file.
+ * @param indexOffset  Set to the offset of the index records.
+ * @param count  Set to the number of index records.
+ * @return false if the trailer is invalid or its index does not fit in front of it.
+ */
+static bool readTrailer(const char *trailer, uint64_t trailerOffset, uint64_t &indexOffset,
+                        uint64_t &count) {
+  memcpy(&indexOffset, trailer, 8);
+  memcpy(&count, trailer + 8, 8);
+  return memcmp(trailer + 24, INDEX_MAGIC, 8) == 0 &&
+         indexOffset % 8 == 0 &&
+         indexOffset >= HEADER_SIZE &&
+         indexOffset <= trailerOffset &&
+         count <= (trailerOffset - indexOffset) / sizeof(IsdArchiveRecord);
+}
+
+
+/**
+ * @brief Checks that the payloads of the index records lie between the header and the
+ * index, and their image identifiers between the index and the trailer.
+ * @return false if a record points outside its part of the file.
+ */
+static bool validRecords(const IsdArchiveRecord *records, uint64_t count,
+                         uint64_t indexOffset, uint64_t trailerOffset) {
+  uint64_t stringsOffset = indexOffset + count * sizeof(IsdArchiveRecord);
+  for (uint64_t i = 0; i < count; i++) {
+    const IsdArchiveRecord &rec = records[i];
+    if (rec.offset < HEADER_SIZE || rec.offset > indexOffset ||
+        rec.size > indexOffset - rec.offset ||
+        rec.idOffset < stringsOffset || rec.idOffset > trailerOffset ||
+        rec.idLength > trailerOffset - rec.idOffset) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+/**
+ * @brief Checks that the index records of a mapped archive are sorted by image identifier,
+ * without duplicates, as find() binary-searches them.
+ * @return false if a record's identifier does not sort after the one before it.
+ */
+static bool sortedRecords(const char *map, const IsdArchiveRecord *records, uint64_t count) {
+  for (uint64_t i = 1; i < count; i++) {
+    string id(map + records[i].idOffset, records[i].idLength);
+    if (compareId(map + records[i - 1].idOffset, records[i - 1].idLength, id) >= 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+IsdArchiveWriter::IsdArchiveWriter() : m_file(NULL), m_end(HEADER_SIZE) {
+}
+
+
+IsdArchiveWriter::~IsdArchiveWriter() {
+  close();
+}
+
+
+/**
+ * @brief IsdArchiveWriter::open  Opens an archive for appending, creating it if it does not
+ * exist.  The index of an existing archive is read so that it can be rewritten on close.
+ * @param filename  The archive file.
+ * @return true if the archive is ready for writing.
+ */
+bool IsdArchiveWriter::open(const string &filename) {
+  close();
+  m_entries.clear();
+  m_ids.clear();
+  m_filename = filename;
+
+  m_file = fopen(filename.c_str(), "r+b");
+  if (m_file == NULL) {
+    m_file = fopen(filename.c_str(), "w+b");
+    if (m_file == NULL) {
+      perror(("error while opening file " + filename).c_str());
+      return false;
+    }
+  }
+
+  fseeko(m_file, 0, SEEK_END);
+  off_t fileSize = ftello(m_file);
+
+  // New archive: just write the header.  It points at no trailer until close() writes one.
+  if (fileSize == 0) {
+    char header[HEADER_SIZE] = { 0 };
+    memcpy(header, ARCHIVE_MAGIC, 8);
+    memcpy(header + 8, &ARCHIVE_VERSION, 4);
+    if (fwrite(header, 1, HEADER_SIZE, m_file) != HEADER_SIZE) {
+      perror(("error while writing file " + filename).c_str());
+      fclose(m_file);
+      m_file = NULL;
+      return false;
+    }
+    m_end = HEADER_SIZE;
+    return true;
+  }
+
+  // Existing archive: load the index its header points at.
+  char header[HEADER_SIZE];
+  char trailer[TRAILER_SIZE];
+  uint64_t trailerOffset = 0;
+  fseeko(m_file, 0, SEEK_SET);
+  bool valid = fileSize >= off_t(HEADER_SIZE) &&
+               fread(header, 1, HEADER_SIZE, m_file) == HEADER_SIZE &&
+               readHeader(header, trailerOffset);
+
+  // An archive whose first close() never finished has no entries yet.
+  if (valid && trailerOffset == 0) {
+    m_end = HEADER_SIZE;
+    return true;
+  }
+
+  uint64_t indexOffset = 0;
+  uint64_t count = 0;
+  if (valid) {
+    valid = trailerOffset >= HEADER_SIZE &&
+            trailerOffset <= uint64_t(fileSize) - TRAILER_SIZE &&
+            fseeko(m_file, trailerOffset, SEEK_SET) == 0 &&
+            fread(trailer, 1, TRAILER_SIZE, m_file) == TRAILER_SIZE &&
+            readTrailer(trailer, trailerOffset, indexOffset, count);
+  }
+
+  vector<IsdArchiveRecord> records(valid ? count : 0);
+  if (valid && count > 0) {
+    fseeko(m_file, indexOffset, SEEK_SET);
+    valid = fread(&records[0], sizeof(IsdArchiveRecord), count, m_file) == count &&
+            validRecords(&records[0], count, indexOffset, trailerOffset);
+  }
+
+  for (size_t i = 0; valid && i < records.size(); i++) {
+    PendingEntry entry;
+    entry.imageId.resize(records[i].idLength);
+    entry.offset = records[i].offset;
+    entry.size = records[i].size;
+    fseeko(m_file, records[i].idOffset, SEEK_SET);
+    if (records[i].idLength > 0 &&
+        fread(&entry.imageId[0], 1, records[i].idLength, m_file) != records[i].idLength) {
+      valid = false;
+      break;
+    }
+    // The index is sorted by identifier; one that is not would be mis-searched by readers.
+    if (!m_entries.empty() && !(m_entries.back().imageId < entry.imageId)) {
+      valid = false;
+      break;
+    }
+    m_ids.insert(entry.imageId);
+    m_entries.push_back(entry);
+  }
+
+  if (!valid) {
+    cerr << "error while opening archive " << filename << ": not a valid ISD archive" << endl;
+    fclose(m_file);
+    m_file = NULL;
+    m_entries.clear();
+    m_ids.clear();
+    return false;
+  }
+
+  // New payloads go after the current trailer, which stays valid until close() replaces it.
+  // Anything after it is left over from an append that did not finish, and is overwritten.
+  m_end = trailerOffset + TRAILER_SIZE;
+  return true;
+}
+
+
+/**
+ * @brief IsdArchiveWriter::add  Appends an ISD to the archive.
+ * @param imageId  The identifier the ISD is looked up by.  Must be unique in the archive.
+ * @param data  The ISD text.
+ * @param size  The number of bytes of ISD text.
+ * @return true if the ISD was appended.
+ */
+bool IsdArchiveWriter::add(const string &imageId, const char *data, size_t size) {
+  if (m_file == NULL) {
+    return false;
+  }
+
+  if (!m_ids.insert(imageId).second) {
+    cerr << "ISD archive " << m_filename << " already contains " << imageId << endl;
+    return false;
+  }
+
+  static const char padding[8] = { 0 };
+  fseeko(m_file, m_end, SEEK_SET);
+  size_t padded = align8(size) - size;
+  if (fwrite(data, 1, size, m_file) != size ||
+      fwrite(padding, 1, padded, m_file) != padded) {
+    perror(("error while writing file " + m_filename).c_str());
+    m_ids.erase(imageId);
+    return false;
+  }
+
+  PendingEntry entry;
+  entry.imageId = imageId;
+  entry.offset = m_end;
+  entry.size = size;
+  m_entries.push_back(entry);
+  m_end += size + padded;
+  return true;
+}
+
+
+/**
+ * @brief IsdArchiveWriter::addFile  Appends the contents of an ISD file to the archive.
+ * @param imageId  The identifier the ISD is looked up by.
+ * @param isdFile  The ISD file to store.
+ * @return true if the ISD was appended.
+ */
+bool IsdArchiveWriter::addFile(const string &imageId, const string &isdFile) {
+  ifstream file(isdFile.c_str(), ios::in | ios::binary);
+  if (!file.is_open()) {
+    perror(("error while opening file " + isdFile).c_str());
+    return false;
+  }
+  stringstream contents;
+  contents << file.rdbuf();
+  string text = contents.str();
+  return add(imageId, text.data(), text.size());
+}
+
+
+/**
+ * @brief IsdArchiveWriter::close  Writes the sorted index and trailer after the payloads and
+ * closes the archive.  Once they are on disk the header is pointed at the new trailer, so
+ * until then the archive keeps its previous index and a failed close loses only the ISDs
+ * added since open().
+ * @return true if the index was written.
+ */
+bool IsdArchiveWriter::close() {
+  if (m_file == NULL) {
+    return true;
+  }
+
+  // Sort an index of positions into m_entries by identifier.
+  vector<size_t> order(m_entries.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  const vector<PendingEntry> &entries = m_entries;
+  sort(order.begin(), order.end(), [&entries](size_t a, size_t b) {
+    return entries[a].imageId < entries[b].imageId;
+  });
+
+  uint64_t indexOffset = align8(m_end);
+  uint64_t stringsOffset = indexOffset + order.size() * sizeof(IsdArchiveRecord);
+
+  vector<IsdArchiveRecord> records(order.size());
+  string strings;
+  for (size_t i = 0; i < order.size(); i++) {
+    const PendingEntry &entry = m_entries[order[i]];
+    records[i].offset = entry.offset;
+    records[i].size = entry.size;
+    records[i].idOffset = stringsOffset + strings.size();
+    records[i].idLength = entry.imageId.size();
+    records[i].reserved = 0;
+    strings += entry.imageId;
+  }
+  strings.resize(align8(strings.size()), '\0');
+
+  uint64_t count = records.size();
+  char trailer[TRAILER_SIZE];
+  memcpy(trailer, &indexOffset, 8);
+  memcpy(trailer + 8, &count, 8);
+  memcpy(trailer + 16, &stringsOffset, 8);
+  memcpy(trailer + 24, INDEX_MAGIC, 8);
+
+  static const char padding[8] = { 0 };
+  fseeko(m_file, m_end, SEEK_SET);
+  bool ok = fwrite(padding, 1, indexOffset - m_end, m_file) == indexOffset - m_end;
+  if (ok && count > 0) {
+    ok = fwrite(&records[0], sizeof(IsdArchiveRecord), count, m_file) == count;
+  }
+  ok = ok && fwrite(strings.data(), 1, strings.size(), m_file) == strings.size();
+  ok = ok && fwrite(trailer, 1, TRAILER_SIZE, m_file) == TRAILER_SIZE;
+  ok = ok && fflush(m_file) == 0 && fsync(fileno(m_file)) == 0;
+
+  // Make the new trailer current, then drop anything left after it.
+  uint64_t trailerOffset = stringsOffset + strings.size();
+  ok = ok && pwrite(fileno(m_file), &trailerOffset, 8, TRAILER_POINTER) == 8 &&
+       fsync(fileno(m_file)) == 0;
+  ok = ok && ftruncate(fileno(m_file), trailerOffset + TRAILER_SIZE) == 0;
+  if (!ok) {
+    perror(("error while writing file " + m_filename).c_str());
+  }
+
+  fclose(m_file);
+  m_file = NULL;
+  return ok;
+}
+
+
+IsdArchive::IsdArchive() : m_map(NULL), m_mapSize(0), m_records(NULL), m_count(0) {
+}
+
+
+IsdArchive::~IsdArchive() {
+  close();
+}
+
+
+/**
+ * @brief IsdArchive::open  Memory-maps an archive written by IsdArchiveWriter.
+ * @param filename  The archive file.
+ * @return true if the archive was mapped and its index is valid.
+ */
+bool IsdArchive::open(const string &filename) {
+  close();
+
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    perror(("error while opening file " + filename).c_str());
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    perror(("error while reading file " + filename).c_str());
+    ::close(fd);
+    return false;
+  }
+
+  size_t fileSize = info.st_size;
+  if (fileSize < HEADER_SIZE + TRAILER_SIZE) {
+    cerr << "error while opening archive " << filename << ": not a valid ISD archive" << endl;
+    ::close(fd);
+    return false;
+  }
+
+  void *map = mmap(NULL, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    perror(("error while mapping file " + filename).c_str());
+    return false;
+  }
+
+  m_map = static_cast<const char *>(map);
+  m_mapSize = fileSize;
+  m_filename = filename;
+
+  uint64_t trailerOffset = 0;
+  uint64_t indexOffset = 0;
+  uint64_t count = 0;
+  bool valid = readHeader(m_map, trailerOffset) &&
+               trailerOffset >= HEADER_SIZE &&
+               trailerOffset <= fileSize - TRAILER_SIZE &&
+               readTrailer(m_map + trailerOffset, trailerOffset, indexOffset, count) &&
+               validRecords(reinterpret_cast<const IsdArchiveRecord *>(m_map + indexOffset),
+                            count, indexOffset, trailerOffset);
+  // Only once every identifier is known to lie inside the file can they be compared.
+  valid = valid && sortedRecords(m_map,
+                                 reinterpret_cast<const IsdArchiveRecord *>(m_map + indexOffset),
+                                 count);
+
+  if (!valid) {
+    cerr << "error while opening archive " << filename << ": not a valid ISD archive" << endl;
+    close();
+    return false;
+  }
+
+  m_records = reinterpret_cast<const IsdArchiveRecord *>(m_map + indexOffset);
+  m_count = count;
+  return true;
+}
+
+
+/**
+ * @brief IsdArchive::close  Unmaps the archive.  Pointers returned by find() become invalid.
+ */
+void IsdArchive::close() {
+  if (m_map != NULL) {
+    munmap(const_cast<char *>(m_map), m_mapSize);
+  }
+  m_map = NULL;
+  m_mapSize = 0;
+  m_records = NULL;
+  m_count = 0;
+}
+
+
+/**
+ * @brief IsdArchive::find  Looks up an ISD by image identifier.
+ * @param imageId  The identifier to find.
+ * @param data  Set to the start of the ISD text inside the mapping.
+ * @param size  Set to the number of bytes of ISD text.
+ * @return true if the identifier is in the archive.
+ */
+bool IsdArchive::find(const string &imageId, const char **data, size_t *size) const {
+  size_t low = 0;
+  size_t high = m_count;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    const IsdArchiveRecord &rec = m_records[mid];
+    int cmp = compareId(m_map + rec.idOffset, rec.idLength, imageId);
+    if (cmp == 0) {
+      *data = m_map + rec.offset;
+      *size = rec.size;
+      return true;
+    }
+    if (cmp < 0) {
+      low = mid + 1;
+    }
+    else {
+      high = mid;
+    }
+  }
+  return false;
+}
+
+
+/**
+ * @brief IsdArchive::readISD  Looks up an ISD by image identifier and parses it.
+ * @param imageId  The identifier to find.
+ * @return A new ISD, or NULL if the identifier is not in the archive.
+ */
+csm::Isd *IsdArchive::readISD(const string &imageId) const {
+  const char *data = NULL;
+  size_t size = 0;
+  if (!find(imageId, &data, &size)) {
+    cerr << "ISD archive " << m_filename << " does not contain " << imageId << endl;
+    return NULL;
+  }
+  return ::readISD(data, size, imageId);
+}
+
+
+/**
+ * @brief IsdArchive::imageId  Returns the image identifier of the index-th entry.
+ */
+string IsdArchive::imageId(size_t index) const {
+  const IsdArchiveRecord &rec = m_records[index];
+  return string(m_map + rec.idOffset, rec.idLength);
+}
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <iomanip>
 #include <map>
 #include <string>
 #include <sstream>
@@ -9,12 +10,31 @@
 #include <json/json.hpp>
 #include <csm/Isd.h>
 
+#include <TextBuffer.h>
+
+#ifdef USE_SIMDJSON
+#include <simdjson.h>
+#endif
+
 using namespace std;
 using json = nlohmann::json;
 
+#ifdef USE_SIMDJSON
+static csm::Isd *readISDSimdjson(const simdjson::padded_string &text, const string &filename,
+                                 int prec);
+#endif
+
 csm::Isd *readISD(string filename) {
+#ifdef USE_SIMDJSON
+  simdjson::padded_string text;
+  if (simdjson::padded_string::load(filename).get(text) != simdjson::SUCCESS) {
+    perror(("error while opening file " + filename).c_str());
+    return NULL;
+  }
+  return readISDSimdjson(text, filename, 0);
+#else
   json jsonFile;
-  int prec = 12;
+  int prec = 0;
   csm::Isd *isd = NULL;
 
   //Read the ISD file
@@ -33,20 +53,189 @@ csm::Isd *readISD(string filename) {
     isd = new csm::Isd();
     file >> jsonFile;
     isd->setFilename(filename);
-    for (json::iterator i = jsonFile.begin(); i != jsonFile.end(); i++) {        
-        if (i.value().is_array()){
-          DataType arrayType = checkType(i.value()[0]);
-          addParam(*isd, i,arrayType,prec);
-        }
-        else {
-          DataType dt = checkType(i.value());
-          addParam(*isd,i,dt,prec);
-        }
-    }//end for
+    addParams(*isd, jsonFile, prec);
   } //end outer-else
   //printISD(*isd);
   file.close();
   return isd;
+#endif
+}
+
+
+/**
+ * @brief readISD  Creates an ISD from JSON text that is already in memory (e.g. an entry
+ * of a memory-mapped IsdArchive), using the parser selected at build time.
+ * @param data  Pointer to the first character of the JSON text.
+ * @param size  Number of bytes of JSON text.
+ * @param filename  The name to record as the ISD's filename.
+ * @return A new ISD, or NULL if the text could not be parsed.
+ */
+csm::Isd *readISD(const char *data, size_t size, string filename) {
+#ifdef USE_SIMDJSON
+  return readISD(data, size, filename, SIMDJSON_PARSER);
+#else
+  return readISD(data, size, filename, NLOHMANN_PARSER);
+#endif
+}
+
+
+/**
+ * @brief isdParserAvailable  Returns true if the parser was compiled into this build.
+ * nlohmann::json is always available; simdjson requires building with USE_SIMDJSON.
+ */
+bool isdParserAvailable(IsdParser parser) {
+  if (parser == SIMDJSON_PARSER) {
+#ifdef USE_SIMDJSON
+    return true;
+#else
+    return false;
+#endif
+  }
+  return true;
+}
+
+
+/**
+ * @brief readISD  Creates an ISD from JSON text that is already in memory with a specific
+ * parser.  nlohmann::json parses the buffer in place; simdjson needs padding after the
+ * text, so it parses a padded copy.
+ * @param data  Pointer to the first character of the JSON text.
+ * @param size  Number of bytes of JSON text.
+ * @param filename  The name to record as the ISD's filename.
+ * @param parser  The parser to use.
+ * @return A new ISD, or NULL if the text could not be parsed or the parser is not available.
+ */
+csm::Isd *readISD(const char *data, size_t size, string filename, IsdParser parser) {
+  int prec = 0;
+
+  if (parser == SIMDJSON_PARSER) {
+#ifdef USE_SIMDJSON
+    simdjson::padded_string text(data, size);
+    return readISDSimdjson(text, filename, prec);
+#else
+    cerr << "ISD parser simdjson is not available in this build" << endl;
+    return NULL;
+#endif
+  }
+
+  json jsonFile;
+  try {
+    jsonFile = json::parse(data, data + size);
+  }
+  catch (std::exception &e) {
+    cerr << "error while parsing ISD " << filename << ": " << e.what() << endl;
+    return NULL;
+  }
+
+  csm::Isd *isd = new csm::Isd();
+  isd->setFilename(filename);
+  addParams(*isd, jsonFile, prec);
+  return isd;
+}
+
+
+#ifdef USE_SIMDJSON
+/**
+ * @brief addSimdjsonParam  Adds one JSON value to the ISD, formatting it the same way
+ * addParam does.  Array elements are added as repeated keywords.
+ * @param isd A reference to the ISD object
+ * @param key The keyword.
+ * @param value The value of the keyword.
+ * @param prec The # of significant digits to be written to the ISD (if the value is a float)
+ */
+static void addSimdjsonParam(csm::Isd &isd, const string &key, simdjson::ondemand::value value,
+                             int prec) {
+  switch (value.type()) {
+    case simdjson::ondemand::json_type::array:
+      for (simdjson::ondemand::value element : value.get_array()) {
+        addSimdjsonParam(isd, key, element, prec);
+      }
+      break;
+
+    case simdjson::ondemand::json_type::number:
+      switch (value.get_number_type()) {
+        case simdjson::ondemand::number_type::signed_integer:
+          isd.addParam(key, to_string(int64_t(value.get_int64())));
+          break;
+        case simdjson::ondemand::number_type::unsigned_integer:
+          isd.addParam(key, to_string(uint64_t(value.get_uint64())));
+          break;
+        default: {
+          char val[MAX_NUMBER_LENGTH];
+          formatDouble(double(value.get_double()), prec, val);
+          isd.addParam(key, val);
+          break;
+        }
+      }
+      break;
+
+    case simdjson::ondemand::json_type::string:
+      isd.addParam(key, string(std::string_view(value.get_string())));
+      break;
+
+    case simdjson::ondemand::json_type::boolean:
+      isd.addParam(key, bool(value.get_bool()) ? "1" : "0");
+      break;
+
+    case simdjson::ondemand::json_type::null:
+      isd.addParam(key, "null");
+      break;
+
+    default:
+      // Nested objects are not ISD keywords
+      break;
+  }
+}
+
+
+/**
+ * @brief readISDSimdjson  Parses an ISD with the simdjson On Demand API.
+ * @param text The JSON text, with simdjson's required padding.
+ * @param filename The name to record as the ISD's filename.
+ * @param prec The # of significant digits to be written to the ISD (if the value is a float)
+ * @return A new ISD, or NULL if the text could not be parsed.
+ */
+static csm::Isd *readISDSimdjson(const simdjson::padded_string &text, const string &filename,
+                                 int prec) {
+  // The parser keeps its buffers between documents, so reuse one per thread.
+  static thread_local simdjson::ondemand::parser parser;
+
+  csm::Isd *isd = new csm::Isd();
+  isd->setFilename(filename);
+  try {
+    simdjson::ondemand::document doc = parser.iterate(text);
+    for (simdjson::ondemand::field field : doc.get_object()) {
+      string key(std::string_view(field.unescaped_key()));
+      addSimdjsonParam(*isd, key, field.value(), prec);
+    }
+  }
+  catch (simdjson::simdjson_error &e) {
+    cerr << "error while parsing ISD " << filename << ": " << e.what() << endl;
+    delete isd;
+    return NULL;
+  }
+  return isd;
+}
+#endif
+
+
+/**
+ * @brief addParams  Adds every keyword of a parsed JSON object to the ISD.
+ * @param isd A reference to the ISD object
+ * @param jsonFile The parsed JSON object.
+ * @param prec The # of significant digits to be written to the ISD (if the value is a float)
+ */
+void addParams(csm::Isd &isd, json &jsonFile, int prec) {
+  for (json::iterator i = jsonFile.begin(); i != jsonFile.end(); i++) {
+      if (i.value().is_array()){
+        DataType arrayType = checkType(i.value()[0]);
+        addParam(isd, i,arrayType,prec);
+      }
+      else {
+        DataType dt = checkType(i.value());
+        addParam(isd,i,dt,prec);
+      }
+  }//end for
 }
 
 
@@ -87,91 +276,56 @@ DataType checkType(json::value_type obj){
  * @param isd A reference to the ISD object
  * @param it  The iterator to the json file which iterates over the keywords.
  * @param dt  The enum DataType value
- * @param prec The # of decimal places to be written to the ISD (if the value is a float)
+ * @param prec The # of significant digits to be written to the ISD (if the value is a float);
+ *             0 writes the shortest text that reads back to the same double.
  * @author Tyler Wilson
  */
 void addParam(csm::Isd &isd, json::iterator it, DataType dt, int prec) {
-  ostringstream key;
   //output the key to the ISD
-  key << it.key();
+  const string &key = it.key();
+  char val[MAX_NUMBER_LENGTH];
   if (it.value().is_array()) {
     if (dt==FLOAT) {
       vector<double> v = it.value();
       for (int j=0;j < v.size(); j++) {
-        ostringstream val;
-        val << setprecision(prec) << v[j];
-        isd.addParam(key.str(),val.str());
+        formatDouble(v[j], prec, val);
+        isd.addParam(key,val);
       }
     }
-    else if(dt==INT){
-      vector<double> v = it.value();
-      for (int j=0;j < v.size(); j++) {
-        ostringstream val;
-        val << v[j];
-        isd.addParam(key.str(),val.str());
-      }
-    }
-
-    else if(dt==UINT) {
-      vector<double> v = it.value();
-      for (int j=0;j < v.size(); j++) {
-        ostringstream val;
-        val  << v[j];
-        isd.addParam(key.str(),val.str());
-      }
-    }
-    else if(dt ==BOOL) {
-      vector<double> v = it.value();
-      for (int j=0;j < v.size(); j++) {
-        ostringstream val;
-        val << v[j];
-        isd.addParam(key.str(),val.str());
-      }
-    }
-    else if (dt ==STRING) {
+    else if(dt==INT || dt==UINT || dt==BOOL || dt==STRING) {
       vector<double> v = it.value();
       for (int j=0;j < v.size(); j++) {
-        ostringstream val;
-        val <<  v[j];
-        isd.addParam(key.str(),val.str());
+        formatDouble(v[j], val);
+        isd.addParam(key,val);
       }
     }
   }
   else {
     if(dt==FLOAT) {
       double v = it.value();
-      ostringstream val;
-      val << setprecision(prec) << v;
-      isd.addParam(key.str(),val.str());
+      formatDouble(v, prec, val);
+      isd.addParam(key,val);
     }
     else if(dt==INT){
       int v = it.value();
-      ostringstream val;
-      val  << v;
-      isd.addParam(key.str(),val.str());
+      formatInteger(v, val);
+      isd.addParam(key,val);
     }
     else if(dt==UINT) {
       unsigned int v = it.value();
-      ostringstream val;
-      val << v;
-      isd.addParam(key.str(),val.str());
+      formatInteger(v, val);
+      isd.addParam(key,val);
     }
     else if(dt ==BOOL) {
       bool v = it.value();
-      ostringstream val;
-      val  << v;
-      isd.addParam(key.str(),val.str());
+      isd.addParam(key,v ? "1" : "0");
     }
     else if (dt ==STRING) {
       string v = it.value();
-      ostringstream val;
-      val  << v;
-      isd.addParam(key.str(),val.str());
+      isd.addParam(key,v);
     }
     else if (dt ==NULL8) {
-      ostringstream val;
-      val  << "null";
-      isd.addParam(key.str(),val.str());
+      isd.addParam(key,"null");
     }
   }//end outer else
 }//end addParam
@@ -0,0 +1,276 @@
+#include "IsdWriter.h"
+
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+
+using namespace std;
+
+// The numbers of the binary format: the scalars, then the arrays and their sizes.
+static const int NUM_SCALARS = 17;
+static const int NUM_ARRAYS = 11;
+static const int ARRAY_SIZES[NUM_ARRAYS] = { 3, 3, 3, 3, 3, 3, 3, 9, 9, 15, 15 };
+static const size_t NUMBERS_SIZE = (NUM_SCALARS + 7 * 3 + 2 * 9 + 2 * 15) * sizeof(double);
+
+
+/**
+ * @brief Creates a writer with an empty buffer.
+ */
+IsdWriter::IsdWriter() : m_buffer(NULL, 4096), m_firstField(true) {
+}
+
+
+/**
+ * @brief Starts a JSON object.
+ */
+void IsdWriter::beginJSON() {
+  m_buffer.append("{\n");
+  m_firstField = true;
+}
+
+
+/**
+ * @brief Appends "key": value to the JSON object.
+ */
+void IsdWriter::field(const char *key, double value) {
+  this->key(key);
+  m_buffer.appendDouble(value);
+}
+
+
+/**
+ * @brief Appends "key": "text" to the JSON object.
+ */
+void IsdWriter::field(const char *key, const string &text) {
+  this->key(key);
+  appendText(text);
+}
+
+
+/**
+ * @brief Appends "key": [values] to the JSON object.
+ */
+void IsdWriter::field(const char *key, const double *values, int count) {
+  this->key(key);
+  m_buffer.append('[');
+  for (int i = 0; i < count; i++) {
+    if (i > 0) {
+      m_buffer.append(", ");
+    }
+    m_buffer.appendDouble(values[i]);
+  }
+  m_buffer.append(']');
+}
+
+
+/**
+ * @brief Ends the JSON object.
+ */
+void IsdWriter::endJSON() {
+  m_buffer.append("\n}\n");
+}
+
+
+/**
+ * @brief Appends a field's separator and key.
+ */
+void IsdWriter::key(const char *key) {
+  if (!m_firstField) {
+    m_buffer.append(",\n");
+  }
+  m_firstField = false;
+  m_buffer.append('"');
+  m_buffer.append(key);
+  m_buffer.append("\": ");
+}
+
+
+/**
+ * @brief Appends text as a JSON string, escaping quotes, backslashes and control characters.
+ */
+void IsdWriter::appendText(const string &text) {
+  m_buffer.append('"');
+  size_t start = 0;
+  for (size_t i = 0; i < text.size(); i++) {
+    unsigned char c = text[i];
+    if (c != '"' && c != '\\' && c >= 0x20) {
+      continue;
+    }
+    m_buffer.append(text.data() + start, i - start);
+    char escape[8];
+    if (c == '"' || c == '\\') {
+      snprintf(escape, sizeof(escape), "\\%c", c);
+    }
+    else {
+      snprintf(escape, sizeof(escape), "\\u%04x", c);
+    }
+    m_buffer.append(escape);
+    start = i + 1;
+  }
+  m_buffer.append(text.data() + start, text.size() - start);
+  m_buffer.append('"');
+}
+
+
+/**
+ * @brief Appends an ISD as a JSON object with the keywords MdisIsdView reads.
+ * @param isd  The ISD.
+ */
+void IsdWriter::appendJSON(const MdisIsd &isd) {
+  beginJSON();
+  field("instrument_id", isd.instrumentId);
+  field("spacecraft_name", isd.spacecraftName);
+  field("target_name", isd.targetName);
+  field("ephemeris_time", isd.ephemerisTime);
+  field("focal_length", isd.focalLength);
+  field("focal_length_epsilon", isd.focalLengthEpsilon);
+  field("pixel_pitch", isd.pixelPitch);
+  field("ccd_center", isd.ccdCenter);
+  field("ifov", isd.ifov);
+  field("nlines", isd.nLines);
+  field("nsamples", isd.nSamples);
+  field("original_half_lines", isd.originalHalfLines);
+  field("original_half_samples", isd.originalHalfSamples);
+  field("starting_detector_sample", isd.startingDetectorSample);
+  field("starting_detector_line", isd.startingDetectorLine);
+  field("boresight", isd.boresight, 3);
+  field("transx", isd.transX, 3);
+  field("transy", isd.transY, 3);
+  field("itrans_sample", isd.iTransS, 3);
+  field("itrans_line", isd.iTransL, 3);
+  field("odt_x", isd.odtX, 9);
+  field("odt_y", isd.odtY, 9);
+  field("semi_major_axis", isd.semiMajorAxis);
+  field("semi_minor_axis", isd.semiMinorAxis);
+  field("x_sensor_origin", isd.sensorPosition[0]);
+  field("y_sensor_origin", isd.sensorPosition[1]);
+  field("z_sensor_origin", isd.sensorPosition[2]);
+  field("omega", isd.omega);
+  field("phi", isd.phi);
+  field("kappa", isd.kappa);
+  field("sensor_position_coefficients", isd.sensorCoefficients, 15);
+  field("sun_position_coefficients", isd.sunCoefficients, 15);
+  field("sun_position", isd.sunPosition, 3);
+  endJSON();
+}
+
+
+/**
+ * @brief Appends an ISD in the binary format: its strings, each as a uint32 length and the
+ * text, then its scalars and its arrays as native doubles.
+ * @param isd  The ISD.
+ */
+void IsdWriter::appendBinary(const MdisIsd &isd) {
+  const string *strings[] = { &isd.instrumentId, &isd.spacecraftName, &isd.targetName };
+  for (int i = 0; i < 3; i++) {
+    uint32_t length = strings[i]->size();
+    m_buffer.append(reinterpret_cast<const char *>(&length), 4);
+    m_buffer.append(*strings[i]);
+  }
+  const double scalars[NUM_SCALARS] = {
+    isd.ephemerisTime, isd.focalLength, isd.focalLengthEpsilon, isd.pixelPitch,
+    isd.ccdCenter, isd.ifov, double(isd.nLines), double(isd.nSamples), isd.originalHalfLines,
+    isd.originalHalfSamples, isd.startingDetectorSample, isd.startingDetectorLine,
+    isd.semiMajorAxis, isd.semiMinorAxis, isd.omega, isd.phi, isd.kappa
+  };
+  m_buffer.append(reinterpret_cast<const char *>(scalars), sizeof(scalars));
+  const double *arrays[NUM_ARRAYS] = {
+    isd.boresight, isd.transX, isd.transY, isd.iTransS, isd.iTransL, isd.sensorPosition,
+    isd.sunPosition, isd.odtX, isd.odtY, isd.sensorCoefficients, isd.sunCoefficients
+  };
+  for (int i = 0; i < NUM_ARRAYS; i++) {
+    m_buffer.append(reinterpret_cast<const char *>(arrays[i]), ARRAY_SIZES[i] * sizeof(double));
+  }
+}
+
+
+/**
+ * @brief Reads an ISD written by appendBinary().
+ * @param bytes  The binary ISD.
+ * @param size  The size of the binary ISD.
+ * @param isd  Receives the ISD.
+ * @return false if the binary ISD is truncated or too long.
+ */
+bool IsdWriter::readBinary(const char *bytes, size_t size, MdisIsd &isd) {
+  const char *end = bytes + size;
+  string *strings[] = { &isd.instrumentId, &isd.spacecraftName, &isd.targetName };
+  for (int i = 0; i < 3; i++) {
+    uint32_t length;
+    if (end - bytes < 4) {
+      return false;
+    }
+    memcpy(&length, bytes, 4);
+    bytes += 4;
+    if ((size_t)(end - bytes) < length) {
+      return false;
+    }
+    strings[i]->assign(bytes, length);
+    bytes += length;
+  }
+  if ((size_t)(end - bytes) != NUMBERS_SIZE) {
+    return false;
+  }
+
+  double scalars[NUM_SCALARS];
+  memcpy(scalars, bytes, sizeof(scalars));
+  bytes += sizeof(scalars);
+  double *values[NUM_SCALARS] = {
+    &isd.ephemerisTime, &isd.focalLength, &isd.focalLengthEpsilon, &isd.pixelPitch,
+    &isd.ccdCenter, &isd.ifov, NULL, NULL, &isd.originalHalfLines, &isd.originalHalfSamples,
+    &isd.startingDetectorSample, &isd.startingDetectorLine, &isd.semiMajorAxis,
+    &isd.semiMinorAxis, &isd.omega, &isd.phi, &isd.kappa
+  };
+  for (int i = 0; i < NUM_SCALARS; i++) {
+    if (values[i] != NULL) {
+      *values[i] = scalars[i];
+    }
+  }
+  isd.nLines = (int)scalars[6];
+  isd.nSamples = (int)scalars[7];
+
+  double *arrays[NUM_ARRAYS] = {
+    isd.boresight, isd.transX, isd.transY, isd.iTransS, isd.iTransL, isd.sensorPosition,
+    isd.sunPosition, isd.odtX, isd.odtY, isd.sensorCoefficients, isd.sunCoefficients
+  };
+  for (int i = 0; i < NUM_ARRAYS; i++) {
+    size_t count = ARRAY_SIZES[i] * sizeof(double);
+    memcpy(arrays[i], bytes, count);
+    bytes += count;
+  }
+  return true;
+}
+
+
+/**
+ * @brief Writes the buffer to a file with a single write.
+ * @param filePath  The path name of the output file.
+ * @return false if the file could not be written.
+ */
+bool IsdWriter::write(const string &filePath) const {
+  FILE *os = fopen(filePath.c_str(), "wb");
+  if (os == NULL) {
+    perror(("error while opening file " + filePath).c_str());
+    return false;
+  }
+  bool ok = fwrite(data(), 1, size(), os) == size();
+  if (fclose(os) != 0) {
+    ok = false;
+  }
+  if (!ok) {
+    perror(("error while writing file " + filePath).c_str());
+  }
+  return ok;
+}
+
+
+/**
+ * @brief Writes an ISD to a file as JSON, replacing what the buffer held.
+ * @param isd  The ISD.
+ * @param filePath  The path name of the output file.
+ * @return false if the file could not be written.
+ */
+bool IsdWriter::writeJSON(const MdisIsd &isd, const string &filePath) {
+  clear();
+  appendJSON(isd);
+  return write(filePath);
+}
@@ -0,0 +1,165 @@
+#include "MdisIsdView.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+
+#include <csm/Isd.h>
+
+// Keyword table.  Must stay sorted by name (the constructor merges it against the sorted
+// ISD multimap) and slots must be contiguous.
+const MdisIsdView::KeywordInfo MdisIsdView::s_keywords[MdisIsdView::NUM_KEYWORDS] = {
+  { "boresight",                     0,  3, false },
+  { "ccd_center",                    3,  1, false },
+  { "ephemeris_time",                4,  1, false },
+  { "focal_length",                  5,  1, false },
+  { "focal_length_epsilon",          6,  1, false },
+  { "ifov",                          7,  1, false },
+  { "instrument_id",                 8,  1, true  },
+  { "itrans_line",                   9,  3, false },
+  { "itrans_sample",                12,  3, false },
+  { "kappa",                        15,  1, false },
+  { "nlines",                       16,  1, false },
+  { "nsamples",                     17,  1, false },
+  { "odt_x",                        18,  9, false },
+  { "odt_y",                        27,  9, false },
+  { "omega",                        36,  1, false },
+  { "original_half_lines",          37,  1, false },
+  { "original_half_samples",        38,  1, false },
+  { "phi",                          39,  1, false },
+  { "pixel_pitch",                  40,  1, false },
+  { "semi_major_axis",              41,  1, false },
+  { "semi_minor_axis",              42,  1, false },
+  { "sensor_position_coefficients", 43, 15, false },
+  { "spacecraft_name",              58,  1, true  },
+  { "starting_detector_line",       59,  1, false },
+  { "starting_detector_sample",     60,  1, false },
+  { "sun_position",                 61,  3, false },
+  { "sun_position_coefficients",    64, 15, false },
+  { "target_name",                  79,  1, true  },
+  { "transx",                       80,  3, false },
+  { "transy",                       83,  3, false },
+  { "x_sensor_origin",              86,  1, false },
+  { "y_sensor_origin",              87,  1, false },
+  { "z_sensor_origin",              88,  1, false }
+};
+
+// Keywords a sensor model cannot be constructed without, in the order they are reported.
+const MdisIsdView::RequiredKeyword MdisIsdView::s_requiredKeywords[] = {
+  { INSTRUMENT_ID,   "instrument_id" },
+  { FOCAL_LENGTH,    "focal_length" },
+  { X_SENSOR_ORIGIN, "x_sensor_origin" },
+  { Y_SENSOR_ORIGIN, "y_sensor_origin" },
+  { Z_SENSOR_ORIGIN, "z_sensor_origin" },
+  { OMEGA,           "omega" },
+  { PHI,             "phi" },
+  { KAPPA,           "kappa" },
+  { ITRANS_SAMPLE,   "itrans_sample needs 3 elements" },
+  { EPHEMERIS_TIME,  "ephemeris_time" },
+  { ITRANS_LINE,     "itrans_line needs 3 elements" },
+  { NLINES,          "nlines" },
+  { NSAMPLES,        "nsamples" },
+  { TRANSY,          "transy" },
+  { TRANSX,          "transx" },
+  { SEMI_MAJOR_AXIS, "semi_major_axis" }
+};
+
+
+/**
+ * @brief Resolves every MDIS keyword of an ISD in a single pass.
+ *
+ * The ISD's multimap is ordered by keyword and, for repeated keywords, by insertion order,
+ * so walking it alongside the sorted keyword table visits each array element in index
+ * order.  Values are converted with atof exactly once.
+ *
+ * @param isd The ISD to index.
+ */
+MdisIsdView::MdisIsdView(const csm::Isd &isd) {
+  std::fill(m_values, m_values + NUM_SLOTS, 0.0);
+  std::fill(m_counts, m_counts + NUM_KEYWORDS, 0);
+
+  const std::multimap<std::string, std::string> &params = isd.parameters();
+  std::multimap<std::string, std::string>::const_iterator it = params.begin();
+  int k = 0;
+  int element = 0;
+
+  while (it != params.end() && k < NUM_KEYWORDS) {
+    const KeywordInfo &info = s_keywords[k];
+    int cmp = it->first.compare(info.name);
+
+    // Not an MDIS keyword.
+    if (cmp < 0) {
+      ++it;
+      continue;
+    }
+
+    // Done with this keyword; move to the next one in the table.
+    if (cmp > 0) {
+      k++;
+      element = 0;
+      continue;
+    }
+
+    if (element < info.size) {
+      const std::string &text = it->second;
+      if (!text.empty()) {
+        m_values[info.slot + element] = atof(text.c_str());
+        m_counts[k]++;
+      }
+      if (element == 0 && info.isText) {
+        m_text[k] = text;
+      }
+    }
+    element++;
+    ++it;
+  }
+
+  int numRequired = sizeof(s_requiredKeywords) / sizeof(s_requiredKeywords[0]);
+  for (int i = 0; i < numRequired; i++) {
+    if (!has(s_requiredKeywords[i].keyword)) {
+      m_missingKeywords.push_back(s_requiredKeywords[i].message);
+    }
+  }
+}
+
+
+/**
+ * @brief Returns the ISD name of a keyword.
+ */
+const char *MdisIsdView::keywordName(Keyword keyword) {
+  return s_keywords[keyword].name;
+}
+
+
+/**
+ * @brief Returns the number of elements of a keyword (e.g. 9 for odt_x).
+ */
+int MdisIsdView::keywordSize(Keyword keyword) {
+  return s_keywords[keyword].size;
+}
+
+
+/**
+ * @brief Looks up a keyword by its ISD name.
+ * @return The keyword, or NUM_KEYWORDS if the name is not an MDIS keyword.
+ */
+MdisIsdView::Keyword MdisIsdView::findKeyword(const std::string &name) {
+  int low = 0;
+  int high = NUM_KEYWORDS;
+  while (low < high) {
+    int mid = (low + high) / 2;
+    int cmp = name.compare(s_keywords[mid].name);
+    if (cmp == 0) {
+      return static_cast<Keyword>(mid);
+    }
+    if (cmp > 0) {
+      low = mid + 1;
+    }
+    else {
+      high = mid;
+    }
+  }
+  return NUM_KEYWORDS;
+}
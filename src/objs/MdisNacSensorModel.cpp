@@ -1,10 +1,13 @@
 #include "MdisNacSensorModel.h"
 
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
 
 #include <csm/Error.h>
 
+#include <transformations.h>
+
 using namespace std;
 
 const std::string MdisNacSensorModel::_SENSOR_MODEL_NAME 
@@ -32,6 +35,15 @@ MdisNacSensorModel::MdisNacSensorModel() {
   m_spacecraftPosition[0] = 0.0;
   m_spacecraftPosition[1] = 0.0;
   m_spacecraftPosition[2] = 0.0;
+
+  m_sunPosition[0] = 0.0;
+  m_sunPosition[1] = 0.0;
+  m_sunPosition[2] = 0.0;
+  m_hasSunPosition = false;
+  std::fill(m_sensorCoefficients, m_sensorCoefficients + 3 * STATE_TERMS, 0.0);
+  m_hasSensorCoefficients = false;
+  std::fill(m_sunCoefficients, m_sunCoefficients + 3 * STATE_TERMS, 0.0);
+  m_hasSunCoefficients = false;
   
   m_ccdCenter = 0.0;
 
@@ -361,26 +373,9 @@ csm::EcefCoord MdisNacSensorModel::imageToGround(const csm::ImageCoord &imagePt,
 
   setFocalPlane(focalPlaneX, focalPlaneY, undistortedFocalPlaneX, undistortedFocalPlaneY);
 
-  // Trigonometric functions for rotation matrix
-  const double sinw = std::sin(m_omega);
-  const double sinp = std::sin(m_phi);
-  const double sink = std::sin(m_kappa);
-  const double cosw = std::cos(m_omega);
-  const double cosp = std::cos(m_phi);
-  const double cosk = std::cos(m_kappa);
-
   // Rotation matrix taken from Introduction to Mordern Photogrammetry by 
   // Edward M. Mikhail, et al., p. 373
-  std::vector<double> m(9);
-  m[0] = cosp * cosk;
-  m[1] = cosw * sink + sinw * sinp * cosk;
-  m[2] = sinw * sink - cosw * sinp * cosk;
-  m[3] = -1 * cosp * sink;
-  m[4] = cosw * cosk - sinw * sinp * sink;
-  m[5] = sinw * cosk + cosw * sinp * sink;
-  m[6] = sinp;
-  m[7] = -1 * sinw * cosp;
-  m[8] = cosw * cosp;
+  std::vector<double> m = createRotationMatrix(m_omega, m_phi, m_kappa);
   
   // Multiply the focal vector to the rotation matrix to get the direction of the camera
   std::vector<double> direction(3);
@@ -603,25 +598,9 @@ std::vector<double> MdisNacSensorModel::normalize(const std::vector<double> &v)
 std::vector<double> MdisNacSensorModel::createRotationMatrix(const double omega,
                                                              const double phi,
                                                              const double kappa) const {
-  // Trigonometric functions for rotation matrix
-  const double sinw = std::sin(omega);
-  const double sinp = std::sin(phi);
-  const double sink = std::sin(kappa);
-  const double cosw = std::cos(omega);
-  const double cosp = std::cos(phi);
-  const double cosk = std::cos(kappa);
-  
+  const double opk[3] = { omega, phi, kappa };
   std::vector<double> m(9);
-  m[0] = cosp * cosk;
-  m[1] = cosw * sink + sinw * sinp * cosk;
-  m[2] = sinw * sink - cosw * sinp * cosk;
-  m[3] = -1 * cosp * sink;
-  m[4] = cosw * cosk - sinw * sinp * sink;
-  m[5] = sinw * cosk + cosw * sinp * sink;
-  m[6] = sinp;
-  m[7] = -1 * sinw * cosp;
-  m[8] = cosw * cosp;
-  
+  opkToRotation(opk, 1, &m[0]);
   return m;
 }
 
@@ -684,10 +663,7 @@ csm::ImageCoord MdisNacSensorModel::getImageStart() const {
 }
 
 csm::ImageVector MdisNacSensorModel::getImageSize() const {
-
-    throw csm::Error(csm::Error::UNSUPPORTED_FUNCTION,
-      "Unsupported function",
-      "MdisNacSensorModel::getImageSize");
+  return csm::ImageVector(m_nLines, m_nSamples);
 }
 
 std::pair<csm::ImageCoord, csm::ImageCoord> MdisNacSensorModel::getValidImageRange() const {
@@ -704,46 +680,160 @@ std::pair<double, double> MdisNacSensorModel::getValidHeightRange() const {
       "MdisNacSensorModel::getValidHeightRange");
 }
 
+/**
+ * @brief Returns the unit vector from the sun to a ground point.
+ *
+ * A frame is exposed at one instant, so the sun's position at the ephemeris time is used
+ * for every ground point of the image.
+ *
+ * @param groundPt Ground point in body-fixed meters.
+ *
+ * @return @b csm::EcefVector The direction light travels to the ground point.
+ */
 csm::EcefVector MdisNacSensorModel::getIlluminationDirection(const csm::EcefCoord &groundPt) const {
-
+  if (!m_hasSunPosition) {
     throw csm::Error(csm::Error::UNSUPPORTED_FUNCTION,
-      "Unsupported function",
+      "The ISD does not have a sun_position",
       "MdisNacSensorModel::getIlluminationDirection");
+  }
+
+  std::vector<double> direction(3);
+  direction[0] = groundPt.x - m_sunPosition[0];
+  direction[1] = groundPt.y - m_sunPosition[1];
+  direction[2] = groundPt.z - m_sunPosition[2];
+  direction = normalize(direction);
+  return csm::EcefVector(direction[0], direction[1], direction[2]);
 }
 
+/**
+ * @brief Returns the time a pixel was exposed, in seconds relative to the ephemeris time.
+ *
+ * Every pixel of a frame is exposed at the ephemeris time, so this is always 0.
+ */
 double MdisNacSensorModel::getImageTime(const csm::ImageCoord &imagePt) const {
-
-    throw csm::Error(csm::Error::UNSUPPORTED_FUNCTION,
-      "Unsupported function",
-      "MdisNacSensorModel::getImageTime");
+  return 0.0;
 }
 
+/**
+ * @brief Returns the position of the sensor, which is the same for every pixel of a frame.
+ */
 csm::EcefCoord MdisNacSensorModel::getSensorPosition(const csm::ImageCoord &imagePt) const {
-
-    throw csm::Error(csm::Error::UNSUPPORTED_FUNCTION,
-      "Unsupported function",
-      "MdisNacSensorModel::getSensorPosition");
+  return csm::EcefCoord(m_spacecraftPosition[0], m_spacecraftPosition[1],
+                        m_spacecraftPosition[2]);
 }
 
+/**
+ * @brief Returns the position of the sensor at a time.
+ *
+ * The ISD's sensor_position_coefficients are evaluated if it has them; otherwise the
+ * position at the ephemeris time is returned for every time.
+ *
+ * @param time Seconds relative to the ephemeris time.
+ *
+ * @return @b csm::EcefCoord The sensor position in body-fixed meters.
+ */
 csm::EcefCoord MdisNacSensorModel::getSensorPosition(double time) const {
+  if (!m_hasSensorCoefficients) {
+    return csm::EcefCoord(m_spacecraftPosition[0], m_spacecraftPosition[1],
+                          m_spacecraftPosition[2]);
+  }
+  double position[3];
+  evaluateState(m_sensorCoefficients, time, position, NULL);
+  return csm::EcefCoord(position[0], position[1], position[2]);
+}
 
-    throw csm::Error(csm::Error::UNSUPPORTED_FUNCTION,
-      "Unsupported function",
-      "MdisNacSensorModel::getSensorPosition");
+
+double MdisNacSensorModel::getPixelResolution(const csm::EcefCoord &groundPt) const {
+  std::vector<double> range(3);
+  range[0] = groundPt.x - m_spacecraftPosition[0];
+  range[1] = groundPt.y - m_spacecraftPosition[1];
+  range[2] = groundPt.z - m_spacecraftPosition[2];
+  return magnitude(range) * m_pixelPitch / m_focalLength;
 }
 
+/**
+ * @brief Returns the velocity of the sensor when a pixel was exposed.
+ */
 csm::EcefVector MdisNacSensorModel::getSensorVelocity(const csm::ImageCoord &imagePt) const {
+  return getSensorVelocity(getImageTime(imagePt));
+}
 
+/**
+ * @brief Returns the velocity of the sensor at a time, from the derivative of the ISD's
+ * sensor_position_coefficients.
+ *
+ * @param time Seconds relative to the ephemeris time.
+ *
+ * @return @b csm::EcefVector The sensor velocity in body-fixed meters per second.
+ */
+csm::EcefVector MdisNacSensorModel::getSensorVelocity(double time) const {
+  if (!m_hasSensorCoefficients) {
     throw csm::Error(csm::Error::UNSUPPORTED_FUNCTION,
-      "Unsupported function",
+      "The ISD does not have sensor_position_coefficients",
       "MdisNacSensorModel::getSensorVelocity");
+  }
+  double position[3], velocity[3];
+  evaluateState(m_sensorCoefficients, time, position, velocity);
+  return csm::EcefVector(velocity[0], velocity[1], velocity[2]);
 }
 
-csm::EcefVector MdisNacSensorModel::getSensorVelocity(double time) const {
-
+/**
+ * @brief Returns the position of the sun at a time.
+ *
+ * The ISD's sun_position_coefficients are evaluated if it has them; otherwise its
+ * sun_position is returned for every time.
+ *
+ * @param time Seconds relative to the ephemeris time.
+ *
+ * @return @b csm::EcefCoord The sun position in body-fixed meters.
+ */
+csm::EcefCoord MdisNacSensorModel::getSunPosition(double time) const {
+  if (!m_hasSunPosition) {
     throw csm::Error(csm::Error::UNSUPPORTED_FUNCTION,
-      "Unsupported function",
-      "MdisNacSensorModel::getSensorVelocity");
+      "The ISD does not have a sun_position",
+      "MdisNacSensorModel::getSunPosition");
+  }
+  if (!m_hasSunCoefficients) {
+    return csm::EcefCoord(m_sunPosition[0], m_sunPosition[1], m_sunPosition[2]);
+  }
+  double position[3];
+  evaluateState(m_sunCoefficients, time, position, NULL);
+  return csm::EcefCoord(position[0], position[1], position[2]);
+}
+
+/**
+ * @brief Returns the target's equatorial radius.
+ *
+ * @return @b double The semi-major axis in meters.
+ */
+double MdisNacSensorModel::getSemiMajorAxis() const {
+  return m_majorAxis;
+}
+
+/**
+ * @brief Returns the target's polar radius.
+ *
+ * @return @b double The semi-minor axis in meters.
+ */
+double MdisNacSensorModel::getSemiMinorAxis() const {
+  return m_minorAxis;
+}
+
+void MdisNacSensorModel::evaluateState(const double *coefficients, double time,
+                                       double *values, double *rates) const {
+  for (int axis = 0; axis < 3; axis++) {
+    const double *c = coefficients + axis * STATE_TERMS;
+    double value = c[STATE_TERMS - 1];
+    double rate = 0.0;
+    for (int i = STATE_TERMS - 2; i >= 0; i--) {
+      rate = rate * time + value;
+      value = value * time + c[i];
+    }
+    values[axis] = value;
+    if (rates != NULL) {
+      rates[axis] = rate;
+    }
+  }
 }
 
 csm::RasterGM::SensorPartials MdisNacSensorModel::computeSensorPartials(int index, const csm::EcefCoord &groundPt, 
@@ -8,6 +8,7 @@
 #include <csm/Plugin.h>
 #include <csm/Warning.h>
 
+#include "MdisIsdView.h"
 #include "MdisNacSensorModel.h"
 
 // Create static instance of self for plugin registration to work with csm::Plugin
@@ -99,190 +100,108 @@ csm::Model *MdisPlugin::constructModelFromISD(const csm::Isd &imageSupportData,
                      "MdisPlugin::constructModelFromISD");
   }
 
-  MdisNacSensorModel *sensorModel = new MdisNacSensorModel();
+  // Resolve every keyword of the ISD in one pass.
+  MdisIsdView isd(imageSupportData);
+
+  // If we are missing necessary keywords from ISD, we cannot create a valid sensor model.
+  const std::vector<std::string> &missingKeywords = isd.missingKeywords();
+  if (missingKeywords.size() != 0) {
+
+    std::string errorMessage = "ISD is missing the necessary keywords: [";
   
-  // Keep track of necessary keywords that are missing from the ISD.
-  std::vector<std::string> missingKeywords;
+    for (int i = 0; i < missingKeywords.size(); i++) {
+      if (i == missingKeywords.size() - 1) {
+        errorMessage += missingKeywords[i] + "]";
+      }
+      else {
+        errorMessage += missingKeywords[i] + ", ";
+      }
+    }
+    
+    throw csm::Error(csm::Error::SENSOR_MODEL_NOT_CONSTRUCTIBLE,
+                     errorMessage,
+                     "MdisPlugin::constructModelFromISD");
+  }
 
-  sensorModel->m_startingDetectorSample =
-      atof(imageSupportData.param("starting_detector_sample").c_str());
-  sensorModel->m_startingDetectorLine =
-      atof(imageSupportData.param("starting_detector_line").c_str());
+  MdisNacSensorModel *sensorModel = new MdisNacSensorModel();
 
-  sensorModel->m_targetName = imageSupportData.param("target_name");
+  sensorModel->m_startingDetectorSample = isd.value(MdisIsdView::STARTING_DETECTOR_SAMPLE);
+  sensorModel->m_startingDetectorLine = isd.value(MdisIsdView::STARTING_DETECTOR_LINE);
 
-  sensorModel->m_ifov = atof(imageSupportData.param("ifov").c_str());
+  sensorModel->m_targetName = isd.text(MdisIsdView::TARGET_NAME);
 
-  sensorModel->m_instrumentID = imageSupportData.param("instrument_id");
-  if (imageSupportData.param("instrument_id") == "") {
-    missingKeywords.push_back("instrument_id");
-  }
+  sensorModel->m_ifov = isd.value(MdisIsdView::IFOV);
 
-  sensorModel->m_focalLength = atof(imageSupportData.param("focal_length").c_str());
-  if (imageSupportData.param("focal_length") == "") {
-    missingKeywords.push_back("focal_length");
-  }
-  sensorModel->m_focalLengthEpsilon =
-      atof(imageSupportData.param("focal_length_epsilon").c_str());
-
-  sensorModel->m_spacecraftPosition[0] =
-      atof(imageSupportData.param("x_sensor_origin").c_str());
-  sensorModel->m_spacecraftPosition[1] =
-      atof(imageSupportData.param("y_sensor_origin").c_str());
-  sensorModel->m_spacecraftPosition[2] =
-      atof(imageSupportData.param("z_sensor_origin").c_str());
-  if (imageSupportData.param("x_sensor_origin") == "") {
-    missingKeywords.push_back("x_sensor_origin");
-  }
-  if (imageSupportData.param("y_sensor_origin") == "") {
-    missingKeywords.push_back("y_sensor_origin");
-  }
-  if (imageSupportData.param("z_sensor_origin") == "") {
-    missingKeywords.push_back("z_sensor_origin");
-  }
-  
-  sensorModel->m_omega = atof(imageSupportData.param("omega").c_str());
-  sensorModel->m_phi = atof(imageSupportData.param("phi").c_str());
-  sensorModel->m_kappa = atof(imageSupportData.param("kappa").c_str());
-  if (imageSupportData.param("omega") == "") {
-    missingKeywords.push_back("omega");
-  }
-  if (imageSupportData.param("phi") == "") {
-    missingKeywords.push_back("phi");
-  }
-  if (imageSupportData.param("kappa") == "") {
-    missingKeywords.push_back("kappa");
-  }
+  sensorModel->m_instrumentID = isd.text(MdisIsdView::INSTRUMENT_ID);
 
-  sensorModel->m_odtX[0] = atof(imageSupportData.param("odt_x", 0).c_str());
-  sensorModel->m_odtX[1] = atof(imageSupportData.param("odt_x", 1).c_str());
-  sensorModel->m_odtX[2] = atof(imageSupportData.param("odt_x", 2).c_str());
-  sensorModel->m_odtX[3] = atof(imageSupportData.param("odt_x", 3).c_str());
-  sensorModel->m_odtX[4] = atof(imageSupportData.param("odt_x", 4).c_str());
-  sensorModel->m_odtX[5] = atof(imageSupportData.param("odt_x", 5).c_str());
-  sensorModel->m_odtX[6] = atof(imageSupportData.param("odt_x", 6).c_str());
-  sensorModel->m_odtX[7] = atof(imageSupportData.param("odt_x", 7).c_str());
-  sensorModel->m_odtX[8] = atof(imageSupportData.param("odt_x", 8).c_str());
-
-  sensorModel->m_odtY[0] = atof(imageSupportData.param("odt_y", 0).c_str());
-  sensorModel->m_odtY[1] = atof(imageSupportData.param("odt_y", 1).c_str());
-  sensorModel->m_odtY[2] = atof(imageSupportData.param("odt_y", 2).c_str());
-  sensorModel->m_odtY[3] = atof(imageSupportData.param("odt_y", 3).c_str());
-  sensorModel->m_odtY[4] = atof(imageSupportData.param("odt_y", 4).c_str());
-  sensorModel->m_odtY[5] = atof(imageSupportData.param("odt_y", 5).c_str());
-  sensorModel->m_odtY[6] = atof(imageSupportData.param("odt_y", 6).c_str());
-  sensorModel->m_odtY[7] = atof(imageSupportData.param("odt_y", 7).c_str());
-  sensorModel->m_odtY[8] = atof(imageSupportData.param("odt_y", 8).c_str());
-
-  sensorModel->m_ccdCenter = atof(imageSupportData.param("ccd_center").c_str());
-
-  sensorModel->m_originalHalfLines = atof(imageSupportData.param("original_half_lines").c_str());
-  sensorModel->m_spacecraftName = imageSupportData.param("spacecraft_name");
-
-  sensorModel->m_pixelPitch = atof(imageSupportData.param("pixel_pitch").c_str());
-
-  sensorModel->m_iTransS[0] = atof(imageSupportData.param("itrans_sample", 0).c_str());
-  sensorModel->m_iTransS[1] = atof(imageSupportData.param("itrans_sample", 1).c_str());
-  sensorModel->m_iTransS[2] = atof(imageSupportData.param("itrans_sample", 2).c_str());
-  if (imageSupportData.param("itrans_sample", 0) == "") {
-    missingKeywords.push_back("itrans_sample needs 3 elements");
+  sensorModel->m_focalLength = isd.value(MdisIsdView::FOCAL_LENGTH);
+  sensorModel->m_focalLengthEpsilon = isd.value(MdisIsdView::FOCAL_LENGTH_EPSILON);
+
+  sensorModel->m_spacecraftPosition[0] = isd.value(MdisIsdView::X_SENSOR_ORIGIN);
+  sensorModel->m_spacecraftPosition[1] = isd.value(MdisIsdView::Y_SENSOR_ORIGIN);
+  sensorModel->m_spacecraftPosition[2] = isd.value(MdisIsdView::Z_SENSOR_ORIGIN);
+
+  // The sun position is optional; only getIlluminationDirection needs it.
+  sensorModel->m_hasSunPosition = isd.has(MdisIsdView::SUN_POSITION);
+  for (int i = 0; i < 3; i++) {
+    sensorModel->m_sunPosition[i] = isd.value(MdisIsdView::SUN_POSITION, i);
   }
-  else if (imageSupportData.param("itrans_sample", 1) == "") {
-    missingKeywords.push_back("itrans_sample needs 3 elements");
+
+  // So are the position polynomials around the ephemeris time; without them the sensor
+  // and sun stand still.
+  sensorModel->m_hasSensorCoefficients = isd.has(MdisIsdView::SENSOR_POSITION_COEFFICIENTS);
+  sensorModel->m_hasSunCoefficients = isd.has(MdisIsdView::SUN_POSITION_COEFFICIENTS);
+  for (int i = 0; i < 3 * MdisNacSensorModel::STATE_TERMS; i++) {
+    sensorModel->m_sensorCoefficients[i] =
+        isd.value(MdisIsdView::SENSOR_POSITION_COEFFICIENTS, i);
+    sensorModel->m_sunCoefficients[i] = isd.value(MdisIsdView::SUN_POSITION_COEFFICIENTS, i);
   }
-  else if (imageSupportData.param("itrans_sample", 2) == "") {
-    missingKeywords.push_back("itrans_sample needs 3 elements");
+  if (sensorModel->m_hasSunCoefficients && !sensorModel->m_hasSunPosition) {
+    sensorModel->m_hasSunPosition = true;
+    for (int i = 0; i < 3; i++) {
+      sensorModel->m_sunPosition[i] =
+          sensorModel->m_sunCoefficients[i * MdisNacSensorModel::STATE_TERMS];
+    }
   }
-  
-  sensorModel->m_ephemerisTime = atof(imageSupportData.param("ephemeris_time").c_str());
-  if (imageSupportData.param("ephemeris_time") == "") {
-    missingKeywords.push_back("ephemeris_time");
+
+  sensorModel->m_omega = isd.value(MdisIsdView::OMEGA);
+  sensorModel->m_phi = isd.value(MdisIsdView::PHI);
+  sensorModel->m_kappa = isd.value(MdisIsdView::KAPPA);
+
+  for (int i = 0; i < 9; i++) {
+    sensorModel->m_odtX[i] = isd.value(MdisIsdView::ODT_X, i);
+    sensorModel->m_odtY[i] = isd.value(MdisIsdView::ODT_Y, i);
   }
 
-  sensorModel->m_originalHalfSamples =
-      atof(imageSupportData.param("original_half_samples").c_str());
+  sensorModel->m_ccdCenter = isd.value(MdisIsdView::CCD_CENTER);
 
-  sensorModel->m_boresight[0] = atof(imageSupportData.param("boresight", 0).c_str());
-  sensorModel->m_boresight[1] = atof(imageSupportData.param("boresight", 1).c_str());
-  sensorModel->m_boresight[2] = atof(imageSupportData.param("boresight", 2).c_str());
+  sensorModel->m_originalHalfLines = isd.value(MdisIsdView::ORIGINAL_HALF_LINES);
+  sensorModel->m_spacecraftName = isd.text(MdisIsdView::SPACECRAFT_NAME);
 
-  sensorModel->m_iTransL[0] = atof(imageSupportData.param("itrans_line", 0).c_str());
-  sensorModel->m_iTransL[1] = atof(imageSupportData.param("itrans_line", 1).c_str());
-  sensorModel->m_iTransL[2] = atof(imageSupportData.param("itrans_line", 2).c_str());
-  if (imageSupportData.param("itrans_line", 0) == "") {
-    missingKeywords.push_back("itrans_line needs 3 elements");
-  }
-  else if (imageSupportData.param("itrans_line", 1) == "") {
-    missingKeywords.push_back("itrans_line needs 3 elements");
-  }
-  else if (imageSupportData.param("itrans_line", 2) == "") {
-    missingKeywords.push_back("itrans_line needs 3 elements");
-  }
-  
-  sensorModel->m_nLines = atoi(imageSupportData.param("nlines").c_str());
-  sensorModel->m_nSamples = atoi(imageSupportData.param("nsamples").c_str());
-  if (imageSupportData.param("nlines") == "") {
-    missingKeywords.push_back("nlines");
-  }
-  if (imageSupportData.param("nsamples") == "") {
-    missingKeywords.push_back("nsamples");
-  }
-  
-  sensorModel->m_transY[0] = atof(imageSupportData.param("transy", 0).c_str());
-  sensorModel->m_transY[1] = atof(imageSupportData.param("transy", 1).c_str());
-  sensorModel->m_transY[2] = atof(imageSupportData.param("transy", 2).c_str());
-  if (imageSupportData.param("transy", 0) == "") {
-    missingKeywords.push_back("transy");
-  }
-  else if (imageSupportData.param("transy", 1) == "") {
-    missingKeywords.push_back("transy");
-  }
-  else if (imageSupportData.param("transy", 2) == "") {
-    missingKeywords.push_back("transy");
-  }
-  
-  sensorModel->m_transX[0] = atof(imageSupportData.param("transx", 0).c_str());
-  sensorModel->m_transX[1] = atof(imageSupportData.param("transx", 1).c_str());
-  sensorModel->m_transX[2] = atof(imageSupportData.param("transx", 2).c_str());
-  if (imageSupportData.param("transx", 0) == "") {
-    missingKeywords.push_back("transx");
-  }
-  else if (imageSupportData.param("transx", 1) == "") {
-    missingKeywords.push_back("transx");
-  }
-  else if (imageSupportData.param("transx", 2) == "") {
-    missingKeywords.push_back("transx");
-  }
-  
-  sensorModel->m_majorAxis = 1000 * atof(imageSupportData.param("semi_major_axis").c_str());
-  if (imageSupportData.param("semi_major_axis") == "") {
-    missingKeywords.push_back("semi_major_axis");
+  sensorModel->m_pixelPitch = isd.value(MdisIsdView::PIXEL_PITCH);
+
+  sensorModel->m_ephemerisTime = isd.value(MdisIsdView::EPHEMERIS_TIME);
+
+  sensorModel->m_originalHalfSamples = isd.value(MdisIsdView::ORIGINAL_HALF_SAMPLES);
+
+  for (int i = 0; i < 3; i++) {
+    sensorModel->m_iTransS[i] = isd.value(MdisIsdView::ITRANS_SAMPLE, i);
+    sensorModel->m_iTransL[i] = isd.value(MdisIsdView::ITRANS_LINE, i);
+    sensorModel->m_boresight[i] = isd.value(MdisIsdView::BORESIGHT, i);
+    sensorModel->m_transX[i] = isd.value(MdisIsdView::TRANSX, i);
+    sensorModel->m_transY[i] = isd.value(MdisIsdView::TRANSY, i);
   }
+
+  sensorModel->m_nLines = static_cast<int>(isd.value(MdisIsdView::NLINES));
+  sensorModel->m_nSamples = static_cast<int>(isd.value(MdisIsdView::NSAMPLES));
+
+  sensorModel->m_majorAxis = 1000 * isd.value(MdisIsdView::SEMI_MAJOR_AXIS);
   // Do we assume that if we do not have a semi-minor axis, then the body is a sphere?
-  if (imageSupportData.param("semi_minor_axis") == "") {
+  if (!isd.has(MdisIsdView::SEMI_MINOR_AXIS)) {
     sensorModel->m_minorAxis = sensorModel->m_majorAxis;
   }
   else {
-    sensorModel->m_minorAxis = 1000 * atof(imageSupportData.param("semi_minor_axis").c_str());
-  }
-  
-  // If we are missing necessary keywords from ISD, we cannot create a valid sensor model.
-  if (missingKeywords.size() != 0) {
-
-    std::string errorMessage = "ISD is missing the necessary keywords: [";
-  
-    for (int i = 0; i < missingKeywords.size(); i++) {
-      if (i == missingKeywords.size() - 1) {
-        errorMessage += missingKeywords[i] + "]";
-      }
-      else {
-        errorMessage += missingKeywords[i] + ", ";
-      }
-    }
-    
-    throw csm::Error(csm::Error::SENSOR_MODEL_NOT_CONSTRUCTIBLE,
-                     errorMessage,
-                     "MdisPlugin::constructModelFromISD");
+    sensorModel->m_minorAxis = 1000 * isd.value(MdisIsdView::SEMI_MINOR_AXIS);
   }
                                                 
   return sensorModel;
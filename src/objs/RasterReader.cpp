@@ -0,0 +1,294 @@
+#include "RasterReader.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+#include <gdal/gdal.h>
+#include <gdal/gdal_priv.h>
+
+using namespace std;
+
+// Alignment of the pixel buffers, one cache line (and a full AVX-512 register).
+static const size_t BUFFER_ALIGNMENT = 64;
+
+
+RasterBuffer::RasterBuffer() : m_data(NULL), m_capacity(0), m_samples(0), m_lines(0) {
+}
+
+
+/**
+ * @brief Creates a buffer of samples x lines pixels.
+ */
+RasterBuffer::RasterBuffer(int samples, int lines) :
+    m_data(NULL), m_capacity(0), m_samples(0), m_lines(0) {
+  resize(samples, lines);
+}
+
+
+RasterBuffer::~RasterBuffer() {
+  free(m_data);
+}
+
+
+/**
+ * @brief Sets the size of the buffer.  Memory is only reallocated when the buffer grows; the
+ * pixel values are not preserved.
+ * @param samples  The new width.
+ * @param lines  The new height.
+ * @return false if the memory could not be allocated.
+ */
+bool RasterBuffer::resize(int samples, int lines) {
+  size_t count = (size_t)max(samples, 0) * max(lines, 0);
+  if (count > m_capacity) {
+    void *data = NULL;
+    if (posix_memalign(&data, BUFFER_ALIGNMENT, count * sizeof(float)) != 0) {
+      cerr << "Could not allocate a " << samples << " x " << lines << " pixel buffer" << endl;
+      return false;
+    }
+    free(m_data);
+    m_data = static_cast<float *>(data);
+    m_capacity = count;
+  }
+  m_samples = samples;
+  m_lines = lines;
+  return true;
+}
+
+
+RasterReader::RasterReader() :
+    m_dataset(NULL), m_band(NULL), m_bandNumber(0), m_samples(0), m_lines(0),
+    m_blockSamples(0), m_blockLines(0) {
+}
+
+
+RasterReader::~RasterReader() {
+  close();
+}
+
+
+/**
+ * @brief Opens a band of a raster for reading.  ISIS cubes that CubeReader can map are read
+ * without GDAL.
+ * @param filename  The raster (any format GDAL reads, e.g. an ISIS cube).
+ * @param band  The (1-based) band to read.
+ * @return false if the raster or band could not be opened.
+ */
+bool RasterReader::open(const string &filename, int band) {
+  close();
+
+  if (CubeReader::isCube(filename) && m_cube.open(filename)) {
+    return openCube(filename, band);
+  }
+
+  GDALAllRegister();
+  m_dataset = (GDALDataset *)GDALOpen(filename.c_str(), GA_ReadOnly);
+  if (m_dataset == NULL) {
+    cerr << "Could not open the:  " << filename << endl;
+    return false;
+  }
+
+  if (band < 1 || band > m_dataset->GetRasterCount()) {
+    cerr << filename << " does not have band " << band << endl;
+    close();
+    return false;
+  }
+
+  m_filename = filename;
+  m_bandNumber = band;
+  m_band = m_dataset->GetRasterBand(band);
+  m_samples = m_band->GetXSize();
+  m_lines = m_band->GetYSize();
+  m_band->GetBlockSize(&m_blockSamples, &m_blockLines);
+  if (m_blockSamples <= 0 || m_blockLines <= 0) {
+    m_blockSamples = m_samples;
+    m_blockLines = 1;
+  }
+  return true;
+}
+
+
+/**
+ * @brief Opens a band of an ISIS cube that is already in memory (see CubeLoader).  The memory
+ * is not copied; it must stay valid until the reader is closed.
+ * @param filename  Name of the cube, for error messages.
+ * @param data  The whole cube file.
+ * @param size  Size of the file.
+ * @param band  The (1-based) band to read.
+ * @return false if the data is not a cube CubeReader handles or does not have the band.
+ */
+bool RasterReader::open(const string &filename, const unsigned char *data, size_t size,
+                        int band) {
+  close();
+  return m_cube.open(filename, data, size) && openCube(filename, band);
+}
+
+
+/**
+ * @brief Finishes opening a band of the cube m_cube has opened.
+ * @return false (after closing the reader) if the cube does not have the band.
+ */
+bool RasterReader::openCube(const string &filename, int band) {
+  if (band < 1 || band > m_cube.bands()) {
+    cerr << filename << " does not have band " << band << endl;
+    close();
+    return false;
+  }
+  m_filename = filename;
+  m_bandNumber = band;
+  m_samples = m_cube.samples();
+  m_lines = m_cube.lines();
+  m_blockSamples = m_cube.blockSamples();
+  m_blockLines = m_cube.blockLines();
+  return true;
+}
+
+
+/**
+ * @brief Closes the raster.
+ */
+void RasterReader::close() {
+  if (m_dataset != NULL) {
+    GDALClose(m_dataset);
+  }
+  m_dataset = NULL;
+  m_band = NULL;
+  m_cube.close();
+  m_bandNumber = 0;
+  m_filename.clear();
+  m_samples = 0;
+  m_lines = 0;
+  m_blockSamples = 0;
+  m_blockLines = 0;
+}
+
+
+/**
+ * @brief Reads a window of the band into a buffer, which is resized to the window.
+ *
+ * The window is read one block-grid cell at a time, each straight into its place in the
+ * buffer, so windows aligned to the block grid are read in whole blocks without any copies
+ * beyond GDAL's conversion to float.  Cubes read without GDAL are copied straight from the
+ * map.
+ *
+ * @param buffer  The buffer to read into.
+ * @param startSample  The (0-based) first sample of the window.
+ * @param startLine  The (0-based) first line of the window.
+ * @param samples  The width of the window.
+ * @param lines  The height of the window.
+ * @return false if no raster is open, the window is outside of the band, or a read failed.
+ */
+bool RasterReader::read(RasterBuffer &buffer, int startSample, int startLine, int samples,
+                        int lines) {
+  if (!isOpen()) {
+    cerr << "No raster is open" << endl;
+    return false;
+  }
+  if (startSample < 0 || startLine < 0 || samples <= 0 || lines <= 0 ||
+      startSample + samples > m_samples || startLine + lines > m_lines) {
+    cerr << "Window " << startSample << ", " << startLine << ", " << samples << " x " << lines
+         << " is outside of " << m_filename << endl;
+    return false;
+  }
+  if (!buffer.resize(samples, lines)) {
+    return false;
+  }
+  if (m_cube.isOpen()) {
+    return m_cube.read(buffer.data(), samples, m_bandNumber, startSample, startLine, samples,
+                       lines);
+  }
+
+  int endSample = startSample + samples;
+  int endLine = startLine + lines;
+  int lineSpace = samples * sizeof(float);
+
+  for (int line = startLine; line < endLine; ) {
+    int blockEndLine = min((line / m_blockLines + 1) * m_blockLines, endLine);
+    for (int sample = startSample; sample < endSample; ) {
+      int blockEndSample = min((sample / m_blockSamples + 1) * m_blockSamples, endSample);
+      float *destination = buffer.line(line - startLine) + (sample - startSample);
+
+      CPLErr status = m_band->RasterIO(GF_Read, sample, line,
+                                       blockEndSample - sample, blockEndLine - line,
+                                       destination,
+                                       blockEndSample - sample, blockEndLine - line,
+                                       GDT_Float32, sizeof(float), lineSpace);
+      if (status != CE_None) {
+        cerr << "Could not read " << m_filename << " at sample " << sample + 1 << ", line "
+             << line + 1 << endl;
+        return false;
+      }
+      sample = blockEndSample;
+    }
+    line = blockEndLine;
+  }
+  return true;
+}
+
+
+/**
+ * @brief Reads rows of the output grid of a window (region of interest and stride) into a
+ * buffer, which is resized to window.outputSamples() x rows.
+ *
+ * Only the lines of the grid are read.  Each is read along the block grid like any other
+ * window and every sampleStride-th sample is kept; without a stride the rows are read
+ * straight into the buffer.
+ *
+ * @param buffer  The buffer to read into.
+ * @param window  The window and its stride.
+ * @param startRow  The first output row to read.
+ * @param rows  The number of output rows to read.
+ * @return false if no raster is open, the rows are outside of the window, the window is
+ *         outside of the band, or a read failed.
+ */
+bool RasterReader::read(RasterBuffer &buffer, const ImageWindow &window, int startRow,
+                        int rows) {
+  if (window.sampleStride < 1 || window.lineStride < 1 || startRow < 0 || rows <= 0 ||
+      startRow + rows > window.outputLines()) {
+    cerr << "Rows " << startRow << " to " << startRow + rows << " are outside of the window"
+         << endl;
+    return false;
+  }
+
+  if (window.sampleStride == 1 && window.lineStride == 1) {
+    return read(buffer, window.startSample, window.startLine + startRow, window.samples,
+                rows);
+  }
+
+  if (!buffer.resize(window.outputSamples(), rows)) {
+    return false;
+  }
+  for (int row = 0; row < rows; row++) {
+    if (!read(m_lineBuffer, window.startSample, window.imageLine(startRow + row),
+              window.samples, 1)) {
+      return false;
+    }
+    const float *source = m_lineBuffer.line(0);
+    float *destination = buffer.line(row);
+    for (int column = 0; column < buffer.samples(); column++) {
+      destination[column] = source[column * window.sampleStride];
+    }
+  }
+  return true;
+}
+
+
+/**
+ * @brief Reads the whole band into a buffer, which is resized to the band.
+ * @return false if no raster is open or a read failed.
+ */
+bool RasterReader::readAll(RasterBuffer &buffer) {
+  return read(buffer, 0, 0, m_samples, m_lines);
+}
+
+
+/**
+ * @brief Returns a block of the band in place, without copying (see CubeReader::block).
+ * @param blockRow  The (0-based) row of the block in the block grid.
+ * @param blockColumn  The (0-based) column of the block in the block grid.
+ * @return NULL unless the raster is a cube read without GDAL whose pixels are native floats,
+ *         or if the block is outside of the band.
+ */
+const float *RasterReader::block(int blockRow, int blockColumn) const {
+  return m_cube.block(m_bandNumber, blockRow, blockColumn);
+}
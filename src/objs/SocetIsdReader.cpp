@@ -0,0 +1,269 @@
+#include "SocetIsdReader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <csm/Isd.h>
+
+#include "TextBuffer.h"
+
+using namespace std;
+
+/** How an ISD_* keyword maps onto an MDIS keyword. */
+struct SocetKeyword {
+  const char *socetName;  //!< Keyword in the SOCET ISD.
+  const char *mdisName;   //!< MDIS keyword it provides, or NULL to drop it.
+  double scale;           //!< Factor converting the SOCET value to MDIS units (0 = verbatim).
+};
+
+// MdisPlugin expects the axes in km and the angles in radians.  The legacy ISD writer
+// (see CSpiceIsd::writeISD) stores omega/phi/kappa in degrees even though the keywords say
+// RADIANS, so the angles are converted from degrees.  The principal point is a single
+// ccd_center in the MDIS model; the sample principal point provides it.
+static const SocetKeyword s_socetKeywords[] = {
+  { "ISD_CURRENT_PARAMETER_COVARIANCE",  NULL,              0.0 },
+  { "ISD_FOCAL_LENGTH_PIXELS",           "focal_length",    0.0 },
+  { "ISD_KAPPA_CURR_RADIANS",            "kappa",           M_PI / 180.0 },
+  { "ISD_KAPPA_ORIG_RADIANS",            NULL,              0.0 },
+  { "ISD_LINE_PRINCIPAL_POINT_PIXELS",   NULL,              0.0 },
+  { "ISD_MAX_ELEVATION_METERS",          NULL,              0.0 },
+  { "ISD_MIN_ELEVATION_METERS",          NULL,              0.0 },
+  { "ISD_NUMBER_OF_LINES",               "nlines",          0.0 },
+  { "ISD_NUMBER_OF_SAMPLES",             "nsamples",        0.0 },
+  { "ISD_OMEGA_CURR_RADIANS",            "omega",           M_PI / 180.0 },
+  { "ISD_OMEGA_ORIG_RADIANS",            NULL,              0.0 },
+  { "ISD_ORIGINAL_PARAMETER_COVARIANCE", NULL,              0.0 },
+  { "ISD_PHI_CURR_RADIANS",              "phi",             M_PI / 180.0 },
+  { "ISD_PHI_ORIG_RADIANS",              NULL,              0.0 },
+  { "ISD_SAMPLE_PRINCIPAL_POINT_PIXELS", "ccd_center",      0.0 },
+  { "ISD_SEMI_MAJOR_AXIS_METERS",        "semi_major_axis", 0.001 },
+  { "ISD_SEMI_MINOR_AXIS_METERS",        "semi_minor_axis", 0.001 },
+  { "ISD_SENSOR_MODEL_NAME",             NULL,              0.0 },
+  { "ISD_X_SENSOR_CURR_METERS",          "x_sensor_origin", 0.0 },
+  { "ISD_X_SENSOR_ORIG_METERS",          NULL,              0.0 },
+  { "ISD_Y_SENSOR_CURR_METERS",          "y_sensor_origin", 0.0 },
+  { "ISD_Y_SENSOR_ORIG_METERS",          NULL,              0.0 },
+  { "ISD_Z_SENSOR_CURR_METERS",          "z_sensor_origin", 0.0 },
+  { "ISD_Z_SENSOR_ORIG_METERS",          NULL,              0.0 }
+};
+
+
+/**
+ * @brief Finds the mapping of a SOCET keyword by binary search of the (sorted) table.
+ * @return The mapping, or NULL if the keyword is not a known ISD_* keyword.
+ */
+static const SocetKeyword *findSocetKeyword(const char *key, size_t length) {
+  size_t low = 0;
+  size_t high = sizeof(s_socetKeywords) / sizeof(s_socetKeywords[0]);
+  while (low < high) {
+    size_t mid = (low + high) / 2;
+    const char *name = s_socetKeywords[mid].socetName;
+    int cmp = strncmp(key, name, length);
+    if (cmp == 0 && name[length] != '\0') {
+      cmp = -1;
+    }
+    if (cmp == 0) {
+      return &s_socetKeywords[mid];
+    }
+    if (cmp > 0) {
+      low = mid + 1;
+    }
+    else {
+      high = mid;
+    }
+  }
+  return NULL;
+}
+
+
+static bool isBlank(char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+
+/**
+ * @brief Adds the instrument constants the ISD does not already have.
+ */
+static void addInstrumentParams(csm::Isd &isd, const csm::Isd &instrument) {
+  const multimap<string, string> &params = instrument.parameters();
+  multimap<string, string>::const_iterator it = params.begin();
+  while (it != params.end()) {
+    multimap<string, string>::const_iterator next = params.upper_bound(it->first);
+    if (isd.parameters().find(it->first) == isd.parameters().end()) {
+      for (; it != next; ++it) {
+        isd.addParam(it->first, it->second);
+      }
+    }
+    it = next;
+  }
+}
+
+
+/**
+ * @brief readSocetISD  Creates an ISD from SOCET style keyword text that is already in
+ * memory.  Lines are split in place; only the keyword values are copied into the ISD.
+ * @param data  Pointer to the first character of the text.
+ * @param size  Number of bytes of text.
+ * @param filename  The name to record as the ISD's filename.
+ * @param instrument  Optional ISD of instrument constants for keywords the text lacks.
+ * @return A new ISD, or NULL if the text is a JSON ISD rather than a keyword ISD.
+ */
+csm::Isd *readSocetISD(const char *data, size_t size, const string &filename,
+                       const csm::Isd *instrument) {
+  const char *first = data;
+  while (first < data + size && (isBlank(*first) || *first == '\n')) {
+    first++;
+  }
+  if (first < data + size && *first == '{') {
+    cerr << filename << " is a JSON ISD, not a keyword ISD" << endl;
+    return NULL;
+  }
+
+  csm::Isd *isd = new csm::Isd();
+  isd->setFilename(filename);
+
+  const char *end = data + size;
+  const char *line = data;
+  while (line < end) {
+    const char *lineEnd = static_cast<const char *>(memchr(line, '\n', end - line));
+    if (lineEnd == NULL) {
+      lineEnd = end;
+    }
+
+    // Keyword: up to the first blank.  Value: the rest of the line, trimmed.
+    const char *keyEnd = line;
+    while (keyEnd < lineEnd && !isBlank(*keyEnd)) {
+      keyEnd++;
+    }
+    const char *value = keyEnd;
+    while (value < lineEnd && isBlank(*value)) {
+      value++;
+    }
+    const char *valueEnd = lineEnd;
+    while (valueEnd > value && isBlank(valueEnd[-1])) {
+      valueEnd--;
+    }
+
+    size_t keyLength = keyEnd - line;
+    if (keyLength == 0 || line[0] == '#') {
+      line = lineEnd + 1;
+      continue;
+    }
+
+    const SocetKeyword *keyword = findSocetKeyword(line, keyLength);
+    if (keyword == NULL) {
+      isd->addParam(string(line, keyLength), string(value, valueEnd));
+    }
+    else if (keyword->mdisName != NULL && keyword->scale == 0.0) {
+      isd->addParam(keyword->mdisName, string(value, valueEnd));
+    }
+    else if (keyword->mdisName != NULL) {
+      // Copy the number out so strtod cannot read past the end of the buffer.
+      char number[64];
+      size_t length = min<size_t>(valueEnd - value, sizeof(number) - 1);
+      memcpy(number, value, length);
+      number[length] = '\0';
+
+      char formatted[MAX_NUMBER_LENGTH];
+      formatDouble(strtod(number, NULL) * keyword->scale, formatted);
+      isd->addParam(keyword->mdisName, formatted);
+    }
+
+    line = lineEnd + 1;
+  }
+
+  if (instrument != NULL) {
+    addInstrumentParams(*isd, *instrument);
+  }
+  return isd;
+}
+
+
+/**
+ * @brief readSocetISD  Memory-maps a SOCET style keyword ISD file and creates an ISD from it.
+ * @param filename  The ISD file.
+ * @param instrument  Optional ISD of instrument constants for keywords the file lacks.
+ * @return A new ISD, or NULL if the file could not be read.
+ */
+csm::Isd *readSocetISD(const string &filename, const csm::Isd *instrument) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    perror(("error while opening file " + filename).c_str());
+    return NULL;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    perror(("error while reading file " + filename).c_str());
+    close(fd);
+    return NULL;
+  }
+
+  // mmap cannot map an empty file
+  if (info.st_size == 0) {
+    close(fd);
+    return readSocetISD("", 0, filename, instrument);
+  }
+
+  void *map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    perror(("error while mapping file " + filename).c_str());
+    return NULL;
+  }
+
+  csm::Isd *isd = readSocetISD(static_cast<const char *>(map), info.st_size, filename,
+                               instrument);
+  munmap(map, info.st_size);
+  return isd;
+}
+
+
+/**
+ * @brief readSocetISDDirectory  Reads every *.isd file of a directory, in name order.
+ * @param directory  The directory to read.
+ * @param isds  The ISDs that were read are appended here; the caller owns them.
+ * @param instrument  Optional ISD of instrument constants for keywords the files lack.
+ * @return The number of ISDs read, or -1 if the directory could not be opened.
+ */
+int readSocetISDDirectory(const string &directory, vector<csm::Isd *> &isds,
+                          const csm::Isd *instrument) {
+  DIR *dir = opendir(directory.c_str());
+  if (dir == NULL) {
+    perror(("error while opening directory " + directory).c_str());
+    return -1;
+  }
+
+  vector<string> names;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    string name(entry->d_name);
+    if (name.size() > 4 && name.compare(name.size() - 4, 4, ".isd") == 0) {
+      names.push_back(name);
+    }
+  }
+  closedir(dir);
+  sort(names.begin(), names.end());
+
+  int count = 0;
+  for (size_t i = 0; i < names.size(); i++) {
+    csm::Isd *isd = readSocetISD(directory + "/" + names[i], instrument);
+    if (isd != NULL) {
+      isds.push_back(isd);
+      count++;
+    }
+  }
+  return count;
+}
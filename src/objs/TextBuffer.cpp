@@ -0,0 +1,218 @@
+#include "TextBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+/**
+ * @brief formatDouble  Writes the shortest text that reads back (with strtod/atof) to exactly
+ * the same double.  Most values need 15 significant digits or fewer, in which case %g also
+ * drops trailing zeros; the rest need 16 or 17.
+ * @param value  The value to format.
+ * @param buffer  Destination of at least MAX_NUMBER_LENGTH characters.
+ * @return The number of characters written, not counting the terminating null.
+ */
+int formatDouble(double value, char *buffer) {
+  if (!std::isfinite(value)) {
+    return snprintf(buffer, MAX_NUMBER_LENGTH, "%g", value);
+  }
+
+  int length = 0;
+  for (int precision = 15; precision < 17; precision++) {
+    length = snprintf(buffer, MAX_NUMBER_LENGTH, "%.*g", precision, value);
+    if (strtod(buffer, NULL) == value) {
+      return length;
+    }
+  }
+  return snprintf(buffer, MAX_NUMBER_LENGTH, "%.17g", value);
+}
+
+
+/**
+ * @brief formatDouble  Writes a double with a fixed number of significant digits, the same
+ * way an ostream with setprecision(precision) does.
+ * @param value  The value to format.
+ * @param precision  Number of significant digits.  Zero or less selects the shortest
+ *                   round-trip text.
+ * @param buffer  Destination of at least MAX_NUMBER_LENGTH characters.
+ * @return The number of characters written, not counting the terminating null.
+ */
+int formatDouble(double value, int precision, char *buffer) {
+  if (precision <= 0) {
+    return formatDouble(value, buffer);
+  }
+  if (precision > 17) {
+    precision = 17;
+  }
+  return snprintf(buffer, MAX_NUMBER_LENGTH, "%.*g", precision, value);
+}
+
+
+/**
+ * @brief formatFloat  Writes the shortest text that reads back to exactly the same float
+ * (at most 9 significant digits).
+ * @param value  The value to format.
+ * @param buffer  Destination of at least MAX_NUMBER_LENGTH characters.
+ * @return The number of characters written, not counting the terminating null.
+ */
+int formatFloat(float value, char *buffer) {
+  if (!std::isfinite(value)) {
+    return snprintf(buffer, MAX_NUMBER_LENGTH, "%g", value);
+  }
+
+  int length = 0;
+  for (int precision = 6; precision < 9; precision++) {
+    length = snprintf(buffer, MAX_NUMBER_LENGTH, "%.*g", precision, value);
+    if (strtof(buffer, NULL) == value) {
+      return length;
+    }
+  }
+  return snprintf(buffer, MAX_NUMBER_LENGTH, "%.9g", value);
+}
+
+
+/**
+ * @brief formatInteger  Writes an integer in decimal.
+ * @param value  The value to format.
+ * @param buffer  Destination of at least MAX_NUMBER_LENGTH characters.
+ * @return The number of characters written, not counting the terminating null.
+ */
+int formatInteger(long long value, char *buffer) {
+  char digits[MAX_NUMBER_LENGTH];
+  int count = 0;
+  unsigned long long magnitude = value < 0 ? 0ULL - (unsigned long long)value : value;
+  do {
+    digits[count++] = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude != 0);
+
+  int length = 0;
+  if (value < 0) {
+    buffer[length++] = '-';
+  }
+  while (count > 0) {
+    buffer[length++] = digits[--count];
+  }
+  buffer[length] = '\0';
+  return length;
+}
+
+
+/**
+ * @brief Creates a buffer.
+ * @param file  File the text is written to when the buffer fills up and on flush(), or NULL
+ *              to keep all of the text in memory.  The caller still owns (and closes) it.
+ * @param capacity  Initial size of the buffer in bytes.
+ */
+TextBuffer::TextBuffer(FILE *file, size_t capacity) :
+    m_file(file), m_buffer(capacity > MAX_NUMBER_LENGTH ? capacity : MAX_NUMBER_LENGTH),
+    m_size(0), m_failed(false) {
+}
+
+
+/**
+ * @brief Writes any pending text to the file.
+ */
+TextBuffer::~TextBuffer() {
+  flush();
+}
+
+
+/**
+ * @brief Returns room for length more bytes, writing out or growing the buffer as needed.
+ */
+char *TextBuffer::reserve(size_t length) {
+  if (m_size + length > m_buffer.size()) {
+    flush();
+    if (m_size + length > m_buffer.size()) {
+      m_buffer.resize(std::max(m_buffer.size() * 2, m_size + length));
+    }
+  }
+  return &m_buffer[m_size];
+}
+
+
+void TextBuffer::append(const char *text, size_t length) {
+  memcpy(reserve(length), text, length);
+  m_size += length;
+}
+
+
+void TextBuffer::append(const char *text) {
+  append(text, strlen(text));
+}
+
+
+void TextBuffer::append(const string &text) {
+  append(text.data(), text.size());
+}
+
+
+void TextBuffer::append(char c) {
+  *reserve(1) = c;
+  m_size++;
+}
+
+
+/**
+ * @brief Appends the shortest text that reads back to the same double.
+ */
+void TextBuffer::appendDouble(double value) {
+  m_size += formatDouble(value, reserve(MAX_NUMBER_LENGTH));
+}
+
+
+/**
+ * @brief Appends a double with a fixed number of significant digits (<= 0: round trip).
+ */
+void TextBuffer::appendDouble(double value, int precision) {
+  m_size += formatDouble(value, precision, reserve(MAX_NUMBER_LENGTH));
+}
+
+
+/**
+ * @brief Appends the shortest text that reads back to the same float.
+ */
+void TextBuffer::appendFloat(float value) {
+  m_size += formatFloat(value, reserve(MAX_NUMBER_LENGTH));
+}
+
+
+void TextBuffer::appendInteger(long long value) {
+  m_size += formatInteger(value, reserve(MAX_NUMBER_LENGTH));
+}
+
+
+/**
+ * @brief Writes the pending text to the file (if the buffer has one) and empties the buffer.
+ * @return false if this or an earlier write to the file failed.
+ */
+bool TextBuffer::flush() {
+  if (m_file == NULL) {
+    return true;
+  }
+  if (m_size > 0 && fwrite(&m_buffer[0], 1, m_size, m_file) != m_size) {
+    m_failed = true;
+  }
+  m_size = 0;
+  return !m_failed;
+}
+
+
+/**
+ * @brief Discards the pending text, keeping the memory for reuse.
+ */
+void TextBuffer::clear() {
+  m_size = 0;
+}
+
+
+/**
+ * @brief Returns a copy of the pending text.
+ */
+string TextBuffer::str() const {
+  return string(data(), m_size);
+}
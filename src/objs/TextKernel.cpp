@@ -0,0 +1,622 @@
+#include "TextKernel.h"
+
+#include <cctype>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <unistd.h>
+
+using namespace std;
+
+static const char CACHE_MAGIC[8] = { 'M', 'D', 'I', 'S', 'T', 'K', 'C', '2' };
+static const size_t CACHE_HEADER_SIZE = 24;
+
+
+/**
+ * @brief Reads a whole file into a string.
+ * @return false if the file could not be read.
+ */
+static bool readFile(const string &filename, string &contents) {
+  ifstream file(filename.c_str(), ios::in | ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+  stringstream buffer;
+  buffer << file.rdbuf();
+  contents = buffer.str();
+  return true;
+}
+
+
+/**
+ * @brief Returns true if a line, without its leading blanks, starts with a marker (e.g.
+ * \begindata).
+ */
+static bool isMarker(const char *line, size_t length, const char *marker) {
+  size_t i = 0;
+  while (i < length && (line[i] == ' ' || line[i] == '\t')) {
+    i++;
+  }
+  size_t markerLength = strlen(marker);
+  return length - i >= markerLength && memcmp(line + i, marker, markerLength) == 0;
+}
+
+
+/**
+ * @brief Returns true if a character ends an unquoted value.
+ */
+static bool endsValue(char c) {
+  return isspace((unsigned char)c) || c == ',' || c == ')';
+}
+
+
+/**
+ * @brief Returns the 64-bit FNV-1a hash of some bytes.
+ */
+uint64_t TextKernel::hash(const char *data, size_t size) {
+  uint64_t value = 14695981039346656037ULL;
+  for (size_t i = 0; i < size; i++) {
+    value ^= (unsigned char)data[i];
+    value *= 1099511628211ULL;
+  }
+  return value;
+}
+
+
+/**
+ * @brief Reads the digits of an unsigned integer.
+ * @return The number of digits read.
+ */
+static int readDigits(const char *&c, long &value) {
+  int digits = 0;
+  value = 0;
+  while (isdigit((unsigned char)*c)) {
+    value = value * 10 + (*c - '0');
+    c++;
+    digits++;
+  }
+  return digits;
+}
+
+
+/**
+ * @brief Skips the separators between the fields of a date.
+ * @return false if there are none.
+ */
+static bool skipDateSeparators(const char *&c) {
+  const char *start = c;
+  while (*c == '-' || *c == '/' || *c == ' ') {
+    c++;
+  }
+  return c != start;
+}
+
+
+/**
+ * @brief Parses a UTC calendar date and time of day.
+ *
+ * The date is YYYY-MM-DD, YYYY-MON-DD (e.g. 1972-JAN-1) or YYYY-DDD (day of year), with -,
+ * / or blanks between the fields.  It may be followed, after a T or blanks, by HH:MM or
+ * HH:MM:SS.ffffff, and then a Z.  Seconds may reach 60 during a leap second.
+ *
+ * @param text  The date and time.
+ * @param day  Receives the days past 2000-01-01.
+ * @param seconds  Receives the seconds past the start of the day.
+ * @return false if the text is not a valid date and time.
+ */
+bool TextKernel::parseCalendar(const string &text, long &day, double &seconds) {
+  static const char MONTHS[] = "JANFEBMARAPRMAYJUNJULAUGSEPOCTNOVDEC";
+  static const int LENGTHS[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+  const char *c = text.c_str();
+  while (*c == ' ') {
+    c++;
+  }
+  long year, month, dayOfMonth;
+  if (readDigits(c, year) == 0 || !skipDateSeparators(c)) {
+    return false;
+  }
+  bool leapYear = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+
+  bool dayOfYear = false;
+  if (isalpha((unsigned char)*c)) {
+    char name[4] = { 0, 0, 0, 0 };
+    for (int i = 0; i < 3 && isalpha((unsigned char)*c); i++, c++) {
+      name[i] = toupper((unsigned char)*c);
+    }
+    if (isalpha((unsigned char)*c) || strlen(name) != 3) {
+      return false;
+    }
+    const char *found = strstr(MONTHS, name);
+    if (found == NULL || (found - MONTHS) % 3 != 0) {
+      return false;
+    }
+    month = (found - MONTHS) / 3 + 1;
+  }
+  else {
+    int digits = readDigits(c, month);
+    dayOfYear = digits == 3 && *c != '-' && *c != '/';
+    if (digits == 0 || month < 1 || month > (dayOfYear ? (leapYear ? 366 : 365) : 12)) {
+      return false;
+    }
+  }
+
+  if (dayOfYear) {
+    dayOfMonth = month;
+    month = 1;
+  }
+  else {
+    int length = LENGTHS[month - 1] + (month == 2 && leapYear ? 1 : 0);
+    if (!skipDateSeparators(c) || readDigits(c, dayOfMonth) == 0 || dayOfMonth < 1 ||
+        dayOfMonth > length) {
+      return false;
+    }
+  }
+
+  // Days past 2000-01-01: the days of the whole years since, then those of this year.
+  long before = year - 1;
+  day = (year - 2000) * 365 + (before / 4 - before / 100 + before / 400) - (499 - 19 + 4);
+  for (int m = 1; m < month; m++) {
+    day += LENGTHS[m - 1] + (m == 2 && leapYear ? 1 : 0);
+  }
+  day += dayOfMonth - 1;
+
+  seconds = 0.0;
+  if (*c == 'T' || *c == ' ') {
+    c++;
+    while (*c == ' ') {
+      c++;
+    }
+  }
+  if (isdigit((unsigned char)*c)) {
+    long hours, minutes;
+    if (readDigits(c, hours) == 0 || *c != ':' || hours > 23) {
+      return false;
+    }
+    c++;
+    if (readDigits(c, minutes) == 0 || minutes > 59) {
+      return false;
+    }
+    seconds = hours * 3600.0 + minutes * 60.0;
+    if (*c == ':') {
+      c++;
+      char *end = NULL;
+      double value = isdigit((unsigned char)*c) ? strtod(c, &end) : -1.0;
+      if (value < 0.0 || value >= 61.0) {
+        return false;
+      }
+      seconds += value;
+      c = end;
+    }
+  }
+  if (*c == 'Z') {
+    c++;
+  }
+  while (*c == ' ') {
+    c++;
+  }
+  return *c == '\0';
+}
+
+
+TextKernel::TextKernel() : m_fromCache(false) {
+}
+
+
+/**
+ * @brief Reads and parses a text kernel, replacing any variables read before.
+ * @param filename  The kernel file.
+ * @return false if the file could not be read or is not a valid text kernel.
+ */
+bool TextKernel::load(const string &filename) {
+  string text;
+  if (!readFile(filename, text)) {
+    perror(("error while opening file " + filename).c_str());
+    return false;
+  }
+  m_fromCache = false;
+  return parse(text.data(), text.size(), filename);
+}
+
+
+/**
+ * @brief Reads a text kernel from its cache file, or parses it and writes the cache file.
+ *
+ * The cache file is cacheDirectory/<hash of the kernel's text>.tkc, so an edited kernel
+ * gets a new cache file.  A cache file that cannot be written only costs the next run a
+ * parse.
+ *
+ * @param filename  The kernel file.
+ * @param cacheDirectory  The directory of the cache files, which must exist.
+ * @return false if the kernel could not be read or is not a valid text kernel.
+ */
+bool TextKernel::loadCached(const string &filename, const string &cacheDirectory) {
+  string text;
+  if (!readFile(filename, text)) {
+    perror(("error while opening file " + filename).c_str());
+    return false;
+  }
+  uint64_t kernelHash = hash(text.data(), text.size());
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.tkc", (unsigned long long)kernelHash);
+  string cacheFile = cacheDirectory + "/" + name;
+
+  m_fromCache = readCache(cacheFile, kernelHash);
+  if (m_fromCache) {
+    return true;
+  }
+  if (!parse(text.data(), text.size(), filename)) {
+    return false;
+  }
+  writeCache(cacheFile, kernelHash);
+  return true;
+}
+
+
+/**
+ * @brief Parses the \begindata sections of a text kernel, replacing any variables read
+ * before.
+ * @param text  The kernel's text.
+ * @param size  The size of the text.
+ * @param filename  The kernel file, for error messages.
+ * @return false if an assignment is not valid (the variables are then cleared).
+ */
+bool TextKernel::parse(const char *text, size_t size, const string &filename) {
+  clear();
+
+  // Gather the lines of the data sections.
+  string data;
+  bool inData = false;
+  size_t position = 0;
+  while (position < size) {
+    const char *end = static_cast<const char *>(memchr(text + position, '\n',
+                                                       size - position));
+    size_t length = (end == NULL ? size : end - text) - position;
+    const char *line = text + position;
+    position += length + 1;
+    if (isMarker(line, length, "\\begindata")) {
+      inData = true;
+    }
+    else if (isMarker(line, length, "\\begintext")) {
+      inData = false;
+    }
+    else if (inData) {
+      data.append(line, length);
+      data += '\n';
+    }
+  }
+
+  size_t i = 0;
+  size_t n = data.size();
+  string error;
+  while (error.empty()) {
+    while (i < n && isspace((unsigned char)data[i])) {
+      i++;
+    }
+    if (i >= n) {
+      break;
+    }
+
+    size_t start = i;
+    while (i < n && !isspace((unsigned char)data[i]) && data[i] != '=' &&
+           !(data[i] == '+' && i + 1 < n && data[i + 1] == '=')) {
+      i++;
+    }
+    string name = data.substr(start, i - start);
+    while (i < n && isspace((unsigned char)data[i])) {
+      i++;
+    }
+    bool append = i + 1 < n && data[i] == '+' && data[i + 1] == '=';
+    if (!append && (i >= n || data[i] != '=')) {
+      error = "expected = or += after " + name;
+      break;
+    }
+    i += append ? 2 : 1;
+
+    while (i < n && isspace((unsigned char)data[i])) {
+      i++;
+    }
+    bool list = i < n && data[i] == '(';
+    if (list) {
+      i++;
+    }
+
+    Variable values;
+    values.isString = false;
+    bool typed = false;
+    while (error.empty()) {
+      while (i < n && (isspace((unsigned char)data[i]) || data[i] == ',')) {
+        i++;
+      }
+      if (list && i < n && data[i] == ')') {
+        i++;
+        break;
+      }
+      if (i >= n) {
+        if (list || !typed) {
+          error = "missing value of " + name;
+        }
+        break;
+      }
+
+      bool isString = data[i] == '\'';
+      if (typed && isString != values.isString) {
+        error = name + " mixes numbers and strings";
+        break;
+      }
+      values.isString = isString;
+      typed = true;
+
+      if (data[i] == '\'') {
+        string value;
+        i++;
+        while (true) {
+          size_t quote = data.find('\'', i);
+          if (quote == string::npos) {
+            error = "unterminated string in " + name;
+            break;
+          }
+          value.append(data, i, quote - i);
+          i = quote + 1;
+          if (i < n && data[i] == '\'') {
+            value += '\'';
+            i++;
+            continue;
+          }
+          break;
+        }
+        values.strings.push_back(value);
+      }
+      else {
+        start = i;
+        while (i < n && !endsValue(data[i])) {
+          i++;
+        }
+        string token = data.substr(start, i - start);
+        if (token[0] == '@') {
+          long day;
+          double seconds;
+          if (!parseCalendar(token.substr(1), day, seconds)) {
+            error = "invalid date " + token + " of " + name;
+            break;
+          }
+          values.numbers.push_back(day * 86400.0 - 43200.0 + seconds);
+        }
+        else {
+          for (size_t c = 0; c < token.size(); c++) {
+            if (token[c] == 'D' || token[c] == 'd') {
+              token[c] = 'E';
+            }
+          }
+          char *end = NULL;
+          double value = strtod(token.c_str(), &end);
+          if (token.empty() || *end != '\0') {
+            error = "invalid value " + token + " of " + name;
+            break;
+          }
+          values.numbers.push_back(value);
+        }
+      }
+
+      if (!list) {
+        break;
+      }
+    }
+    if (!error.empty()) {
+      break;
+    }
+
+    map<string, Variable>::iterator variable = m_variables.find(name);
+    if (!append || variable == m_variables.end()) {
+      m_variables[name] = values;
+    }
+    else if (variable->second.isString != values.isString) {
+      error = name + " mixes numbers and strings";
+    }
+    else {
+      Variable &existing = variable->second;
+      existing.numbers.insert(existing.numbers.end(), values.numbers.begin(),
+                              values.numbers.end());
+      existing.strings.insert(existing.strings.end(), values.strings.begin(),
+                              values.strings.end());
+    }
+  }
+
+  if (!error.empty()) {
+    cerr << "error while parsing text kernel " << filename << ": " << error << endl;
+    clear();
+    return false;
+  }
+  return true;
+}
+
+
+/**
+ * @brief Removes every variable.
+ */
+void TextKernel::clear() {
+  m_variables.clear();
+}
+
+
+/**
+ * @brief Reads the variables from a cache file written by writeCache().
+ * @param cacheFile  The cache file.
+ * @param kernelHash  The hash of the kernel the cache file must be for.
+ * @return false if there is no valid cache file for the kernel (the variables are then
+ *         cleared).
+ */
+bool TextKernel::readCache(const string &cacheFile, uint64_t kernelHash) {
+  clear();
+  string contents;
+  if (!readFile(cacheFile, contents) || contents.size() < CACHE_HEADER_SIZE ||
+      memcmp(contents.data(), CACHE_MAGIC, 8) != 0) {
+    return false;
+  }
+  uint64_t storedHash;
+  uint32_t count;
+  memcpy(&storedHash, contents.data() + 8, 8);
+  memcpy(&count, contents.data() + 16, 4);
+  if (storedHash != kernelHash) {
+    return false;
+  }
+
+  const char *bytes = contents.data() + CACHE_HEADER_SIZE;
+  const char *end = contents.data() + contents.size();
+  for (uint32_t v = 0; v < count; v++) {
+    uint32_t header[3];   // name length, is string, value count
+    if (end - bytes < (ptrdiff_t)sizeof(header)) {
+      clear();
+      return false;
+    }
+    memcpy(header, bytes, sizeof(header));
+    bytes += sizeof(header);
+    if ((size_t)(end - bytes) < header[0]) {
+      clear();
+      return false;
+    }
+    string name(bytes, header[0]);
+    bytes += header[0];
+
+    Variable &variable = m_variables[name];
+    variable.isString = header[1] != 0;
+    if (!variable.isString) {
+      if ((size_t)(end - bytes) / sizeof(double) < header[2]) {
+        clear();
+        return false;
+      }
+      variable.numbers.resize(header[2]);
+      if (header[2] > 0) {
+        memcpy(&variable.numbers[0], bytes, header[2] * sizeof(double));
+      }
+      bytes += header[2] * sizeof(double);
+      continue;
+    }
+    for (uint32_t s = 0; s < header[2]; s++) {
+      uint32_t length;
+      if (end - bytes < 4) {
+        clear();
+        return false;
+      }
+      memcpy(&length, bytes, 4);
+      bytes += 4;
+      if ((size_t)(end - bytes) < length) {
+        clear();
+        return false;
+      }
+      variable.strings.push_back(string(bytes, length));
+      bytes += length;
+    }
+  }
+  return true;
+}
+
+
+/**
+ * @brief Writes the variables to a cache file.  The file is written under a temporary name
+ * and renamed, so concurrent runs never read a partial cache file.
+ *
+ * Layout (native byte order): "MDISTKC2" magic, uint64 kernel hash, uint32 variable count,
+ * uint32 reserved; then for each variable a uint32 name length, uint32 1 for strings or 0
+ * for numbers, uint32 value count, the name, and the values (doubles, or each string as a
+ * uint32 length and its text).
+ *
+ * @param cacheFile  The cache file.
+ * @param kernelHash  The hash of the kernel the variables were parsed from.
+ * @return false if the file could not be written.
+ */
+bool TextKernel::writeCache(const string &cacheFile, uint64_t kernelHash) const {
+  string contents(CACHE_HEADER_SIZE, '\0');
+  uint32_t count = m_variables.size();
+  memcpy(&contents[0], CACHE_MAGIC, 8);
+  memcpy(&contents[8], &kernelHash, 8);
+  memcpy(&contents[16], &count, 4);
+
+  for (map<string, Variable>::const_iterator variable = m_variables.begin();
+       variable != m_variables.end(); ++variable) {
+    const Variable &values = variable->second;
+    uint32_t header[3] = { (uint32_t)variable->first.size(), values.isString ? 1u : 0u,
+                           (uint32_t)(values.isString ? values.strings.size()
+                                                      : values.numbers.size()) };
+    contents.append(reinterpret_cast<const char *>(header), sizeof(header));
+    contents.append(variable->first);
+    if (!values.isString) {
+      contents.append(reinterpret_cast<const char *>(values.numbers.data()),
+                      values.numbers.size() * sizeof(double));
+      continue;
+    }
+    for (size_t s = 0; s < values.strings.size(); s++) {
+      uint32_t length = values.strings[s].size();
+      contents.append(reinterpret_cast<const char *>(&length), 4);
+      contents.append(values.strings[s]);
+    }
+  }
+
+  char suffix[32];
+  snprintf(suffix, sizeof(suffix), ".%ld.tmp", (long)getpid());
+  string temporary = cacheFile + suffix;
+  FILE *file = fopen(temporary.c_str(), "wb");
+  if (file == NULL) {
+    perror(("error while opening file " + temporary).c_str());
+    return false;
+  }
+  bool ok = fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+  ok = fclose(file) == 0 && ok;
+  ok = ok && rename(temporary.c_str(), cacheFile.c_str()) == 0;
+  if (!ok) {
+    perror(("error while writing file " + cacheFile).c_str());
+    remove(temporary.c_str());
+  }
+  return ok;
+}
+
+
+/**
+ * @brief Returns the values of a numeric variable, or NULL if the kernel does not assign it
+ * or it holds strings.
+ */
+const vector<double> *TextKernel::numbers(const string &name) const {
+  map<string, Variable>::const_iterator variable = m_variables.find(name);
+  if (variable == m_variables.end() || variable->second.isString) {
+    return NULL;
+  }
+  return &variable->second.numbers;
+}
+
+
+/**
+ * @brief Returns the values of a string variable, or NULL if the kernel does not assign it
+ * or it holds numbers.
+ */
+const vector<string> *TextKernel::strings(const string &name) const {
+  map<string, Variable>::const_iterator variable = m_variables.find(name);
+  if (variable == m_variables.end() || !variable->second.isString) {
+    return NULL;
+  }
+  return &variable->second.strings;
+}
+
+
+/**
+ * @brief Copies the first values of a numeric variable, like gdpool_c with room for count
+ * values.
+ * @param name  The variable.
+ * @param count  The number of values to copy.
+ * @param values  Receives the values.
+ * @return false if the variable is not numeric or has fewer than count values.
+ */
+bool TextKernel::getDoubles(const string &name, int count, double *values) const {
+  const vector<double> *variable = numbers(name);
+  if (variable == NULL || variable->size() < (size_t)count) {
+    return false;
+  }
+  for (int i = 0; i < count; i++) {
+    values[i] = (*variable)[i];
+  }
+  return true;
+}
@@ -0,0 +1,122 @@
+#include "ThreadPool.h"
+
+using namespace std;
+
+/**
+ * @brief Starts the worker threads.
+ * @param threads  Number of threads loops run on, including the calling thread.  Values
+ *                 below 1 are treated as 1 (no workers, loops run on the caller).
+ */
+ThreadPool::ThreadPool(int threads) :
+    m_task(NULL), m_count(0), m_next(0), m_busy(0), m_generation(0), m_stop(false) {
+  for (int i = 1; i < threads; i++) {
+    m_workers.push_back(thread(&ThreadPool::work, this));
+  }
+}
+
+
+/**
+ * @brief Stops and joins the worker threads.
+ */
+ThreadPool::~ThreadPool() {
+  {
+    lock_guard<mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_start.notify_all();
+  for (size_t i = 0; i < m_workers.size(); i++) {
+    m_workers[i].join();
+  }
+}
+
+
+/**
+ * @brief Returns the number of hardware threads, or 1 if it is not known.
+ */
+int ThreadPool::defaultThreads() {
+  unsigned int threads = thread::hardware_concurrency();
+  return threads > 0 ? threads : 1;
+}
+
+
+/**
+ * @brief Calls task(i) for every i in [0, count) on the pool's threads and waits for them.
+ *
+ * If a task throws, the remaining indices are skipped and the first exception is rethrown
+ * here once every thread has left the loop.
+ *
+ * @param count  The number of indices.
+ * @param task  The loop body.
+ */
+void ThreadPool::parallelFor(int count, const function<void(int)> &task) {
+  if (count <= 0) {
+    return;
+  }
+
+  {
+    lock_guard<mutex> lock(m_mutex);
+    m_task = &task;
+    m_count = count;
+    m_next = 0;
+    m_busy = m_workers.size();
+    m_error = exception_ptr();
+    m_generation++;
+  }
+  m_start.notify_all();
+
+  runTasks();
+
+  unique_lock<mutex> lock(m_mutex);
+  m_done.wait(lock, [this] { return m_busy == 0; });
+  m_task = NULL;
+  if (m_error) {
+    exception_ptr error = m_error;
+    m_error = exception_ptr();
+    rethrow_exception(error);
+  }
+}
+
+
+/**
+ * @brief Runs indices of the current loop until there are none left.
+ */
+void ThreadPool::runTasks() {
+  for (int i = m_next++; i < m_count; i = m_next++) {
+    try {
+      (*m_task)(i);
+    }
+    catch (...) {
+      lock_guard<mutex> lock(m_mutex);
+      if (!m_error) {
+        m_error = current_exception();
+      }
+      m_next = m_count;
+    }
+  }
+}
+
+
+/**
+ * @brief The worker threads' main loop: wait for a loop, help run it, report back.
+ */
+void ThreadPool::work() {
+  unsigned long generation = 0;
+  while (true) {
+    {
+      unique_lock<mutex> lock(m_mutex);
+      m_start.wait(lock, [&] { return m_stop || m_generation != generation; });
+      if (m_stop) {
+        return;
+      }
+      generation = m_generation;
+    }
+
+    runTasks();
+
+    {
+      lock_guard<mutex> lock(m_mutex);
+      m_busy--;
+    }
+    m_done.notify_one();
+  }
+}
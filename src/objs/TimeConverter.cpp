@@ -0,0 +1,410 @@
+#include "TimeConverter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+#include "TextKernel.h"
+
+using namespace std;
+
+
+/**
+ * @brief Returns the index of the last of some sorted values that is not after a value, or
+ * 0 if they all are.  The index found for the previous value is tried first.
+ * @param starts  The sorted values.
+ * @param value  The value.
+ * @param hint  The index found for the previous value.
+ */
+static size_t findInterval(const vector<double> &starts, double value, size_t hint) {
+  size_t count = starts.size();
+  if (hint < count && starts[hint] <= value && (hint + 1 == count || value < starts[hint + 1])) {
+    return hint;
+  }
+  size_t next = upper_bound(starts.begin(), starts.end(), value) - starts.begin();
+  return next == 0 ? 0 : next - 1;
+}
+
+
+/**
+ * @brief Copies a numeric kernel variable with a number of values, printing an error if
+ * it cannot.
+ * @param kernel  The kernel.
+ * @param name  The variable.
+ * @param values  Receives the values.
+ * @param count  The number of values it must have, or 0 for any.
+ * @return false if the variable is missing, holds strings or has the wrong number of values.
+ */
+static bool readVariable(const TextKernel &kernel, const string &name, vector<double> &values,
+                         size_t count) {
+  const vector<double> *variable = kernel.numbers(name);
+  if (variable == NULL || variable->empty() || (count > 0 && variable->size() != count)) {
+    cerr << "error while reading time kernels: " << name << " is missing or invalid" << endl;
+    return false;
+  }
+  values = *variable;
+  return true;
+}
+
+
+TimeConverter::TimeConverter() : m_deltaTA(0.0), m_k(0.0), m_eb(0.0), m_clockTdt(false) {
+  m_m[0] = m_m[1] = 0.0;
+}
+
+
+/**
+ * @brief Builds the TAI-UTC table and the TDB - TDT model from a leapseconds kernel.
+ * @param kernel  The LSK (e.g. naif0011.tls).
+ * @return false if the kernel lacks a DELTET variable.
+ */
+bool TimeConverter::loadLeapseconds(const TextKernel &kernel) {
+  vector<double> deltaTA, k, eb, m, deltaAt;
+  if (!readVariable(kernel, "DELTET/DELTA_T_A", deltaTA, 1) ||
+      !readVariable(kernel, "DELTET/K", k, 1) || !readVariable(kernel, "DELTET/EB", eb, 1) ||
+      !readVariable(kernel, "DELTET/M", m, 2) ||
+      !readVariable(kernel, "DELTET/DELTA_AT", deltaAt, 0)) {
+    return false;
+  }
+  if (deltaAt.size() % 2 != 0) {
+    cerr << "error while reading time kernels: DELTET/DELTA_AT is not (value, date) pairs"
+         << endl;
+    return false;
+  }
+
+  m_deltaTA = deltaTA[0];
+  m_k = k[0];
+  m_eb = eb[0];
+  m_m[0] = m[0];
+  m_m[1] = m[1];
+  m_leapDays.clear();
+  m_deltaAt.clear();
+  m_leapSeconds.clear();
+  for (size_t i = 0; i < deltaAt.size(); i += 2) {
+    // The dates are UTC seconds past J2000 at midnight.
+    double day = floor((deltaAt[i + 1] + 43200.0) / 86400.0 + 0.5);
+    if (!m_leapDays.empty() && day <= m_leapDays.back()) {
+      cerr << "error while reading time kernels: DELTET/DELTA_AT is not sorted" << endl;
+      m_leapDays.clear();
+      m_deltaAt.clear();
+      m_leapSeconds.clear();
+      return false;
+    }
+    m_leapDays.push_back(day);
+    m_deltaAt.push_back(deltaAt[i]);
+    m_leapSeconds.push_back(day * 86400.0 - 43200.0);
+  }
+  return true;
+}
+
+
+/**
+ * @brief Builds the partition and record tables of a type 1 spacecraft clock.
+ *
+ * A clock whose parallel time is TDT needs the leapseconds kernel loaded first.
+ *
+ * @param kernel  The SCLK (e.g. messenger_2548.tsc).
+ * @param spacecraftCode  The NAIF code of the spacecraft (e.g. -236 for MESSENGER).
+ * @return false if the kernel lacks a variable of the clock or is not a type 1 clock.
+ */
+bool TimeConverter::loadClock(const TextKernel &kernel, int spacecraftCode) {
+  ostringstream id;
+  id << "_" << -spacecraftCode;
+  vector<double> type, fields, timeSystem, coefficients;
+  m_clockTicks.clear();
+
+  if (kernel.has("SCLK_DATA_TYPE" + id.str()) &&
+      (!readVariable(kernel, "SCLK_DATA_TYPE" + id.str(), type, 1) || type[0] != 1.0)) {
+    cerr << "error while reading time kernels: only type 1 clocks are supported" << endl;
+    return false;
+  }
+  if (!readVariable(kernel, "SCLK01_N_FIELDS" + id.str(), fields, 1) || fields[0] < 1.0 ||
+      !readVariable(kernel, "SCLK01_MODULI" + id.str(), m_moduli, (size_t)fields[0]) ||
+      !readVariable(kernel, "SCLK01_OFFSETS" + id.str(), m_offsets, (size_t)fields[0]) ||
+      !readVariable(kernel, "SCLK_PARTITION_START" + id.str(), m_partitionStart, 0) ||
+      !readVariable(kernel, "SCLK_PARTITION_END" + id.str(), m_partitionEnd,
+                    m_partitionStart.size()) ||
+      !readVariable(kernel, "SCLK01_COEFFICIENTS" + id.str(), coefficients, 0)) {
+    return false;
+  }
+  if (coefficients.size() % 3 != 0) {
+    cerr << "error while reading time kernels: SCLK01_COEFFICIENTS" << id.str()
+         << " is not (ticks, time, rate) triplets" << endl;
+    return false;
+  }
+  m_clockTdt = false;
+  if (kernel.has("SCLK01_TIME_SYSTEM" + id.str())) {
+    if (!readVariable(kernel, "SCLK01_TIME_SYSTEM" + id.str(), timeSystem, 1) ||
+        (timeSystem[0] != 1.0 && timeSystem[0] != 2.0)) {
+      return false;
+    }
+    m_clockTdt = timeSystem[0] == 2.0;
+    if (m_clockTdt && !hasLeapseconds()) {
+      cerr << "error while reading time kernels: a TDT clock needs the leapseconds kernel"
+           << endl;
+      return false;
+    }
+  }
+
+  // A field counts its modulus of the next one; the last counts ticks.
+  m_weights.assign(m_moduli.size(), 1.0);
+  for (size_t i = m_moduli.size() - 1; i > 0; i--) {
+    m_weights[i - 1] = m_weights[i] * m_moduli[i];
+  }
+  m_partitionBase.assign(m_partitionStart.size(), 0.0);
+  for (size_t p = 1; p < m_partitionStart.size(); p++) {
+    m_partitionBase[p] = m_partitionBase[p - 1] + m_partitionEnd[p - 1] -
+                         m_partitionStart[p - 1];
+  }
+
+  // The rates are parallel seconds per count of the first field.
+  m_clockTimes.clear();
+  m_clockRates.clear();
+  for (size_t i = 0; i < coefficients.size(); i += 3) {
+    if (!m_clockTicks.empty() && coefficients[i] <= m_clockTicks.back()) {
+      cerr << "error while reading time kernels: SCLK01_COEFFICIENTS" << id.str()
+           << " is not sorted" << endl;
+      m_clockTicks.clear();
+      return false;
+    }
+    m_clockTicks.push_back(coefficients[i]);
+    m_clockTimes.push_back(coefficients[i + 1]);
+    m_clockRates.push_back(coefficients[i + 2] / m_weights[0]);
+  }
+  return true;
+}
+
+
+/**
+ * @brief Converts a UTC time to ephemeris time.
+ * @param utc  The time, in a form TextKernel::parseCalendar() reads.
+ * @param et  Receives the ephemeris time.
+ * @return false if no leapseconds kernel is loaded or the time is not valid.
+ */
+bool TimeConverter::utcToEt(const string &utc, double &et) const {
+  long day;
+  double seconds;
+  if (!hasLeapseconds() || !TextKernel::parseCalendar(utc, day, seconds)) {
+    return false;
+  }
+  size_t leap = 0;
+  et = etOfUtc(day, seconds, leap);
+  return true;
+}
+
+
+/**
+ * @brief Converts UTC times to ephemeris times.
+ * @param utc  The times, in a form TextKernel::parseCalendar() reads.
+ * @param count  The number of times.
+ * @param et  Receives the ephemeris times; NaN for the times that are not valid.
+ * @return The number of times that are not valid (all of them if no leapseconds kernel is
+ *         loaded).
+ */
+size_t TimeConverter::utcToEt(const string *utc, size_t count, double *et) const {
+  size_t failures = 0;
+  size_t leap = 0;
+  long day;
+  double seconds;
+  for (size_t i = 0; i < count; i++) {
+    if (!hasLeapseconds() || !TextKernel::parseCalendar(utc[i], day, seconds)) {
+      et[i] = numeric_limits<double>::quiet_NaN();
+      failures++;
+      continue;
+    }
+    et[i] = etOfUtc(day, seconds, leap);
+  }
+  return failures;
+}
+
+
+/**
+ * @brief Converts UTC seconds past J2000, counting 86400 seconds a day, to ephemeris times.
+ * These cannot name a time during a leap second, which belongs to the next day.  A
+ * leapseconds kernel must be loaded.
+ * @param utc  The UTC times.
+ * @param count  The number of times.
+ * @param et  Receives the ephemeris times.
+ */
+void TimeConverter::utcSecondsToEt(const double *utc, size_t count, double *et) const {
+  size_t leap = 0;
+  for (size_t i = 0; i < count; i++) {
+    leap = findInterval(m_leapSeconds, utc[i], leap);
+    et[i] = tdtToEt(utc[i] + m_deltaAt[leap] + m_deltaTA);
+  }
+}
+
+
+/**
+ * @brief Converts terrestrial dynamical times (TDT seconds past J2000) to ephemeris times.
+ * A leapseconds kernel must be loaded.
+ * @param tdt  The TDT times.
+ * @param count  The number of times.
+ * @param et  Receives the ephemeris times.
+ */
+void TimeConverter::tdtToEt(const double *tdt, size_t count, double *et) const {
+  for (size_t i = 0; i < count; i++) {
+    et[i] = tdtToEt(tdt[i]);
+  }
+}
+
+
+/**
+ * @brief Encodes a spacecraft clock reading as ticks since the start of the clock, counting
+ * the ticks of every partition before its own.
+ *
+ * The reading is [P/]FIELD[SEP FIELD...], with any of . : - , or blanks between the fields;
+ * missing fields at the end are zero.  Without a partition, the first partition that holds
+ * the reading is used.
+ *
+ * @param sclk  The clock reading (e.g. 1/0108840044:982000).
+ * @param ticks  Receives the encoded ticks.
+ * @return false if no clock kernel is loaded or the reading is not valid.
+ */
+bool TimeConverter::sclkToTicks(const string &sclk, double &ticks) const {
+  if (!hasClock()) {
+    return false;
+  }
+  const char *c = sclk.c_str();
+  while (*c == ' ') {
+    c++;
+  }
+  size_t partition = 0;
+  size_t slash = sclk.find('/');
+  if (slash != string::npos) {
+    char *end = NULL;
+    long value = strtol(c, &end, 10);
+    if (end != sclk.c_str() + slash || value < 1 || (size_t)value > m_partitionStart.size()) {
+      return false;
+    }
+    partition = value;
+    c = end + 1;
+  }
+
+  double reading = 0.0;
+  size_t field = 0;
+  while (*c != '\0') {
+    if (field == m_moduli.size() || !isdigit((unsigned char)*c)) {
+      return false;
+    }
+    double value = 0.0;
+    while (isdigit((unsigned char)*c)) {
+      value = value * 10.0 + (*c - '0');
+      c++;
+    }
+    if (field > 0 && value >= m_moduli[field]) {
+      return false;
+    }
+    reading += (value - m_offsets[field]) * m_weights[field];
+    field++;
+    while (*c == '.' || *c == ':' || *c == '-' || *c == ',' || *c == ' ') {
+      c++;
+    }
+  }
+  if (field == 0) {
+    return false;
+  }
+
+  size_t first = partition > 0 ? partition - 1 : 0;
+  size_t last = partition > 0 ? partition : m_partitionStart.size();
+  for (size_t p = first; p < last; p++) {
+    if (reading >= m_partitionStart[p] && reading <= m_partitionEnd[p]) {
+      ticks = m_partitionBase[p] + reading - m_partitionStart[p];
+      return true;
+    }
+  }
+  return false;
+}
+
+
+/**
+ * @brief Converts a spacecraft clock reading to ephemeris time.
+ * @param sclk  The clock reading (see sclkToTicks()).
+ * @param et  Receives the ephemeris time.
+ * @return false if no clock kernel is loaded or the reading is not valid.
+ */
+bool TimeConverter::sclkToEt(const string &sclk, double &et) const {
+  double ticks;
+  if (!sclkToTicks(sclk, ticks)) {
+    return false;
+  }
+  size_t record = 0;
+  et = etOfTicks(ticks, record);
+  return true;
+}
+
+
+/**
+ * @brief Converts spacecraft clock readings to ephemeris times.
+ * @param sclk  The clock readings (see sclkToTicks()).
+ * @param count  The number of readings.
+ * @param et  Receives the ephemeris times; NaN for the readings that are not valid.
+ * @return The number of readings that are not valid.
+ */
+size_t TimeConverter::sclkToEt(const string *sclk, size_t count, double *et) const {
+  size_t failures = 0;
+  size_t record = 0;
+  double ticks;
+  for (size_t i = 0; i < count; i++) {
+    if (!sclkToTicks(sclk[i], ticks)) {
+      et[i] = numeric_limits<double>::quiet_NaN();
+      failures++;
+      continue;
+    }
+    et[i] = etOfTicks(ticks, record);
+  }
+  return failures;
+}
+
+
+/**
+ * @brief Converts encoded spacecraft clock ticks (see sclkToTicks()) to ephemeris times.
+ * A clock kernel must be loaded.
+ * @param ticks  The encoded ticks.
+ * @param count  The number of times.
+ * @param et  Receives the ephemeris times.
+ */
+void TimeConverter::ticksToEt(const double *ticks, size_t count, double *et) const {
+  size_t record = 0;
+  for (size_t i = 0; i < count; i++) {
+    et[i] = etOfTicks(ticks[i], record);
+  }
+}
+
+
+/**
+ * @brief Returns the ephemeris time of a TDT time: TDT + K sin(E), with E the eccentric
+ * anomaly of the heliocentric orbit.
+ */
+double TimeConverter::tdtToEt(double tdt) const {
+  double meanAnomaly = m_m[0] + m_m[1] * tdt;
+  return tdt + m_k * sin(meanAnomaly + m_eb * sin(meanAnomaly));
+}
+
+
+/**
+ * @brief Returns the ephemeris time of a UTC day and time of day.
+ * @param day  The days past 2000-01-01.
+ * @param seconds  The seconds past the start of the day (past 86400 in a leap second).
+ * @param leap  The TAI-UTC entry of the previous time; receives that of this one.
+ */
+double TimeConverter::etOfUtc(double day, double seconds, size_t &leap) const {
+  leap = findInterval(m_leapDays, day, leap);
+  return tdtToEt(day * 86400.0 - 43200.0 + seconds + m_deltaAt[leap] + m_deltaTA);
+}
+
+
+/**
+ * @brief Returns the ephemeris time of encoded clock ticks, from the clock record they fall
+ * in (the first or last record beyond the ends of the clock).
+ * @param ticks  The encoded ticks.
+ * @param record  The record of the previous ticks; receives that of these.
+ */
+double TimeConverter::etOfTicks(double ticks, size_t &record) const {
+  record = findInterval(m_clockTicks, ticks, record);
+  double time = m_clockTimes[record] + m_clockRates[record] * (ticks - m_clockTicks[record]);
+  return m_clockTdt ? tdtToEt(time) : time;
+}
@@ -0,0 +1,163 @@
+#include <UnitQuaternion.h>
+
+#include <math.h>
+
+// Above this dot product slerp() falls back to nlerp(), whose path is the same to within
+// rounding there and which does not divide by the sine of a tiny angle.
+static const double SLERP_THRESHOLD = 0.9995;
+
+
+/**
+ * Finds the unit quaternion of a rotation matrix, with Shepperd's method: the largest of
+ * w, x, y and z is found from the diagonal, and the others from the off-diagonal elements
+ * divided by it, which keeps the result accurate for every angle.
+ *
+ * @param m The 9 elements of the matrix, row by row.
+ */
+UnitQuaternion UnitQuaternion::fromRotation(const double *m) {
+  double trace = m[0] + m[4] + m[8];
+  UnitQuaternion q;
+  if (trace > 0.0) {
+    double s = 2.0 * sqrt(1.0 + trace);
+    q = UnitQuaternion(0.25 * s, (m[7] - m[5]) / s, (m[2] - m[6]) / s, (m[3] - m[1]) / s);
+  }
+  else if (m[0] > m[4] && m[0] > m[8]) {
+    double s = 2.0 * sqrt(1.0 + m[0] - m[4] - m[8]);
+    q = UnitQuaternion((m[7] - m[5]) / s, 0.25 * s, (m[1] + m[3]) / s, (m[2] + m[6]) / s);
+  }
+  else if (m[4] > m[8]) {
+    double s = 2.0 * sqrt(1.0 + m[4] - m[0] - m[8]);
+    q = UnitQuaternion((m[2] - m[6]) / s, (m[1] + m[3]) / s, 0.25 * s, (m[5] + m[7]) / s);
+  }
+  else {
+    double s = 2.0 * sqrt(1.0 + m[8] - m[0] - m[4]);
+    q = UnitQuaternion((m[3] - m[1]) / s, (m[2] + m[6]) / s, (m[5] + m[7]) / s, 0.25 * s);
+  }
+  return q.normalized();
+}
+
+
+/**
+ * Finds the unit quaternion of the rotation opkToRotation() builds from omega, phi and
+ * kappa (radians), as the product of the rotations about the z, y and x axes.
+ */
+UnitQuaternion UnitQuaternion::fromOpk(double omega, double phi, double kappa) {
+  UnitQuaternion o(cos(0.5 * omega), -sin(0.5 * omega), 0.0, 0.0);
+  UnitQuaternion p(cos(0.5 * phi), 0.0, -sin(0.5 * phi), 0.0);
+  UnitQuaternion k(cos(0.5 * kappa), 0.0, 0.0, -sin(0.5 * kappa));
+  return k * p * o;
+}
+
+
+/**
+ * Returns the quaternion scaled to unit length.
+ */
+UnitQuaternion UnitQuaternion::normalized() const {
+  double scale = 1.0 / sqrt(dot(*this));
+  return UnitQuaternion(w * scale, x * scale, y * scale, z * scale);
+}
+
+
+/**
+ * Writes the rotation matrix of a unit quaternion.
+ *
+ * @param rotation Receives the 9 elements of the matrix, row by row.
+ */
+void UnitQuaternion::toRotation(double *rotation) const {
+  quaternionsToRotations(this, 1, rotation);
+}
+
+
+/**
+ * Rotates a vector.
+ *
+ * @param v The 3 elements of the vector.
+ * @param rotated Receives the 3 elements of the rotated vector.
+ */
+void UnitQuaternion::rotate(const double *v, double *rotated) const {
+  // v + 2w(u x v) + 2u x (u x v), with u the vector part.
+  double tx = 2.0 * (y * v[2] - z * v[1]);
+  double ty = 2.0 * (z * v[0] - x * v[2]);
+  double tz = 2.0 * (x * v[1] - y * v[0]);
+  rotated[0] = v[0] + w * tx + y * tz - z * ty;
+  rotated[1] = v[1] + w * ty + z * tx - x * tz;
+  rotated[2] = v[2] + w * tz + x * ty - y * tx;
+}
+
+
+/**
+ * Interpolates between two attitudes along the shorter arc by normalizing the linear
+ * interpolation of the quaternions.
+ *
+ * @param a The attitude at t = 0.
+ * @param b The attitude at t = 1.
+ * @param t The fraction of the way from a to b.
+ */
+UnitQuaternion UnitQuaternion::nlerp(const UnitQuaternion &a, const UnitQuaternion &b, double t) {
+  // q and -q are the same rotation; take the one nearer a.
+  double sign = a.dot(b) < 0.0 ? -1.0 : 1.0;
+  double s = 1.0 - t;
+  double u = sign * t;
+  return UnitQuaternion(s * a.w + u * b.w, s * a.x + u * b.x, s * a.y + u * b.y,
+                        s * a.z + u * b.z).normalized();
+}
+
+
+/**
+ * Interpolates between two attitudes along the shorter arc at a constant angular rate.
+ *
+ * @param a The attitude at t = 0.
+ * @param b The attitude at t = 1.
+ * @param t The fraction of the way from a to b.
+ */
+UnitQuaternion UnitQuaternion::slerp(const UnitQuaternion &a, const UnitQuaternion &b, double t) {
+  double cosine = a.dot(b);
+  double sign = 1.0;
+  if (cosine < 0.0) {
+    cosine = -cosine;
+    sign = -1.0;
+  }
+  if (cosine > SLERP_THRESHOLD) {
+    return nlerp(a, b, t);
+  }
+  double angle = acos(cosine);
+  double scale = 1.0 / sin(angle);
+  double s = sin((1.0 - t) * angle) * scale;
+  double u = sign * sin(t * angle) * scale;
+  return UnitQuaternion(s * a.w + u * b.w, s * a.x + u * b.x, s * a.y + u * b.y,
+                        s * a.z + u * b.z);
+}
+
+
+/**
+ * Writes the rotation matrices of an array of unit quaternions.
+ *
+ * @param quaternions The quaternions.
+ * @param count The number of quaternions.
+ * @param rotations Receives the 9 elements of each matrix, row by row.
+ */
+void quaternionsToRotations(const UnitQuaternion *quaternions, size_t count, double *rotations) {
+  for (size_t i = 0; i < count; i++) {
+    const UnitQuaternion &q = quaternions[i];
+    double xx = 2.0 * q.x * q.x;
+    double yy = 2.0 * q.y * q.y;
+    double zz = 2.0 * q.z * q.z;
+    double xy = 2.0 * q.x * q.y;
+    double xz = 2.0 * q.x * q.z;
+    double yz = 2.0 * q.y * q.z;
+    double wx = 2.0 * q.w * q.x;
+    double wy = 2.0 * q.w * q.y;
+    double wz = 2.0 * q.w * q.z;
+
+    double *m = rotations + 9 * i;
+    m[0] = 1.0 - yy - zz;
+    m[1] = xy - wz;
+    m[2] = xz + wy;
+    m[3] = xy + wz;
+    m[4] = 1.0 - xx - zz;
+    m[5] = yz - wx;
+    m[6] = xz - wy;
+    m[7] = yz + wx;
+    m[8] = 1.0 - xx - yy;
+  }
+}
@@ -1,25 +1,283 @@
 #include <math.h>
 #include <transformations.h>
+#include <algorithm>
 #include <iostream>
-Matrix3d opkToRotation(float omega, float phi, float kappa) {
-  Matrix3d o;
-  o << 1, 0, 0,
-       0, cos(omega), sin(omega),
-       0, -sin(omega), cos(omega);
-
-  Matrix3d p;
-  p << cos(phi), 0, -sin(phi),
-       0, 1, 0,
-       sin(phi), 0, cos(phi);
-
-  Matrix3d k;
-  k << cos(kappa), sin(kappa), 0,
-       -sin(kappa), cos(kappa), 0,
-       0, 0, 1;
-
-  //Chain multiplication roation = k*p*o
-  k *= p;
-  k *= o;
-  return k;
 
+/**
+ * Builds the rotation matrix k*p*o of omega, phi and kappa (radians), the photogrammetric
+ * rotation of Mikhail, Modern Photogrammetry, p. 373.
+ */
+Matrix3d opkToRotation(double omega, double phi, double kappa) {
+  double opk[3] = { omega, phi, kappa };
+  double m[9];
+  opkToRotation(opk, 1, m);
+  Matrix3d rotation;
+  rotation << m[0], m[1], m[2],
+              m[3], m[4], m[5],
+              m[6], m[7], m[8];
+  return rotation;
+}
+
+
+/**
+ * Builds the rotation matrices of an array of (omega, phi, kappa) triples in closed form,
+ * and optionally their derivatives with respect to each angle (e.g. for the partials of a
+ * bundle adjustment).
+ *
+ * @param opk The count triples, in radians.
+ * @param count The number of triples.
+ * @param rotations Receives the 9 elements of each matrix, row by row.
+ * @param derivatives If not NULL, receives 27 elements per triple: the derivatives of the
+ *                    matrix with respect to omega, phi and kappa, each row by row.
+ */
+void opkToRotation(const double *opk, size_t count, double *rotations, double *derivatives) {
+  for (size_t i = 0; i < count; i++) {
+    const double sinw = sin(opk[3 * i]);
+    const double cosw = cos(opk[3 * i]);
+    const double sinp = sin(opk[3 * i + 1]);
+    const double cosp = cos(opk[3 * i + 1]);
+    const double sink = sin(opk[3 * i + 2]);
+    const double cosk = cos(opk[3 * i + 2]);
+
+    double *m = rotations + 9 * i;
+    m[0] = cosp * cosk;
+    m[1] = cosw * sink + sinw * sinp * cosk;
+    m[2] = sinw * sink - cosw * sinp * cosk;
+    m[3] = -cosp * sink;
+    m[4] = cosw * cosk - sinw * sinp * sink;
+    m[5] = sinw * cosk + cosw * sinp * sink;
+    m[6] = sinp;
+    m[7] = -sinw * cosp;
+    m[8] = cosw * cosp;
+    if (derivatives == NULL) {
+      continue;
+    }
+
+    // Omega only turns the last two columns.
+    double *d = derivatives + 27 * i;
+    d[0] = 0.0;
+    d[1] = -sinw * sink + cosw * sinp * cosk;
+    d[2] = cosw * sink + sinw * sinp * cosk;
+    d[3] = 0.0;
+    d[4] = -sinw * cosk - cosw * sinp * sink;
+    d[5] = cosw * cosk - sinw * sinp * sink;
+    d[6] = 0.0;
+    d[7] = -cosw * cosp;
+    d[8] = -sinw * cosp;
+
+    d += 9;
+    d[0] = -sinp * cosk;
+    d[1] = sinw * cosp * cosk;
+    d[2] = -cosw * cosp * cosk;
+    d[3] = sinp * sink;
+    d[4] = -sinw * cosp * sink;
+    d[5] = cosw * cosp * sink;
+    d[6] = cosp;
+    d[7] = sinw * sinp;
+    d[8] = -cosw * sinp;
+
+    // Kappa turns the first two rows into each other.
+    d += 9;
+    d[0] = m[3];
+    d[1] = m[4];
+    d[2] = m[5];
+    d[3] = -m[0];
+    d[4] = -m[1];
+    d[5] = -m[2];
+    d[6] = 0.0;
+    d[7] = 0.0;
+    d[8] = 0.0;
+  }
+}
+
+
+/**
+ * Finds the (omega, phi, kappa) triples of an array of rotation matrices built as by
+ * opkToRotation(), with phi in [-pi/2, pi/2].
+ *
+ * @param rotations The 9 elements of each matrix, row by row.
+ * @param count The number of matrices.
+ * @param opk Receives the count triples, in radians.
+ */
+void rotationToOpk(const double *rotations, size_t count, double *opk) {
+  for (size_t i = 0; i < count; i++) {
+    const double *m = rotations + 9 * i;
+    opk[3 * i] = atan2(-m[7], m[8]);
+    opk[3 * i + 1] = asin(std::max(-1.0, std::min(1.0, m[6])));
+    opk[3 * i + 2] = atan2(-m[3], m[0]);
+  }
+}
+
+
+/**
+ * Converts an array of body-fixed (x, y, z) points to (latitude, longitude, height) on a
+ * sphere (semiMajor == semiMinor, planetocentric latitude) or a biaxial ellipsoid (geodetic
+ * latitude, with Heikkinen's closed form).  The loops have no iterations or branches that
+ * depend on the points, so they vectorize with a vector math library.
+ *
+ * The ellipsoid form holds away from the center of the body (e.g. for points within a
+ * few body radii of the surface).  A point with NaN coordinates converts to NaNs.
+ *
+ * @param ecef The count points, in the units of the axes.
+ * @param count The number of points.
+ * @param semiMajor The equatorial radius.
+ * @param semiMinor The polar radius.
+ * @param geodetic Receives the count triples: latitude and longitude in radians (longitude
+ *                 in [-pi, pi]) and height in the units of the axes.  It may be ecef, to
+ *                 convert in place.
+ */
+void ecefToGeodetic(const double *ecef, size_t count, double semiMajor, double semiMinor,
+                    double *geodetic) {
+  if (semiMajor == semiMinor) {
+    for (size_t i = 0; i < count; i++) {
+      const double x = ecef[3 * i];
+      const double y = ecef[3 * i + 1];
+      const double z = ecef[3 * i + 2];
+      const double p = sqrt(x * x + y * y);
+      geodetic[3 * i] = atan2(z, p);
+      geodetic[3 * i + 1] = atan2(y, x);
+      geodetic[3 * i + 2] = sqrt(p * p + z * z) - semiMajor;
+    }
+    return;
+  }
+
+  const double a2 = semiMajor * semiMajor;
+  const double b2 = semiMinor * semiMinor;
+  const double e2 = (a2 - b2) / a2;
+  const double ep2 = (a2 - b2) / b2;
+  for (size_t i = 0; i < count; i++) {
+    const double x = ecef[3 * i];
+    const double y = ecef[3 * i + 1];
+    const double z = ecef[3 * i + 2];
+    const double p2 = x * x + y * y;
+    const double p = sqrt(p2);
+    const double z2 = z * z;
+
+    const double f = 54.0 * b2 * z2;
+    const double g = p2 + (1.0 - e2) * z2 - e2 * (a2 - b2);
+    const double c = e2 * e2 * f * p2 / (g * g * g);
+    const double s = cbrt(1.0 + c + sqrt(c * c + 2.0 * c));
+    const double k = s + 1.0 + 1.0 / s;
+    const double q = f / (3.0 * k * k * g * g);
+    const double r = sqrt(1.0 + 2.0 * e2 * e2 * q);
+    // At the poles the radicand is 0, or just below it after rounding.
+    const double r0 = -q * e2 * p / (1.0 + r) +
+                      sqrt(std::max(0.0, 0.5 * a2 * (1.0 + 1.0 / r) -
+                                         q * (1.0 - e2) * z2 / (r * (1.0 + r)) - 0.5 * q * p2));
+    const double pe = p - e2 * r0;
+    const double u = sqrt(pe * pe + z2);
+    const double v = sqrt(pe * pe + (1.0 - e2) * z2);
+    const double z0 = b2 * z / (semiMajor * v);
+
+    geodetic[3 * i] = atan2(z + ep2 * z0, p);
+    geodetic[3 * i + 1] = atan2(y, x);
+    geodetic[3 * i + 2] = u * (1.0 - b2 / (semiMajor * v));
+  }
+}
+
+
+/**
+ * Converts an array of (latitude, longitude, height) triples, as ecefToGeodetic() finds
+ * them, to body-fixed (x, y, z) points.
+ *
+ * @param geodetic The count triples: latitude and longitude in radians and height in the
+ *                 units of the axes.
+ * @param count The number of triples.
+ * @param semiMajor The equatorial radius.
+ * @param semiMinor The polar radius.
+ * @param ecef Receives the count points.  It may be geodetic, to convert in place.
+ */
+void geodeticToEcef(const double *geodetic, size_t count, double semiMajor, double semiMinor,
+                    double *ecef) {
+  const double e2 = 1.0 - semiMinor * semiMinor / (semiMajor * semiMajor);
+  for (size_t i = 0; i < count; i++) {
+    const double sinLat = sin(geodetic[3 * i]);
+    const double cosLat = cos(geodetic[3 * i]);
+    const double sinLon = sin(geodetic[3 * i + 1]);
+    const double cosLon = cos(geodetic[3 * i + 1]);
+    const double height = geodetic[3 * i + 2];
+
+    // The prime vertical radius of curvature, semiMajor on a sphere.
+    const double n = semiMajor / sqrt(1.0 - e2 * sinLat * sinLat);
+    ecef[3 * i] = (n + height) * cosLat * cosLon;
+    ecef[3 * i + 1] = (n + height) * cosLat * sinLon;
+    ecef[3 * i + 2] = (n * (1.0 - e2) + height) * sinLat;
+  }
+}
+
+
+/**
+ * Builds the local east, north, up frame at a (latitude, longitude, height) origin: its
+ * body-fixed position and the rotation from body-fixed to ENU axes, row by row.
+ */
+static void enuFrame(const double *origin, double semiMajor, double semiMinor,
+                     double *position, double *m) {
+  geodeticToEcef(origin, 1, semiMajor, semiMinor, position);
+  const double sinLat = sin(origin[0]);
+  const double cosLat = cos(origin[0]);
+  const double sinLon = sin(origin[1]);
+  const double cosLon = cos(origin[1]);
+  m[0] = -sinLon;
+  m[1] = cosLon;
+  m[2] = 0.0;
+  m[3] = -sinLat * cosLon;
+  m[4] = -sinLat * sinLon;
+  m[5] = cosLat;
+  m[6] = cosLat * cosLon;
+  m[7] = cosLat * sinLon;
+  m[8] = sinLat;
+}
+
+
+/**
+ * Converts an array of body-fixed (x, y, z) points to (east, north, up) coordinates in the
+ * local frame at an origin on or above the ellipsoid (a sphere if semiMajor == semiMinor).
+ *
+ * @param ecef The count points, in the units of the axes.
+ * @param count The number of points.
+ * @param origin The (latitude, longitude, height) of the origin, as ecefToGeodetic() finds
+ *               it.
+ * @param semiMajor The equatorial radius.
+ * @param semiMinor The polar radius.
+ * @param enu Receives the count (east, north, up) triples.  It may be ecef, to convert in
+ *            place.  A point with NaN coordinates converts to NaNs.
+ */
+void ecefToEnu(const double *ecef, size_t count, const double *origin, double semiMajor,
+               double semiMinor, double *enu) {
+  double position[3], m[9];
+  enuFrame(origin, semiMajor, semiMinor, position, m);
+  for (size_t i = 0; i < count; i++) {
+    const double dx = ecef[3 * i] - position[0];
+    const double dy = ecef[3 * i + 1] - position[1];
+    const double dz = ecef[3 * i + 2] - position[2];
+    enu[3 * i] = m[0] * dx + m[1] * dy;
+    enu[3 * i + 1] = m[3] * dx + m[4] * dy + m[5] * dz;
+    enu[3 * i + 2] = m[6] * dx + m[7] * dy + m[8] * dz;
+  }
+}
+
+
+/**
+ * Converts an array of (east, north, up) triples in the local frame at an origin, as
+ * ecefToEnu() finds them, to body-fixed (x, y, z) points.
+ *
+ * @param enu The count triples, in the units of the axes.
+ * @param count The number of triples.
+ * @param origin The (latitude, longitude, height) of the origin.
+ * @param semiMajor The equatorial radius.
+ * @param semiMinor The polar radius.
+ * @param ecef Receives the count points.  It may be enu, to convert in place.
+ */
+void enuToEcef(const double *enu, size_t count, const double *origin, double semiMajor,
+               double semiMinor, double *ecef) {
+  double position[3], m[9];
+  enuFrame(origin, semiMajor, semiMinor, position, m);
+  for (size_t i = 0; i < count; i++) {
+    const double east = enu[3 * i];
+    const double north = enu[3 * i + 1];
+    const double up = enu[3 * i + 2];
+    ecef[3 * i] = position[0] + m[0] * east + m[3] * north + m[6] * up;
+    ecef[3 * i + 1] = position[1] + m[1] * east + m[4] * north + m[7] * up;
+    ecef[3 * i + 2] = position[2] + m[5] * north + m[8] * up;
+  }
 }
@@ -0,0 +1,112 @@
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <csm/Error.h>
+#include <csm/Isd.h>
+
+#include <gtest/gtest.h>
+
+#include <Backplanes.h>
+#include <IsdReader.h>
+#include <MdisNacSensorModel.h>
+#include <MdisPlugin.h>
+#include <TextBuffer.h>
+
+#include "TestFrameModel.h"
+
+
+TEST(BackplanesTest, illuminationDirection) {
+  csm::EcefCoord center;
+  MdisNacSensorModel *model = createTestFrameModel(false, &center);
+  ASSERT_TRUE(model != NULL);
+  EXPECT_THROW(model->getIlluminationDirection(center), csm::Error);
+  delete model;
+
+  model = createTestFrameModel(true, &center);
+  ASSERT_TRUE(model != NULL);
+  csm::EcefCoord sensor = model->getSensorPosition(csm::ImageCoord(1, 1));
+  csm::EcefVector direction = model->getIlluminationDirection(center);
+  double range = sqrt((sensor.x - center.x) * (sensor.x - center.x) +
+                      (sensor.y - center.y) * (sensor.y - center.y) +
+                      (sensor.z - center.z) * (sensor.z - center.z));
+  // The light comes from the sensor's direction.
+  EXPECT_NEAR((center.x - sensor.x) / range, direction.x, 1e-9);
+  EXPECT_NEAR((center.y - sensor.y) / range, direction.y, 1e-9);
+  EXPECT_NEAR((center.z - sensor.z) / range, direction.z, 1e-9);
+  delete model;
+}
+
+
+TEST(BackplanesTest, computePixel) {
+  csm::EcefCoord center;
+  MdisNacSensorModel *model = createTestFrameModel(true, &center);
+  ASSERT_TRUE(model != NULL);
+  Backplanes backplanes(*model);
+
+  float values[Backplanes::NUM_BACKPLANES];
+  backplanes.computePixel(csm::ImageCoord(512.5, 512.5), values, 1);
+
+  double radius = sqrt(center.x * center.x + center.y * center.y + center.z * center.z);
+  EXPECT_NEAR(2439.4, values[Backplanes::RADIUS], 1e-3);
+  EXPECT_NEAR(asin(center.z / radius) * 180 / M_PI, values[Backplanes::LATITUDE], 1e-4);
+  EXPECT_NEAR(atan2(center.y, center.x) * 180 / M_PI + 360, values[Backplanes::LONGITUDE],
+              1e-4);
+  EXPECT_NEAR(0.0, values[Backplanes::PHASE], 0.05);
+  EXPECT_NEAR(values[Backplanes::EMISSION], values[Backplanes::INCIDENCE], 0.05);
+  EXPECT_GT(values[Backplanes::EMISSION], 0.0);
+  EXPECT_LT(values[Backplanes::EMISSION], 90.0);
+
+  csm::EcefCoord sensor = model->getSensorPosition(0.0);
+  double range = sqrt((sensor.x - center.x) * (sensor.x - center.x) +
+                      (sensor.y - center.y) * (sensor.y - center.y) +
+                      (sensor.z - center.z) * (sensor.z - center.z));
+  EXPECT_NEAR(range * 0.014 / 549.1178195372703, values[Backplanes::RESOLUTION], 1e-3);
+  delete model;
+}
+
+
+TEST(BackplanesTest, offBody) {
+  // Turn the camera around, so that it looks away from the body.
+  csm::Isd *isd = readISD(g_dataPath + "/EN1007907102M.json");
+  ASSERT_TRUE(isd != NULL);
+  double omega = atof(isd->param("omega").c_str()) + M_PI;
+  char value[MAX_NUMBER_LENGTH];
+  formatDouble(omega, value);
+  isd->clearParams("omega");
+  isd->addParam("omega", value);
+  MdisPlugin plugin;
+  MdisNacSensorModel *model = dynamic_cast<MdisNacSensorModel *>(
+      plugin.constructModelFromISD(*isd, MdisNacSensorModel::_SENSOR_MODEL_NAME));
+  delete isd;
+  ASSERT_TRUE(model != NULL);
+  Backplanes backplanes(*model);
+
+  float values[Backplanes::NUM_BACKPLANES];
+  backplanes.computePixel(csm::ImageCoord(512.5, 512.5), values, 1);
+  for (int band = 0; band < Backplanes::NUM_BACKPLANES; band++) {
+    EXPECT_TRUE(std::isnan(values[band])) << Backplanes::name(Backplanes::Backplane(band));
+  }
+  delete model;
+}
+
+
+TEST(BackplanesTest, computeRow) {
+  csm::EcefCoord center;
+  MdisNacSensorModel *model = createTestFrameModel(true, &center);
+  ASSERT_TRUE(model != NULL);
+  Backplanes backplanes(*model);
+
+  // Row 2 of every 10th sample of every 5th line, starting at sample 101, line 201.
+  ImageWindow window(100, 200, 50, 20, 10, 5);
+  std::vector<float> row(Backplanes::NUM_BACKPLANES * window.outputSamples());
+  backplanes.computeRow(window, 2, row.data(), window.outputSamples());
+
+  float values[Backplanes::NUM_BACKPLANES];
+  backplanes.computePixel(csm::ImageCoord(211, 131), values, 1);
+  for (int band = 0; band < Backplanes::NUM_BACKPLANES; band++) {
+    EXPECT_EQ(values[band], row[band * window.outputSamples() + 3]);
+  }
+  delete model;
+}
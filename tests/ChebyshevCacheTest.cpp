@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <ChebyshevCache.h>
+
+
+/**
+ * An orbit-like function: a position on a circle, in meters, and an angle.
+ */
+static bool orbit(double time, double *values, std::vector<double> *times) {
+  if (times != NULL) {
+    times->push_back(time);
+  }
+  values[0] = 2.5e6 * cos(time / 1000.0);
+  values[1] = 2.5e6 * sin(time / 1000.0);
+  values[2] = 0.1 * time;
+  return true;
+}
+
+
+static ChebyshevCache orbitCache() {
+  std::vector<double> tolerances;
+  tolerances.push_back(1e-3);
+  tolerances.push_back(1e-3);
+  tolerances.push_back(1e-9);
+  return ChebyshevCache(tolerances, 10, 1.0);
+}
+
+
+TEST(ChebyshevCacheTest, fit) {
+  ChebyshevCache cache = orbitCache();
+  std::vector<double> times;
+  using namespace std::placeholders;
+  ASSERT_TRUE(cache.fit(std::bind(orbit, _1, _2, &times), 0.0, 20000.0));
+  EXPECT_GT(cache.segments(), 1u);
+  EXPECT_LE(cache.errors()[0], 1e-3);
+  EXPECT_LE(cache.errors()[2], 1e-9);
+
+  double values[3], rates[3], expected[3];
+  for (double time = 0.0; time <= 20000.0; time += 37.3) {
+    ASSERT_TRUE(cache.evaluate(time, values, rates));
+    orbit(time, expected, NULL);
+    EXPECT_NEAR(expected[0], values[0], 2e-3) << time;
+    EXPECT_NEAR(expected[1], values[1], 2e-3) << time;
+    EXPECT_NEAR(expected[2], values[2], 2e-9) << time;
+    EXPECT_NEAR(-2500.0 * sin(time / 1000.0), rates[0], 1e-4) << time;
+    EXPECT_NEAR(0.1, rates[2], 1e-9) << time;
+  }
+  EXPECT_FALSE(cache.evaluate(-1.0, values));
+  EXPECT_FALSE(cache.evaluate(20000.5, values));
+  EXPECT_TRUE(cache.covers(0.0, 20000.0));
+  EXPECT_FALSE(cache.covers(0.0, 20001.0));
+
+  // A window that overlaps the fitted one is only sampled where it is new.
+  size_t segments = cache.segments();
+  times.clear();
+  ASSERT_TRUE(cache.fit(std::bind(orbit, _1, _2, &times), 15000.0, 30000.0));
+  EXPECT_GT(cache.segments(), segments);
+  ASSERT_FALSE(times.empty());
+  EXPECT_GE(*std::min_element(times.begin(), times.end()), 20000.0);
+  EXPECT_TRUE(cache.covers(0.0, 30000.0));
+
+  times.clear();
+  ASSERT_TRUE(cache.fit(std::bind(orbit, _1, _2, &times), 100.0, 200.0));
+  EXPECT_TRUE(times.empty());
+}
+
+
+/**
+ * A function with a jump, which no polynomial fits.
+ */
+static bool step(double time, double *values) {
+  values[0] = 0.0;
+  values[1] = time < 500.0 ? 0.0 : 1.0;
+  values[2] = 0.0;
+  return true;
+}
+
+
+/**
+ * A function that can only be sampled before 500.
+ */
+static bool limited(double time, double *values) {
+  orbit(time, values, NULL);
+  return time < 500.0;
+}
+
+
+TEST(ChebyshevCacheTest, failures) {
+  ChebyshevCache cache = orbitCache();
+  using namespace std::placeholders;
+  ASSERT_TRUE(cache.fit(std::bind(orbit, _1, _2, (std::vector<double> *)NULL), 0.0, 100.0));
+  size_t segments = cache.segments();
+
+  EXPECT_FALSE(cache.fit(step, 200.0, 1000.0));
+  EXPECT_FALSE(cache.fit(limited, 200.0, 1000.0));
+  EXPECT_FALSE(cache.fit(limited, 300.0, 200.0));
+  EXPECT_EQ(segments, cache.segments());
+  EXPECT_FALSE(cache.covers(300.0));
+  EXPECT_LE(cache.errors()[1], 1e-3);
+
+  EXPECT_FALSE(ChebyshevCache().fit(limited, 0.0, 100.0));
+}
+
+
+TEST(ChebyshevCacheTest, saveAndLoad) {
+  ChebyshevCache cache = orbitCache();
+  cache.setLabel("MERCURY");
+  using namespace std::placeholders;
+  ASSERT_TRUE(cache.fit(std::bind(orbit, _1, _2, (std::vector<double> *)NULL), 0.0, 5000.0));
+  ASSERT_TRUE(cache.fit(std::bind(orbit, _1, _2, (std::vector<double> *)NULL), 9000.0,
+                        9500.0));
+
+  std::string filename("ChebyshevCacheTest.cheb");
+  ASSERT_TRUE(cache.save(filename));
+  ChebyshevCache loaded;
+  ASSERT_TRUE(loaded.load(filename));
+  EXPECT_EQ("MERCURY", loaded.label());
+  EXPECT_EQ(3, loaded.components());
+  EXPECT_EQ(cache.segments(), loaded.segments());
+  EXPECT_EQ(cache.errors(), loaded.errors());
+  EXPECT_FALSE(loaded.covers(7000.0));
+
+  double values[3], expected[3];
+  for (double time = 0.0; time <= 9500.0; time += 250.0) {
+    ASSERT_EQ(cache.evaluate(time, expected), loaded.evaluate(time, values)) << time;
+    if (cache.covers(time)) {
+      EXPECT_EQ(expected[0], values[0]);
+      EXPECT_EQ(expected[2], values[2]);
+    }
+  }
+
+  // A truncated file is rejected.
+  FILE *file = fopen(filename.c_str(), "r+b");
+  ASSERT_TRUE(file != NULL);
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fclose(file);
+  ASSERT_EQ(0, truncate(filename.c_str(), size - 8));
+  EXPECT_FALSE(loaded.load(filename));
+  EXPECT_EQ(0u, loaded.segments());
+  std::remove(filename.c_str());
+}
@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <CubeLoader.h>
+#include <RasterReader.h>
+
+// runTest.cpp defines this global string to a data directory
+extern std::string g_dataPath;
+
+
+TEST(CubeLoaderTest, loadInOrder) {
+  std::string cubeFile = g_dataPath + "/CN0108840044M_IF_5_NAC_spiced.cub";
+  RasterReader fileReader;
+  ASSERT_TRUE(fileReader.open(cubeFile));
+  RasterBuffer expected;
+  ASSERT_TRUE(fileReader.readAll(expected));
+
+  // Small reads and few files in memory, so reads of several files are in flight at once
+  // and memory is reused.
+  std::vector<std::string> filenames(5, cubeFile);
+  filenames[2] = g_dataPath + "/naif0011.tls.txt";
+  CubeLoader loader(8, 3, 100000);
+
+  std::vector<int> order;
+  EXPECT_TRUE(loader.load(filenames, [&](int index, const unsigned char *data, size_t size) {
+    order.push_back(index);
+    EXPECT_TRUE(data != NULL);
+    if (index == 2) {
+      FILE *file = fopen(filenames[2].c_str(), "rb");
+      std::vector<unsigned char> text(size + 1);
+      EXPECT_EQ(size, fread(&text[0], 1, text.size(), file));
+      fclose(file);
+      EXPECT_TRUE(std::equal(data, data + size, text.begin()));
+      return true;
+    }
+
+    RasterReader reader;
+    EXPECT_TRUE(reader.open(filenames[index], data, size));
+    RasterBuffer pixels;
+    EXPECT_TRUE(reader.readAll(pixels));
+    EXPECT_EQ(expected.at(100, 200), pixels.at(100, 200));
+    EXPECT_EQ(expected.at(511, 511), pixels.at(511, 511));
+    return true;
+  }));
+
+  ASSERT_EQ(5u, order.size());
+  for (int i = 0; i < 5; i++) {
+    EXPECT_EQ(i, order[i]);
+  }
+}
+
+
+TEST(CubeLoaderTest, failures) {
+  std::vector<std::string> filenames;
+  filenames.push_back(g_dataPath + "/does_not_exist.cub");
+  filenames.push_back(g_dataPath + "/CN0108840044M_IF_5_NAC_spiced.cub");
+  filenames.push_back(g_dataPath + "/CN0108840044M_IF_5_NAC_spiced.cub");
+  CubeLoader loader;
+
+  std::vector<int> order;
+  EXPECT_FALSE(loader.load(filenames, [&](int index, const unsigned char *data, size_t size) {
+    order.push_back(index);
+    EXPECT_EQ(index == 0, data == NULL);
+    // Stop after the first cube.
+    return index == 0;
+  }));
+  ASSERT_EQ(2u, order.size());
+  EXPECT_EQ(1, order[1]);
+}
@@ -0,0 +1,264 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <CubeReader.h>
+
+// runTest.cpp defines this global string to a data directory
+extern std::string g_dataPath;
+
+
+TEST(CubeReaderTest, readTiledCube) {
+  std::string filename = g_dataPath + "/CN0108840044M_IF_5_NAC_spiced.cub";
+  EXPECT_TRUE(CubeReader::isCube(filename));
+
+  CubeReader cube;
+  ASSERT_TRUE(cube.open(filename));
+  EXPECT_EQ(512, cube.samples());
+  EXPECT_EQ(512, cube.lines());
+  EXPECT_EQ(1, cube.bands());
+  EXPECT_EQ(CubeReader::TILE_FORMAT, cube.format());
+  EXPECT_EQ(CubeReader::REAL, cube.pixelType());
+  EXPECT_EQ(512, cube.blockSamples());
+  EXPECT_EQ(512, cube.blockLines());
+  ASSERT_TRUE(cube.isDirect());
+
+  // The only tile starts at StartByte = 65537 of the file.
+  std::vector<float> expected(512 * 512);
+  FILE *file = fopen(filename.c_str(), "rb");
+  ASSERT_TRUE(file != NULL);
+  ASSERT_EQ(0, fseek(file, 65536, SEEK_SET));
+  ASSERT_EQ(expected.size(), fread(&expected[0], sizeof(float), expected.size(), file));
+  fclose(file);
+
+  const float *tile = cube.block(1, 0, 0);
+  ASSERT_TRUE(tile != NULL);
+  EXPECT_EQ(0, memcmp(&expected[0], tile, expected.size() * sizeof(float)));
+  EXPECT_TRUE(cube.block(1, 1, 0) == NULL);
+  EXPECT_TRUE(cube.block(2, 0, 0) == NULL);
+
+  std::vector<float> window(30 * 20);
+  ASSERT_TRUE(cube.read(&window[0], 30, 1, 100, 200, 30, 20));
+  EXPECT_EQ(expected[200 * 512 + 100], window[0]);
+  EXPECT_EQ(expected[219 * 512 + 129], window[19 * 30 + 29]);
+
+  EXPECT_FALSE(cube.read(&window[0], 30, 1, 500, 0, 13, 1));
+
+  EXPECT_EQ("MDIS-NAC", cube.instrumentValue("InstrumentId"));
+  EXPECT_EQ("2008-01-14T23:17:44.078578", cube.instrumentValue("StartTime"));
+  EXPECT_EQ("8", cube.instrumentValue("ExposureDuration"));
+  EXPECT_EQ("", cube.instrumentValue("ProductId"));
+}
+
+
+TEST(CubeReaderTest, notACube) {
+  std::string filename = g_dataPath + "/EN1007907102M.json";
+  EXPECT_FALSE(CubeReader::isCube(filename));
+
+  CubeReader cube;
+  EXPECT_FALSE(cube.open(filename));
+  EXPECT_FALSE(cube.isOpen());
+  EXPECT_FALSE(cube.open(g_dataPath + "/does_not_exist.cub"));
+}
+
+
+// The special pixels of ISIS as float bits, and as the stored values of 8 and 16 bit cubes.
+static const uint32_t NULL4 = 0xFF7FFFFB;
+static const uint32_t LOW_INSTR_SAT4 = 0xFF7FFFFD;
+static const uint32_t HIGH_REPR_SAT4 = 0xFF7FFFFF;
+
+
+/**
+ * Builds a cube file in memory: an attached label, then the core at byte 1025.
+ */
+static std::vector<unsigned char> makeCube(const std::string &format, int samples, int lines,
+                                           int bands, const std::string &type,
+                                           const std::string &byteOrder,
+                                           const std::string &scaling,
+                                           const std::vector<unsigned char> &core) {
+  char dimensions[128];
+  snprintf(dimensions, sizeof(dimensions),
+           "    Group = Dimensions\n      Samples = %d\n      Lines = %d\n"
+           "      Bands = %d\n    End_Group\n", samples, lines, bands);
+  std::string label = "Object = IsisCube\n  Object = Core\n    StartByte = 1025\n" + format +
+                      dimensions + "    Group = Pixels\n      Type = " + type +
+                      "\n      ByteOrder = " + byteOrder + "\n" + scaling +
+                      "    End_Group\n  End_Object\nEnd_Object\nEnd\n";
+  std::vector<unsigned char> cube(1024, ' ');
+  memcpy(&cube[0], label.data(), label.size());
+  cube.insert(cube.end(), core.begin(), core.end());
+  return cube;
+}
+
+
+/**
+ * Appends a pixel of size bytes to a core in a byte order.
+ */
+static void appendPixel(std::vector<unsigned char> &core, uint32_t bits, int size, bool msb) {
+  for (int i = 0; i < size; i++) {
+    int shift = 8 * (msb ? size - 1 - i : i);
+    core.push_back((bits >> shift) & 0xFF);
+  }
+}
+
+
+static uint32_t bitsOf(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+
+TEST(CubeReaderTest, readBandSequentialBytes) {
+  // 3 x 2 x 2 bands; band 2 is band 1 plus 10.  0 is Null and 255 HighReprSat.
+  std::vector<unsigned char> core;
+  const unsigned char band1[] = { 1, 2, 3, 0, 5, 255 };
+  for (int band = 0; band < 2; band++) {
+    for (int i = 0; i < 6; i++) {
+      core.push_back(band1[i] == 0 || band1[i] == 255 ? band1[i] : band1[i] + 10 * band);
+    }
+  }
+  std::vector<unsigned char> file = makeCube("    Format = BandSequential\n", 3, 2, 2,
+                                             "UnsignedByte", "Lsb",
+                                             "      Base = 1.0\n      Multiplier = 2.0\n",
+                                             core);
+  CubeReader cube;
+  ASSERT_TRUE(cube.open("bands.cub", &file[0], file.size()));
+  EXPECT_EQ(CubeReader::BAND_SEQUENTIAL_FORMAT, cube.format());
+  EXPECT_EQ(CubeReader::UNSIGNED_BYTE, cube.pixelType());
+  EXPECT_EQ(3, cube.blockSamples());
+  EXPECT_EQ(2, cube.blockLines());
+  EXPECT_FALSE(cube.isDirect());
+  EXPECT_TRUE(cube.block(1, 0, 0) == NULL);
+
+  float values[6];
+  ASSERT_TRUE(cube.read(values, 3, 2, 0, 0, 3, 2));
+  EXPECT_EQ(23.0f, values[0]);
+  EXPECT_EQ(27.0f, values[2]);
+  EXPECT_EQ(NULL4, bitsOf(values[3]));
+  EXPECT_EQ(31.0f, values[4]);
+  EXPECT_EQ(HIGH_REPR_SAT4, bitsOf(values[5]));
+
+  // A window of band 1 into a wider buffer.
+  float window[5] = { 0, 0, -7, 0, 0 };
+  ASSERT_TRUE(cube.read(window, 3, 1, 1, 0, 2, 2));
+  EXPECT_EQ(5.0f, window[0]);
+  EXPECT_EQ(7.0f, window[1]);
+  EXPECT_EQ(-7.0f, window[2]);
+  EXPECT_EQ(11.0f, window[3]);
+  EXPECT_EQ(HIGH_REPR_SAT4, bitsOf(window[4]));
+}
+
+
+TEST(CubeReaderTest, readTilesAcrossBoundaries) {
+  // 5 x 3 pixels in 2 x 2 tiles: a grid of 3 x 2 tiles, padded with -1 past the edges.
+  // Pixel (line, sample) is 100 * line + sample.
+  std::vector<unsigned char> core;
+  for (int tileRow = 0; tileRow < 2; tileRow++) {
+    for (int tileColumn = 0; tileColumn < 3; tileColumn++) {
+      for (int line = 2 * tileRow; line < 2 * tileRow + 2; line++) {
+        for (int sample = 2 * tileColumn; sample < 2 * tileColumn + 2; sample++) {
+          float value = line < 3 && sample < 5 ? 100.0f * line + sample : -1.0f;
+          appendPixel(core, bitsOf(value), 4, false);
+        }
+      }
+    }
+  }
+  std::vector<unsigned char> file = makeCube("    Format = Tile\n    TileSamples = 2\n"
+                                             "    TileLines = 2\n", 5, 3, 1, "Real", "Lsb", "",
+                                             core);
+  CubeReader cube;
+  ASSERT_TRUE(cube.open("tiles.cub", &file[0], file.size()));
+  EXPECT_EQ(CubeReader::TILE_FORMAT, cube.format());
+  EXPECT_EQ(2, cube.blockSamples());
+  EXPECT_EQ(2, cube.blockLines());
+
+  // The last tile holds pixel (2, 4) and its padding.
+  const float *tile = cube.block(1, 1, 2);
+  ASSERT_TRUE(tile != NULL);
+  EXPECT_EQ(204.0f, tile[0]);
+  EXPECT_EQ(-1.0f, tile[1]);
+  EXPECT_TRUE(cube.block(1, 2, 0) == NULL);
+  EXPECT_TRUE(cube.block(1, 0, 3) == NULL);
+
+  // A window that crosses every tile boundary.
+  float window[4 * 3];
+  ASSERT_TRUE(cube.read(window, 4, 1, 1, 0, 4, 3));
+  for (int line = 0; line < 3; line++) {
+    for (int sample = 0; sample < 4; sample++) {
+      EXPECT_EQ(100.0f * line + sample + 1, window[4 * line + sample]) << line << " " << sample;
+    }
+  }
+
+  // The core must hold every tile.
+  file.resize(file.size() - 4);
+  EXPECT_FALSE(cube.open("tiles.cub", &file[0], file.size()));
+}
+
+
+TEST(CubeReaderTest, readMsbAndScaled) {
+  const std::string scaling = "      Base = 10.0\n      Multiplier = 0.5\n";
+
+  // SignedWord: 4, -6, Null and HighReprSat.
+  std::vector<unsigned char> core;
+  const int16_t words[] = { 4, -6, -32768, -32764 };
+  for (int i = 0; i < 4; i++) {
+    appendPixel(core, (uint16_t)words[i], 2, true);
+  }
+  std::vector<unsigned char> file = makeCube("    Format = BandSequential\n", 2, 2, 1,
+                                             "SignedWord", "Msb", scaling, core);
+  CubeReader cube;
+  ASSERT_TRUE(cube.open("words.cub", &file[0], file.size()));
+  float values[4];
+  ASSERT_TRUE(cube.read(values, 2, 1, 0, 0, 2, 2));
+  EXPECT_EQ(12.0f, values[0]);
+  EXPECT_EQ(7.0f, values[1]);
+  EXPECT_EQ(NULL4, bitsOf(values[2]));
+  EXPECT_EQ(HIGH_REPR_SAT4, bitsOf(values[3]));
+
+  // UnsignedWord: 2 is LowInstrSat.
+  core.clear();
+  const uint16_t unsignedWords[] = { 1000, 2, 0, 65535 };
+  for (int i = 0; i < 4; i++) {
+    appendPixel(core, unsignedWords[i], 2, true);
+  }
+  file = makeCube("    Format = BandSequential\n", 2, 2, 1, "UnsignedWord", "Msb", scaling,
+                  core);
+  ASSERT_TRUE(cube.open("words.cub", &file[0], file.size()));
+  ASSERT_TRUE(cube.read(values, 2, 1, 0, 0, 2, 2));
+  EXPECT_EQ(510.0f, values[0]);
+  EXPECT_EQ(LOW_INSTR_SAT4, bitsOf(values[1]));
+  EXPECT_EQ(NULL4, bitsOf(values[2]));
+  EXPECT_EQ(HIGH_REPR_SAT4, bitsOf(values[3]));
+
+  // SignedInteger and Real are scaled unless they hold a special pixel; -2147483646 is
+  // LowInstrSat.
+  core.clear();
+  appendPixel(core, (uint32_t)-40, 4, true);
+  appendPixel(core, (uint32_t)-2147483646, 4, true);
+  file = makeCube("    Format = BandSequential\n", 2, 1, 1, "SignedInteger", "Msb", scaling,
+                  core);
+  ASSERT_TRUE(cube.open("integers.cub", &file[0], file.size()));
+  ASSERT_TRUE(cube.read(values, 2, 1, 0, 0, 2, 1));
+  EXPECT_EQ(-10.0f, values[0]);
+  EXPECT_EQ(LOW_INSTR_SAT4, bitsOf(values[1]));
+
+  core.clear();
+  appendPixel(core, bitsOf(1.5f), 4, true);
+  appendPixel(core, NULL4, 4, true);
+  file = makeCube("    Format = BandSequential\n", 2, 1, 1, "Real", "Msb", "", core);
+  ASSERT_TRUE(cube.open("reals.cub", &file[0], file.size()));
+  EXPECT_FALSE(cube.isDirect());
+  ASSERT_TRUE(cube.read(values, 2, 1, 0, 0, 2, 1));
+  EXPECT_EQ(1.5f, values[0]);
+  EXPECT_EQ(NULL4, bitsOf(values[1]));
+
+  file = makeCube("    Format = BandSequential\n", 2, 1, 1, "Real", "Msb", scaling, core);
+  ASSERT_TRUE(cube.open("reals.cub", &file[0], file.size()));
+  ASSERT_TRUE(cube.read(values, 2, 1, 0, 0, 2, 1));
+  EXPECT_EQ(10.75f, values[0]);
+  EXPECT_EQ(NULL4, bitsOf(values[1]));
+}
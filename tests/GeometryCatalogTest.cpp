@@ -0,0 +1,147 @@
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <Backplanes.h>
+#include <GeometryCatalog.h>
+#include <MdisNacSensorModel.h>
+
+#include "TestFrameModel.h"
+
+
+TEST(GeometryCatalogTest, summarizeImage) {
+  MdisNacSensorModel *model = createTestFrameModel(true);
+  ASSERT_TRUE(model != NULL);
+
+  ImageSummary summary;
+  ASSERT_TRUE(summarizeImage(*model, 5, summary));
+
+  // The center values agree with the backplanes of the center pixel.
+  Backplanes backplanes(*model);
+  float center[Backplanes::NUM_BACKPLANES];
+  backplanes.computePixel(csm::ImageCoord(512.5, 512.5), center, 1);
+  EXPECT_NEAR(center[Backplanes::LATITUDE], summary.centerLatitude, 1e-4);
+  EXPECT_NEAR(center[Backplanes::LONGITUDE], summary.centerLongitude, 1e-4);
+  EXPECT_NEAR(center[Backplanes::EMISSION], summary.emission, 1e-4);
+  EXPECT_NEAR(center[Backplanes::INCIDENCE], summary.incidence, 1e-4);
+  EXPECT_NEAR(summary.emission, summary.incidence, 1e-3);
+  EXPECT_NEAR(center[Backplanes::RESOLUTION], summary.groundSampleDistance, 1e-3);
+
+  // The footprint holds the center, and the spacecraft is above the surface.
+  EXPECT_GT(summary.coverage, 0.0);
+  EXPECT_LE(summary.coverage, 1.0);
+  EXPECT_LE(summary.minLatitude, summary.centerLatitude);
+  EXPECT_GE(summary.maxLatitude, summary.centerLatitude);
+  EXPECT_LT(summary.westLongitude, summary.eastLongitude);
+  EXPECT_LE(summary.westLongitude, summary.centerLongitude);
+  EXPECT_GE(summary.eastLongitude, summary.centerLongitude);
+  EXPECT_GT(summary.altitude, 0.0);
+  delete model;
+
+  // Without a sun position only the incidence is missing.
+  model = createTestFrameModel(false);
+  ASSERT_TRUE(model != NULL);
+  ImageSummary noSun;
+  ASSERT_TRUE(summarizeImage(*model, 5, noSun));
+  EXPECT_TRUE(std::isnan(noSun.incidence));
+  EXPECT_DOUBLE_EQ(summary.emission, noSun.emission);
+  EXPECT_DOUBLE_EQ(summary.altitude, noSun.altitude);
+  delete model;
+}
+
+
+TEST(GeometryCatalogTest, writeAndRead) {
+  std::string catalogFile("GeometryCatalogTest.cat");
+
+  ImageSummary first = { 10.0, 20.0, 9.0, 11.0, 19.0, 21.0, 50.0, 30.0, 40.0, 1000.0, 1.0 };
+  ImageSummary second = { -5.0, 359.5, -6.0, -4.0, 359.0, 1.0, 75.0, 35.0, NAN, 2000.0, 0.5 };
+
+  CatalogWriter writer;
+  ASSERT_TRUE(writer.open(catalogFile));
+  writer.add("EN1007907102M", first);
+  writer.add("EN0108828332M", second);
+  EXPECT_EQ(2u, writer.size());
+  ASSERT_TRUE(writer.close());
+
+  Catalog catalog;
+  ASSERT_TRUE(catalog.open(catalogFile));
+  ASSERT_EQ(2u, catalog.size());
+  EXPECT_EQ(11u, catalog.columns());
+  EXPECT_EQ("center_latitude", catalog.columnName(0));
+  EXPECT_EQ("EN1007907102M", catalog.imageId(0));
+  EXPECT_EQ("EN0108828332M", catalog.imageId(1));
+
+  const double *longitude = catalog.column("center_longitude");
+  ASSERT_TRUE(longitude != NULL);
+  EXPECT_DOUBLE_EQ(20.0, longitude[0]);
+  EXPECT_DOUBLE_EQ(359.5, longitude[1]);
+  const double *incidence = catalog.column("incidence");
+  ASSERT_TRUE(incidence != NULL);
+  EXPECT_DOUBLE_EQ(40.0, incidence[0]);
+  EXPECT_TRUE(std::isnan(incidence[1]));
+  const double *altitude = catalog.column("altitude");
+  ASSERT_TRUE(altitude != NULL);
+  EXPECT_DOUBLE_EQ(2000.0, altitude[1]);
+  EXPECT_TRUE(catalog.column("phase") == NULL);
+
+  catalog.close();
+  std::remove(catalogFile.c_str());
+}
+
+
+/**
+ * Overwrites 8 bytes of a file at an offset.
+ */
+static void patchFile(const std::string &filename, long offset, uint64_t value) {
+  FILE *file = std::fopen(filename.c_str(), "r+b");
+  ASSERT_TRUE(file != NULL);
+  std::fseek(file, offset, SEEK_SET);
+  std::fwrite(&value, sizeof(value), 1, file);
+  std::fclose(file);
+}
+
+
+TEST(GeometryCatalogTest, openCorrupt) {
+  std::string catalogFile("GeometryCatalogTest.cat");
+  ImageSummary summary = { 10.0, 20.0, 9.0, 11.0, 19.0, 21.0, 50.0, 30.0, 40.0, 1000.0, 1.0 };
+
+  CatalogWriter writer;
+  ASSERT_TRUE(writer.open(catalogFile));
+  writer.add("EN1007907102M", summary);
+  writer.add("EN0108828332M", summary);
+  ASSERT_TRUE(writer.close());
+
+  uint64_t idsOffset = 0;
+  FILE *file = std::fopen(catalogFile.c_str(), "rb");
+  ASSERT_TRUE(file != NULL);
+  std::fseek(file, 24, SEEK_SET);
+  ASSERT_EQ(1u, std::fread(&idsOffset, sizeof(idsOffset), 1, file));
+  std::fclose(file);
+
+  // The second id would start after the end of the id text.
+  Catalog catalog;
+  patchFile(catalogFile, idsOffset + 8, 1000);
+  EXPECT_FALSE(catalog.open(catalogFile));
+
+  // The second id would start before the first one, giving it a negative length.
+  patchFile(catalogFile, idsOffset, 20);
+  patchFile(catalogFile, idsOffset + 8, 13);
+  EXPECT_FALSE(catalog.open(catalogFile));
+
+  // A row count large enough to overflow the size of the id starts.
+  patchFile(catalogFile, idsOffset, 0);
+  patchFile(catalogFile, 16, UINT64_MAX / 4);
+  EXPECT_FALSE(catalog.open(catalogFile));
+
+  // A later version of the layout, with the column count kept.
+  patchFile(catalogFile, 16, 2);
+  ASSERT_TRUE(catalog.open(catalogFile));
+  catalog.close();
+  patchFile(catalogFile, 8, (uint64_t(11) << 32) | 2);
+  EXPECT_FALSE(catalog.open(catalogFile));
+
+  std::remove(catalogFile.c_str());
+}
@@ -0,0 +1,162 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <csm/csm.h>
+
+#include <gtest/gtest.h>
+
+#include <GroundWriter.h>
+
+
+// A 3 x 2 grid written as two one-line strips.
+static bool writeGrid(GroundWriter &writer, const std::string &filename) {
+  float dn[6] = { 1, 2, 3, 4, 5, 6 };
+  std::vector<csm::EcefCoord> ground;
+  for (int i = 0; i < 6; i++) {
+    ground.push_back(csm::EcefCoord(1000.0 * i, -1000.0 * i, 500.0));
+  }
+  return writer.open(filename, ImageWindow(0, 0, 3, 2)) &&
+         writer.write(0, 1, dn, &ground[0]) &&
+         writer.write(1, 1, dn + 3, &ground[3]) &&
+         writer.close();
+}
+
+
+static std::string readFile(const std::string &filename) {
+  std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+  std::stringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+
+TEST(GroundWriterTest, formats) {
+  GroundWriter::Format format;
+  EXPECT_TRUE(GroundWriter::findFormat("npy", format));
+  EXPECT_EQ(GroundWriter::NPY_FORMAT, format);
+  EXPECT_TRUE(GroundWriter::findFormat("csv", format));
+  EXPECT_EQ(GroundWriter::CSV_FORMAT, format);
+  EXPECT_FALSE(GroundWriter::findFormat("png", format));
+  EXPECT_STREQ(".bsq", GroundWriter::extension(GroundWriter::ENVI_FORMAT));
+}
+
+
+TEST(GroundWriterTest, csv) {
+  GroundWriter *writer = GroundWriter::create(GroundWriter::CSV_FORMAT);
+  ASSERT_TRUE(writeGrid(*writer, "GroundWriterTest.csv"));
+  delete writer;
+
+  std::string text = readFile("GroundWriterTest.csv");
+  EXPECT_EQ(0, text.find("Line, Sample, DN, X (km), Y (km), Z (km)\n1, 1, 1, 0, -0, 0.5\n"));
+  EXPECT_NE(std::string::npos, text.find("\n2, 3, 6, 5, -5, 0.5\n"));
+  remove("GroundWriterTest.csv");
+}
+
+
+TEST(GroundWriterTest, csvWindow) {
+  // Samples 11, 14 and 17 of lines 5 and 7.
+  GroundWriter *writer = GroundWriter::create(GroundWriter::CSV_FORMAT);
+  float dn[6] = { 1, 2, 3, 4, 5, 6 };
+  std::vector<csm::EcefCoord> ground(6);
+  ASSERT_TRUE(writer->open("GroundWriterTest.csv", ImageWindow(10, 4, 8, 4, 3, 2)));
+  ASSERT_TRUE(writer->write(0, 2, dn, &ground[0]));
+  ASSERT_TRUE(writer->close());
+  delete writer;
+
+  std::string text = readFile("GroundWriterTest.csv");
+  EXPECT_NE(std::string::npos, text.find("\n5, 11, 1, 0, 0, 0\n5, 14, 2,"));
+  EXPECT_NE(std::string::npos, text.find("\n7, 17, 6, 0, 0, 0\n"));
+  remove("GroundWriterTest.csv");
+}
+
+
+TEST(GroundWriterTest, envi) {
+  GroundWriter *writer = GroundWriter::create(GroundWriter::ENVI_FORMAT);
+  ASSERT_TRUE(writeGrid(*writer, "GroundWriterTest.bsq"));
+  delete writer;
+
+  std::string data = readFile("GroundWriterTest.bsq");
+  ASSERT_EQ(4 * 6 * sizeof(double), data.size());
+  const double *values = reinterpret_cast<const double *>(data.data());
+  EXPECT_EQ(6.0, values[5]);      // DN band, last pixel
+  EXPECT_EQ(5.0, values[6 + 5]);  // X band
+  EXPECT_EQ(-4.0, values[12 + 4]); // Y band
+  EXPECT_EQ(0.5, values[18]);     // Z band
+
+  std::string header = readFile("GroundWriterTest.hdr");
+  EXPECT_EQ(0, header.find("ENVI\n"));
+  EXPECT_NE(std::string::npos, header.find("samples = 3\n"));
+  EXPECT_NE(std::string::npos, header.find("lines = 2\n"));
+  EXPECT_NE(std::string::npos, header.find("data type = 5\n"));
+  EXPECT_NE(std::string::npos, header.find("interleave = bsq\n"));
+  EXPECT_NE(std::string::npos, header.find("samples 1-3 every 1, lines 1-2 every 1"));
+  remove("GroundWriterTest.bsq");
+  remove("GroundWriterTest.hdr");
+}
+
+
+TEST(GroundWriterTest, npy) {
+  GroundWriter *writer = GroundWriter::create(GroundWriter::NPY_FORMAT);
+  ASSERT_TRUE(writeGrid(*writer, "GroundWriterTest.npy"));
+  delete writer;
+
+  std::string data = readFile("GroundWriterTest.npy");
+  ASSERT_GT(data.size(), 10);
+  EXPECT_EQ(0, data.compare(0, 8, std::string("\x93NUMPY\x01\x00", 8)));
+  size_t headerLength = (unsigned char)data[8] | ((unsigned char)data[9] << 8);
+  size_t offset = 10 + headerLength;
+  EXPECT_EQ(0, offset % 64);
+  EXPECT_EQ('\n', data[offset - 1]);
+
+  std::string header = data.substr(10, headerLength);
+  EXPECT_NE(std::string::npos, header.find("'fortran_order': False"));
+  EXPECT_NE(std::string::npos, header.find("'shape': (4, 2, 3)"));
+
+  ASSERT_EQ(offset + 4 * 6 * sizeof(double), data.size());
+  double values[24];
+  memcpy(values, data.data() + offset, sizeof(values));
+  EXPECT_EQ(1.0, values[0]);
+  EXPECT_EQ(3.0, values[6 + 3]);
+  EXPECT_EQ(0.5, values[23]);
+  remove("GroundWriterTest.npy");
+}
+
+
+TEST(GroundWriterTest, coordinates) {
+  GroundWriter::Coordinates coordinates;
+  EXPECT_TRUE(GroundWriter::findCoordinates("enu", coordinates));
+  EXPECT_EQ(GroundWriter::ENU_COORDINATES, coordinates);
+  EXPECT_TRUE(GroundWriter::findCoordinates("geodetic", coordinates));
+  EXPECT_EQ(GroundWriter::GEODETIC_COORDINATES, coordinates);
+  EXPECT_FALSE(GroundWriter::findCoordinates("utm", coordinates));
+
+  // Latitude and longitude are given in radians and written in degrees.
+  GroundWriter *writer = GroundWriter::create(GroundWriter::CSV_FORMAT, coordinates);
+  float dn[2] = { 7, 8 };
+  std::vector<csm::EcefCoord> ground;
+  ground.push_back(csm::EcefCoord(M_PI / 2, -M_PI / 4, 1500.0));
+  ground.push_back(csm::EcefCoord(0.0, M_PI, -250.0));
+  ASSERT_TRUE(writer->open("GroundWriterTest.csv", ImageWindow(0, 0, 2, 1)));
+  ASSERT_TRUE(writer->write(0, 1, dn, &ground[0]));
+  ASSERT_TRUE(writer->close());
+  delete writer;
+
+  std::string text = readFile("GroundWriterTest.csv");
+  EXPECT_EQ("Line, Sample, DN, Latitude (deg), Longitude (deg), Height (km)\n"
+            "1, 1, 7, 90, -45, 1.5\n1, 2, 8, 0, 180, -0.25\n", text);
+  remove("GroundWriterTest.csv");
+
+  writer = GroundWriter::create(GroundWriter::ENVI_FORMAT, GroundWriter::ENU_COORDINATES);
+  ASSERT_TRUE(writeGrid(*writer, "GroundWriterTest.bsq"));
+  delete writer;
+  std::string header = readFile("GroundWriterTest.hdr");
+  EXPECT_NE(std::string::npos, header.find("band names = {DN, East (km), North (km), Up (km)}"));
+  EXPECT_EQ(5.0, reinterpret_cast<const double *>(readFile("GroundWriterTest.bsq").data())[11]);
+  remove("GroundWriterTest.bsq");
+  remove("GroundWriterTest.hdr");
+}
@@ -0,0 +1,205 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include <csm/Isd.h>
+
+#include <gtest/gtest.h>
+
+#include <IsdArchive.h>
+#include <IsdReader.h>
+
+// runTest.cpp defines this global string to a data directory
+extern std::string g_dataPath;
+
+class IsdArchiveTest : public ::testing::Test {
+  protected:
+    virtual void SetUp() {
+      archiveFile = "IsdArchiveTest.isda";
+      std::remove(archiveFile.c_str());
+    }
+
+    virtual void TearDown() {
+      std::remove(archiveFile.c_str());
+    }
+
+    std::string archiveFile;
+};
+
+
+TEST_F(IsdArchiveTest, findEntries) {
+  IsdArchiveWriter writer;
+  ASSERT_TRUE(writer.open(archiveFile));
+  std::string b("{\"nlines\": 2}");
+  std::string a("{\"nlines\": 1}");
+  EXPECT_TRUE(writer.add("B", b.data(), b.size()));
+  EXPECT_TRUE(writer.add("A", a.data(), a.size()));
+  EXPECT_FALSE(writer.add("A", a.data(), a.size()));
+  EXPECT_TRUE(writer.close());
+
+  IsdArchive archive;
+  ASSERT_TRUE(archive.open(archiveFile));
+  ASSERT_EQ(2, archive.size());
+  EXPECT_EQ("A", archive.imageId(0));
+  EXPECT_EQ("B", archive.imageId(1));
+
+  const char *data = NULL;
+  size_t size = 0;
+  ASSERT_TRUE(archive.find("B", &data, &size));
+  EXPECT_EQ(b, std::string(data, size));
+  EXPECT_FALSE(archive.find("C", &data, &size));
+}
+
+
+TEST_F(IsdArchiveTest, appendToExisting) {
+  IsdArchiveWriter writer;
+  std::string a("{\"nlines\": 1}");
+  std::string c("{\"nlines\": 3}");
+  ASSERT_TRUE(writer.open(archiveFile));
+  EXPECT_TRUE(writer.add("A", a.data(), a.size()));
+  EXPECT_TRUE(writer.close());
+
+  ASSERT_TRUE(writer.open(archiveFile));
+  EXPECT_EQ(1, writer.size());
+  EXPECT_TRUE(writer.add("C", c.data(), c.size()));
+  EXPECT_TRUE(writer.close());
+
+  IsdArchive archive;
+  ASSERT_TRUE(archive.open(archiveFile));
+  ASSERT_EQ(2, archive.size());
+  const char *data = NULL;
+  size_t size = 0;
+  ASSERT_TRUE(archive.find("A", &data, &size));
+  EXPECT_EQ(a, std::string(data, size));
+  ASSERT_TRUE(archive.find("C", &data, &size));
+  EXPECT_EQ(c, std::string(data, size));
+}
+
+
+TEST_F(IsdArchiveTest, readISD) {
+  IsdArchiveWriter writer;
+  ASSERT_TRUE(writer.open(archiveFile));
+  ASSERT_TRUE(writer.addFile("EN1007907102M", g_dataPath + "/EN1007907102M.json"));
+  EXPECT_TRUE(writer.close());
+
+  IsdArchive archive;
+  ASSERT_TRUE(archive.open(archiveFile));
+  csm::Isd *isd = archive.readISD("EN1007907102M");
+  ASSERT_TRUE(isd != NULL);
+  EXPECT_EQ("EN1007907102M", isd->filename());
+  EXPECT_EQ("MDIS-NAC", isd->param("instrument_id"));
+  EXPECT_EQ("1024", isd->param("nlines"));
+  delete isd;
+
+  EXPECT_TRUE(archive.readISD("EN0000000000M") == NULL);
+}
+
+
+TEST_F(IsdArchiveTest, openInvalid) {
+  std::FILE *file = std::fopen(archiveFile.c_str(), "wb");
+  std::fputs("not an archive, but long enough to have a header and trailer", file);
+  std::fclose(file);
+
+  IsdArchive archive;
+  EXPECT_FALSE(archive.open(archiveFile));
+  EXPECT_EQ(0, archive.size());
+}
+
+
+TEST_F(IsdArchiveTest, unfinishedAppend) {
+  IsdArchiveWriter writer;
+  std::string a("{\"nlines\": 1}");
+  std::string c("{\"nlines\": 3}");
+  ASSERT_TRUE(writer.open(archiveFile));
+  EXPECT_TRUE(writer.add("A", a.data(), a.size()));
+  EXPECT_TRUE(writer.close());
+
+  // An append that stopped part way leaves bytes after the current trailer.
+  std::FILE *file = std::fopen(archiveFile.c_str(), "ab");
+  std::fputs("{\"nlines\": 2} and half an index", file);
+  std::fclose(file);
+
+  IsdArchive archive;
+  ASSERT_TRUE(archive.open(archiveFile));
+  ASSERT_EQ(1, archive.size());
+  archive.close();
+
+  ASSERT_TRUE(writer.open(archiveFile));
+  EXPECT_TRUE(writer.add("C", c.data(), c.size()));
+  EXPECT_TRUE(writer.close());
+  ASSERT_TRUE(archive.open(archiveFile));
+  ASSERT_EQ(2, archive.size());
+  const char *data = NULL;
+  size_t size = 0;
+  ASSERT_TRUE(archive.find("A", &data, &size));
+  EXPECT_EQ(a, std::string(data, size));
+  ASSERT_TRUE(archive.find("C", &data, &size));
+  EXPECT_EQ(c, std::string(data, size));
+}
+
+
+TEST_F(IsdArchiveTest, openCorrupt) {
+  IsdArchiveWriter writer;
+  std::string a("{\"nlines\": 1}");
+  ASSERT_TRUE(writer.open(archiveFile));
+  EXPECT_TRUE(writer.add("A", a.data(), a.size()));
+  EXPECT_TRUE(writer.close());
+
+  // The 24 byte header and A's payload, padded to 16 bytes, put A's index record at 40 and,
+  // after the padded identifier, the trailer at 80.  Corrupt the record's payload offset,
+  // then the entry count so that the size of the index overflows.
+  IsdArchive archive;
+  uint64_t values[] = { 1 << 20, uint64_t(1) << 60 };
+  long positions[] = { 40, 88 };
+  for (int i = 0; i < 2; i++) {
+    std::FILE *file = std::fopen(archiveFile.c_str(), "r+b");
+    uint64_t original;
+    std::fseek(file, positions[i], SEEK_SET);
+    ASSERT_EQ(1u, std::fread(&original, 8, 1, file));
+    std::fseek(file, positions[i], SEEK_SET);
+    std::fwrite(&values[i], 8, 1, file);
+    std::fclose(file);
+
+    EXPECT_FALSE(archive.open(archiveFile)) << i;
+    EXPECT_FALSE(writer.open(archiveFile)) << i;
+
+    file = std::fopen(archiveFile.c_str(), "r+b");
+    std::fseek(file, positions[i], SEEK_SET);
+    std::fwrite(&original, 8, 1, file);
+    std::fclose(file);
+    EXPECT_TRUE(archive.open(archiveFile)) << i;
+    archive.close();
+  }
+}
+
+
+TEST_F(IsdArchiveTest, openUnsorted) {
+  IsdArchiveWriter writer;
+  std::string isd("{\"nlines\": 1}");
+  ASSERT_TRUE(writer.open(archiveFile));
+  EXPECT_TRUE(writer.add("A", isd.data(), isd.size()));
+  EXPECT_TRUE(writer.add("B", isd.data(), isd.size()));
+  EXPECT_TRUE(writer.close());
+
+  // Swap the two index records: each still points inside the file, but the index is no
+  // longer sorted, so a lookup would silently miss entries.
+  std::FILE *file = std::fopen(archiveFile.c_str(), "r+b");
+  ASSERT_TRUE(file != NULL);
+  uint64_t trailerOffset, indexOffset;
+  std::fseek(file, 16, SEEK_SET);
+  ASSERT_EQ(1u, std::fread(&trailerOffset, 8, 1, file));
+  std::fseek(file, trailerOffset, SEEK_SET);
+  ASSERT_EQ(1u, std::fread(&indexOffset, 8, 1, file));
+  IsdArchiveRecord records[2];
+  std::fseek(file, indexOffset, SEEK_SET);
+  ASSERT_EQ(2u, std::fread(records, sizeof(IsdArchiveRecord), 2, file));
+  std::swap(records[0], records[1]);
+  std::fseek(file, indexOffset, SEEK_SET);
+  std::fwrite(records, sizeof(IsdArchiveRecord), 2, file);
+  std::fclose(file);
+
+  IsdArchive archive;
+  EXPECT_FALSE(archive.open(archiveFile));
+  EXPECT_FALSE(writer.open(archiveFile));
+}
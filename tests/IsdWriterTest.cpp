@@ -0,0 +1,129 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <csm/Isd.h>
+
+#include <gtest/gtest.h>
+
+#include <IsdReader.h>
+#include <IsdWriter.h>
+#include <MdisIsdView.h>
+
+
+/**
+ * Returns an ISD whose every number is different.
+ */
+static MdisIsd testIsd() {
+  MdisIsd isd;
+  isd.instrumentId = "MDIS-NAC";
+  isd.spacecraftName = "MESSENGER";
+  isd.targetName = "Mercury";
+  double *numbers[] = { &isd.ephemerisTime, &isd.focalLength, &isd.focalLengthEpsilon,
+                        &isd.pixelPitch, &isd.ccdCenter, &isd.ifov, &isd.originalHalfLines,
+                        &isd.originalHalfSamples, &isd.startingDetectorSample,
+                        &isd.startingDetectorLine, &isd.semiMajorAxis, &isd.semiMinorAxis,
+                        &isd.omega, &isd.phi, &isd.kappa };
+  for (int i = 0; i < 15; i++) {
+    *numbers[i] = 0.1 + i;
+  }
+  isd.nLines = 1024;
+  isd.nSamples = 512;
+  for (int i = 0; i < 3; i++) {
+    isd.boresight[i] = 1.0 / (i + 3);
+    isd.transX[i] = 2.0 / (i + 3);
+    isd.transY[i] = 3.0 / (i + 3);
+    isd.iTransS[i] = 4.0 / (i + 3);
+    isd.iTransL[i] = 5.0 / (i + 3);
+    isd.sensorPosition[i] = 6.0e6 / (i + 3);
+    isd.sunPosition[i] = 7.0e10 / (i + 3);
+  }
+  for (int i = 0; i < 9; i++) {
+    isd.odtX[i] = 1e-5 * i;
+    isd.odtY[i] = -1e-5 * i;
+  }
+  for (int i = 0; i < 15; i++) {
+    isd.sensorCoefficients[i] = 1.0 / (i + 7);
+    isd.sunCoefficients[i] = -1.0 / (i + 7);
+  }
+  return isd;
+}
+
+
+TEST(IsdWriterTest, json) {
+  MdisIsd isd = testIsd();
+  IsdWriter writer;
+  writer.appendJSON(isd);
+  csm::Isd *parsed = readISD(writer.data(), writer.size(), "test");
+  ASSERT_TRUE(parsed != NULL);
+
+  MdisIsdView view(*parsed);
+  EXPECT_TRUE(view.missingKeywords().empty());
+  EXPECT_EQ("MESSENGER", view.text(MdisIsdView::SPACECRAFT_NAME));
+  EXPECT_EQ(isd.ephemerisTime, view.value(MdisIsdView::EPHEMERIS_TIME));
+  EXPECT_EQ(1024, view.value(MdisIsdView::NLINES));
+  EXPECT_EQ(isd.sensorPosition[2], view.value(MdisIsdView::Z_SENSOR_ORIGIN));
+  EXPECT_EQ(isd.odtY[8], view.value(MdisIsdView::ODT_Y, 8));
+  EXPECT_EQ(isd.sensorCoefficients[14],
+            view.value(MdisIsdView::SENSOR_POSITION_COEFFICIENTS, 14));
+  EXPECT_EQ(isd.sunPosition[1], view.value(MdisIsdView::SUN_POSITION, 1));
+  delete parsed;
+
+  // Fields of any type, with text that needs escaping.
+  writer.clear();
+  writer.beginJSON();
+  writer.field("ISD_SENSOR_MODEL_NAME", std::string("MDIS \"NAC\"\\\n"));
+  writer.field("value", 0.1);
+  double values[] = { 1.5, -2.0 };
+  writer.field("values", values, 2);
+  writer.endJSON();
+  EXPECT_EQ("{\n\"ISD_SENSOR_MODEL_NAME\": \"MDIS \\\"NAC\\\"\\\\\\u000a\",\n"
+            "\"value\": 0.1,\n\"values\": [1.5, -2]\n}\n",
+            std::string(writer.data(), writer.size()));
+  parsed = readISD(writer.data(), writer.size(), "test");
+  ASSERT_TRUE(parsed != NULL);
+  EXPECT_EQ("MDIS \"NAC\"\\\n", parsed->param("ISD_SENSOR_MODEL_NAME"));
+  delete parsed;
+}
+
+
+TEST(IsdWriterTest, binary) {
+  MdisIsd isd = testIsd();
+  IsdWriter writer;
+  writer.appendBinary(isd);
+
+  MdisIsd read;
+  ASSERT_TRUE(IsdWriter::readBinary(writer.data(), writer.size(), read));
+  EXPECT_EQ(isd.instrumentId, read.instrumentId);
+  EXPECT_EQ(isd.targetName, read.targetName);
+  EXPECT_EQ(isd.kappa, read.kappa);
+  EXPECT_EQ(isd.nSamples, read.nSamples);
+  EXPECT_EQ(0, memcmp(isd.odtY, read.odtY, sizeof(isd.odtY)));
+  EXPECT_EQ(0, memcmp(isd.sunCoefficients, read.sunCoefficients, sizeof(isd.sunCoefficients)));
+
+  // Both formats write the same JSON.
+  IsdWriter fromRead;
+  fromRead.appendJSON(read);
+  writer.clear();
+  writer.appendJSON(isd);
+  EXPECT_EQ(std::string(writer.data(), writer.size()),
+            std::string(fromRead.data(), fromRead.size()));
+
+  writer.clear();
+  writer.appendBinary(isd);
+  EXPECT_FALSE(IsdWriter::readBinary(writer.data(), writer.size() - 1, read));
+  EXPECT_FALSE(IsdWriter::readBinary(writer.data(), 6, read));
+}
+
+
+TEST(IsdWriterTest, write) {
+  std::string filename("IsdWriterTest.json");
+  IsdWriter writer;
+  ASSERT_TRUE(writer.writeJSON(testIsd(), filename));
+  csm::Isd *parsed = readISD(filename);
+  ASSERT_TRUE(parsed != NULL);
+  EXPECT_EQ("Mercury", parsed->param("target_name"));
+  delete parsed;
+  std::remove(filename.c_str());
+  EXPECT_FALSE(writer.writeJSON(testIsd(), "no/such/directory/isd.json"));
+}
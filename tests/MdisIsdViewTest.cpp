@@ -0,0 +1,65 @@
+#include <string>
+
+#include <csm/Isd.h>
+
+#include <gtest/gtest.h>
+
+#include <IsdReader.h>
+#include <MdisIsdView.h>
+
+// runTest.cpp defines this global string to a data directory
+extern std::string g_dataPath;
+
+// The constructor merges the keyword table against the sorted ISD, so the table must be
+// sorted and its slots contiguous.
+TEST(MdisIsdViewTest, keywordTableSorted) {
+  for (int k = 0; k + 1 < MdisIsdView::NUM_KEYWORDS; k++) {
+    MdisIsdView::Keyword keyword = static_cast<MdisIsdView::Keyword>(k);
+    MdisIsdView::Keyword next = static_cast<MdisIsdView::Keyword>(k + 1);
+    EXPECT_LT(std::string(MdisIsdView::keywordName(keyword)),
+              std::string(MdisIsdView::keywordName(next)));
+    EXPECT_EQ(keyword, MdisIsdView::findKeyword(MdisIsdView::keywordName(keyword)));
+  }
+  EXPECT_EQ(MdisIsdView::NUM_KEYWORDS, MdisIsdView::findKeyword("not_a_keyword"));
+}
+
+
+TEST(MdisIsdViewTest, resolveKeywords) {
+  csm::Isd *isd = readISD(g_dataPath + "/EN1007907102M.json");
+  ASSERT_TRUE(isd != NULL);
+  MdisIsdView view(*isd);
+
+  EXPECT_TRUE(view.missingKeywords().empty());
+  EXPECT_EQ("MDIS-NAC", view.text(MdisIsdView::INSTRUMENT_ID));
+  EXPECT_EQ("Mercury", view.text(MdisIsdView::TARGET_NAME));
+  EXPECT_EQ(1024, view.value(MdisIsdView::NLINES));
+  EXPECT_EQ(512.5, view.value(MdisIsdView::CCD_CENTER));
+  EXPECT_NEAR(549.1178195372703, view.value(MdisIsdView::FOCAL_LENGTH), 1e-9);
+  EXPECT_EQ(0.014, view.value(MdisIsdView::TRANSX, 1));
+  EXPECT_EQ(0.014, view.value(MdisIsdView::TRANSY, 2));
+  EXPECT_NEAR(1.004010471468856e-05, view.value(MdisIsdView::ODT_X, 8), 1e-15);
+  EXPECT_EQ(atof(isd->param("odt_y", 3).c_str()), view.value(MdisIsdView::ODT_Y, 3));
+  EXPECT_TRUE(view.has(MdisIsdView::ODT_Y));
+
+  // The test ISD spells this keyword "orginal_half_samples"
+  EXPECT_FALSE(view.has(MdisIsdView::ORIGINAL_HALF_SAMPLES));
+  delete isd;
+}
+
+
+TEST(MdisIsdViewTest, missingKeywords) {
+  csm::Isd isd;
+  isd.addParam("itrans_line", "0.0");
+  isd.addParam("itrans_line", "0.0");
+  isd.addParam("nlines", "1024");
+  isd.addParam("nsamples", "1024");
+  MdisIsdView view(isd);
+
+  std::vector<std::string> missing = view.missingKeywords();
+  ASSERT_EQ(14, missing.size());
+  EXPECT_EQ("instrument_id", missing[0]);
+  EXPECT_EQ("itrans_sample needs 3 elements", missing[8]);
+  EXPECT_EQ("itrans_line needs 3 elements", missing[10]);
+  EXPECT_EQ("transy", missing[11]);
+  EXPECT_EQ("semi_major_axis", missing[13]);
+}
@@ -1,5 +1,7 @@
+#include <cmath>
 #include <string>
 
+#include <csm/Error.h>
 #include <csm/Isd.h>
 
 #include <gtest/gtest.h>
@@ -7,6 +9,7 @@
 #include <MdisPlugin.h>
 #include <MdisNacSensorModel.h>
 #include <IsdReader.h>
+#include <TextBuffer.h>
 
 #include "MdisNacSensorModelTest.h"
 
@@ -226,5 +229,59 @@ TEST_F(MdisNacSensorModelTest, distortionModel2) {
 
 }
 
+TEST_F(MdisNacSensorModelTest, statePolynomials) {
 
+  // gtest #247 work-around
+  if (setupFixtureFailed) {
+    FAIL() << setupFixtureError;
+  }
 
+  // The polynomials are added to a fresh ISD, leaving the fixture's ISD untouched.
+  csm::Isd *isd = readISD(dataFile);
+  ASSERT_TRUE(isd != NULL);
+  MdisNacSensorModel *model = dynamic_cast<MdisNacSensorModel *>(
+      mdisPlugin.constructModelFromISD(*isd, MdisNacSensorModel::_SENSOR_MODEL_NAME));
+  csm::EcefCoord origin = model->getSensorPosition(0.0);
+  EXPECT_EQ(0.0, model->getImageTime(csm::ImageCoord(1, 1)));
+  EXPECT_EQ(origin.x, model->getSensorPosition(30.0).x);
+  EXPECT_THROW(model->getSensorVelocity(0.0), csm::Error);
+  delete model;
+
+  // x moves at 3 km/s, y accelerates at 2 m/s^2, z has every term; the sun drifts in x.
+  double sensor[15] = { origin.x, 3000.0, 0.0, 0.0, 0.0,
+                        origin.y, 0.0, 1.0, 0.0, 0.0,
+                        origin.z, 1.0, 0.5, 0.25, 0.125 };
+  double sun[15] = { 5.0e10, 1.0e4, 0.0, 0.0, 0.0,
+                     0.0, 0.0, 0.0, 0.0, 0.0,
+                     1.0e9, 0.0, 0.0, 0.0, 0.0 };
+  for (int i = 0; i < 15; i++) {
+    char value[MAX_NUMBER_LENGTH];
+    formatDouble(sensor[i], value);
+    isd->addParam("sensor_position_coefficients", value);
+    formatDouble(sun[i], value);
+    isd->addParam("sun_position_coefficients", value);
+  }
+  model = dynamic_cast<MdisNacSensorModel *>(
+      mdisPlugin.constructModelFromISD(*isd, MdisNacSensorModel::_SENSOR_MODEL_NAME));
+  delete isd;
+  ASSERT_TRUE(model != NULL);
+
+  csm::EcefCoord position = model->getSensorPosition(2.0);
+  EXPECT_NEAR(origin.x + 6000.0, position.x, 1e-6);
+  EXPECT_NEAR(origin.y + 4.0, position.y, 1e-6);
+  EXPECT_NEAR(origin.z + 2.0 + 2.0 + 2.0 + 2.0, position.z, 1e-6);
+  csm::EcefVector velocity = model->getSensorVelocity(2.0);
+  EXPECT_NEAR(3000.0, velocity.x, 1e-9);
+  EXPECT_NEAR(4.0, velocity.y, 1e-9);
+  EXPECT_NEAR(1.0 + 2.0 + 3.0 + 4.0, velocity.z, 1e-9);
+  velocity = model->getSensorVelocity(csm::ImageCoord(1, 1));
+  EXPECT_NEAR(3000.0, velocity.x, 1e-9);
+
+  // The sun's polynomial stands in for a missing sun_position.
+  EXPECT_NEAR(5.0e10 - 1.0e5, model->getSunPosition(-10.0).x, 1e-3);
+  csm::EcefVector direction = model->getIlluminationDirection(csm::EcefCoord(0.0, 0.0, 0.0));
+  double range = sqrt(5.0e10 * 5.0e10 + 1.0e9 * 1.0e9);
+  EXPECT_NEAR(-5.0e10 / range, direction.x, 1e-12);
+  EXPECT_NEAR(-1.0e9 / range, direction.z, 1e-12);
+  delete model;
+}
@@ -0,0 +1,86 @@
+#include <cstdint>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <RasterReader.h>
+
+// runTest.cpp defines this global string to a data directory
+extern std::string g_dataPath;
+
+
+TEST(RasterReaderTest, bufferAlignment) {
+  RasterBuffer buffer(100, 3);
+  ASSERT_TRUE(buffer.data() != NULL);
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(buffer.data()) % 64);
+  EXPECT_EQ(buffer.data() + 200, buffer.line(2));
+
+  // Shrinking keeps the memory.
+  float *data = buffer.data();
+  EXPECT_TRUE(buffer.resize(10, 10));
+  EXPECT_EQ(data, buffer.data());
+  EXPECT_EQ(10, buffer.samples());
+  EXPECT_EQ(10, buffer.lines());
+}
+
+
+TEST(RasterReaderTest, readCube) {
+  RasterReader reader;
+  ASSERT_TRUE(reader.open(g_dataPath + "/CN0108840044M_IF_5_NAC_spiced.cub"));
+  EXPECT_EQ(512, reader.samples());
+  EXPECT_EQ(512, reader.lines());
+  EXPECT_EQ(512, reader.blockSamples());
+  EXPECT_EQ(512, reader.blockLines());
+
+  RasterBuffer cube;
+  ASSERT_TRUE(reader.readAll(cube));
+  EXPECT_EQ(512, cube.samples());
+  EXPECT_EQ(512, cube.lines());
+
+  // A window that is not aligned to the block grid sees the same pixels.
+  RasterBuffer window;
+  ASSERT_TRUE(reader.read(window, 100, 200, 30, 20));
+  EXPECT_EQ(30, window.samples());
+  EXPECT_EQ(20, window.lines());
+  EXPECT_EQ(cube.at(200, 100), window.at(0, 0));
+  EXPECT_EQ(cube.at(219, 129), window.at(19, 29));
+
+  EXPECT_FALSE(reader.read(window, 500, 0, 13, 1));
+
+  // The cube is mapped, so its only tile can be used in place.
+  const float *block = reader.block(0, 0);
+  ASSERT_TRUE(block != NULL);
+  EXPECT_EQ(cube.at(219, 129), block[219 * 512 + 129]);
+}
+
+
+TEST(RasterReaderTest, openFailure) {
+  RasterReader reader;
+  EXPECT_FALSE(reader.open(g_dataPath + "/does_not_exist.cub"));
+  EXPECT_FALSE(reader.isOpen());
+
+  RasterBuffer buffer;
+  EXPECT_FALSE(reader.readAll(buffer));
+}
+
+
+TEST(RasterReaderTest, readWindowWithStride) {
+  RasterReader reader;
+  ASSERT_TRUE(reader.open(g_dataPath + "/CN0108840044M_IF_5_NAC_spiced.cub"));
+  RasterBuffer cube;
+  ASSERT_TRUE(reader.readAll(cube));
+
+  // Samples 11..110 and lines 21..70 (1-based), every 3rd sample of every 7th line.
+  ImageWindow window(10, 20, 100, 50, 3, 7);
+  EXPECT_EQ(34, window.outputSamples());
+  EXPECT_EQ(8, window.outputLines());
+
+  RasterBuffer grid;
+  ASSERT_TRUE(reader.read(grid, window, 2, 6));
+  EXPECT_EQ(34, grid.samples());
+  EXPECT_EQ(6, grid.lines());
+  EXPECT_EQ(cube.at(20 + 2 * 7, 10), grid.at(0, 0));
+  EXPECT_EQ(cube.at(20 + 7 * 7, 10 + 33 * 3), grid.at(5, 33));
+
+  EXPECT_FALSE(reader.read(grid, window, 2, 7));
+}
@@ -0,0 +1,82 @@
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <csm/Isd.h>
+
+#include <gtest/gtest.h>
+
+#include <IsdReader.h>
+#include <SocetIsdReader.h>
+
+// runTest.cpp defines this global string to a data directory
+extern std::string g_dataPath;
+
+TEST(SocetIsdReaderTest, readKeywords) {
+  csm::Isd *isd = readSocetISD(g_dataPath + "/CN0108840044M_IF_5_NAC_spiced.isd");
+  ASSERT_TRUE(isd != NULL);
+
+  EXPECT_EQ("512", isd->param("nlines"));
+  EXPECT_EQ("512", isd->param("nsamples"));
+  EXPECT_EQ("512.5", isd->param("ccd_center"));
+  EXPECT_EQ("549.2139159521081", isd->param("focal_length"));
+  EXPECT_EQ("-65063487.21727712", isd->param("x_sensor_origin"));
+  EXPECT_EQ("-2131998.869653347", isd->param("z_sensor_origin"));
+  EXPECT_DOUBLE_EQ(2440.0, atof(isd->param("semi_major_axis").c_str()));
+  EXPECT_DOUBLE_EQ(-179.4128007163052 * M_PI / 180.0, atof(isd->param("kappa").c_str()));
+
+  // Keywords without an MDIS equivalent are dropped
+  EXPECT_EQ("", isd->param("ISD_X_SENSOR_ORIG_METERS"));
+  EXPECT_EQ(0, isd->parameters().count("ISD_SENSOR_MODEL_NAME"));
+  delete isd;
+}
+
+
+TEST(SocetIsdReaderTest, instrumentConstants) {
+  csm::Isd *instrument = readISD(g_dataPath + "/hardcoded.isd");
+  ASSERT_TRUE(instrument != NULL);
+  csm::Isd *isd = readSocetISD(g_dataPath + "/CN0108840044M_IF_5_NAC_spiced.isd", instrument);
+  ASSERT_TRUE(isd != NULL);
+
+  // From the SOCET ISD, not the instrument ISD
+  EXPECT_EQ("512", isd->param("nlines"));
+  EXPECT_EQ(1, isd->parameters().count("nlines"));
+
+  // From the instrument ISD
+  EXPECT_EQ(10, isd->parameters().count("odt_x"));
+  EXPECT_EQ(instrument->param("odt_x", 1), isd->param("odt_x", 1));
+  EXPECT_EQ(instrument->param("transx", 1), isd->param("transx", 1));
+  delete isd;
+  delete instrument;
+}
+
+
+TEST(SocetIsdReaderTest, readBuffer) {
+  std::string text("ISD_NUMBER_OF_LINES\t\t1024\r\n"
+                   "\n"
+                   "ISD_SEMI_MINOR_AXIS_METERS  2439400\n"
+                   "CUSTOM_KEYWORD\tsome value \n"
+                   "ISD_OMEGA_CURR_RADIANS\t\t90");
+  csm::Isd *isd = readSocetISD(text.data(), text.size(), "buffer");
+  EXPECT_EQ("1024", isd->param("nlines"));
+  EXPECT_DOUBLE_EQ(2439.4, atof(isd->param("semi_minor_axis").c_str()));
+  EXPECT_EQ("some value", isd->param("CUSTOM_KEYWORD"));
+  EXPECT_DOUBLE_EQ(M_PI / 2.0, atof(isd->param("omega").c_str()));
+  delete isd;
+
+  EXPECT_TRUE(readSocetISD(g_dataPath + "/EN1007907102M.json") == NULL);
+}
+
+
+TEST(SocetIsdReaderTest, readDirectory) {
+  std::vector<csm::Isd *> isds;
+  // hardcoded.isd is a JSON ISD, so it is skipped
+  EXPECT_EQ(1, readSocetISDDirectory(g_dataPath, isds));
+  ASSERT_EQ(1, isds.size());
+  EXPECT_EQ(g_dataPath + "/CN0108840044M_IF_5_NAC_spiced.isd", isds[0]->filename());
+  for (size_t i = 0; i < isds.size(); i++) {
+    delete isds[i];
+  }
+  EXPECT_EQ(-1, readSocetISDDirectory(g_dataPath + "/does_not_exist", isds));
+}
@@ -0,0 +1,75 @@
+#include <chrono>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <SpscQueue.h>
+
+
+TEST(SpscQueueTest, bounded) {
+  SpscQueue<int> queue(2);
+  EXPECT_EQ(2, queue.capacity());
+
+  int value = 0;
+  EXPECT_FALSE(queue.tryPop(value));
+  EXPECT_TRUE(queue.tryPush(1));
+  EXPECT_TRUE(queue.tryPush(2));
+  EXPECT_FALSE(queue.tryPush(3));
+
+  EXPECT_TRUE(queue.tryPop(value));
+  EXPECT_EQ(1, value);
+  EXPECT_TRUE(queue.tryPush(3));
+  EXPECT_EQ(2, queue.pop());
+  EXPECT_EQ(3, queue.pop());
+  EXPECT_FALSE(queue.tryPop(value));
+}
+
+
+TEST(SpscQueueTest, producerConsumer) {
+  // A small queue between two threads keeps every value, in order.
+  SpscQueue<int> queue(3);
+  const int count = 100000;
+  std::thread producer([&] {
+    for (int i = 0; i < count; i++) {
+      queue.push(i);
+    }
+  });
+
+  long long sum = 0;
+  bool ordered = true;
+  for (int i = 0; i < count; i++) {
+    int value = queue.pop();
+    ordered = ordered && value == i;
+    sum += value;
+  }
+  producer.join();
+
+  EXPECT_TRUE(ordered);
+  EXPECT_EQ((long long)count * (count - 1) / 2, sum);
+}
+
+
+TEST(SpscQueueTest, sleepingWaits) {
+  // A slow producer and a slow consumer leave the other side asleep in pop() and push();
+  // every value still arrives once it is woken.
+  SpscQueue<int> queue(1);
+  const int count = 20;
+  std::thread producer([&] {
+    for (int i = 0; i < count; i++) {
+      if (i < count / 2) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      }
+      queue.push(i);
+    }
+  });
+
+  bool ordered = true;
+  for (int i = 0; i < count; i++) {
+    if (i >= count / 2) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    ordered = queue.pop() == i && ordered;
+  }
+  producer.join();
+  EXPECT_TRUE(ordered);
+}
@@ -0,0 +1,56 @@
+#ifndef TestFrameModel_h
+#define TestFrameModel_h
+
+#include <string>
+
+#include <csm/csm.h>
+#include <csm/Isd.h>
+
+#include <IsdReader.h>
+#include <MdisNacSensorModel.h>
+#include <MdisPlugin.h>
+#include <TextBuffer.h>
+
+// runTest.cpp defines this global string to a data directory
+extern std::string g_dataPath;
+
+/**
+ * Creates the model of the EN1007907102M test frame, optionally with the sun placed on the
+ * line from the center pixel's ground point through the sensor, so the phase angle of that
+ * pixel is 0 and its incidence equals its emission.
+ *
+ * If center is not NULL, it receives the ground point of the center pixel.  Returns NULL if
+ * the ISD cannot be read.
+ */
+inline MdisNacSensorModel *createTestFrameModel(bool withSun, csm::EcefCoord *center = NULL) {
+  csm::Isd *isd = readISD(g_dataPath + "/EN1007907102M.json");
+  if (isd == NULL) {
+    return NULL;
+  }
+  MdisPlugin plugin;
+  MdisNacSensorModel *model = dynamic_cast<MdisNacSensorModel *>(
+      plugin.constructModelFromISD(*isd, MdisNacSensorModel::_SENSOR_MODEL_NAME));
+  csm::EcefCoord ground = model->imageToGround(csm::ImageCoord(512.5, 512.5), 0.0);
+  if (center != NULL) {
+    *center = ground;
+  }
+
+  if (withSun) {
+    csm::EcefCoord sensor = model->getSensorPosition(0.0);
+    double sun[3] = { ground.x + 1000 * (sensor.x - ground.x),
+                      ground.y + 1000 * (sensor.y - ground.y),
+                      ground.z + 1000 * (sensor.z - ground.z) };
+    for (int i = 0; i < 3; i++) {
+      char value[MAX_NUMBER_LENGTH];
+      formatDouble(sun[i], value);
+      isd->addParam("sun_position", value);
+    }
+    delete model;
+    model = dynamic_cast<MdisNacSensorModel *>(
+        plugin.constructModelFromISD(*isd, MdisNacSensorModel::_SENSOR_MODEL_NAME));
+  }
+  delete isd;
+  return model;
+}
+
+#endif
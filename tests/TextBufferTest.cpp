@@ -0,0 +1,89 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <string>
+
+#include <csm/Isd.h>
+
+#include <gtest/gtest.h>
+
+#include <IsdReader.h>
+#include <TextBuffer.h>
+
+// runTest.cpp defines this global string to a data directory
+extern std::string g_dataPath;
+
+
+TEST(TextBufferTest, shortestRoundTrip) {
+  char buffer[MAX_NUMBER_LENGTH];
+
+  EXPECT_EQ(3, formatDouble(0.1, buffer));
+  EXPECT_STREQ("0.1", buffer);
+  formatDouble(1024.0, buffer);
+  EXPECT_STREQ("1024", buffer);
+  formatDouble(-65063487.21727712, buffer);
+  EXPECT_STREQ("-65063487.21727712", buffer);
+
+  // Values that need all 17 digits still read back exactly.
+  double values[] = { 0.1 + 0.2, M_PI, 1.0 / 3.0, 2439.4e3 * 1.0000001, 1e-300, 5e-324 };
+  for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+    formatDouble(values[i], buffer);
+    EXPECT_EQ(values[i], strtod(buffer, NULL)) << buffer;
+  }
+
+  formatFloat(0.1f, buffer);
+  EXPECT_STREQ("0.1", buffer);
+  formatFloat(16777215.0f, buffer);
+  EXPECT_EQ(16777215.0f, strtof(buffer, NULL));
+
+  formatInteger(-9223372036854775807LL - 1, buffer);
+  EXPECT_STREQ("-9223372036854775808", buffer);
+  formatInteger(0, buffer);
+  EXPECT_STREQ("0", buffer);
+
+  formatDouble(M_PI, 6, buffer);
+  EXPECT_STREQ("3.14159", buffer);
+}
+
+
+TEST(TextBufferTest, buffer) {
+  TextBuffer text(NULL, 4);
+  text.append("Line");
+  text.append(", ");
+  text.appendInteger(12);
+  text.append(',');
+  text.appendDouble(0.5);
+  text.append(',');
+  text.appendFloat(2.25f);
+  EXPECT_EQ("Line, 12,0.5,2.25", text.str());
+
+  text.clear();
+  EXPECT_EQ(0, text.size());
+  EXPECT_EQ("", text.str());
+
+  FILE *file = tmpfile();
+  ASSERT_TRUE(file != NULL);
+  {
+    TextBuffer output(file, 64);
+    for (int i = 0; i < 100; i++) {
+      output.appendInteger(i);
+      output.append('\n');
+    }
+    EXPECT_TRUE(output.flush());
+  }
+  EXPECT_EQ(290, ftell(file));
+  fclose(file);
+}
+
+
+TEST(TextBufferTest, isdValuesRoundTrip) {
+  csm::Isd *isd = readISD(g_dataPath + "/EN1007907102M.json");
+  ASSERT_TRUE(isd != NULL);
+
+  // 12 significant digits lost part of the sensor position.
+  EXPECT_EQ("1728357.7031238307", isd->param("x_sensor_origin"));
+  EXPECT_EQ("1.004010471468856e-05", isd->param("odt_x", 8));
+  EXPECT_EQ("1024", isd->param("nlines"));
+  delete isd;
+}
@@ -0,0 +1,166 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <TextKernel.h>
+
+// runTest.cpp defines this global string to a data directory
+extern std::string g_dataPath;
+
+
+/**
+ * Checks the MDIS NAC constants spice2isd reads from the MDIS instrument kernel.
+ */
+static void expectNacConstants(const TextKernel &kernel) {
+  double focalLength;
+  ASSERT_TRUE(kernel.getDoubles("INS-236820_FOCAL_LENGTH", 1, &focalLength));
+  EXPECT_DOUBLE_EQ(549.1178195372703, focalLength);
+
+  const std::vector<double> *center = kernel.numbers("INS-236820_CCD_CENTER");
+  ASSERT_TRUE(center != NULL);
+  ASSERT_EQ(2u, center->size());
+  EXPECT_DOUBLE_EQ(512.5, (*center)[1]);
+  EXPECT_DOUBLE_EQ(14.0e-3, kernel.numbers("INS-236820_PIXEL_PITCH")->at(0));
+
+  // Only the assignments inside \begindata sections count, and a later one replaces an
+  // earlier one.
+  const std::vector<double> *odtX = kernel.numbers("INS-236820_OD_T_X");
+  ASSERT_TRUE(odtX != NULL);
+  ASSERT_EQ(10u, odtX->size());
+  EXPECT_DOUBLE_EQ(1.0018542696238023333, (*odtX)[1]);
+  EXPECT_DOUBLE_EQ(549.5120497341695, kernel.numbers("INS-236820_FL_TEMP_COEFFS")->at(0));
+
+  const std::vector<std::string> *frame = kernel.strings("INS-236820_FOV_FRAME");
+  ASSERT_TRUE(frame != NULL);
+  ASSERT_EQ(1u, frame->size());
+  EXPECT_EQ("MSGR_MDIS_NAC", (*frame)[0]);
+
+  // += appends to the values of earlier assignments.
+  const std::vector<std::string> *names = kernel.strings("NAIF_BODY_NAME");
+  ASSERT_TRUE(names != NULL);
+  ASSERT_EQ(2u, names->size());
+  EXPECT_EQ("MSGR_MDIS_NAC", (*names)[1]);
+
+  EXPECT_TRUE(kernel.strings("INS-236820_FOCAL_LENGTH") == NULL);
+  EXPECT_TRUE(kernel.numbers("INS-236820_FOV_FRAME") == NULL);
+  EXPECT_FALSE(kernel.has("INS-236820_NOT_A_VARIABLE"));
+}
+
+
+TEST(TextKernelTest, instrumentKernel) {
+  TextKernel kernel;
+  ASSERT_TRUE(kernel.load(g_dataPath + "/msgr_mdis_v160.ti"));
+  EXPECT_FALSE(kernel.fromCache());
+  expectNacConstants(kernel);
+}
+
+
+TEST(TextKernelTest, syntax) {
+  const char *text =
+      "Comments are ignored: A = ( 1 )\n"
+      "\\begindata\n"
+      "A = ( 1.5D2, -2d-1\n"
+      "      3 )\n"
+      "B='it''s' C=@2008-JAN-14\n"
+      "A += 4\n"
+      "\\begintext\n"
+      "B = 'ignored'\n";
+  TextKernel kernel;
+  ASSERT_TRUE(kernel.parse(text, strlen(text), "syntax"));
+  EXPECT_EQ(3u, kernel.size());
+  const std::vector<double> *a = kernel.numbers("A");
+  ASSERT_TRUE(a != NULL);
+  ASSERT_EQ(4u, a->size());
+  EXPECT_DOUBLE_EQ(150.0, (*a)[0]);
+  EXPECT_DOUBLE_EQ(-0.2, (*a)[1]);
+  EXPECT_DOUBLE_EQ(4.0, (*a)[3]);
+  EXPECT_EQ("it's", kernel.strings("B")->at(0));
+  // @ dates are UTC seconds past J2000, without leap seconds.
+  ASSERT_TRUE(kernel.numbers("C") != NULL);
+  EXPECT_DOUBLE_EQ(2935 * 86400.0 - 43200.0, kernel.numbers("C")->at(0));
+
+  const char *invalid[] = {
+    "\\begindata\nA = ( 1, 'two' )\n",
+    "\\begindata\nA = ( 1, 2\n",
+    "\\begindata\nA 1\n",
+    "\\begindata\nA = 1x\n",
+    "\\begindata\nA = 'open\n",
+    "\\begindata\nA = @2001-FEB-29\n"
+  };
+  for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+    EXPECT_FALSE(kernel.parse(invalid[i], strlen(invalid[i]), "invalid")) << invalid[i];
+    EXPECT_EQ(0u, kernel.size());
+  }
+}
+
+
+TEST(TextKernelTest, parseCalendar) {
+  long day;
+  double seconds;
+  ASSERT_TRUE(TextKernel::parseCalendar("2000-01-01T12:00:00", day, seconds));
+  EXPECT_EQ(0, day);
+  EXPECT_DOUBLE_EQ(43200.0, seconds);
+
+  ASSERT_TRUE(TextKernel::parseCalendar("2008-01-14T23:17:44.078578", day, seconds));
+  EXPECT_EQ(2935, day);
+  EXPECT_NEAR(83864.078578, seconds, 1e-9);
+  long other;
+  ASSERT_TRUE(TextKernel::parseCalendar("2008-014 23:17:44.078578Z", other, seconds));
+  EXPECT_EQ(day, other);
+  ASSERT_TRUE(TextKernel::parseCalendar("2008 jan 14", other, seconds));
+  EXPECT_EQ(day, other);
+  EXPECT_DOUBLE_EQ(0.0, seconds);
+
+  ASSERT_TRUE(TextKernel::parseCalendar("1972-JAN-1", day, seconds));
+  EXPECT_EQ(-10227, day);
+  ASSERT_TRUE(TextKernel::parseCalendar("2016-12-31T23:59:60.5", day, seconds));
+  EXPECT_DOUBLE_EQ(86400.5, seconds);
+  ASSERT_TRUE(TextKernel::parseCalendar("2012-366", day, seconds));
+  EXPECT_EQ(4748, day);
+
+  const char *invalid[] = { "2008", "2008-13-01", "2009-02-29", "2009-366", "2008-JUNK-1",
+                            "2008-01-14T24:00:00", "2008-01-14T12:00:61", "2008-01-14 x" };
+  for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+    EXPECT_FALSE(TextKernel::parseCalendar(invalid[i], day, seconds)) << invalid[i];
+  }
+}
+
+
+TEST(TextKernelTest, cache) {
+  std::string kernelFile = g_dataPath + "/msgr_mdis_v160.ti";
+
+  TextKernel parsed;
+  ASSERT_TRUE(parsed.loadCached(kernelFile, "."));
+  EXPECT_FALSE(parsed.fromCache());
+
+  TextKernel cached;
+  ASSERT_TRUE(cached.loadCached(kernelFile, "."));
+  EXPECT_TRUE(cached.fromCache());
+  EXPECT_EQ(parsed.size(), cached.size());
+  expectNacConstants(cached);
+
+  // A cache file is only used for the kernel it was written for.
+  std::string cacheFile("TextKernelTest.tkc");
+  ASSERT_TRUE(parsed.writeCache(cacheFile, 1));
+  EXPECT_TRUE(cached.readCache(cacheFile, 1));
+  EXPECT_FALSE(cached.readCache(cacheFile, 2));
+  EXPECT_EQ(0u, cached.size());
+  std::remove(cacheFile.c_str());
+
+  char name[32];
+  std::string text;
+  FILE *file = fopen(kernelFile.c_str(), "rb");
+  ASSERT_TRUE(file != NULL);
+  char buffer[4096];
+  size_t count;
+  while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    text.append(buffer, count);
+  }
+  fclose(file);
+  snprintf(name, sizeof(name), "%016llx.tkc",
+           (unsigned long long)TextKernel::hash(text.data(), text.size()));
+  EXPECT_EQ(0, std::remove(name));
+}
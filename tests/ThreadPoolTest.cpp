@@ -0,0 +1,56 @@
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <ThreadPool.h>
+
+
+TEST(ThreadPoolTest, parallelFor) {
+  ThreadPool pool(4);
+  EXPECT_EQ(4, pool.threads());
+
+  // Every index is run exactly once, for several loops in a row.
+  for (int loop = 0; loop < 10; loop++) {
+    std::vector<int> hits(1000, 0);
+    pool.parallelFor(hits.size(), [&](int i) { hits[i]++; });
+    for (size_t i = 0; i < hits.size(); i++) {
+      ASSERT_EQ(1, hits[i]) << "loop " << loop << ", index " << i;
+    }
+  }
+
+  // Empty loops return at once.
+  pool.parallelFor(0, [](int) { FAIL(); });
+}
+
+
+TEST(ThreadPoolTest, singleThread) {
+  ThreadPool pool(1);
+  EXPECT_EQ(1, pool.threads());
+
+  std::vector<int> order;
+  pool.parallelFor(5, [&](int i) { order.push_back(i); });
+  ASSERT_EQ(5, order.size());
+  for (int i = 0; i < 5; i++) {
+    EXPECT_EQ(i, order[i]);
+  }
+}
+
+
+TEST(ThreadPoolTest, exception) {
+  ThreadPool pool(3);
+  std::atomic<int> ran(0);
+  EXPECT_THROW(pool.parallelFor(100, [&](int i) {
+                 ran++;
+                 if (i == 10) {
+                   throw std::runtime_error("task failed");
+                 }
+               }), std::runtime_error);
+  EXPECT_LE(ran.load(), 100);
+
+  // The pool is still usable afterwards.
+  std::atomic<int> sum(0);
+  pool.parallelFor(10, [&](int i) { sum += i; });
+  EXPECT_EQ(45, sum.load());
+}
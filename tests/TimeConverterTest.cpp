@@ -0,0 +1,143 @@
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <TextKernel.h>
+#include <TimeConverter.h>
+
+// runTest.cpp defines this global string to a data directory
+extern std::string g_dataPath;
+
+
+class TimeConverterTest : public ::testing::Test {
+  protected:
+    virtual void SetUp() {
+      TextKernel lsk;
+      ASSERT_TRUE(lsk.load(g_dataPath + "/naif0011.tls.txt"));
+      ASSERT_TRUE(converter.loadLeapseconds(lsk));
+    }
+
+    TimeConverter converter;
+};
+
+
+TEST_F(TimeConverterTest, utcToEt) {
+  double et;
+  ASSERT_TRUE(converter.utcToEt("2000-01-01T12:00:00", et));
+  EXPECT_NEAR(64.183927284731, et, 1e-9);
+
+  // The start of CN0108840044M; ISIS puts the center of its 8 ms exposure at 253624729.26689.
+  ASSERT_TRUE(converter.utcToEt("2008-01-14T23:17:44.078578", et));
+  EXPECT_NEAR(253624729.26689 - 0.004, et, 1e-5);
+
+  // Before 1972 the first TAI-UTC applies.
+  ASSERT_TRUE(converter.utcToEt("1970-01-01", et));
+
+  // A leap second is the second before the next day.
+  double leap, next;
+  ASSERT_TRUE(converter.utcToEt("2015-06-30T23:59:60", leap));
+  ASSERT_TRUE(converter.utcToEt("2015-07-01T00:00:00", next));
+  EXPECT_NEAR(1.0, next - leap, 1e-9);
+  double before;
+  ASSERT_TRUE(converter.utcToEt("2015-06-30T23:59:59", before));
+  EXPECT_NEAR(1.0, leap - before, 1e-9);
+
+  EXPECT_FALSE(converter.utcToEt("not a time", et));
+  EXPECT_FALSE(TimeConverter().utcToEt("2000-01-01T12:00:00", et));
+}
+
+
+TEST_F(TimeConverterTest, batches) {
+  std::vector<std::string> utc;
+  utc.push_back("2015-07-01T00:00:01");
+  utc.push_back("2008-01-14T23:17:44.078578");
+  utc.push_back("2008-01-14T23:17:45");
+  utc.push_back("2008-13-14");
+  utc.push_back("1999-12-31T23:59:59");
+  std::vector<double> et(utc.size());
+  EXPECT_EQ(1u, converter.utcToEt(&utc[0], utc.size(), &et[0]));
+  EXPECT_TRUE(std::isnan(et[3]));
+  for (size_t i = 0; i < utc.size(); i++) {
+    double single;
+    if (i != 3) {
+      ASSERT_TRUE(converter.utcToEt(utc[i], single));
+      EXPECT_DOUBLE_EQ(single, et[i]) << utc[i];
+    }
+  }
+
+  // UTC seconds past J2000 give the same times.
+  double seconds[] = { 5.5 * 86400 + 0.25, -43200.0, 475920000.0 };
+  double fromSeconds[3];
+  converter.utcSecondsToEt(seconds, 3, fromSeconds);
+  const char *dates[] = { "2000-01-07T00:00:00.25", "2000-01-01T00:00:00",
+                          "2015-01-30T20:00:00" };
+  for (int i = 0; i < 3; i++) {
+    double single;
+    ASSERT_TRUE(converter.utcToEt(dates[i], single));
+    EXPECT_DOUBLE_EQ(single, fromSeconds[i]) << dates[i];
+  }
+}
+
+
+TEST_F(TimeConverterTest, clock) {
+  // A two-partition clock in TDT, with the fields of the MESSENGER clock.
+  const char *sclk =
+      "\\begindata\n"
+      "SCLK_KERNEL_ID            = ( @2008-05-28 )\n"
+      "SCLK_DATA_TYPE_236        = ( 1 )\n"
+      "SCLK01_TIME_SYSTEM_236    = ( 2 )\n"
+      "SCLK01_N_FIELDS_236       = ( 2 )\n"
+      "SCLK01_MODULI_236         = ( 4294967296 1000000 )\n"
+      "SCLK01_OFFSETS_236        = ( 0 0 )\n"
+      "SCLK_PARTITION_START_236  = ( 0.0 1.0E14 )\n"
+      "SCLK_PARTITION_END_236    = ( 5.0E13 2.0E15 )\n"
+      "SCLK01_COEFFICIENTS_236   = ( 0.0 -1.0D8 1.0\n"
+      "                              5.0E13 2.5E8 0.99999 )\n";
+  TextKernel kernel;
+  ASSERT_TRUE(kernel.parse(sclk, strlen(sclk), "sclk"));
+  EXPECT_FALSE(TimeConverter().loadClock(kernel, -236));   // TDT needs the leapseconds.
+  EXPECT_FALSE(converter.loadClock(kernel, -82));
+  ASSERT_TRUE(converter.loadClock(kernel, -236));
+
+  double ticks;
+  ASSERT_TRUE(converter.sclkToTicks("2/0108840044:982000", ticks));
+  EXPECT_DOUBLE_EQ(5.0e13 + 8840044982000.0, ticks);
+  double automatic;
+  ASSERT_TRUE(converter.sclkToTicks("0108840044.982000", automatic));
+  EXPECT_DOUBLE_EQ(ticks, automatic);
+
+  double et, tdt;
+  ASSERT_TRUE(converter.sclkToEt("2/0108840044:982000", et));
+  tdt = 2.5e8 + 0.99999 * 8840044.982;
+  double expected;
+  converter.tdtToEt(&tdt, 1, &expected);
+  EXPECT_NEAR(expected, et, 1e-6);
+
+  ASSERT_TRUE(converter.sclkToEt("1/1000:5", et));
+  tdt = -1.0e8 + 1000.000005;
+  converter.tdtToEt(&tdt, 1, &expected);
+  EXPECT_NEAR(expected, et, 1e-6);
+
+  const char *invalid[] = { "1/0108840044:982000", "3/1", "2/0108840044:1000000", "1:2:3",
+                            "", "x" };
+  for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+    EXPECT_FALSE(converter.sclkToTicks(invalid[i], ticks)) << invalid[i];
+  }
+
+  std::string readings[] = { "1/1000:5", "1/2", "bad", "2/0108840044:982000" };
+  double batch[4];
+  EXPECT_EQ(1u, converter.sclkToEt(readings, 4, batch));
+  EXPECT_TRUE(std::isnan(batch[2]));
+  EXPECT_DOUBLE_EQ(et, batch[0]);
+  ASSERT_TRUE(converter.sclkToEt(readings[3], et));
+  EXPECT_DOUBLE_EQ(et, batch[3]);
+
+  double encoded[] = { 1.0e9, 4.0e13, 5.0e13, 6.0e13 };
+  double fromTicks[4];
+  converter.ticksToEt(encoded, 4, fromTicks);
+  EXPECT_LT(fromTicks[1], fromTicks[2]);
+  EXPECT_NEAR(0.99999 * 1.0e7, fromTicks[3] - fromTicks[2], 1e-2);
+}
@@ -1,7 +1,10 @@
 #include <math.h>
+#include <string.h>
 #include <transformations.h>
+#include <UnitQuaternion.h>
 #include <Eigen/Dense>
 #include <iostream>
+#include <vector>
 #include <gtest/gtest.h>
 
 class TransformationsTest : public ::testing::Test {
@@ -24,3 +27,201 @@ TEST_F(TransformationsTest, OpkToRotation){
   float k = (15 * M_PI) / 180;
   ASSERT_TRUE(rot.isApprox(opkToRotation(o,p,k), tolerance));
 }
+
+TEST_F(TransformationsTest, OpkToRotationBatch){
+  double opk[] = { 0.1, -0.2, 0.3,
+                   -2.5, 1.2, 3.0,
+                   0.0, 0.0, 0.0 };
+  double rotations[27];
+  double derivatives[81];
+  opkToRotation(opk, 3, rotations, derivatives);
+
+  const double h = 1e-6;
+  for (int i = 0; i < 3; i++) {
+    // The matrices are k*p*o.
+    Eigen::Matrix3d o = Eigen::AngleAxisd(-opk[3 * i], Eigen::Vector3d::UnitX()).matrix();
+    Eigen::Matrix3d p = Eigen::AngleAxisd(-opk[3 * i + 1], Eigen::Vector3d::UnitY()).matrix();
+    Eigen::Matrix3d k = Eigen::AngleAxisd(-opk[3 * i + 2], Eigen::Vector3d::UnitZ()).matrix();
+    Eigen::Matrix3d expected = k * p * o;
+    for (int j = 0; j < 9; j++) {
+      EXPECT_NEAR(expected(j / 3, j % 3), rotations[9 * i + j], 1e-15) << i << " " << j;
+    }
+
+    // The derivatives match central differences.
+    for (int angle = 0; angle < 3; angle++) {
+      double plus[3] = { opk[3 * i], opk[3 * i + 1], opk[3 * i + 2] };
+      double minus[3] = { opk[3 * i], opk[3 * i + 1], opk[3 * i + 2] };
+      plus[angle] += h;
+      minus[angle] -= h;
+      double mPlus[9], mMinus[9];
+      opkToRotation(plus, 1, mPlus);
+      opkToRotation(minus, 1, mMinus);
+      for (int j = 0; j < 9; j++) {
+        EXPECT_NEAR((mPlus[j] - mMinus[j]) / (2 * h), derivatives[27 * i + 9 * angle + j], 1e-9)
+            << i << " " << angle << " " << j;
+      }
+    }
+  }
+
+  double single[9];
+  opkToRotation(opk + 3, 1, single);
+  EXPECT_EQ(0, memcmp(rotations + 9, single, sizeof(single)));
+
+  double angles[9];
+  rotationToOpk(rotations, 3, angles);
+  EXPECT_NEAR(0.1, angles[0], 1e-12);
+  EXPECT_NEAR(-0.2, angles[1], 1e-12);
+  EXPECT_NEAR(0.3, angles[2], 1e-12);
+  // Angles are recovered modulo 2 pi, with phi in [-pi/2, pi/2].
+  double again[27];
+  opkToRotation(angles, 3, again);
+  for (int j = 0; j < 27; j++) {
+    EXPECT_NEAR(rotations[j], again[j], 1e-12) << j;
+  }
+}
+
+TEST_F(TransformationsTest, Quaternion){
+  const double angles[][3] = { { 0.1, -0.2, 0.3 }, { -2.5, 1.2, 3.0 }, { 3.1, 0.0, -3.1 },
+                               { 0.0, 1.5707, 0.0 } };
+  for (int i = 0; i < 4; i++) {
+    double expected[9], fromOpk[9], fromMatrix[9];
+    opkToRotation(angles[i], 1, expected);
+    UnitQuaternion q = UnitQuaternion::fromOpk(angles[i][0], angles[i][1], angles[i][2]);
+    q.toRotation(fromOpk);
+    UnitQuaternion::fromRotation(expected).toRotation(fromMatrix);
+    for (int j = 0; j < 9; j++) {
+      EXPECT_NEAR(expected[j], fromOpk[j], 1e-15) << i << " " << j;
+      EXPECT_NEAR(expected[j], fromMatrix[j], 1e-15) << i << " " << j;
+    }
+
+    double v[3] = { 1.0, -2.0, 0.5 }, rotated[3];
+    q.rotate(v, rotated);
+    for (int j = 0; j < 3; j++) {
+      EXPECT_NEAR(expected[3 * j] * v[0] + expected[3 * j + 1] * v[1] +
+                  expected[3 * j + 2] * v[2], rotated[j], 1e-15);
+    }
+  }
+
+  // Products compose the matrices; the conjugate undoes a rotation.
+  UnitQuaternion a = UnitQuaternion::fromOpk(0.1, -0.2, 0.3);
+  UnitQuaternion b = UnitQuaternion::fromOpk(-2.5, 1.2, 3.0);
+  double ma[9], mb[9], mab[9];
+  a.toRotation(ma);
+  b.toRotation(mb);
+  (a * b).toRotation(mab);
+  Eigen::Map<Eigen::Matrix<double, 3, 3, Eigen::RowMajor> > matrixA(ma), matrixB(mb),
+      matrixAB(mab);
+  EXPECT_TRUE(matrixAB.isApprox(matrixA * matrixB, 1e-14));
+  EXPECT_NEAR(1.0, fabs((a * a.conjugate()).w), 1e-15);
+
+  // Interpolation: the ends, constant rate and the shorter arc.
+  UnitQuaternion start = UnitQuaternion::fromOpk(0.0, 0.0, 0.2);
+  UnitQuaternion end = UnitQuaternion::fromOpk(0.0, 0.0, 1.2);
+  UnitQuaternion negated(-end.w, -end.x, -end.y, -end.z);
+  double m[9];
+  for (double t = 0.0; t <= 1.0; t += 0.125) {
+    UnitQuaternion::slerp(start, end, t).toRotation(m);
+    EXPECT_NEAR(-(0.2 + t), atan2(m[3], m[0]), 1e-14) << t;
+    UnitQuaternion::slerp(start, negated, t).toRotation(m);
+    EXPECT_NEAR(-(0.2 + t), atan2(m[3], m[0]), 1e-14) << t;
+    UnitQuaternion::nlerp(start, end, t).toRotation(m);
+    EXPECT_NEAR(-(0.2 + t), atan2(m[3], m[0]), 0.02) << t;
+  }
+  UnitQuaternion::nlerp(start, end, 0.5).toRotation(m);
+  EXPECT_NEAR(-0.7, atan2(m[3], m[0]), 1e-14);
+  UnitQuaternion near = UnitQuaternion::fromOpk(0.0, 0.0, 0.2 + 1e-9);
+  UnitQuaternion::slerp(start, near, 0.5).toRotation(m);
+  EXPECT_NEAR(-(0.2 + 0.5e-9), atan2(m[3], m[0]), 1e-15);
+
+  UnitQuaternion batch[2] = { a, b };
+  double rotations[18];
+  quaternionsToRotations(batch, 2, rotations);
+  EXPECT_EQ(0, memcmp(rotations, ma, sizeof(ma)));
+  EXPECT_EQ(0, memcmp(rotations + 9, mb, sizeof(mb)));
+}
+
+TEST_F(TransformationsTest, Geodetic){
+  // WGS84 and a sphere of Mercury's radius, in meters.
+  const double axes[][2] = { { 6378137.0, 6356752.314245 }, { 2439400.0, 2439400.0 } };
+  for (int body = 0; body < 2; body++) {
+    double a = axes[body][0], b = axes[body][1];
+    double points[] = { a, 0.0, 0.0,   0.0, 0.0, b,   0.0, -a - 1000.0, 0.0,
+                        0.0, 0.0, -b + 500.0 };
+    double geodetic[12];
+    ecefToGeodetic(points, 4, a, b, geodetic);
+    const double expected[] = { 0.0, 0.0, 0.0,   M_PI / 2, 0.0, 0.0,   0.0, -M_PI / 2, 1000.0,
+                                -M_PI / 2, 0.0, -500.0 };
+    for (int i = 0; i < 12; i++) {
+      EXPECT_NEAR(expected[i], geodetic[i], i % 3 == 2 ? 1e-6 : 1e-12) << body << " " << i;
+    }
+
+    // Off-body pixels are marked with NaN points, which stay NaN.
+    double missing[3] = { NAN, NAN, NAN };
+    ecefToGeodetic(missing, 1, a, b, missing);
+    for (int i = 0; i < 3; i++) {
+      EXPECT_TRUE(std::isnan(missing[i])) << body << " " << i;
+    }
+
+    // Round trips, in place, from the pole to the equator and below to above the surface.
+    std::vector<double> triples;
+    for (double lat = -90.0; lat <= 90.0; lat += 7.5) {
+      for (double lon = -180.0; lon < 180.0; lon += 45.0) {
+        for (double height = -8000.0; height <= 1e6; height += 252000.0) {
+          triples.push_back(lat * M_PI / 180.0);
+          triples.push_back(lon * M_PI / 180.0);
+          triples.push_back(height);
+        }
+      }
+    }
+    std::vector<double> converted(triples);
+    size_t count = triples.size() / 3;
+    geodeticToEcef(&converted[0], count, a, b, &converted[0]);
+    ecefToGeodetic(&converted[0], count, a, b, &converted[0]);
+    for (size_t i = 0; i < triples.size(); i += 3) {
+      EXPECT_NEAR(triples[i], converted[i], 1e-11) << body << " " << i;
+      if (fabs(triples[i]) < M_PI / 2 - 1e-6) {
+        EXPECT_NEAR(0.0, remainder(triples[i + 1] - converted[i + 1], 2 * M_PI), 1e-11);
+      }
+      EXPECT_NEAR(triples[i + 2], converted[i + 2], 1e-6) << body << " " << i;
+    }
+  }
+}
+
+TEST_F(TransformationsTest, Enu){
+  double a = 6378137.0, b = 6356752.314245;
+  const double origin[3] = { 0.6, -1.9, 250.0 };
+  double center[3];
+  geodeticToEcef(origin, 1, a, b, center);
+
+  // A point straight above the origin, and one a little north and east of it.
+  double above[3] = { origin[0], origin[1], origin[2] + 100.0 };
+  double offset[3] = { origin[0] + 1e-5, origin[1] + 1e-5, origin[2] };
+  double points[9];
+  memcpy(points, center, sizeof(center));
+  geodeticToEcef(above, 1, a, b, points + 3);
+  geodeticToEcef(offset, 1, a, b, points + 6);
+
+  double enu[9];
+  ecefToEnu(points, 3, origin, a, b, enu);
+  for (int i = 0; i < 3; i++) {
+    EXPECT_NEAR(0.0, enu[i], 1e-8);
+  }
+  EXPECT_NEAR(0.0, enu[3], 1e-8);
+  EXPECT_NEAR(0.0, enu[4], 1e-8);
+  EXPECT_NEAR(100.0, enu[5], 1e-8);
+  EXPECT_GT(enu[6], 40.0);
+  EXPECT_GT(enu[7], 60.0);
+  EXPECT_NEAR(0.0, enu[8], 1e-3);
+
+  double back[9];
+  enuToEcef(enu, 3, origin, a, b, back);
+  for (int i = 0; i < 9; i++) {
+    EXPECT_NEAR(points[i], back[i], 1e-8) << i;
+  }
+
+  double missing[3] = { NAN, NAN, NAN };
+  ecefToEnu(missing, 1, origin, a, b, missing);
+  for (int i = 0; i < 3; i++) {
+    EXPECT_TRUE(std::isnan(missing[i])) << i;
+  }
+}